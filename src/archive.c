@@ -0,0 +1,805 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "config.h"
+#include "archive.h"
+#include "util.h"
+#include "compat.h"
+
+#define BBBM_ARCHIVE_BUFFER_SIZE            65536
+/* extracted files are kept for a while, since the set command may still be reading them */
+#define BBBM_ARCHIVE_MAX_EXTRACTED          8
+
+/* a zip file ends with the end of central directory record, followed by a comment of at most 65535 bytes */
+#define BBBM_ARCHIVE_ZIP_END_SIZE           22
+#define BBBM_ARCHIVE_ZIP_MAX_COMMENT        65535
+#define BBBM_ARCHIVE_ZIP_END_SIGNATURE      0x06054b50
+#define BBBM_ARCHIVE_ZIP_CENTRAL_SIZE       46
+#define BBBM_ARCHIVE_ZIP_CENTRAL_SIGNATURE  0x02014b50
+#define BBBM_ARCHIVE_ZIP_LOCAL_SIZE         30
+#define BBBM_ARCHIVE_ZIP_LOCAL_SIGNATURE    0x04034b50
+#define BBBM_ARCHIVE_ZIP_STORED             0
+#define BBBM_ARCHIVE_ZIP_DEFLATED           8
+/* sizes and offsets that do not fit in 32 bits are stored in zip64 extra fields instead */
+#define BBBM_ARCHIVE_ZIP_64                 0xFFFFFFFF
+
+#define BBBM_ARCHIVE_TAR_BLOCK_SIZE         512
+
+#define BBBM_ARCHIVE_READ16(data)  ((guint) (data)[0] | ((guint) (data)[1] << 8))
+#define BBBM_ARCHIVE_READ32(data)  ((guint32) BBBM_ARCHIVE_READ16(data) | ((guint32) BBBM_ARCHIVE_READ16((data) + 2) << 16))
+
+typedef enum {
+    /* members are read directly from the file */
+    BBBM_ARCHIVE_ZIP,
+    /* members are read through zlib, which reads files that are not gzipped as they are */
+    BBBM_ARCHIVE_TAR
+} BBBMArchiveFormat;
+
+typedef struct {
+    /* for zip members the offset of their local header, which the data follows;
+       for tar members the offset of the data in the uncompressed archive */
+    gint64 offset;
+    /* the number of bytes stored in the archive */
+    gint64 size;
+    gboolean deflated;
+} BBBMArchiveMember;
+
+typedef struct {
+    BBBMArchiveFormat format;
+    time_t mtime;
+    gint64 size;
+    /* name -> BBBMArchiveMember; empty if the archive could not be read */
+    GHashTable *members;
+    /* the names in the order they are stored in; owned by members */
+    GPtrArray *names;
+} BBBMArchiveIndex;
+
+typedef struct {
+    FILE *file;
+    gzFile gz;
+    gboolean inflating;
+    z_stream inflater;
+    guchar *input;
+    /* the number of stored bytes that have not been read yet */
+    gint64 remaining;
+} BBBMArchiveStream;
+
+static const gchar *bbbm_archive_zip_extensions[] = { ".zip", NULL };
+static const gchar *bbbm_archive_tar_extensions[] = { ".tar", ".tar.gz", ".tgz", NULL };
+
+/* archive -> BBBMArchiveIndex */
+static GHashTable *bbbm_archive_indexes = NULL;
+G_LOCK_DEFINE_STATIC(bbbm_archive_indexes);
+
+static gboolean bbbm_archive_get_format(const gchar *filename, gsize length, BBBMArchiveFormat *format);
+static gboolean bbbm_archive_split(const gchar *filename, gchar **archive, const gchar **name);
+static gboolean bbbm_archive_find(const gchar *filename, gchar **archive, BBBMArchiveFormat *format,
+                                  BBBMArchiveMember *member);
+static BBBMArchiveIndex *bbbm_archive_get_index(const gchar *archive);
+static void bbbm_archive_read_zip(const gchar *archive, BBBMArchiveIndex *index);
+static void bbbm_archive_read_tar(const gchar *archive, BBBMArchiveIndex *index);
+static gint64 bbbm_archive_parse_tar_number(const guchar *data, gsize length);
+static void bbbm_archive_index_add(BBBMArchiveIndex *index, gchar *name, gint64 offset, gint64 size,
+                                   gboolean deflated);
+static void bbbm_archive_index_destroy(BBBMArchiveIndex *index);
+static gboolean bbbm_archive_open(const gchar *filename, BBBMArchiveStream *stream, GError **error);
+static gssize bbbm_archive_read(BBBMArchiveStream *stream, guchar *buffer, gsize length, GError **error);
+static void bbbm_archive_close(BBBMArchiveStream *stream);
+static void bbbm_archive_size_prepared(GdkPixbufLoader *loader, gint width, gint height, gint *size);
+static gchar *bbbm_archive_get_extracted_file(const gchar *filename, const gchar *archive, const gchar *directory);
+static void bbbm_archive_prune(const gchar *directory);
+static gint bbbm_archive_compare_mtime(const gchar *file1, const gchar *file2, GHashTable *mtimes);
+
+gboolean bbbm_archive_is_archive(const gchar *filename) {
+    BBBMArchiveFormat format;
+
+    g_return_val_if_fail(filename != NULL, FALSE);
+    return bbbm_archive_get_format(filename, strlen(filename), &format);
+}
+
+gboolean bbbm_archive_is_member(const gchar *filename) {
+    BBBMArchiveFormat format;
+    BBBMArchiveMember member;
+    gchar *archive;
+
+    g_return_val_if_fail(filename != NULL, FALSE);
+
+    if (!bbbm_archive_find(filename, &archive, &format, &member)) {
+        return FALSE;
+    }
+    g_free(archive);
+    return TRUE;
+}
+
+GList *bbbm_archive_list(const gchar *archive) {
+    BBBMArchiveIndex *index;
+    GList *files = NULL;
+    guint i;
+
+    g_return_val_if_fail(archive != NULL, NULL);
+
+    G_LOCK(bbbm_archive_indexes);
+    index = bbbm_archive_get_index(archive);
+    for (i = index != NULL ? index->names->len : 0; i > 0; --i) {
+        files = g_list_prepend(files, g_build_filename(archive, g_ptr_array_index(index->names, i - 1), NULL));
+    }
+    G_UNLOCK(bbbm_archive_indexes);
+    return files;
+}
+
+GdkPixbuf *bbbm_archive_load(const gchar *filename, gint width, gint height, GError **error) {
+    BBBMArchiveStream stream;
+    GdkPixbufLoader *loader;
+    GdkPixbuf *pixbuf = NULL;
+    guchar *buffer;
+    gssize read;
+    gint size[2];
+
+    g_return_val_if_fail(filename != NULL, NULL);
+
+    if (!bbbm_archive_open(filename, &stream, error)) {
+        return NULL;
+    }
+    loader = gdk_pixbuf_loader_new();
+    if (width > 0 && height > 0) {
+        /* loaders such as the JPEG one decode a lot faster at reduced sizes */
+        size[0] = width;
+        size[1] = height;
+        g_signal_connect(G_OBJECT(loader), "size-prepared", G_CALLBACK(bbbm_archive_size_prepared), size);
+    }
+    buffer = g_malloc(BBBM_ARCHIVE_BUFFER_SIZE);
+    while ((read = bbbm_archive_read(&stream, buffer, BBBM_ARCHIVE_BUFFER_SIZE, error)) > 0) {
+        if (!gdk_pixbuf_loader_write(loader, buffer, read, error)) {
+            read = -1;
+            break;
+        }
+    }
+    g_free(buffer);
+    bbbm_archive_close(&stream);
+
+    /* closing also reports images that have been cut short, but only one error can be reported */
+    if (gdk_pixbuf_loader_close(loader, read < 0 ? NULL : error) && read == 0) {
+        pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+        if (pixbuf != NULL) {
+            g_object_ref(pixbuf);
+        } else {
+            g_set_error(error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_UNKNOWN_TYPE, "'%s' is not an image", filename);
+        }
+    }
+    g_object_unref(loader);
+    return pixbuf;
+}
+
+gchar *bbbm_archive_extract(const gchar *filename, const gchar *directory) {
+    BBBMArchiveStream stream;
+    BBBMArchiveFormat format;
+    BBBMArchiveMember member;
+    GError *error = NULL;
+    gchar *archive, *extracted, *partial;
+    guchar *buffer;
+    gssize read;
+    FILE *file;
+    gboolean result;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+    g_return_val_if_fail(directory != NULL, NULL);
+
+    if (!bbbm_archive_find(filename, &archive, &format, &member)) {
+        g_warning("could not find '%s' in an archive", filename);
+        return NULL;
+    }
+    extracted = bbbm_archive_get_extracted_file(filename, archive, directory);
+    g_free(archive);
+    if (extracted == NULL) {
+        return NULL;
+    }
+    if (g_file_test(extracted, G_FILE_TEST_IS_REGULAR)) {
+        /* touched, so pruning treats it as recently used */
+        utime(extracted, NULL);
+        return extracted;
+    }
+
+    if (!g_file_test(directory, G_FILE_TEST_IS_DIR) && mkdir(directory, 0700) == -1) {
+        g_warning("could not create directory '%s': %s", directory, g_strerror(errno));
+        g_free(extracted);
+        return NULL;
+    }
+    if (!bbbm_archive_open(filename, &stream, &error)) {
+        g_warning("could not extract '%s': %s", filename, error->message);
+        g_error_free(error);
+        g_free(extracted);
+        return NULL;
+    }
+    /* written under another name first, so a partial file is never mistaken for an extracted one */
+    partial = g_strconcat(extracted, ".part", NULL);
+    file = g_fopen(partial, "wb");
+    if (file == NULL) {
+        g_warning("could not write to '%s': %s", partial, g_strerror(errno));
+        bbbm_archive_close(&stream);
+        g_free(partial);
+        g_free(extracted);
+        return NULL;
+    }
+    buffer = g_malloc(BBBM_ARCHIVE_BUFFER_SIZE);
+    result = TRUE;
+    while (result && (read = bbbm_archive_read(&stream, buffer, BBBM_ARCHIVE_BUFFER_SIZE, &error)) != 0) {
+        if (read < 0) {
+            g_warning("could not extract '%s': %s", filename, error->message);
+            g_error_free(error);
+            result = FALSE;
+        } else if (fwrite(buffer, 1, read, file) != (gsize) read) {
+            g_warning("could not write to '%s': %s", partial, g_strerror(errno));
+            result = FALSE;
+        }
+    }
+    g_free(buffer);
+    bbbm_archive_close(&stream);
+    if (fclose(file) != 0 && result) {
+        g_warning("could not write to '%s': %s", partial, g_strerror(errno));
+        result = FALSE;
+    }
+    if (result && g_rename(partial, extracted) == -1) {
+        g_warning("could not rename '%s' to '%s': %s", partial, extracted, g_strerror(errno));
+        result = FALSE;
+    }
+    if (!result) {
+        g_remove(partial);
+        g_free(extracted);
+        extracted = NULL;
+    }
+    g_free(partial);
+    bbbm_archive_prune(directory);
+    return extracted;
+}
+
+static gboolean bbbm_archive_get_format(const gchar *filename, gsize length, BBBMArchiveFormat *format) {
+    guint i;
+
+    for (i = 0; bbbm_archive_zip_extensions[i] != NULL; ++i) {
+        gsize ext_length = strlen(bbbm_archive_zip_extensions[i]);
+        if (length > ext_length
+                && strncmp(filename + length - ext_length, bbbm_archive_zip_extensions[i], ext_length) == 0) {
+            *format = BBBM_ARCHIVE_ZIP;
+            return TRUE;
+        }
+    }
+    for (i = 0; bbbm_archive_tar_extensions[i] != NULL; ++i) {
+        gsize ext_length = strlen(bbbm_archive_tar_extensions[i]);
+        if (length > ext_length
+                && strncmp(filename + length - ext_length, bbbm_archive_tar_extensions[i], ext_length) == 0) {
+            *format = BBBM_ARCHIVE_TAR;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static gboolean bbbm_archive_split(const gchar *filename, gchar **archive, const gchar **name) {
+    BBBMArchiveFormat format;
+    const gchar *separator;
+
+    /* the extension is checked first, so only possible archives are looked up on disk */
+    for (separator = strchr(filename, '/'); separator != NULL; separator = strchr(separator + 1, '/')) {
+        if (bbbm_archive_get_format(filename, separator - filename, &format)) {
+            gchar *prefix = g_strndup(filename, separator - filename);
+
+            if (g_file_test(prefix, G_FILE_TEST_IS_REGULAR)) {
+                *archive = prefix;
+                *name = separator + 1;
+                return TRUE;
+            }
+            g_free(prefix);
+        }
+    }
+    return FALSE;
+}
+
+static gboolean bbbm_archive_find(const gchar *filename, gchar **archive, BBBMArchiveFormat *format,
+                                  BBBMArchiveMember *member) {
+    BBBMArchiveIndex *index;
+    BBBMArchiveMember *found = NULL;
+    const gchar *name;
+
+    if (!bbbm_archive_split(filename, archive, &name)) {
+        return FALSE;
+    }
+    G_LOCK(bbbm_archive_indexes);
+    index = bbbm_archive_get_index(*archive);
+    if (index != NULL && (found = (BBBMArchiveMember *) g_hash_table_lookup(index->members, name)) != NULL) {
+        /* copied, since the index may be replaced by another thread as soon as the lock is released */
+        *format = index->format;
+        *member = *found;
+    }
+    G_UNLOCK(bbbm_archive_indexes);
+    if (found == NULL) {
+        g_free(*archive);
+        *archive = NULL;
+    }
+    return found != NULL;
+}
+
+/* must be called with the lock held. The lock is released while the archive is looked at and read, so other
+   threads, the main thread in particular, are not held up by a large archive; it is held again on return */
+static BBBMArchiveIndex *bbbm_archive_get_index(const gchar *archive) {
+    BBBMArchiveIndex *index, *existing;
+    struct stat info;
+    gboolean found;
+
+    if (bbbm_archive_indexes == NULL) {
+        bbbm_archive_indexes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                     (GDestroyNotify) bbbm_archive_index_destroy);
+    }
+    G_UNLOCK(bbbm_archive_indexes);
+    found = g_stat(archive, &info) == 0;
+    G_LOCK(bbbm_archive_indexes);
+    if (!found) {
+        g_hash_table_remove(bbbm_archive_indexes, archive);
+        return NULL;
+    }
+    index = (BBBMArchiveIndex *) g_hash_table_lookup(bbbm_archive_indexes, archive);
+    if (index != NULL && index->mtime == info.st_mtime && index->size == info.st_size) {
+        return index;
+    }
+
+    G_UNLOCK(bbbm_archive_indexes);
+    index = g_malloc(sizeof(BBBMArchiveIndex));
+    index->mtime   = info.st_mtime;
+    index->size    = info.st_size;
+    index->members = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    index->names   = g_ptr_array_new();
+    if (!bbbm_archive_get_format(archive, strlen(archive), &(index->format))) {
+        /* not an archive; kept so it is not looked at again */
+    } else if (index->format == BBBM_ARCHIVE_ZIP) {
+        bbbm_archive_read_zip(archive, index);
+    } else {
+        bbbm_archive_read_tar(archive, index);
+    }
+    g_debug("read %u members from '%s'", index->names->len, archive);
+    G_LOCK(bbbm_archive_indexes);
+
+    /* another thread may have read the same archive in the meantime; the first one wins */
+    existing = (BBBMArchiveIndex *) g_hash_table_lookup(bbbm_archive_indexes, archive);
+    if (existing != NULL && existing->mtime == index->mtime && existing->size == index->size) {
+        bbbm_archive_index_destroy(index);
+        return existing;
+    }
+    g_hash_table_insert(bbbm_archive_indexes, g_strdup(archive), index);
+    return index;
+}
+
+static void bbbm_archive_read_zip(const gchar *archive, BBBMArchiveIndex *index) {
+    guchar *buffer, *end, *entry;
+    gsize tail;
+    gint64 directory_offset, directory_size;
+    guint count, i;
+    FILE *file;
+
+    file = g_fopen(archive, "rb");
+    if (file == NULL) {
+        g_warning("could not read '%s': %s", archive, g_strerror(errno));
+        return;
+    }
+    /* only the central directory at the end is read; the members themselves are not touched */
+    tail = (gsize) MIN(index->size, BBBM_ARCHIVE_ZIP_END_SIZE + BBBM_ARCHIVE_ZIP_MAX_COMMENT);
+    buffer = g_malloc(MAX(tail, 1));
+    if (fseeko(file, (off_t) (index->size - tail), SEEK_SET) != 0 || fread(buffer, 1, tail, file) != tail) {
+        g_warning("could not read '%s': %s", archive, g_strerror(errno));
+        g_free(buffer);
+        fclose(file);
+        return;
+    }
+    /* searched backwards, since the comment could contain the signature as well */
+    for (entry = NULL, i = tail >= BBBM_ARCHIVE_ZIP_END_SIZE ? tail - BBBM_ARCHIVE_ZIP_END_SIZE + 1 : 0; i > 0; --i) {
+        if (BBBM_ARCHIVE_READ32(buffer + i - 1) == BBBM_ARCHIVE_ZIP_END_SIGNATURE) {
+            entry = buffer + i - 1;
+            break;
+        }
+    }
+    if (entry == NULL) {
+        g_warning("could not read '%s': not a zip file", archive);
+        g_free(buffer);
+        fclose(file);
+        return;
+    }
+    count            = BBBM_ARCHIVE_READ16(entry + 10);
+    directory_size   = BBBM_ARCHIVE_READ32(entry + 12);
+    directory_offset = BBBM_ARCHIVE_READ32(entry + 16);
+    g_free(buffer);
+    if (directory_offset + directory_size > index->size) {
+        g_warning("could not read '%s': zip64 archives are not supported", archive);
+        fclose(file);
+        return;
+    }
+
+    buffer = g_malloc(MAX(directory_size, 1));
+    if (fseeko(file, (off_t) directory_offset, SEEK_SET) != 0
+            || fread(buffer, 1, directory_size, file) != (gsize) directory_size) {
+        g_warning("could not read '%s': %s", archive, g_strerror(errno));
+        g_free(buffer);
+        fclose(file);
+        return;
+    }
+    fclose(file);
+
+    end = buffer + directory_size;
+    for (entry = buffer, i = 0; i < count && entry + BBBM_ARCHIVE_ZIP_CENTRAL_SIZE <= end; ++i) {
+        guint flags, method, name_length, extra_length, comment_length;
+        guint32 size, length, offset;
+        gchar *name;
+
+        if (BBBM_ARCHIVE_READ32(entry) != BBBM_ARCHIVE_ZIP_CENTRAL_SIGNATURE) {
+            g_warning("could not read all of '%s': corrupt central directory", archive);
+            break;
+        }
+        flags          = BBBM_ARCHIVE_READ16(entry + 8);
+        method         = BBBM_ARCHIVE_READ16(entry + 10);
+        size           = BBBM_ARCHIVE_READ32(entry + 20);
+        length         = BBBM_ARCHIVE_READ32(entry + 24);
+        name_length    = BBBM_ARCHIVE_READ16(entry + 28);
+        extra_length   = BBBM_ARCHIVE_READ16(entry + 30);
+        comment_length = BBBM_ARCHIVE_READ16(entry + 32);
+        offset         = BBBM_ARCHIVE_READ32(entry + 42);
+        if (entry + BBBM_ARCHIVE_ZIP_CENTRAL_SIZE + name_length > end) {
+            g_warning("could not read all of '%s': corrupt central directory", archive);
+            break;
+        }
+        name = g_strndup((const gchar *) entry + BBBM_ARCHIVE_ZIP_CENTRAL_SIZE, name_length);
+        if (name_length == 0 || name[name_length - 1] == '/') {
+            /* a directory */
+            g_free(name);
+        } else if ((flags & 1) != 0) {
+            g_debug("skipping encrypted member '%s' of '%s'", name, archive);
+            g_free(name);
+        } else if (method != BBBM_ARCHIVE_ZIP_STORED && method != BBBM_ARCHIVE_ZIP_DEFLATED) {
+            g_debug("skipping member '%s' of '%s': compression method %u is not supported", name, archive, method);
+            g_free(name);
+        } else if (size == BBBM_ARCHIVE_ZIP_64 || length == BBBM_ARCHIVE_ZIP_64 || offset == BBBM_ARCHIVE_ZIP_64) {
+            g_debug("skipping member '%s' of '%s': zip64 members are not supported", name, archive);
+            g_free(name);
+        } else {
+            bbbm_archive_index_add(index, name, offset, size, method == BBBM_ARCHIVE_ZIP_DEFLATED);
+        }
+        entry += BBBM_ARCHIVE_ZIP_CENTRAL_SIZE + name_length + extra_length + comment_length;
+    }
+    g_free(buffer);
+}
+
+static void bbbm_archive_read_tar(const gchar *archive, BBBMArchiveIndex *index) {
+    guchar header[BBBM_ARCHIVE_TAR_BLOCK_SIZE];
+    gchar *long_name = NULL;
+    gint64 offset = 0;
+    gzFile gz;
+
+    gz = gzopen(archive, "rb");
+    if (gz == NULL) {
+        g_warning("could not read '%s': %s", archive, g_strerror(errno));
+        return;
+    }
+    /* tar files have no central directory; the headers are read, and the data in between is skipped */
+    while (gzread(gz, header, BBBM_ARCHIVE_TAR_BLOCK_SIZE) == BBBM_ARCHIVE_TAR_BLOCK_SIZE && header[0] != '\0') {
+        gint64 size, blocks;
+        gchar type, *name;
+
+        offset += BBBM_ARCHIVE_TAR_BLOCK_SIZE;
+        size = bbbm_archive_parse_tar_number(header + 124, 12);
+        type = header[156];
+        blocks = (size + BBBM_ARCHIVE_TAR_BLOCK_SIZE - 1) / BBBM_ARCHIVE_TAR_BLOCK_SIZE * BBBM_ARCHIVE_TAR_BLOCK_SIZE;
+        if (size < 0) {
+            g_warning("could not read all of '%s': corrupt header", archive);
+            break;
+        }
+        if (type == 'L') {
+            /* a GNU long name; the data is the name of the next member */
+            if (size >= PATH_MAX) {
+                g_warning("could not read all of '%s': corrupt header", archive);
+                break;
+            }
+            g_free(long_name);
+            long_name = g_malloc0(size + 1);
+            if (gzread(gz, long_name, (unsigned) size) != size) {
+                break;
+            }
+        } else {
+            if (long_name != NULL) {
+                name = long_name;
+                long_name = NULL;
+            } else if (memcmp(header + 257, "ustar", 5) == 0 && header[345] != '\0') {
+                name = g_strdup_printf("%.155s/%.100s", (const gchar *) header + 345, (const gchar *) header);
+            } else {
+                name = g_strndup((const gchar *) header, 100);
+            }
+            if (g_str_has_prefix(name, "./")) {
+                memmove(name, name + 2, strlen(name + 2) + 1);
+            }
+            if ((type == '0' || type == '\0') && *name != '\0') {
+                bbbm_archive_index_add(index, name, offset, size, FALSE);
+            } else {
+                g_free(name);
+            }
+        }
+        offset += blocks;
+        if (gzseek(gz, (z_off_t) offset, SEEK_SET) != offset) {
+            g_warning("could not read all of '%s': the archive is cut short", archive);
+            break;
+        }
+    }
+    g_free(long_name);
+    gzclose(gz);
+}
+
+static gint64 bbbm_archive_parse_tar_number(const guchar *data, gsize length) {
+    gint64 result = 0;
+    gsize i;
+
+    if ((data[0] & 0x80) != 0) {
+        /* GNU base-256 encoding, for sizes that do not fit in 11 octal digits */
+        result = data[0] & 0x7F;
+        for (i = 1; i < length; ++i) {
+            result = (result << 8) | data[i];
+        }
+        return result;
+    }
+    for (i = 0; i < length && (data[i] == ' ' || data[i] == '0'); ++i) {
+        /* skip leading spaces and zeroes */
+    }
+    for (; i < length && data[i] >= '0' && data[i] <= '7'; ++i) {
+        result = (result << 3) | (data[i] - '0');
+    }
+    if (i < length && data[i] != ' ' && data[i] != '\0') {
+        return -1;
+    }
+    return result;
+}
+
+static void bbbm_archive_index_add(BBBMArchiveIndex *index, gchar *name, gint64 offset, gint64 size,
+                                   gboolean deflated) {
+    BBBMArchiveMember *member;
+
+    if (g_hash_table_lookup(index->members, name) != NULL) {
+        /* tar files can contain newer versions of a member, but they are rare for wallpapers; keep the first */
+        g_free(name);
+        return;
+    }
+    member = g_malloc(sizeof(BBBMArchiveMember));
+    member->offset   = offset;
+    member->size     = size;
+    member->deflated = deflated;
+    g_hash_table_insert(index->members, name, member);
+    g_ptr_array_add(index->names, name);
+}
+
+static void bbbm_archive_index_destroy(BBBMArchiveIndex *index) {
+    g_ptr_array_free(index->names, TRUE);
+    g_hash_table_destroy(index->members);
+    g_free(index);
+}
+
+static gboolean bbbm_archive_open(const gchar *filename, BBBMArchiveStream *stream, GError **error) {
+    BBBMArchiveFormat format;
+    BBBMArchiveMember member;
+    guchar header[BBBM_ARCHIVE_ZIP_LOCAL_SIZE];
+    gchar *archive;
+    gint64 offset;
+
+    if (!bbbm_archive_find(filename, &archive, &format, &member)) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "'%s' is not found in an archive", filename);
+        return FALSE;
+    }
+    stream->file      = NULL;
+    stream->gz        = NULL;
+    stream->inflating = FALSE;
+    stream->input     = NULL;
+    stream->remaining = member.size;
+
+    if (format == BBBM_ARCHIVE_TAR) {
+        stream->gz = gzopen(archive, "rb");
+        if (stream->gz == NULL || gzseek(stream->gz, (z_off_t) member.offset, SEEK_SET) != member.offset) {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "could not read '%s'", archive);
+            g_free(archive);
+            bbbm_archive_close(stream);
+            return FALSE;
+        }
+        g_free(archive);
+        return TRUE;
+    }
+
+    stream->file = g_fopen(archive, "rb");
+    if (stream->file == NULL) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "could not read '%s': %s", archive,
+                    g_strerror(errno));
+        g_free(archive);
+        return FALSE;
+    }
+    /* the local header can have a different extra field than the central directory, so its length is read here */
+    if (fseeko(stream->file, (off_t) member.offset, SEEK_SET) != 0
+            || fread(header, 1, BBBM_ARCHIVE_ZIP_LOCAL_SIZE, stream->file) != BBBM_ARCHIVE_ZIP_LOCAL_SIZE
+            || BBBM_ARCHIVE_READ32(header) != BBBM_ARCHIVE_ZIP_LOCAL_SIGNATURE) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "could not read '%s': corrupt member", archive);
+        g_free(archive);
+        bbbm_archive_close(stream);
+        return FALSE;
+    }
+    offset = member.offset + BBBM_ARCHIVE_ZIP_LOCAL_SIZE + BBBM_ARCHIVE_READ16(header + 26)
+           + BBBM_ARCHIVE_READ16(header + 28);
+    if (fseeko(stream->file, (off_t) offset, SEEK_SET) != 0) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "could not read '%s': %s", archive, g_strerror(errno));
+        g_free(archive);
+        bbbm_archive_close(stream);
+        return FALSE;
+    }
+    g_free(archive);
+
+    if (member.deflated) {
+        memset(&(stream->inflater), 0, sizeof(z_stream));
+        /* zip members are raw deflate streams, without zlib header */
+        if (inflateInit2(&(stream->inflater), -MAX_WBITS) != Z_OK) {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "could not inflate '%s'", filename);
+            bbbm_archive_close(stream);
+            return FALSE;
+        }
+        stream->inflating = TRUE;
+        stream->input = g_malloc(BBBM_ARCHIVE_BUFFER_SIZE);
+    }
+    return TRUE;
+}
+
+static gssize bbbm_archive_read(BBBMArchiveStream *stream, guchar *buffer, gsize length, GError **error) {
+    gsize read;
+
+    if (stream->gz != NULL) {
+        gint result = gzread(stream->gz, buffer, (unsigned) MIN((gint64) length, stream->remaining));
+        if (result < 0) {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "corrupt archive");
+            return -1;
+        }
+        stream->remaining -= result;
+        return result;
+    }
+    if (!stream->inflating) {
+        read = fread(buffer, 1, (gsize) MIN((gint64) length, stream->remaining), stream->file);
+        if (read == 0 && stream->remaining > 0) {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "the archive is cut short");
+            return -1;
+        }
+        stream->remaining -= read;
+        return read;
+    }
+
+    stream->inflater.next_out  = buffer;
+    stream->inflater.avail_out = length;
+    /* until some output has been produced, or the end of the deflate stream has been reached */
+    while (stream->inflater.avail_out == length) {
+        gint result;
+
+        if (stream->inflater.avail_in == 0 && stream->remaining > 0) {
+            read = fread(stream->input, 1, (gsize) MIN(BBBM_ARCHIVE_BUFFER_SIZE, stream->remaining), stream->file);
+            if (read == 0) {
+                g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "the archive is cut short");
+                return -1;
+            }
+            stream->remaining -= read;
+            stream->inflater.next_in  = stream->input;
+            stream->inflater.avail_in = read;
+        }
+        result = inflate(&(stream->inflater), Z_NO_FLUSH);
+        if (result == Z_STREAM_END) {
+            break;
+        }
+        if (result != Z_OK) {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "corrupt member");
+            return -1;
+        }
+    }
+    return length - stream->inflater.avail_out;
+}
+
+static void bbbm_archive_close(BBBMArchiveStream *stream) {
+    if (stream->inflating) {
+        inflateEnd(&(stream->inflater));
+    }
+    if (stream->gz != NULL) {
+        gzclose(stream->gz);
+    }
+    if (stream->file != NULL) {
+        fclose(stream->file);
+    }
+    g_free(stream->input);
+}
+
+static void bbbm_archive_size_prepared(GdkPixbufLoader *loader, gint width, gint height, gint *size) {
+    gdouble scale;
+
+    scale = MIN((gdouble) size[0] / width, (gdouble) size[1] / height);
+    gdk_pixbuf_loader_set_size(loader, MAX(width * scale, 1), MAX(height * scale, 1));
+}
+
+static gchar *bbbm_archive_get_extracted_file(const gchar *filename, const gchar *archive, const gchar *directory) {
+    struct stat info;
+    const gchar *ext;
+    gchar *key, *name, *extracted;
+
+    if (g_stat(archive, &info) == -1) {
+        g_warning("could not read '%s': %s", archive, g_strerror(errno));
+        return NULL;
+    }
+    /* any change to the archive results in a different file; the extension lets the set command recognize it */
+    key = g_strdup_printf("%s\n%ld\n%ld", filename, (glong) info.st_mtime, (glong) info.st_size);
+    ext = strrchr(filename, '.');
+    if (ext == NULL || strchr(ext, '/') != NULL) {
+        ext = "";
+    }
+#if HAVE_G_COMPUTE_CHECKSUM == 0
+    g_debug("g_compute_checksum_for_string is not available, using g_str_hash instead");
+    name = g_strdup_printf("%08x%s", g_str_hash(key), ext);
+#else
+    {
+        gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_MD5, key, -1);
+        name = g_strdup_printf("%s%s", checksum, ext);
+        g_free(checksum);
+    }
+#endif
+    g_free(key);
+    extracted = g_build_filename(directory, name, NULL);
+    g_free(name);
+    return extracted;
+}
+
+static void bbbm_archive_prune(const gchar *directory) {
+    GHashTable *mtimes;
+    GList *files, *iterator;
+    guint count;
+
+    files = bbbm_util_listdir(directory);
+    if (g_list_length(files) > BBBM_ARCHIVE_MAX_EXTRACTED) {
+        mtimes = g_hash_table_new(g_str_hash, g_str_equal);
+        for (iterator = files; iterator != NULL; iterator = iterator->next) {
+            struct stat info;
+
+            g_hash_table_insert(mtimes, iterator->data,
+                                GINT_TO_POINTER(g_stat((gchar *) iterator->data, &info) == 0 ? info.st_mtime : 0));
+        }
+        /* newest first; everything after the newest few is removed */
+        files = g_list_sort_with_data(files, (GCompareDataFunc) bbbm_archive_compare_mtime, mtimes);
+        for (iterator = files, count = 0; iterator != NULL; iterator = iterator->next, ++count) {
+            if (count >= BBBM_ARCHIVE_MAX_EXTRACTED && g_remove((gchar *) iterator->data) == -1) {
+                g_warning("could not remove '%s': %s", (gchar *) iterator->data, g_strerror(errno));
+            }
+        }
+        g_hash_table_destroy(mtimes);
+    }
+    g_list_foreach(files, (GFunc) g_free, NULL);
+    g_list_free(files);
+}
+
+static gint bbbm_archive_compare_mtime(const gchar *file1, const gchar *file2, GHashTable *mtimes) {
+    return GPOINTER_TO_INT(g_hash_table_lookup(mtimes, file2)) - GPOINTER_TO_INT(g_hash_table_lookup(mtimes, file1));
+}
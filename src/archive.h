@@ -0,0 +1,56 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_ARCHIVE_H_
+#define __BBBM_ARCHIVE_H_
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* the directory members are extracted to, relative to the directory of the configuration file */
+#define BBBM_ARCHIVE_EXTRACT_DIR  "archives"
+
+/* Archives are read as if they were directories: "/packs/nature.zip/forest.jpg" is the member "forest.jpg" of the
+   archive "/packs/nature.zip". Zip files with stored or deflated members, and tar files, gzipped or not, are
+   supported. The list of members of an archive is read once, and read again only when the archive changes.
+   All functions can be called from any thread */
+
+/* Returns whether the given file has the extension of a supported archive */
+gboolean bbbm_archive_is_archive(const gchar *filename);
+
+/* Returns whether the given file is a member of a readable archive */
+gboolean bbbm_archive_is_member(const gchar *filename);
+
+/* Returns the names (as in "/packs/nature.zip/forest.jpg") of all files in the given archive, in the order they
+   are stored in. Returns NULL if the archive could not be read.
+   The returned list and its elements must be freed when no longer needed */
+GList *bbbm_archive_list(const gchar *archive);
+
+/* Decodes the given archive member while reading it, without extracting it.
+   If width and height are positive the image is scaled down or up to fit in them, keeping its aspect ratio.
+   Returns NULL if the member could not be read or decoded */
+GdkPixbuf *bbbm_archive_load(const gchar *filename, gint width, gint height, GError **error);
+
+/* Extracts the given archive member into the given directory, unless it has already been extracted since the
+   archive last changed. Returns the name of the extracted file, or NULL if the member could not be extracted.
+   The returned string must be freed when no longer needed */
+gchar *bbbm_archive_extract(const gchar *filename, const gchar *directory);
+
+#endif /* __BBBM_ARCHIVE_H_ */
@@ -0,0 +1,269 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <glib.h>
+#include "async.h"
+
+/* the number of milliseconds between checks for finished and timed out operations */
+#define BBBM_ASYNC_POLL     50
+/* the number of threads for operations that have not timed out; they mostly wait for the disk or network */
+#define BBBM_ASYNC_THREADS  4
+
+struct _BBBMAsync {
+    gchar *filename;
+    guint timeout;
+    bbbm_async_function function;
+    bbbm_async_callback callback;
+    gpointer data;
+    GDestroyNotify free_data;
+    GDestroyNotify free_result;
+    /* set by the worker thread when the function is called, and by bbbm_async_cancel */
+    gint started;
+    gint cancelled;
+    /* set once the callback has been called or must not be called anymore; the operation is then only waited for */
+    gboolean abandoned;
+    /* set once its thread is counted in bbbm_async_stuck */
+    gboolean stuck;
+    /* started when the operation is run, not when a thread picks it up, so it also times out while it waits */
+    GTimer *timer;
+    /* the results, written by the worker thread */
+    gpointer result;
+    BBBMAsyncStatus status;
+};
+
+/* operations whose worker has not finished yet, in the order they were started */
+static GList *bbbm_async_running = NULL;
+static GAsyncQueue *bbbm_async_finished = NULL;
+static GThreadPool *bbbm_async_pool = NULL;
+static gboolean bbbm_async_initialized = FALSE;
+static guint bbbm_async_poll_id = 0;
+/* the number of threads that are stuck in operations that took too long, including cancelled ones */
+static guint bbbm_async_stuck = 0;
+
+/* the settings for testing; see async.h */
+static gulong bbbm_async_delay = 0;
+static gchar *bbbm_async_stall = NULL;
+static gchar *bbbm_async_fail = NULL;
+
+static void bbbm_async_init(void);
+static void bbbm_async_execute(BBBMAsync *async, gpointer unused);
+static gboolean bbbm_async_poll(gpointer unused);
+static BBBMAsync *bbbm_async_find_timed_out(void);
+static void bbbm_async_replace_stuck(void);
+static void bbbm_async_free(BBBMAsync *async);
+
+BBBMAsync *bbbm_async_run(const gchar *filename, guint timeout, bbbm_async_function function,
+                          bbbm_async_callback callback, gpointer data, GDestroyNotify free_data,
+                          GDestroyNotify free_result) {
+    BBBMAsync *async;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+    g_return_val_if_fail(function != NULL, NULL);
+    g_return_val_if_fail(callback != NULL, NULL);
+
+    if (!bbbm_async_initialized) {
+        bbbm_async_init();
+    }
+
+    async = g_malloc(sizeof(BBBMAsync));
+    async->filename    = g_strdup(filename);
+    async->timeout     = timeout;
+    async->function    = function;
+    async->callback    = callback;
+    async->data        = data;
+    async->free_data   = free_data;
+    async->free_result = free_result;
+    async->started     = FALSE;
+    async->cancelled   = FALSE;
+    async->abandoned   = FALSE;
+    async->stuck       = FALSE;
+    async->timer       = g_timer_new();
+    async->result      = NULL;
+    async->status      = BBBM_ASYNC_OK;
+
+    bbbm_async_running = g_list_append(bbbm_async_running, async);
+    if (bbbm_async_pool != NULL) {
+        g_thread_pool_push(bbbm_async_pool, async, NULL);
+    }
+    if (bbbm_async_poll_id == 0) {
+        bbbm_async_poll_id = g_timeout_add(BBBM_ASYNC_POLL, bbbm_async_poll, NULL);
+    }
+    return async;
+}
+
+guint bbbm_async_get_timeout(guint count) {
+    if (count >= (G_MAXUINT - BBBM_ASYNC_TIMEOUT) / BBBM_ASYNC_TIMEOUT_PER_FILE) {
+        return G_MAXUINT;
+    }
+    return BBBM_ASYNC_TIMEOUT + count * BBBM_ASYNC_TIMEOUT_PER_FILE;
+}
+
+void bbbm_async_cancel(BBBMAsync *async) {
+    g_return_if_fail(async != NULL);
+    g_return_if_fail(!async->abandoned);
+
+    async->abandoned = TRUE;
+    g_atomic_int_set(&(async->cancelled), TRUE);
+}
+
+static void bbbm_async_init(void) {
+    GError *error = NULL;
+    const gchar *value;
+
+    bbbm_async_initialized = TRUE;
+
+    if ((value = g_getenv("BBBM_IO_DELAY")) != NULL) {
+        bbbm_async_delay = strtoul(value, NULL, 10);
+    }
+    if ((value = g_getenv("BBBM_IO_STALL")) != NULL && *value != '\0') {
+        bbbm_async_stall = g_strdup(value);
+    }
+    if ((value = g_getenv("BBBM_IO_FAIL")) != NULL && *value != '\0') {
+        bbbm_async_fail = g_strdup(value);
+    }
+
+    bbbm_async_finished = g_async_queue_new();
+    bbbm_async_pool = g_thread_pool_new((GFunc) bbbm_async_execute, NULL, BBBM_ASYNC_THREADS, FALSE, &error);
+    if (bbbm_async_pool == NULL) {
+        /* operations are then run from the main loop, one per poll, and cannot time out */
+        g_warning("could not create threads for file operations: %s", error->message);
+        g_error_free(error);
+    }
+}
+
+static void bbbm_async_execute(BBBMAsync *async, gpointer unused) {
+    if (!g_atomic_int_get(&(async->cancelled))) {
+        g_atomic_int_set(&(async->started), TRUE);
+        if (bbbm_async_delay != 0) {
+            g_usleep(bbbm_async_delay * 1000);
+        }
+        if (bbbm_async_stall != NULL && g_pattern_match_simple(bbbm_async_stall, async->filename)) {
+            g_debug("stalling file operation for '%s'", async->filename);
+            while (!g_atomic_int_get(&(async->cancelled))) {
+                g_usleep(G_USEC_PER_SEC / 10);
+            }
+        }
+        if (bbbm_async_fail != NULL && g_pattern_match_simple(bbbm_async_fail, async->filename)) {
+            g_debug("failing file operation for '%s'", async->filename);
+            async->status = BBBM_ASYNC_FAILED;
+        } else if (!g_atomic_int_get(&(async->cancelled))) {
+            async->result = async->function(async->filename, async->data);
+        }
+    }
+    g_async_queue_push(bbbm_async_finished, async);
+}
+
+static gboolean bbbm_async_poll(gpointer unused) {
+    BBBMAsync *async;
+    GList *list;
+
+    if (bbbm_async_pool == NULL) {
+        for (list = bbbm_async_running; list != NULL; list = g_list_next(list)) {
+            async = (BBBMAsync *) list->data;
+            if (!async->started) {
+                bbbm_async_execute(async, NULL);
+                break;
+            }
+        }
+    }
+    while ((async = (BBBMAsync *) g_async_queue_try_pop(bbbm_async_finished)) != NULL) {
+        bbbm_async_running = g_list_remove(bbbm_async_running, async);
+        if (async->stuck) {
+            /* its thread is free again, so the replacement is no longer needed */
+            --bbbm_async_stuck;
+            g_thread_pool_set_max_threads(bbbm_async_pool, BBBM_ASYNC_THREADS + bbbm_async_stuck, NULL);
+            g_debug("file operation for '%s' finished after it timed out", async->filename);
+        }
+        if (!async->abandoned) {
+            /* the callback may start or cancel other operations, so it is done with first */
+            async->abandoned = TRUE;
+            async->callback(async->data, async->result, async->status);
+            async->result = NULL;
+        }
+        bbbm_async_free(async);
+    }
+    /* one at a time, as each callback may cancel others */
+    while ((async = bbbm_async_find_timed_out()) != NULL) {
+        g_warning("file operation for '%s' did not finish within %u ms", async->filename, async->timeout);
+        async->abandoned = TRUE;
+        if (!g_atomic_int_get(&(async->started))) {
+            /* it waited behind stuck ones; there is no point in running it anymore */
+            g_atomic_int_set(&(async->cancelled), TRUE);
+        }
+        async->callback(async->data, NULL, BBBM_ASYNC_TIMED_OUT);
+    }
+    bbbm_async_replace_stuck();
+    if (bbbm_async_running == NULL) {
+        bbbm_async_poll_id = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static BBBMAsync *bbbm_async_find_timed_out(void) {
+    BBBMAsync *async;
+    GList *list;
+
+    /* operations run from the main loop cannot time out */
+    if (bbbm_async_pool == NULL) {
+        return NULL;
+    }
+    for (list = bbbm_async_running; list != NULL; list = g_list_next(list)) {
+        async = (BBBMAsync *) list->data;
+        if (!async->abandoned && g_timer_elapsed(async->timer, NULL) * 1000 >= async->timeout) {
+            return async;
+        }
+    }
+    return NULL;
+}
+
+static void bbbm_async_replace_stuck(void) {
+    BBBMAsync *async;
+    GList *list;
+
+    if (bbbm_async_pool == NULL) {
+        return;
+    }
+    /* cancelled and timed out operations alike; their threads are tied up until they return */
+    for (list = bbbm_async_running; list != NULL; list = g_list_next(list)) {
+        async = (BBBMAsync *) list->data;
+        if (!async->stuck && g_atomic_int_get(&(async->started))
+                && g_timer_elapsed(async->timer, NULL) * 1000 >= async->timeout) {
+            async->stuck = TRUE;
+            /* another thread takes the place of the stuck one, so operations for other files can continue */
+            ++bbbm_async_stuck;
+            g_thread_pool_set_max_threads(bbbm_async_pool, BBBM_ASYNC_THREADS + bbbm_async_stuck, NULL);
+            g_debug("file operation for '%s' is stuck; %u threads are", async->filename, bbbm_async_stuck);
+        }
+    }
+}
+
+static void bbbm_async_free(BBBMAsync *async) {
+    if (async->result != NULL && async->free_result != NULL) {
+        async->free_result(async->result);
+    }
+    if (async->free_data != NULL) {
+        async->free_data(async->data);
+    }
+    g_timer_destroy(async->timer);
+    g_free(async->filename);
+    g_free(async);
+}
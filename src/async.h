@@ -0,0 +1,72 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_ASYNC_H_
+#define __BBBM_ASYNC_H_
+
+#include <glib.h>
+
+/* the default number of milliseconds a file operation may take before it is given up on */
+#define BBBM_ASYNC_TIMEOUT  10000
+/* the number of milliseconds that is added to BBBM_ASYNC_TIMEOUT for each file an operation accesses */
+#define BBBM_ASYNC_TIMEOUT_PER_FILE 100
+
+/* File operations that are run by worker threads, so a slow or hung mount never blocks the main loop.
+   An operation that is not done within its timeout after it was run, whether it is running or still waiting for a
+   thread, is reported as timed out. A thread cannot be stopped, but the result of a running operation is thrown
+   away when it finally comes, and another thread takes its place in the mean time; this holds for cancelled
+   operations as well.
+
+   For testing, file operations can be slowed down or made to fail through environment variables:
+     BBBM_IO_DELAY  the number of milliseconds each operation is delayed
+     BBBM_IO_STALL  a pattern (with * and ?) of files whose operations never finish, like on a hung mount
+     BBBM_IO_FAIL   a pattern of files whose operations fail */
+typedef struct _BBBMAsync BBBMAsync;
+
+typedef enum {
+    BBBM_ASYNC_OK,
+    /* injected through BBBM_IO_FAIL */
+    BBBM_ASYNC_FAILED,
+    BBBM_ASYNC_TIMED_OUT
+} BBBMAsyncStatus;
+
+/* Called from a worker thread to access the given file. data may only be read.
+   Returns the result, which is handed to the callback */
+typedef gpointer (* bbbm_async_function) (const gchar *filename, gpointer data);
+
+/* Called from the main loop when the operation has finished or timed out. The result is NULL unless the status is
+   BBBM_ASYNC_OK, and is owned by the callback */
+typedef void (* bbbm_async_callback) (gpointer data, gpointer result, BBBMAsyncStatus status);
+
+/* Runs the given function for the given file in a worker thread, and calls the given callback from the main loop
+   when it is done, or when it has not finished within timeout milliseconds. The data is freed with free_data when
+   both are done with it; results that are not handed to the callback are freed with free_result.
+   The returned object is owned by the operation, and is valid until the callback is called or it is cancelled */
+BBBMAsync *bbbm_async_run(const gchar *filename, guint timeout, bbbm_async_function function,
+                          bbbm_async_callback callback, gpointer data, GDestroyNotify free_data,
+                          GDestroyNotify free_result);
+
+/* Returns the timeout for an operation that accesses the given number of files */
+guint bbbm_async_get_timeout(guint count);
+
+/* Cancels the given operation; its callback will not be called. If its function is running it is left to finish */
+void bbbm_async_cancel(BBBMAsync *async);
+
+#endif /* __BBBM_ASYNC_H_ */
@@ -0,0 +1,516 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include "config.h"
+#include "background.h"
+#include "render.h"
+#include "blend.h"
+#include "async.h"
+#include "util.h"
+#include "compat.h"
+
+#ifndef GDK_WINDOWING_X11
+    #error the built-in background setter requires gtk+ for X11
+#endif
+
+/* the number of milliseconds between crossfade frames; GTK+ 2 cannot tell the refresh rate, so assume 60 Hz */
+#define BBBM_BACKGROUND_FRAME_INTERVAL  16
+/* crossfades never take more frames than this, however long they last */
+#define BBBM_BACKGROUND_MAX_FRAMES      60
+/* the number of milliseconds rendering may take; decoding a large image takes a lot longer than other file
+   operations */
+#define BBBM_BACKGROUND_RENDER_TIMEOUT  60000
+
+typedef struct {
+    /* the pixmap that is set when the crossfade ends */
+    GdkPixmap *target;
+    GdkPixbuf *from;
+    GdkPixbuf *to;
+    GdkPixbuf *frame;
+    GdkPixmap *frame_pixmap;
+    GTimer *timer;
+    /* the time spent on drawing frames; once it exceeds half the duration the crossfade ends */
+    gdouble cost;
+    guint frames;
+    guint source_id;
+} BBBMBackgroundTransition;
+
+typedef struct {
+    gchar *filename;
+    BBBMRenderMode mode;
+    gchar *layout;
+    GdkPixmap *pixmap;
+} BBBMBackgroundEntry;
+
+/* a background that is rendered by a worker thread; the screen is only read and drawn on from the main loop */
+typedef struct {
+    BBBMBackground *background;
+    gchar *filename;
+    BBBMRenderMode mode;
+    gchar *layout;
+    gint width;
+    gint height;
+    GdkRectangle *monitors;
+    guint monitor_count;
+    bbbm_background_function function;
+    gpointer data;
+} BBBMBackgroundRender;
+
+struct _BBBMBackground {
+    guint cache_size;
+    /* the cached pixmaps, most recently used first */
+    GList *cache;
+    /* the pixmap currently set; always the first cache entry, unless the cache size is 0 */
+    GdkPixmap *current;
+    /* the crossfade duration in milliseconds */
+    guint transition_duration;
+    BBBMBackgroundTransition *transition;
+    /* the background that is being rendered, if any */
+    BBBMAsync *rendering;
+};
+
+static GdkRectangle *bbbm_background_get_monitors(GdkScreen *screen, guint *monitor_count, gchar **layout);
+static BBBMBackgroundEntry *bbbm_background_lookup(BBBMBackground *background, const gchar *filename,
+                                                   BBBMRenderMode mode, const gchar *layout);
+static void bbbm_background_trim_cache(BBBMBackground *background, guint size);
+static void bbbm_background_entry_destroy(BBBMBackgroundEntry *entry);
+static gpointer bbbm_background_render(const gchar *filename, BBBMBackgroundRender *render);
+static void bbbm_background_rendered(BBBMBackgroundRender *render, GdkPixbuf *pixbuf, BBBMAsyncStatus status);
+static void bbbm_background_free_render(BBBMBackgroundRender *render);
+static void bbbm_background_show(BBBMBackground *background, GdkPixmap *pixmap);
+static void bbbm_background_apply(BBBMBackground *background, GdkPixmap *pixmap);
+static gboolean bbbm_background_start_transition(BBBMBackground *background, GdkPixmap *pixmap);
+static gboolean bbbm_background_transition_frame(BBBMBackground *background);
+static void bbbm_background_finish_transition(BBBMBackground *background);
+static void bbbm_background_free_retained(Display *display, Window root);
+static void bbbm_background_set_root_pixmap(Display *display, Window root, Pixmap pixmap, gboolean retained);
+static Pixmap bbbm_background_get_root_property(Display *display, Window root, const gchar *name);
+
+BBBMBackground *bbbm_background_new(guint cache_size, guint transition) {
+    BBBMBackground *background;
+
+    background = g_malloc(sizeof(BBBMBackground));
+    background->cache_size = cache_size;
+    background->cache      = NULL;
+    background->current    = NULL;
+    background->transition_duration = transition;
+    background->transition = NULL;
+    background->rendering  = NULL;
+    return background;
+}
+
+void bbbm_background_set_cache_size(BBBMBackground *background, guint cache_size) {
+    g_return_if_fail(background != NULL);
+    background->cache_size = cache_size;
+    bbbm_background_trim_cache(background, cache_size);
+}
+
+void bbbm_background_set_transition(BBBMBackground *background, guint transition) {
+    g_return_if_fail(background != NULL);
+    background->transition_duration = transition;
+}
+
+void bbbm_background_set(BBBMBackground *background, const gchar *filename, BBBMRenderMode mode,
+                         bbbm_background_function function, gpointer data) {
+    GdkScreen *screen;
+    BBBMBackgroundEntry *entry;
+    BBBMBackgroundRender *render;
+
+    g_return_if_fail(background != NULL);
+    g_return_if_fail(filename != NULL);
+
+    /* only the most recent request is set */
+    if (background->rendering != NULL) {
+        bbbm_async_cancel(background->rendering);
+        background->rendering = NULL;
+    }
+
+    render = g_malloc(sizeof(BBBMBackgroundRender));
+    render->background = background;
+    render->filename   = g_strdup(filename);
+    render->mode       = mode;
+    render->function   = function;
+    render->data       = data;
+    screen = gdk_screen_get_default();
+    render->width    = gdk_screen_get_width(screen);
+    render->height   = gdk_screen_get_height(screen);
+    render->monitors = bbbm_background_get_monitors(screen, &(render->monitor_count), &(render->layout));
+
+    entry = bbbm_background_lookup(background, filename, mode, render->layout);
+    if (entry != NULL) {
+        g_debug("using cached pixmap for '%s'", filename);
+        /* move it to the front */
+        background->cache = g_list_remove(background->cache, entry);
+        background->cache = g_list_prepend(background->cache, entry);
+        bbbm_background_show(background, entry->pixmap);
+        if (function != NULL) {
+            function(data, filename, TRUE);
+        }
+        bbbm_background_free_render(render);
+        return;
+    }
+    background->rendering = bbbm_async_run(filename, BBBM_BACKGROUND_RENDER_TIMEOUT,
+                                           (bbbm_async_function) bbbm_background_render,
+                                           (bbbm_async_callback) bbbm_background_rendered, render,
+                                           (GDestroyNotify) bbbm_background_free_render, g_object_unref);
+}
+
+void bbbm_background_destroy(BBBMBackground *background) {
+    g_return_if_fail(background != NULL);
+
+    if (background->rendering != NULL) {
+        bbbm_async_cancel(background->rendering);
+    }
+    if (background->transition != NULL) {
+        bbbm_background_finish_transition(background);
+    }
+    if (background->current != NULL
+        && bbbm_background_get_root_property(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), GDK_ROOT_WINDOW(),
+                                             "_XROOTPMAP_ID") != GDK_PIXMAP_XID(background->current)) {
+        g_debug("the background has been changed by another program; not keeping it");
+    } else if (background->current != NULL) {
+        Display *display;
+
+        /* the pixmaps of this connection are freed when it closes, so copy the current one to a connection whose
+           resources are retained; this is the same approach Esetroot and similar tools use */
+        display = XOpenDisplay(gdk_display_get_name(gdk_display_get_default()));
+        if (display == NULL) {
+            g_warning("could not open display to keep the background");
+        } else {
+            Window root;
+            Pixmap pixmap;
+            GC gc;
+            gint width, height;
+
+            gdk_drawable_get_size(background->current, &width, &height);
+            root = DefaultRootWindow(display);
+            XSetCloseDownMode(display, RetainPermanent);
+            pixmap = XCreatePixmap(display, root, width, height, DefaultDepth(display, DefaultScreen(display)));
+            gc = XCreateGC(display, pixmap, 0, NULL);
+            XCopyArea(display, GDK_PIXMAP_XID(background->current), pixmap, gc, 0, 0, width, height, 0, 0);
+            XFreeGC(display, gc);
+            XSetWindowBackgroundPixmap(display, root, pixmap);
+            XClearWindow(display, root);
+            bbbm_background_set_root_pixmap(display, root, pixmap, TRUE);
+            XCloseDisplay(display);
+        }
+    }
+    if (background->current != NULL) {
+        g_object_unref(background->current);
+    }
+    bbbm_background_trim_cache(background, 0);
+    g_free(background);
+}
+
+static gpointer bbbm_background_render(const gchar *filename, BBBMBackgroundRender *render) {
+    GdkPixbuf *pixbuf;
+    GError *error = NULL;
+
+    pixbuf = bbbm_render_file_for_monitors(filename, render->width, render->height, render->monitors,
+                                           render->monitor_count, render->mode, &error);
+    if (pixbuf == NULL) {
+        g_warning("could not load '%s': %s", filename, error->message);
+        g_error_free(error);
+    }
+    return pixbuf;
+}
+
+static void bbbm_background_rendered(BBBMBackgroundRender *render, GdkPixbuf *pixbuf, BBBMAsyncStatus status) {
+    BBBMBackground *background = render->background;
+    BBBMBackgroundEntry *entry;
+    GdkPixmap *pixmap;
+
+    background->rendering = NULL;
+    if (pixbuf == NULL) {
+        if (status == BBBM_ASYNC_TIMED_OUT) {
+            g_warning("gave up rendering '%s'", render->filename);
+        }
+        if (render->function != NULL) {
+            render->function(render->data, render->filename, FALSE);
+        }
+        return;
+    }
+    pixmap = gdk_pixmap_new(gdk_screen_get_root_window(gdk_screen_get_default()), render->width, render->height, -1);
+    gdk_draw_pixbuf(pixmap, NULL, pixbuf, 0, 0, 0, 0, render->width, render->height, GDK_RGB_DITHER_NORMAL, 0, 0);
+    g_object_unref(pixbuf);
+
+    entry = g_malloc(sizeof(BBBMBackgroundEntry));
+    entry->filename = g_strdup(render->filename);
+    entry->mode     = render->mode;
+    entry->layout   = g_strdup(render->layout);
+    entry->pixmap   = pixmap;
+    background->cache = g_list_prepend(background->cache, entry);
+
+    bbbm_background_show(background, pixmap);
+    if (render->function != NULL) {
+        render->function(render->data, render->filename, TRUE);
+    }
+}
+
+static void bbbm_background_free_render(BBBMBackgroundRender *render) {
+    g_free(render->filename);
+    g_free(render->layout);
+    g_free(render->monitors);
+    g_free(render);
+}
+
+static void bbbm_background_show(BBBMBackground *background, GdkPixmap *pixmap) {
+    /* a running crossfade is finished at once before a new one starts */
+    if (background->transition != NULL) {
+        bbbm_background_finish_transition(background);
+    }
+    if (!bbbm_background_start_transition(background, pixmap)) {
+        bbbm_background_apply(background, pixmap);
+    }
+}
+
+static void bbbm_background_apply(BBBMBackground *background, GdkPixmap *pixmap) {
+    GdkWindow *root;
+
+    root = gdk_screen_get_root_window(gdk_screen_get_default());
+    gdk_window_set_back_pixmap(root, pixmap, FALSE);
+    gdk_window_clear(root);
+    if (background->current == NULL) {
+        bbbm_background_free_retained(GDK_WINDOW_XDISPLAY(root), GDK_WINDOW_XID(root));
+    }
+    bbbm_background_set_root_pixmap(GDK_WINDOW_XDISPLAY(root), GDK_WINDOW_XID(root), GDK_PIXMAP_XID(pixmap), FALSE);
+    gdk_flush();
+
+    if (background->current != NULL) {
+        g_object_unref(background->current);
+    }
+    background->current = g_object_ref(pixmap);
+    /* keep at least the current entry, so the X server does not lose the root pixmap */
+    bbbm_background_trim_cache(background, MAX(background->cache_size, 1));
+}
+
+static gboolean bbbm_background_start_transition(BBBMBackground *background, GdkPixmap *pixmap) {
+    BBBMBackgroundTransition *transition;
+    GdkWindow *root;
+    gint width, height, current_width, current_height;
+
+    if (background->transition_duration == 0 || background->current == NULL || background->current == pixmap) {
+        return FALSE;
+    }
+    gdk_drawable_get_size(pixmap, &width, &height);
+    gdk_drawable_get_size(background->current, &current_width, &current_height);
+    if (width != current_width || height != current_height) {
+        /* the screen size has changed; there is nothing sensible to fade from */
+        return FALSE;
+    }
+
+    root = gdk_screen_get_root_window(gdk_screen_get_default());
+    transition = g_malloc(sizeof(BBBMBackgroundTransition));
+    transition->from = gdk_pixbuf_get_from_drawable(NULL, background->current, gdk_drawable_get_colormap(root),
+                                                    0, 0, 0, 0, width, height);
+    transition->to   = gdk_pixbuf_get_from_drawable(NULL, pixmap, gdk_drawable_get_colormap(root),
+                                                    0, 0, 0, 0, width, height);
+    if (transition->from == NULL || transition->to == NULL
+        || gdk_pixbuf_get_rowstride(transition->from) != gdk_pixbuf_get_rowstride(transition->to)) {
+        g_warning("could not read the backgrounds to crossfade");
+        if (transition->from != NULL) {
+            g_object_unref(transition->from);
+        }
+        if (transition->to != NULL) {
+            g_object_unref(transition->to);
+        }
+        g_free(transition);
+        return FALSE;
+    }
+    transition->target       = g_object_ref(pixmap);
+    transition->frame        = gdk_pixbuf_copy(transition->from);
+    transition->frame_pixmap = gdk_pixmap_new(root, width, height, -1);
+    transition->timer        = g_timer_new();
+    transition->cost         = 0;
+    transition->frames       = 0;
+    transition->source_id    = g_timeout_add(BBBM_BACKGROUND_FRAME_INTERVAL,
+                                             (GSourceFunc) bbbm_background_transition_frame, background);
+    background->transition = transition;
+    g_debug("crossfading in %d ms using %s blending", background->transition_duration, bbbm_blend_get_implementation());
+    return TRUE;
+}
+
+static gboolean bbbm_background_transition_frame(BBBMBackground *background) {
+    BBBMBackgroundTransition *transition = background->transition;
+    GdkWindow *root;
+    GTimer *frame_timer;
+    gdouble elapsed;
+    gsize length;
+    gint width, height;
+
+    /* time based, so slow frames are skipped instead of slowing down the crossfade */
+    elapsed = g_timer_elapsed(transition->timer, NULL) * 1000;
+    if (elapsed >= background->transition_duration || transition->frames >= BBBM_BACKGROUND_MAX_FRAMES
+        || transition->cost * 1000 >= background->transition_duration / 2) {
+        transition->source_id = 0;
+        bbbm_background_finish_transition(background);
+        return FALSE;
+    }
+
+    frame_timer = g_timer_new();
+    width  = gdk_pixbuf_get_width(transition->frame);
+    height = gdk_pixbuf_get_height(transition->frame);
+    /* the last row is not padded to the rowstride */
+    length = (gsize) (height - 1) * gdk_pixbuf_get_rowstride(transition->frame)
+           + width * gdk_pixbuf_get_n_channels(transition->frame);
+    bbbm_blend(gdk_pixbuf_get_pixels(transition->frame), gdk_pixbuf_get_pixels(transition->from),
+               gdk_pixbuf_get_pixels(transition->to), length,
+               (guint) (elapsed * BBBM_BLEND_MAX / background->transition_duration));
+    gdk_draw_pixbuf(transition->frame_pixmap, NULL, transition->frame, 0, 0, 0, 0, width, height,
+                    GDK_RGB_DITHER_NONE, 0, 0);
+
+    /* the X server may copy the background pixmap, so set it again for every frame */
+    root = gdk_screen_get_root_window(gdk_screen_get_default());
+    gdk_window_set_back_pixmap(root, transition->frame_pixmap, FALSE);
+    gdk_window_clear(root);
+    gdk_flush();
+
+    transition->cost += g_timer_elapsed(frame_timer, NULL);
+    transition->frames++;
+    g_timer_destroy(frame_timer);
+    return TRUE;
+}
+
+static void bbbm_background_finish_transition(BBBMBackground *background) {
+    BBBMBackgroundTransition *transition = background->transition;
+
+    if (transition->source_id != 0) {
+        g_source_remove(transition->source_id);
+    }
+    g_info("crossfade took %.3f seconds for %d frames, %.3f seconds of which drawing",
+           g_timer_elapsed(transition->timer, NULL), transition->frames, transition->cost);
+    background->transition = NULL;
+
+    bbbm_background_apply(background, transition->target);
+
+    g_object_unref(transition->target);
+    g_object_unref(transition->from);
+    g_object_unref(transition->to);
+    g_object_unref(transition->frame);
+    g_object_unref(transition->frame_pixmap);
+    g_timer_destroy(transition->timer);
+    g_free(transition);
+}
+
+static GdkRectangle *bbbm_background_get_monitors(GdkScreen *screen, guint *monitor_count, gchar **layout) {
+    GdkRectangle *monitors;
+    GString *description;
+    guint i;
+
+    /* GDK takes the monitor geometry from XRandR, or from Xinerama for older servers */
+    *monitor_count = gdk_screen_get_n_monitors(screen);
+    monitors = g_new(GdkRectangle, *monitor_count);
+    description = g_string_sized_new(64);
+    g_string_append_printf(description, "%dx%d", gdk_screen_get_width(screen), gdk_screen_get_height(screen));
+    for (i = 0; i < *monitor_count; ++i) {
+        gdk_screen_get_monitor_geometry(screen, i, &monitors[i]);
+        g_string_append_printf(description, ";%dx%d+%d+%d",
+                               monitors[i].width, monitors[i].height, monitors[i].x, monitors[i].y);
+    }
+    g_debug("screen layout is %s", description->str);
+    *layout = g_string_free(description, FALSE);
+    return monitors;
+}
+
+static BBBMBackgroundEntry *bbbm_background_lookup(BBBMBackground *background, const gchar *filename,
+                                                   BBBMRenderMode mode, const gchar *layout) {
+    GList *iterator;
+
+    for (iterator = background->cache; iterator != NULL; iterator = iterator->next) {
+        BBBMBackgroundEntry *entry = (BBBMBackgroundEntry *) iterator->data;
+
+        /* after a change of the screen or monitor layout, old entries no longer match and are trimmed eventually */
+        if (entry->mode == mode && bbbm_str_equals(entry->layout, layout)
+            && bbbm_str_equals(entry->filename, filename)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void bbbm_background_trim_cache(BBBMBackground *background, guint size) {
+    while (g_list_length(background->cache) > size) {
+        GList *last = g_list_last(background->cache);
+
+        bbbm_background_entry_destroy((BBBMBackgroundEntry *) last->data);
+        background->cache = g_list_delete_link(background->cache, last);
+    }
+}
+
+static void bbbm_background_entry_destroy(BBBMBackgroundEntry *entry) {
+    g_free(entry->filename);
+    g_free(entry->layout);
+    g_object_unref(entry->pixmap);
+    g_free(entry);
+}
+
+static void bbbm_background_free_retained(Display *display, Window root) {
+    Pixmap xrootpmap, esetroot_pmap;
+
+    /* a pixmap retained by Esetroot (or an earlier bbbm) is only referenced by these properties; free it */
+    xrootpmap     = bbbm_background_get_root_property(display, root, "_XROOTPMAP_ID");
+    esetroot_pmap = bbbm_background_get_root_property(display, root, "ESETROOT_PMAP_ID");
+    if (xrootpmap != None && xrootpmap == esetroot_pmap) {
+        g_debug("freeing retained root pixmap 0x%lx", (gulong) xrootpmap);
+        XKillClient(display, xrootpmap);
+    }
+    XDeleteProperty(display, root, XInternAtom(display, "ESETROOT_PMAP_ID", False));
+}
+
+static void bbbm_background_set_root_pixmap(Display *display, Window root, Pixmap pixmap, gboolean retained) {
+    Atom xrootpmap_id, esetroot_pmap_id;
+
+    xrootpmap_id = XInternAtom(display, "_XROOTPMAP_ID", False);
+    XChangeProperty(display, root, xrootpmap_id, XA_PIXMAP, 32, PropModeReplace, (guchar *) &pixmap, 1);
+    /* setters such as Esetroot and feh free the ESETROOT_PMAP_ID pixmap by killing its owner, so it may only be
+       set for a pixmap whose connection has been closed with RetainPermanent, never for one of this process */
+    if (retained) {
+        esetroot_pmap_id = XInternAtom(display, "ESETROOT_PMAP_ID", False);
+        XChangeProperty(display, root, esetroot_pmap_id, XA_PIXMAP, 32, PropModeReplace, (guchar *) &pixmap, 1);
+    }
+}
+
+static Pixmap bbbm_background_get_root_property(Display *display, Window root, const gchar *name) {
+    Atom atom, type;
+    gint format;
+    gulong count, remaining;
+    guchar *data = NULL;
+    Pixmap pixmap = None;
+
+    atom = XInternAtom(display, name, True);
+    if (atom == None) {
+        return None;
+    }
+    if (XGetWindowProperty(display, root, atom, 0, 1, False, XA_PIXMAP,
+                           &type, &format, &count, &remaining, &data) == Success) {
+        if (type == XA_PIXMAP && format == 32 && count == 1) {
+            pixmap = *((Pixmap *) data);
+        }
+        if (data != NULL) {
+            XFree(data);
+        }
+    }
+    return pixmap;
+}
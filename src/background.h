@@ -0,0 +1,56 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_BACKGROUND_H_
+#define __BBBM_BACKGROUND_H_
+
+#include <gtk/gtk.h>
+#include "render.h"
+
+/* A built-in background setter that draws directly on the root window of the default screen.
+   It sets the _XROOTPMAP_ID property for pseudo-transparent applications,
+   and keeps the pixmaps of the most recently set backgrounds so they can be set again without rendering */
+typedef struct _BBBMBackground BBBMBackground;
+
+/* Creates a new BBBMBackground object that keeps at most cache_size pixmaps, and crossfades from one background
+   to the next in transition milliseconds; 0 switches at once.
+   The returned object must be destroyed with bbbm_background_destroy when no longer needed */
+BBBMBackground *bbbm_background_new(guint cache_size, guint transition);
+
+void bbbm_background_set_cache_size(BBBMBackground *background, guint cache_size);
+
+void bbbm_background_set_transition(BBBMBackground *background, guint transition);
+
+/* Called from the main loop when a background has been set, or could not be loaded */
+typedef void (* bbbm_background_function) (gpointer data, const gchar *filename, gboolean success);
+
+/* Sets the given image file as background, fitted to each monitor of the screen according to the given mode.
+   Unless a pixmap is cached, the image is rendered by a worker thread and set from the main loop afterwards.
+   A background that is still being rendered is dropped, without calling its function.
+   A running crossfade is finished at once before a new one starts.
+   The function is optional; if given it is called when the background has been set or could not be loaded */
+void bbbm_background_set(BBBMBackground *background, const gchar *filename, BBBMRenderMode mode,
+                         bbbm_background_function function, gpointer data);
+
+/* Drops the background that is being rendered, if any, and frees all cached pixmaps. If a background has been set and no other program has replaced it since, a copy of it
+   is kept by the X server after this process exits, and published as both _XROOTPMAP_ID and ESETROOT_PMAP_ID */
+void bbbm_background_destroy(BBBMBackground *background);
+
+#endif /* __BBBM_BACKGROUND_H_ */
@@ -0,0 +1,88 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <glib.h>
+#include "config.h"
+#include "batch.h"
+#include "collection.h"
+#include "options.h"
+#include "util.h"
+#include "archive.h"
+#include "compat.h"
+
+gint bbbm_batch_run(BBBMOptions *options, const gchar *collection_file, const gchar *archive_dir,
+                    const gchar *list_file, const gchar *menu_file, gboolean random_background) {
+    gint result = 0;
+    gchar *absolute_file;
+    GList *entries = NULL;
+
+    g_return_val_if_fail(options != NULL, 1);
+    g_return_val_if_fail(collection_file != NULL, 1);
+    g_return_val_if_fail(archive_dir != NULL, 1);
+
+    if (!g_file_test(collection_file, G_FILE_TEST_IS_REGULAR)) {
+        g_critical("could not open '%s'", collection_file);
+        return 1;
+    }
+    absolute_file = bbbm_util_absolute_path(collection_file);
+    if (!bbbm_collection_read(absolute_file, &entries)) {
+        /* bbbm_collection_read printed what was skipped; continue with the valid entries */
+        g_critical("could not open '%s' properly", absolute_file);
+        result = 1;
+    }
+
+    if (list_file != NULL && !bbbm_collection_write_list(entries, list_file)) {
+        g_critical("could not save to '%s'", list_file);
+        result = 1;
+    }
+    if (menu_file != NULL && !bbbm_collection_write_menu(entries, options, absolute_file, menu_file)) {
+        g_critical("could not save to '%s'", menu_file);
+        result = 1;
+    }
+    if (random_background) {
+        if (entries != NULL) {
+            BBBMCollectionEntry *entry;
+            const gchar *filename;
+            gchar *extracted = NULL;
+
+            entry = (BBBMCollectionEntry *) g_list_nth_data(entries, g_random_int_range(0, g_list_length(entries)));
+            filename = entry->filename;
+            /* the set command cannot read archives */
+            if (bbbm_archive_is_member(filename)) {
+                extracted = bbbm_archive_extract(filename, archive_dir);
+                filename = extracted;
+            }
+            if (filename != NULL) {
+                bbbm_util_execute(bbbm_options_get_set_command(options), filename);
+            } else {
+                g_critical("could not extract '%s'", entry->filename);
+                result = 1;
+            }
+            g_free(extracted);
+        } else {
+            g_critical("'%s' does not contain any images", absolute_file);
+            result = 1;
+        }
+    }
+
+    bbbm_collection_free(entries);
+    g_free(absolute_file);
+    return result;
+}
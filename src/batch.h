@@ -0,0 +1,35 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_BATCH_H_
+#define __BBBM_BATCH_H_
+
+#include <glib.h>
+#include "options.h"
+
+/* Runs the given tasks for the given collection without a display and without decoding any image.
+   The list and menu files are optional; if not NULL, a background list or menu is written to them.
+   If random_background is TRUE, a random background from the collection is set; if it is an archive member, it is
+   extracted to the given archive directory first.
+   Returns the exit status: 0 if all tasks succeeded, or 1 otherwise */
+gint bbbm_batch_run(BBBMOptions *options, const gchar *collection_file, const gchar *archive_dir,
+                    const gchar *list_file, const gchar *menu_file, gboolean random_background);
+
+#endif /* __BBBM_BATCH_H_ */
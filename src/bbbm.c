@@ -25,16 +25,113 @@
 #include <gtk/gtk.h>
 #include "config.h"
 #include "bbbm.h"
+#include "collection.h"
 #include "command.h"
 #include "image.h"
 #include "command_item.h"
 #include "dialogs.h"
 #include "options.h"
+#include "remote.h"
+#include "template.h"
 #include "util.h"
+#include "archive.h"
+#include "decoder.h"
 #include "compat.h"
 
 #define PADDING  5
 
+/* the number of milliseconds to wait for more set requests before setting a background */
+#define BBBM_SET_BACKGROUND_DELAY  100
+/* the number of milliseconds the pointer must rest on an image before it is rendered speculatively */
+#define BBBM_PRERENDER_DELAY       300
+/* the minimal score of images picked by BBBM_RANDOM_FITTING */
+#define BBBM_FIT_THRESHOLD         0.8
+/* the weight BBBM_RANDOM_WEIGHTED gives to images that do not fit at all */
+#define BBBM_FIT_MIN_WEIGHT        0.01
+/* the number of images gathered around an image by similar colors */
+#define BBBM_SIMILAR_COLOR_COUNT   12
+/* the number of milliseconds a search for moved images may take; it can be cancelled before that */
+#define BBBM_RELOCATE_TIMEOUT      600000
+/* the number of milliseconds between updates of the dialog that shows such a search */
+#define BBBM_RELOCATE_PULSE        100
+
+/* a collection entry that could not be added, and the index it would have had */
+typedef struct {
+    BBBMCollectionEntry *entry;
+    guint index;
+    /* the image that already shows the entry, with deferred thumbs; it is replaced if the entry is relocated */
+    BBBMImage *image;
+} BBBMBrokenEntry;
+
+/* a collection that is being opened, and what has been read from it */
+typedef struct {
+    BBBM *bbbm;
+    gchar *filename;
+    gboolean validate;
+    /* the entries that have been read, while their files are checked */
+    GList *entries;
+} BBBMOpenRequest;
+
+typedef struct {
+    gboolean success;
+    GList *entries;
+} BBBMOpenResult;
+
+/* an image that is added on request; see bbbm_handle_command */
+typedef struct {
+    BBBM *bbbm;
+    gchar *filename;
+    BBBMAsync *async;
+} BBBMAddRequest;
+
+/* a file that is extracted if it is an archive member, before it is set or passed to a command */
+typedef struct {
+    BBBM *bbbm;
+    gchar *filename;
+    gchar *archive_dir;
+    /* the command to run for the file, or NULL to set it as background */
+    gchar *command;
+    BBBMAsync *async;
+} BBBMExtractRequest;
+
+/* images whose metadata is refreshed before it is used, and what to do with it afterwards */
+typedef struct {
+    BBBM *bbbm;
+    guint count;
+    gchar **filenames;
+    /* copies of the indexed metadata; only valid for files that are indexed */
+    BBBMMetadata *metadata;
+    gboolean *indexed;
+    void (* finished) (BBBM *bbbm);
+} BBBMRefreshRequest;
+
+/* the outcome of refreshing the metadata of one image */
+typedef struct {
+    gboolean changed;
+    /* only valid if changed is TRUE; FALSE if the file could no longer be read */
+    gboolean readable;
+    BBBMMetadata metadata;
+} BBBMRefreshedMetadata;
+
+/* broken entries that are searched for in a directory; see bbbm_repair_entries */
+typedef struct {
+    BBBM *bbbm;
+    GList *broken;
+    gchar *directory;
+    guint count;
+    gchar **filenames;
+    gint64 *sizes;
+    GtkWidget *dialog;
+    guint pulse_id;
+    BBBMAsync *async;
+} BBBMRelocateRequest;
+
+typedef struct {
+    guint found;
+    guint count;
+    gchar **relocated;
+} BBBMRelocateResult;
+
 /* create utility functions */
 static inline GtkWidget *bbbm_create_menubar(BBBM *bbbm);
 
@@ -53,9 +150,14 @@ static void bbbm_menu_edit_add_collections(BBBM *bbbm);
 static void bbbm_menu_edit_add_image_lists(BBBM *bbbm);
 static void bbbm_menu_edit_sort_on_filename(BBBM *bbbm);
 static void bbbm_menu_edit_sort_on_description(BBBM *bbbm);
+static void bbbm_menu_edit_sort_on_resolution(BBBM *bbbm);
+static void bbbm_menu_edit_sort_on_color(BBBM *bbbm);
+static void bbbm_menu_edit_sort_on_brightness(BBBM *bbbm);
 static void bbbm_menu_tools_create_list(BBBM *bbbm);
 static void bbbm_menu_tools_create_menu(BBBM *bbbm);
 static void bbbm_menu_tools_random_background(BBBM *bbbm);
+static void bbbm_menu_tools_find_duplicates(BBBM *bbbm);
+static void bbbm_menu_tools_find_identical_files(BBBM *bbbm);
 static void bbbm_menu_tools_options(BBBM *bbbm);
 static void bbbm_menu_help_about(BBBM *bbbm);
 
@@ -67,9 +169,11 @@ static gboolean bbbm_image_mouse_leave(GtkWidget *widget, GdkEventCrossing *even
 
 /* image popup callbacks */
 static void bbbm_image_popup_set(BBBMImage *image);
-static void bbbm_image_popup_execute_command(BBBMCommandItem *item);
+static void bbbm_image_popup_execute_command(BBBMCommandItem *item, BBBM *bbbm);
+static void bbbm_image_popup_execute_command_for_all(BBBMCommandItem *item, BBBM *bbbm);
 static void bbbm_image_popup_move_back(BBBMImage *image);
 static void bbbm_image_popup_move_forward(BBBMImage *image);
+static void bbbm_image_popup_gather_similar_colors(BBBMImage *image);
 static void bbbm_image_popup_edit_description(BBBMImage *image);
 static void bbbm_image_popup_insert_images(BBBMImage *image);
 static void bbbm_image_popup_delete(BBBMImage *image);
@@ -80,15 +184,79 @@ static void bbbm_set_modified(BBBM *bbbm, gboolean modified);
 
 static gboolean bbbm_can_close(BBBM *bbbm);
 
-static gboolean bbbm_open_collection(BBBM *bbbm, const gchar *filename);
+static void bbbm_set_background(BBBM *bbbm, const gchar *filename);
+static void bbbm_extract(BBBM *bbbm, const gchar *filename, const gchar *command);
+static gpointer bbbm_extract_file(const gchar *filename, BBBMExtractRequest *request);
+static void bbbm_file_extracted(BBBMExtractRequest *request, gchar *extracted, BBBMAsyncStatus status);
+static void bbbm_free_extract_request(BBBMExtractRequest *request);
+static void bbbm_queue_background(BBBM *bbbm, const gchar *filename);
+static gboolean bbbm_set_pending_background(BBBM *bbbm);
+static void bbbm_run_set_command(BBBM *bbbm, const gchar *filename);
+static void bbbm_set_command_finished(BBBM *bbbm, const gchar *command, gint status, gdouble duration);
+static void bbbm_background_rendered(BBBM *bbbm, const gchar *filename, const gchar *rendered_file);
+static void bbbm_background_set_finished(BBBM *bbbm, const gchar *filename, gboolean success);
+static void bbbm_screen_changed(GdkScreen *screen, BBBM *bbbm);
+static gboolean bbbm_prerender_hovered_background(BBBM *bbbm);
+static void bbbm_cancel_prerender(BBBM *bbbm);
+static void bbbm_sort_on_resolution(BBBM *bbbm);
+static void bbbm_set_random_background(BBBM *bbbm);
+static BBBMImage *bbbm_pick_random_image(BBBM *bbbm, GRand *rand);
+static gdouble bbbm_get_fit_score(BBBM *bbbm, const gchar *filename, gint width, gint height);
+static void bbbm_find_duplicates(BBBM *bbbm, gboolean identical);
+static void bbbm_duplicates_found(BBBM *bbbm, GList *groups);
+static void bbbm_cancel_duplicates(BBBM *bbbm);
+static void bbbm_thumbnail_loaded(BBBM *bbbm, BBBMImage *image, GdkPixbuf *pixbuf, BBBMValidateStatus status,
+                                  const BBBMMetadata *metadata);
+static void bbbm_prioritize_visible(BBBM *bbbm);
+static void bbbm_import_files(BBBM *bbbm, GList *files, BBBMImportSource source);
+static void bbbm_imported(BBBM *bbbm, GList *items, gboolean finished);
+static void bbbm_update_import_progress(BBBM *bbbm);
+static void bbbm_import_dialog_response(GtkDialog *dialog, gint response, BBBM *bbbm);
+static void bbbm_cancel_import(BBBM *bbbm);
+static gboolean bbbm_repair_loaded(BBBM *bbbm);
+static void bbbm_cancel_loaded_broken(BBBM *bbbm);
+static void bbbm_refresh_metadata(BBBM *bbbm, GList *images, void (* finished) (BBBM *bbbm));
+static gpointer bbbm_refresh_files(const gchar *filename, BBBMRefreshRequest *request);
+static void bbbm_metadata_refreshed(BBBMRefreshRequest *request, BBBMRefreshedMetadata *refreshed,
+                                    BBBMAsyncStatus status);
+static void bbbm_free_refresh_request(BBBMRefreshRequest *request);
+
+static void bbbm_open_collection(BBBM *bbbm, const gchar *filename);
+static gpointer bbbm_read_collection(const gchar *filename, BBBMOpenRequest *request);
+static void bbbm_collection_opened(BBBMOpenRequest *request, BBBMOpenResult *result, BBBMAsyncStatus status);
+static gpointer bbbm_validate_collection(const gchar *filename, BBBMOpenRequest *request);
+static void bbbm_collection_validated(BBBMOpenRequest *request, gpointer result, BBBMAsyncStatus status);
+static void bbbm_collection_loaded(BBBM *bbbm, const gchar *filename, GList *entries);
+static void bbbm_collection_failed(BBBM *bbbm, const gchar *filename, BBBMAsyncStatus status);
+static void bbbm_free_open_request(BBBMOpenRequest *request);
+static void bbbm_free_open_result(BBBMOpenResult *result);
+static gpointer bbbm_check_image(const gchar *filename, gpointer unused);
+static void bbbm_image_checked(BBBMAddRequest *request, gpointer is_image, BBBMAsyncStatus status);
+static void bbbm_free_add_request(BBBMAddRequest *request);
+static gpointer bbbm_read_metadata(const gchar *filename, gpointer unused);
+static void bbbm_hovered_metadata_read(BBBMImage *image, BBBMMetadata *metadata, BBBMAsyncStatus status);
+static void bbbm_show_image_info(BBBMImage *image, const BBBMMetadata *metadata);
+static void bbbm_cancel_file_operations(BBBM *bbbm);
 static gboolean bbbm_save_collection(BBBM *bbbm, const gchar *filename);
 static void bbbm_close_collection(BBBM *bbbm);
+static GtkWidget *bbbm_create_image(BBBM *bbbm, const gchar *filename, const gchar *description,
+                                    GdkPixbuf *thumbnail);
 static gboolean bbbm_add_image(BBBM *bbbm, const gchar *filename, const gchar *description, gint index);
-static gboolean bbbm_add_collection(BBBM *bbbm, const gchar *filename);
-static gboolean bbbm_add_image_list(BBBM *bbbm, const gchar *filename);
+static void bbbm_add_entries(BBBM *bbbm, GList *entries, GList **broken);
+static void bbbm_repair_entries(BBBM *bbbm, GList *broken);
+static gpointer bbbm_relocate_files(const gchar *directory, BBBMRelocateRequest *request);
+static void bbbm_entries_relocated(BBBMRelocateRequest *request, BBBMRelocateResult *result, BBBMAsyncStatus status);
+static gboolean bbbm_pulse_relocation(BBBMRelocateRequest *request);
+static void bbbm_relocate_dialog_response(GtkDialog *dialog, gint response, BBBMRelocateRequest *request);
+static void bbbm_finish_relocation(BBBMRelocateRequest *request);
+static void bbbm_cancel_relocation(BBBMRelocateRequest *request);
+static void bbbm_cancel_relocations(BBBM *bbbm);
+static void bbbm_free_relocate_request(BBBMRelocateRequest *request);
+static void bbbm_free_relocate_result(BBBMRelocateResult *result);
+static void bbbm_free_broken_entry(BBBMBrokenEntry *broken_entry);
 static gboolean bbbm_create_list(BBBM *bbbm, const gchar *filename);
 static gboolean bbbm_create_menu(BBBM *bbbm, const gchar *filename);
-static inline void bbbm_write_string(FILE *file, const gchar *string);
+static GList *bbbm_get_entries(BBBM *bbbm);
 
 /* image utility functions */
 static inline void bbbm_attach_image(GtkTable *table, GtkWidget *image, guint x, guint y);
@@ -98,6 +266,8 @@ static inline void bbbm_resize_thumbs(BBBM *bbbm);
 
 BBBM *bbbm_new(BBBMOptions *options, const gchar *config_file, const gchar *collection_file) {
     GtkWidget *vbox, *hbox, *menubar, *scrolled_window;
+    GtkAdjustment *adjustment;
+    gchar *dir, *cache_dir, *metadata_file;
 
     /* create and initialize the new BBBM object */
     BBBM *bbbm = g_malloc(sizeof(BBBM));
@@ -106,6 +276,47 @@ BBBM *bbbm_new(BBBMOptions *options, const gchar *config_file, const gchar *coll
     bbbm->filename    = NULL;
     bbbm->modified    = FALSE;
     bbbm->images      = NULL;
+    bbbm->supervisor  = bbbm_supervisor_new(bbbm_options_get_max_jobs(options),
+                                            bbbm_options_get_job_timeout(options));
+    bbbm->pending_background    = NULL;
+    bbbm->pending_background_id = 0;
+    bbbm->setting_background    = FALSE;
+    bbbm->background            = bbbm_background_new(bbbm_options_get_pixmap_cache_size(options),
+                                                      bbbm_options_get_transition(options));
+    dir = bbbm_util_dirname(config_file);
+    cache_dir = g_build_filename(dir, "cache", NULL);
+    bbbm->render_cache          = bbbm_render_cache_new(cache_dir);
+    metadata_file = g_build_filename(dir, "metadata", NULL);
+    bbbm->metadata              = bbbm_metadata_index_new(metadata_file);
+    g_free(metadata_file);
+    bbbm->archive_dir           = g_build_filename(dir, BBBM_ARCHIVE_EXTRACT_DIR, NULL);
+    g_free(cache_dir);
+    g_free(dir);
+    bbbm->hovered_background    = NULL;
+    bbbm->hovered_background_id = 0;
+    bbbm->fit_scores            = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    bbbm->duplicates            = NULL;
+    bbbm->duplicate_images      = NULL;
+    bbbm->loader                = bbbm_loader_new((bbbm_loader_function) bbbm_thumbnail_loaded, bbbm);
+    bbbm->import                = NULL;
+    bbbm->import_dialog         = NULL;
+    bbbm->import_broken         = NULL;
+    bbbm->import_failed         = NULL;
+    bbbm->loaded_broken         = NULL;
+    bbbm->loaded_broken_id      = 0;
+    bbbm->opening               = NULL;
+    bbbm->adding                = NULL;
+    bbbm->hovering              = NULL;
+    bbbm->extracting_background = NULL;
+    bbbm->extracting            = NULL;
+    bbbm->refreshing            = NULL;
+    bbbm->relocating            = NULL;
+
+    /* rendered files no longer match the screen after its size or monitor layout changes */
+    g_signal_connect(G_OBJECT(gdk_screen_get_default()), "size-changed", G_CALLBACK(bbbm_screen_changed), bbbm);
+#if HAVE_GDK_SCREEN_MONITORS_CHANGED
+    g_signal_connect(G_OBJECT(gdk_screen_get_default()), "monitors-changed", G_CALLBACK(bbbm_screen_changed), bbbm);
+#endif
 
     /* the window */
     bbbm->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
@@ -130,6 +341,11 @@ BBBM *bbbm_new(BBBMOptions *options, const gchar *config_file, const gchar *coll
     bbbm->table = gtk_table_new(1, 1, TRUE);
     gtk_scrolled_window_add_with_viewport(GTK_SCROLLED_WINDOW(scrolled_window), bbbm->table);
 
+    /* deferred thumbs are loaded in the order they are scrolled into view */
+    adjustment = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled_window));
+    g_signal_connect_swapped(G_OBJECT(adjustment), "value-changed", G_CALLBACK(bbbm_prioritize_visible), bbbm);
+    g_signal_connect_swapped(G_OBJECT(adjustment), "changed", G_CALLBACK(bbbm_prioritize_visible), bbbm);
+
     /* the status bar: file info + image info, packed in a horizontal box */
     hbox = gtk_hbox_new(TRUE, 0);
     gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
@@ -154,19 +370,16 @@ BBBM *bbbm_new(BBBMOptions *options, const gchar *config_file, const gchar *coll
 
     /* attempt to open the given file (if any) */
     if (collection_file != NULL) {
-        if (!g_file_test(collection_file, G_FILE_TEST_IS_REGULAR)) {
-            bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not open '%s'", collection_file);
-        } else {
-            gchar *absolute_file = bbbm_util_absolute_path(collection_file);
-            bbbm_open_collection(bbbm, absolute_file);
-            g_free(absolute_file);
-        }
+        /* the file is read in the background; if it cannot be read that is reported then */
+        gchar *absolute_file = bbbm_util_absolute_path(collection_file);
+        bbbm_open_collection(bbbm, absolute_file);
+        g_free(absolute_file);
     }
     return bbbm;
 }
 
 static inline GtkWidget *bbbm_create_menubar(BBBM *bbbm) {
-    static guint n_items = 23;
+    static guint n_items = 28;
     static GtkItemFactoryEntry items[] = {
         {"/_File",                     NULL,             NULL,                               0, "<Branch>"},
         {"/File/_Open...",             "<ctrl>O",        bbbm_menu_file_open,                0, NULL},
@@ -183,10 +396,15 @@ static inline GtkWidget *bbbm_create_menubar(BBBM *bbbm) {
         {"/Edit/sep",                  NULL,             NULL,                               0, "<Separator>"},
         {"/Edit/Sort On _Filename",    "<ctrl><shift>F", bbbm_menu_edit_sort_on_filename,    0, NULL},
         {"/Edit/Sort On D_escription", "<ctrl><shift>D", bbbm_menu_edit_sort_on_description, 0, NULL},
+        {"/Edit/Sort On _Resolution",  "<ctrl><shift>R", bbbm_menu_edit_sort_on_resolution,  0, NULL},
+        {"/Edit/Sort On C_olor",       "<ctrl><shift>C", bbbm_menu_edit_sort_on_color,       0, NULL},
+        {"/Edit/Sort On _Brightness",  "<ctrl><shift>B", bbbm_menu_edit_sort_on_brightness,  0, NULL},
         {"/_Tools",                    NULL,             NULL,                               0, "<Branch>"},
         {"/Tools/Create _List...",     "<ctrl>L",        bbbm_menu_tools_create_list,        0, NULL},
         {"/Tools/Create _Menu...",     "<ctrl>M",        bbbm_menu_tools_create_menu,        0, NULL},
         {"/Tools/_Random Background", "<ctrl>R",         bbbm_menu_tools_random_background,  0, NULL},
+        {"/Tools/Find D_uplicates",    "<ctrl>U",        bbbm_menu_tools_find_duplicates,    0, NULL},
+        {"/Tools/Find _Identical Files", "<ctrl><shift>U", bbbm_menu_tools_find_identical_files, 0, NULL},
         {"/Tools/sep",                 NULL,             NULL,                               0, "<Separator>"},
         {"/Tools/_Options...",         "<alt>P",         bbbm_menu_tools_options,            0, NULL},
         {"/_Help",                     NULL,             NULL,                               0, "<Branch>"},
@@ -205,13 +423,59 @@ static inline GtkWidget *bbbm_create_menubar(BBBM *bbbm) {
 void bbbm_destroy(BBBM *bbbm) {
     /* options and config_file are not owned by the instance, do not destroy them */
     g_free(bbbm->filename);
+    bbbm_cancel_import(bbbm);
+    bbbm_cancel_file_operations(bbbm);
+    bbbm_cancel_loaded_broken(bbbm);
     g_list_foreach(bbbm->images, (GFunc) g_object_unref, NULL);
     g_list_free(bbbm->images);
+    /* destroying images removes their requests, so the loader must outlive them */
+    bbbm_loader_destroy(bbbm->loader);
     /* closing the window already destroyed the window, table and status bars */
     g_object_unref(bbbm->factory);
+    bbbm_supervisor_destroy(bbbm->supervisor);
+    if (bbbm->pending_background_id != 0) {
+        g_source_remove(bbbm->pending_background_id);
+    }
+    g_free(bbbm->pending_background);
+    bbbm_background_destroy(bbbm->background);
+    g_signal_handlers_disconnect_by_func(G_OBJECT(gdk_screen_get_default()), G_CALLBACK(bbbm_screen_changed), bbbm);
+    bbbm_cancel_prerender(bbbm);
+    bbbm_render_cache_destroy(bbbm->render_cache);
+    g_free(bbbm->archive_dir);
+    bbbm_metadata_index_save(bbbm->metadata);
+    bbbm_metadata_index_destroy(bbbm->metadata);
+    g_hash_table_destroy(bbbm->fit_scores);
+    bbbm_cancel_duplicates(bbbm);
     g_free(bbbm);
 }
 
+void bbbm_handle_command(BBBM *bbbm, const gchar *command, const gchar *argument) {
+    g_return_if_fail(bbbm != NULL);
+    g_return_if_fail(command != NULL);
+
+    if (bbbm_str_equals(command, BBBM_REMOTE_OPEN) && argument != NULL) {
+        if (bbbm_can_close(bbbm)) {
+            bbbm_open_collection(bbbm, argument);
+        }
+    } else if (bbbm_str_equals(command, BBBM_REMOTE_ADD) && argument != NULL) {
+        /* the image is checked in the background, and added once that is done */
+        BBBMAddRequest *request = g_malloc(sizeof(BBBMAddRequest));
+
+        request->bbbm = bbbm;
+        request->filename = g_strdup(argument);
+        request->async = bbbm_async_run(argument, BBBM_ASYNC_TIMEOUT, bbbm_check_image,
+                                        (bbbm_async_callback) bbbm_image_checked, request,
+                                        (GDestroyNotify) bbbm_free_add_request, NULL);
+        bbbm->adding = g_list_append(bbbm->adding, request->async);
+    } else if (bbbm_str_equals(command, BBBM_REMOTE_RANDOM)) {
+        bbbm_menu_tools_random_background(bbbm);
+    } else if (bbbm_str_equals(command, BBBM_REMOTE_PRESENT)) {
+        gtk_window_present(GTK_WINDOW(bbbm->window));
+    } else {
+        g_warning("ignoring unknown command '%s'", command);
+    }
+}
+
 static gboolean bbbm_delete_window(GtkWidget *widget, GdkEvent *event, BBBM *bbbm) {
     if (!bbbm_can_close(bbbm)) {
         /* block other handlers, like closing the window! */
@@ -262,31 +526,15 @@ static void bbbm_menu_edit_add_images(BBBM *bbbm) {
     GList *files;
 
     files = bbbm_dialogs_get_files(GTK_WINDOW(bbbm->window), "Add images");
-    while (files != NULL) {
-        gchar *file;
-
-        file = (gchar *) files->data;
-        files = g_list_remove(files, file);
-        if (bbbm_util_is_image(file) && !bbbm_add_image(bbbm, file, NULL, -1)) {
-            bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not add image '%s'", file);
-        }
-        g_free(file);
-    }
+    bbbm_import_files(bbbm, files, BBBM_IMPORT_IMAGE);
 }
 
 static void bbbm_menu_edit_add_directory(BBBM *bbbm) {
-    GList *files;
+    gchar *dir;
 
-    files = bbbm_dialogs_get_files_dir(GTK_WINDOW(bbbm->window), "Add a directory");
-    while (files != NULL) {
-        gchar *file;
-
-        file = (gchar *) files->data;
-        files = g_list_remove(files, file);
-        if (bbbm_util_is_image(file) && !bbbm_add_image(bbbm, file, NULL, -1)) {
-            bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not add image '%s'", file);
-        }
-        g_free(file);
+    dir = bbbm_dialogs_get_dir_or_archive(GTK_WINDOW(bbbm->window), "Add a directory or archive");
+    if (dir != NULL) {
+        bbbm_import_files(bbbm, g_list_append(NULL, dir), BBBM_IMPORT_DIRECTORY);
     }
 }
 
@@ -294,32 +542,14 @@ static void bbbm_menu_edit_add_collections(BBBM *bbbm) {
     GList *files;
 
     files = bbbm_dialogs_get_files(GTK_WINDOW(bbbm->window), "Add collections");
-    while (files != NULL) {
-        gchar *file;
-
-        file = (gchar *) files->data;
-        files = g_list_remove(files, file);
-        if (!bbbm_add_collection(bbbm, file)) {
-            bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not add collection '%s' properly", file);
-        }
-        g_free(file);
-    }
+    bbbm_import_files(bbbm, files, BBBM_IMPORT_COLLECTION);
 }
 
 static void bbbm_menu_edit_add_image_lists(BBBM *bbbm) {
     GList *files;
 
     files = bbbm_dialogs_get_files(GTK_WINDOW(bbbm->window), "Add image lists");
-    while (files != NULL) {
-        gchar *file;
-
-        file = (gchar *) files->data;
-        files = g_list_remove(files, file);
-        if (!bbbm_add_image_list(bbbm, file)) {
-            bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not add image list '%s' properly", file);
-        }
-        g_free(file);
-    }
+    bbbm_import_files(bbbm, files, BBBM_IMPORT_IMAGE_LIST);
 }
 
 static void bbbm_menu_edit_sort_on_filename(BBBM *bbbm) {
@@ -340,6 +570,42 @@ static void bbbm_menu_edit_sort_on_description(BBBM *bbbm) {
     bbbm_set_modified(bbbm, TRUE);
 }
 
+static void bbbm_menu_edit_sort_on_resolution(BBBM *bbbm) {
+    if (bbbm->images == NULL) {
+        return;
+    }
+    /* refresh the index once per image instead of once per comparison; this only reads image headers */
+    bbbm_refresh_metadata(bbbm, bbbm->images, bbbm_sort_on_resolution);
+}
+
+static void bbbm_sort_on_resolution(BBBM *bbbm) {
+    if (bbbm->images == NULL) {
+        return;
+    }
+    bbbm->images = g_list_sort(bbbm->images, (GCompareFunc) bbbm_image_compare_resolution);
+    bbbm_reset_images(bbbm, 0);
+    bbbm_set_modified(bbbm, TRUE);
+}
+
+static void bbbm_menu_edit_sort_on_color(BBBM *bbbm) {
+    if (bbbm->images == NULL) {
+        return;
+    }
+    /* the colors were indexed when the thumbnails were decoded */
+    bbbm->images = g_list_sort(bbbm->images, (GCompareFunc) bbbm_image_compare_color);
+    bbbm_reset_images(bbbm, 0);
+    bbbm_set_modified(bbbm, TRUE);
+}
+
+static void bbbm_menu_edit_sort_on_brightness(BBBM *bbbm) {
+    if (bbbm->images == NULL) {
+        return;
+    }
+    bbbm->images = g_list_sort(bbbm->images, (GCompareFunc) bbbm_image_compare_brightness);
+    bbbm_reset_images(bbbm, 0);
+    bbbm_set_modified(bbbm, TRUE);
+}
+
 static void bbbm_menu_tools_create_list(BBBM *bbbm) {
     bbbm_dialogs_save(GTK_WINDOW(bbbm->window), "Create background list", (bbbm_save_function) bbbm_create_list, bbbm);
 }
@@ -349,22 +615,53 @@ static void bbbm_menu_tools_create_menu(BBBM *bbbm) {
 }
 
 static void bbbm_menu_tools_random_background(BBBM *bbbm) {
+    GList *unscored = NULL, *iterator;
+    const gchar *filename;
+
+    if (bbbm->images == NULL) {
+        return;
+    }
+    if (bbbm_options_get_random_mode(bbbm->options) == BBBM_RANDOM_ANY) {
+        bbbm_set_random_background(bbbm);
+        return;
+    }
+    /* only images without a score need their metadata; the others were refreshed when they were scored */
+    for (iterator = bbbm->images; iterator != NULL; iterator = iterator->next) {
+        filename = bbbm_image_get_filename(BBBM_IMAGE(iterator->data));
+        if (g_hash_table_lookup(bbbm->fit_scores, filename) == NULL) {
+            unscored = g_list_prepend(unscored, iterator->data);
+        }
+    }
+    bbbm_refresh_metadata(bbbm, unscored, bbbm_set_random_background);
+    g_list_free(unscored);
+}
+
+static void bbbm_set_random_background(BBBM *bbbm) {
     if (bbbm->images != NULL) {
         GRand *rand;
-        guint32 index;
         BBBMImage *image;
 
         rand = g_rand_new();
-        index = g_rand_int_range(rand, 0, g_list_length(bbbm->images));
-        image = BBBM_IMAGE(g_list_nth_data(bbbm->images, index));
+        image = bbbm_pick_random_image(bbbm, rand);
 
-        bbbm_util_execute(bbbm_options_get_set_command(bbbm->options),
-                          bbbm_image_get_filename(image));
+        bbbm_set_background(bbbm, bbbm_image_get_filename(image));
 
         g_rand_free(rand);
     }
 }
 
+static void bbbm_menu_tools_find_duplicates(BBBM *bbbm) {
+    if (bbbm->images != NULL && bbbm->duplicates == NULL) {
+        bbbm_find_duplicates(bbbm, FALSE);
+    }
+}
+
+static void bbbm_menu_tools_find_identical_files(BBBM *bbbm) {
+    if (bbbm->images != NULL && bbbm->duplicates == NULL) {
+        bbbm_find_duplicates(bbbm, TRUE);
+    }
+}
+
 static void bbbm_menu_tools_options(BBBM *bbbm) {
     guint changed;
 
@@ -375,6 +672,17 @@ static void bbbm_menu_tools_options(BBBM *bbbm) {
     if ((changed & OPTIONS_THUMB_COLUMN_COUNT_CHANGED) != 0) {
         bbbm_reset_images(bbbm, 0);
     }
+    if ((changed & OPTIONS_JOBS_CHANGED) != 0) {
+        bbbm_supervisor_set_max_jobs(bbbm->supervisor, bbbm_options_get_max_jobs(bbbm->options));
+        bbbm_supervisor_set_timeout(bbbm->supervisor, bbbm_options_get_job_timeout(bbbm->options));
+    }
+    if ((changed & OPTIONS_BACKGROUND_CHANGED) != 0) {
+        bbbm_background_set_cache_size(bbbm->background, bbbm_options_get_pixmap_cache_size(bbbm->options));
+        bbbm_background_set_transition(bbbm->background, bbbm_options_get_transition(bbbm->options));
+    }
+    if ((changed & OPTIONS_DECODE_MEMORY_CHANGED) != 0) {
+        bbbm_decoder_set_memory_budget((gsize) bbbm_options_get_decode_memory(bbbm->options) * 1024 * 1024);
+    }
     if (changed != 0) {
         bbbm_options_write_to_file(bbbm->options, bbbm->config_file);
     }
@@ -386,20 +694,20 @@ static void bbbm_menu_help_about(BBBM *bbbm) {
 
 static gboolean bbbm_image_mouse_press(GtkWidget *widget, GdkEventButton *event, BBBMImage *image) {
     if (event->type == GDK_2BUTTON_PRESS && event->button == 1) {
-        bbbm_util_execute(bbbm_options_get_set_command(image->bbbm->options),
-                          bbbm_image_get_filename(image));
+        bbbm_set_background(image->bbbm, bbbm_image_get_filename(image));
     }
     return FALSE;
 }
 
 static gboolean bbbm_image_mouse_release(GtkWidget *widget, GdkEventButton *event, BBBMImage *image) {
     if (event->type == GDK_BUTTON_RELEASE && event->button == 3) {
-        static guint n_items = 8;
+        static guint n_items = 9;
         static GtkItemFactoryEntry items[] = {
             {"/_Set",                 NULL, bbbm_image_popup_set,              0, NULL},
             {"/sep",                  NULL, NULL,                              0, "<Separator>"},
             {"/Move _Back...",        NULL, bbbm_image_popup_move_back,        0, NULL},
             {"/Move _Forward...",     NULL, bbbm_image_popup_move_forward,     0, NULL},
+            {"/_Gather Similar Colors", NULL, bbbm_image_popup_gather_similar_colors, 0, NULL},
             {"/sep",                  NULL, NULL,                              0, "<Separator>"},
             {"/_Edit Description...", NULL, bbbm_image_popup_edit_description, 0, NULL},
             {"/_Insert Images..",     NULL, bbbm_image_popup_insert_images,    0, NULL},
@@ -407,6 +715,7 @@ static gboolean bbbm_image_mouse_release(GtkWidget *widget, GdkEventButton *even
         };
         GtkWidget *popup;
         GtkWidget *item;
+        GtkWidget *all_images_menu;
         GtkItemFactory *factory;
         const GList *iterator;
         gint index;
@@ -422,8 +731,9 @@ static gboolean bbbm_image_mouse_release(GtkWidget *widget, GdkEventButton *even
         if (index == g_list_length(image->bbbm->images) - 1) {
             gtk_widget_set_sensitive(gtk_item_factory_get_item(factory, "/Move Forward..."), FALSE);
         }
-        /* add the commands */
+        /* add the commands, both for this image and for all images */
         index = 2;
+        all_images_menu = gtk_menu_new();
         for (iterator = bbbm_options_get_commands(image->bbbm->options); iterator != NULL; iterator = iterator->next) {
             BBBMCommand *cmd;
             const gchar *command, *label;
@@ -437,15 +747,25 @@ static gboolean bbbm_image_mouse_release(GtkWidget *widget, GdkEventButton *even
                     label = command;
                 }
                 item = bbbm_command_item_new_for_file(label, command, image->filename);
-                g_signal_connect(G_OBJECT(item), "activate", G_CALLBACK(bbbm_image_popup_execute_command), NULL);
+                g_signal_connect(G_OBJECT(item), "activate", G_CALLBACK(bbbm_image_popup_execute_command), image->bbbm);
                 gtk_menu_insert(GTK_MENU(popup), item, index);
                 index++;
+
+                item = bbbm_command_item_new(label, command);
+                g_signal_connect(G_OBJECT(item), "activate", G_CALLBACK(bbbm_image_popup_execute_command_for_all), image->bbbm);
+                gtk_menu_shell_append(GTK_MENU_SHELL(all_images_menu), item);
             }
         }
         if (index > 2) {
             /* added at least one command */
+            item = gtk_menu_item_new_with_mnemonic("For _All Images");
+            gtk_menu_item_set_submenu(GTK_MENU_ITEM(item), all_images_menu);
+            gtk_menu_insert(GTK_MENU(popup), item, index);
+            index++;
             item = gtk_separator_menu_item_new();
             gtk_menu_insert(GTK_MENU(popup), item, index);
+        } else {
+            gtk_widget_destroy(all_images_menu);
         }
         gtk_widget_show_all(popup);
         gtk_menu_popup(GTK_MENU(popup), NULL, NULL, NULL, NULL, event->button, event->time);
@@ -454,10 +774,24 @@ static gboolean bbbm_image_mouse_release(GtkWidget *widget, GdkEventButton *even
 }
 
 static gboolean bbbm_image_mouse_enter(GtkWidget *widget, GdkEventCrossing *event, BBBMImage *image) {
-    /* pop any existing image first */
-    gtk_statusbar_pop(GTK_STATUSBAR(image->bbbm->image_bar), image->bbbm->image_cid);
-    gtk_statusbar_push(GTK_STATUSBAR(image->bbbm->image_bar), image->bbbm->image_cid,
-                       bbbm_image_get_description(image));
+    /* show what is indexed right away, and refresh it once the file has been checked in the background */
+    bbbm_show_image_info(image, bbbm_metadata_index_peek(image->bbbm->metadata, bbbm_image_get_filename(image)));
+    if (image->bbbm->hovering != NULL) {
+        bbbm_async_cancel(image->bbbm->hovering);
+    }
+    g_object_ref(image);
+    image->bbbm->hovering = bbbm_async_run(bbbm_image_get_filename(image), BBBM_ASYNC_TIMEOUT, bbbm_read_metadata,
+                                           (bbbm_async_callback) bbbm_hovered_metadata_read, image,
+                                           g_object_unref, g_free);
+
+    /* only render if the pointer stays, not for every image it passes on its way */
+    bbbm_cancel_prerender(image->bbbm);
+    if (!bbbm_options_get_builtin_setter(image->bbbm->options) && bbbm_options_get_render_cache(image->bbbm->options)) {
+        image->bbbm->hovered_background    = g_strdup(bbbm_image_get_filename(image));
+        image->bbbm->hovered_background_id = g_timeout_add(BBBM_PRERENDER_DELAY,
+                                                           (GSourceFunc) bbbm_prerender_hovered_background,
+                                                           image->bbbm);
+    }
     return FALSE;
 }
 
@@ -465,19 +799,47 @@ static gboolean bbbm_image_mouse_leave(GtkWidget *widget, GdkEventCrossing *even
     /* pop twice to increase the chance the status bar gets actually closed */
     gtk_statusbar_pop(GTK_STATUSBAR(image->bbbm->image_bar), image->bbbm->image_cid);
     gtk_statusbar_pop(GTK_STATUSBAR(image->bbbm->image_bar), image->bbbm->image_cid);
+
+    if (image->bbbm->hovering != NULL) {
+        bbbm_async_cancel(image->bbbm->hovering);
+        image->bbbm->hovering = NULL;
+    }
+    bbbm_cancel_prerender(image->bbbm);
     return FALSE;
 }
 
 static void bbbm_image_popup_set(BBBMImage *image) {
-    bbbm_util_execute(bbbm_options_get_set_command(image->bbbm->options),
-                      bbbm_image_get_filename(image));
+    bbbm_set_background(image->bbbm, bbbm_image_get_filename(image));
+}
+
+static void bbbm_image_popup_execute_command(BBBMCommandItem *item, BBBM *bbbm) {
+    /* commands cannot read archives, so a member is extracted first, like when it is set */
+    bbbm_extract(bbbm, bbbm_command_item_get_filename(item), bbbm_command_item_get_command(item));
 }
 
-static void bbbm_image_popup_execute_command(BBBMCommandItem *item) {
+static void bbbm_image_popup_execute_command_for_all(BBBMCommandItem *item, BBBM *bbbm) {
     const gchar *command;
+    BBBMTemplate *template;
+    GString *cmd;
+    GList *iterator;
 
     command = bbbm_command_item_get_command(item);
-    bbbm_util_execute_cmd(command);
+    template = bbbm_template_new(command);
+    cmd = g_string_sized_new(PATH_MAX);
+    /* the queue limits the number of commands that run at the same time */
+    for (iterator = bbbm->images; iterator != NULL; iterator = iterator->next) {
+        const gchar *filename = bbbm_image_get_filename(BBBM_IMAGE(iterator->data));
+
+        /* extracting every member would be pointless, as only the most recently extracted ones are kept */
+        if (bbbm_archive_is_member(filename)) {
+            g_warning("skipping '%s': it is a member of an archive", filename);
+            continue;
+        }
+        bbbm_template_expand(template, filename, cmd);
+        bbbm_supervisor_queue(bbbm->supervisor, cmd->str, NULL, NULL);
+    }
+    g_string_free(cmd, TRUE);
+    bbbm_template_destroy(template);
 }
 
 static void bbbm_image_popup_move_back(BBBMImage *image) {
@@ -513,6 +875,49 @@ static void bbbm_image_popup_move_forward(BBBMImage *image) {
     bbbm_set_modified(image->bbbm, TRUE);
 }
 
+static void bbbm_image_popup_gather_similar_colors(BBBMImage *image) {
+    BBBM *bbbm = image->bbbm;
+    const BBBMMetadata *metadata;
+    const BBBMColors **candidates;
+    BBBMImage **images;
+    guint nearest[BBBM_SIMILAR_COLOR_COUNT];
+    guint count, found, i;
+    gint index;
+    GList *iterator;
+
+    metadata = bbbm_metadata_index_peek(bbbm->metadata, bbbm_image_get_filename(image));
+    if (metadata == NULL || !metadata->has_colors) {
+        bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "The colors of '%s' are not known", bbbm_image_get_description(image));
+        return;
+    }
+    count = g_list_length(bbbm->images);
+    candidates = g_new(const BBBMColors *, count);
+    images = g_new(BBBMImage *, count);
+    for (iterator = bbbm->images, i = 0; iterator != NULL; iterator = iterator->next, ++i) {
+        const BBBMMetadata *other;
+
+        images[i] = BBBM_IMAGE(iterator->data);
+        other = bbbm_metadata_index_peek(bbbm->metadata, bbbm_image_get_filename(images[i]));
+        candidates[i] = images[i] != image && other != NULL && other->has_colors ? &(other->colors) : NULL;
+    }
+    found = bbbm_color_nearest(&(metadata->colors), candidates, count, BBBM_SIMILAR_COLOR_COUNT, nearest);
+
+    /* move the nearest images right after this one, closest first */
+    for (i = 0; i < found; ++i) {
+        bbbm->images = g_list_remove(bbbm->images, images[nearest[i]]);
+    }
+    index = g_list_index(bbbm->images, image);
+    for (i = 0; i < found; ++i) {
+        bbbm->images = g_list_insert(bbbm->images, images[nearest[i]], index + 1 + i);
+    }
+    g_free(candidates);
+    g_free(images);
+    if (found > 0) {
+        bbbm_reset_images(bbbm, 0);
+        bbbm_set_modified(bbbm, TRUE);
+    }
+}
+
 static void bbbm_image_popup_edit_description(BBBMImage *image) {
     const gchar *old_description;
     gchar *new_description;
@@ -584,13 +989,33 @@ static void bbbm_update_item_enabled_states(BBBM *bbbm) {
     widget = gtk_item_factory_get_item(bbbm->factory, "/File/Close");
     gtk_widget_set_sensitive(widget, has_filename || has_images);
 
+    /* one import at a time; its files are added at the end, which is only known once the collection is read */
+    widget = gtk_item_factory_get_item(bbbm->factory, "/Edit/Add Images...");
+    gtk_widget_set_sensitive(widget, bbbm->import == NULL && bbbm->opening == NULL);
+    widget = gtk_item_factory_get_item(bbbm->factory, "/Edit/Add Directory...");
+    gtk_widget_set_sensitive(widget, bbbm->import == NULL && bbbm->opening == NULL);
+    widget = gtk_item_factory_get_item(bbbm->factory, "/Edit/Add Collections...");
+    gtk_widget_set_sensitive(widget, bbbm->import == NULL && bbbm->opening == NULL);
+    widget = gtk_item_factory_get_item(bbbm->factory, "/Edit/Add Image Lists...");
+    gtk_widget_set_sensitive(widget, bbbm->import == NULL && bbbm->opening == NULL);
+
     widget = gtk_item_factory_get_item(bbbm->factory, "/Edit/Sort On Filename");
     gtk_widget_set_sensitive(widget, has_images);
     widget = gtk_item_factory_get_item(bbbm->factory, "/Edit/Sort On Description");
     gtk_widget_set_sensitive(widget, has_images);
+    widget = gtk_item_factory_get_item(bbbm->factory, "/Edit/Sort On Resolution");
+    gtk_widget_set_sensitive(widget, has_images);
+    widget = gtk_item_factory_get_item(bbbm->factory, "/Edit/Sort On Color");
+    gtk_widget_set_sensitive(widget, has_images);
+    widget = gtk_item_factory_get_item(bbbm->factory, "/Edit/Sort On Brightness");
+    gtk_widget_set_sensitive(widget, has_images);
 
     widget = gtk_item_factory_get_item(bbbm->factory, "/Tools/Random Background");
     gtk_widget_set_sensitive(widget, has_images);
+    widget = gtk_item_factory_get_item(bbbm->factory, "/Tools/Find Duplicates");
+    gtk_widget_set_sensitive(widget, has_images && bbbm->duplicates == NULL);
+    widget = gtk_item_factory_get_item(bbbm->factory, "/Tools/Find Identical Files");
+    gtk_widget_set_sensitive(widget, has_images && bbbm->duplicates == NULL);
 }
 
 static void bbbm_set_modified(BBBM *bbbm, gboolean modified) {
@@ -616,21 +1041,884 @@ static gboolean bbbm_can_close(BBBM *bbbm) {
     return TRUE;
 }
 
-static gboolean bbbm_open_collection(BBBM *bbbm, const gchar *filename) {
-    bbbm_close_collection(bbbm);
-    if (bbbm_add_collection(bbbm, filename)) {
-        bbbm_set_modified(bbbm, FALSE);
-        bbbm->filename = g_strdup(filename);
-        gtk_statusbar_pop(GTK_STATUSBAR(bbbm->file_bar), bbbm->file_cid);
-        gtk_statusbar_push(GTK_STATUSBAR(bbbm->file_bar), bbbm->file_cid, bbbm->filename);
-        bbbm_update_item_enabled_states(bbbm);
-        return TRUE;
+static void bbbm_set_background(BBBM *bbbm, const gchar *filename) {
+    /* neither the set command nor the built-in setter can read archives, so members are extracted first */
+    bbbm_extract(bbbm, filename, NULL);
+}
+
+static void bbbm_extract(BBBM *bbbm, const gchar *filename, const gchar *command) {
+    BBBMExtractRequest *request;
+
+    request = g_malloc(sizeof(BBBMExtractRequest));
+    request->bbbm        = bbbm;
+    request->filename    = g_strdup(filename);
+    request->archive_dir = g_strdup(bbbm->archive_dir);
+    request->command     = g_strdup(command);
+    request->async = bbbm_async_run(filename, BBBM_ASYNC_TIMEOUT, (bbbm_async_function) bbbm_extract_file,
+                                    (bbbm_async_callback) bbbm_file_extracted, request,
+                                    (GDestroyNotify) bbbm_free_extract_request, g_free);
+    if (command != NULL) {
+        bbbm->extracting = g_list_append(bbbm->extracting, request->async);
     } else {
-        bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not open '%s' properly", filename);
-        /* some images might be added, remove them */
-        bbbm_close_collection(bbbm);
+        /* only the most recent background is set */
+        if (bbbm->extracting_background != NULL) {
+            bbbm_async_cancel(bbbm->extracting_background);
+        }
+        bbbm->extracting_background = request->async;
+    }
+}
+
+static gpointer bbbm_extract_file(const gchar *filename, BBBMExtractRequest *request) {
+    if (bbbm_archive_is_member(filename)) {
+        return bbbm_archive_extract(filename, request->archive_dir);
+    }
+    return g_strdup(filename);
+}
+
+static void bbbm_file_extracted(BBBMExtractRequest *request, gchar *extracted, BBBMAsyncStatus status) {
+    BBBM *bbbm;
+    gchar *cmd;
+
+    bbbm = request->bbbm;
+    if (request->command != NULL) {
+        bbbm->extracting = g_list_remove(bbbm->extracting, request->async);
+    } else {
+        bbbm->extracting_background = NULL;
+    }
+    if (extracted == NULL) {
+        bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not extract '%s'", request->filename);
+    } else if (request->command != NULL) {
+        cmd = bbbm_util_get_command(request->command, extracted);
+        bbbm_supervisor_execute(bbbm->supervisor, cmd, NULL, NULL);
+        g_free(cmd);
+    } else {
+        bbbm_queue_background(bbbm, extracted);
+    }
+    g_free(extracted);
+}
+
+static void bbbm_free_extract_request(BBBMExtractRequest *request) {
+    g_free(request->filename);
+    g_free(request->archive_dir);
+    g_free(request->command);
+    g_free(request);
+}
+
+static void bbbm_queue_background(BBBM *bbbm, const gchar *filename) {
+    /* only the most recent request is kept; any earlier request that has not started yet is dropped */
+    g_free(bbbm->pending_background);
+    bbbm->pending_background = g_strdup(filename);
+    /* while a background is being set, bbbm_set_command_finished will pick up the request */
+    if (!bbbm->setting_background && bbbm->pending_background_id == 0) {
+        bbbm->pending_background_id = g_timeout_add(BBBM_SET_BACKGROUND_DELAY,
+                                                    (GSourceFunc) bbbm_set_pending_background, bbbm);
+    }
+}
+
+static gboolean bbbm_set_pending_background(BBBM *bbbm) {
+    gchar *filename;
+
+    bbbm->pending_background_id = 0;
+    if (bbbm->pending_background != NULL && bbbm_options_get_builtin_setter(bbbm->options)) {
+        /* with a cached pixmap this is a lot faster than starting any process */
+        bbbm_background_set(bbbm->background, bbbm->pending_background,
+                            bbbm_options_get_background_mode(bbbm->options),
+                            (bbbm_background_function) bbbm_background_set_finished, bbbm);
+        g_free(bbbm->pending_background);
+        bbbm->pending_background = NULL;
+    } else if (bbbm->pending_background != NULL) {
+        filename = bbbm->pending_background;
+        bbbm->pending_background = NULL;
+        bbbm->setting_background = TRUE;
+        if (!bbbm_options_get_render_cache(bbbm->options)) {
+            bbbm_run_set_command(bbbm, filename);
+        } else {
+            /* bbbm_background_rendered will run the set command; a file that is already rendered is only checked */
+            bbbm_render_cache_render(bbbm->render_cache, filename, bbbm_options_get_background_mode(bbbm->options),
+                                     (bbbm_render_cache_function) bbbm_background_rendered, bbbm);
+        }
+        g_free(filename);
+    }
+    return FALSE;
+}
+
+static void bbbm_run_set_command(BBBM *bbbm, const gchar *filename) {
+    gchar *cmd;
+
+    cmd = bbbm_util_get_command(bbbm_options_get_set_command(bbbm->options), filename);
+    bbbm_supervisor_execute(bbbm->supervisor, cmd, (bbbm_supervisor_function) bbbm_set_command_finished, bbbm);
+    g_free(cmd);
+}
+
+static void bbbm_set_command_finished(BBBM *bbbm, const gchar *command, gint status, gdouble duration) {
+    bbbm->setting_background = FALSE;
+    /* set the last background requested in the mean time right away, so the last request always wins */
+    if (bbbm->pending_background != NULL) {
+        bbbm_set_pending_background(bbbm);
+    }
+}
+
+static void bbbm_background_rendered(BBBM *bbbm, const gchar *filename, const gchar *rendered_file) {
+    if (bbbm->pending_background != NULL) {
+        /* a newer request came in while rendering; that one wins */
+        bbbm->setting_background = FALSE;
+        bbbm_set_pending_background(bbbm);
+    } else {
+        /* if rendering failed the set command can still try the original file */
+        bbbm_run_set_command(bbbm, rendered_file != NULL ? rendered_file : filename);
+    }
+}
+
+static void bbbm_background_set_finished(BBBM *bbbm, const gchar *filename, gboolean success) {
+    if (!success) {
+        bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not set '%s' as background", filename);
+    }
+}
+
+static gboolean bbbm_prerender_hovered_background(BBBM *bbbm) {
+    bbbm->hovered_background_id = 0;
+    bbbm_render_cache_prerender(bbbm->render_cache, bbbm->hovered_background,
+                                bbbm_options_get_background_mode(bbbm->options));
+    return FALSE;
+}
+
+static void bbbm_cancel_prerender(BBBM *bbbm) {
+    if (bbbm->hovered_background_id != 0) {
+        g_source_remove(bbbm->hovered_background_id);
+        bbbm->hovered_background_id = 0;
+    } else if (bbbm->hovered_background != NULL) {
+        /* the render has already been requested */
+        bbbm_render_cache_cancel(bbbm->render_cache);
+    }
+    g_free(bbbm->hovered_background);
+    bbbm->hovered_background = NULL;
+}
+
+static void bbbm_screen_changed(GdkScreen *screen, BBBM *bbbm) {
+    bbbm_render_cache_clear(bbbm->render_cache);
+    /* scores are against the largest monitor, which may have changed */
+    g_hash_table_destroy(bbbm->fit_scores);
+    bbbm->fit_scores = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static BBBMImage *bbbm_pick_random_image(BBBM *bbbm, GRand *rand) {
+    BBBMRandomMode mode;
+    GdkScreen *screen;
+    GdkRectangle geometry;
+    gint width = 0, height = 0, i;
+    guint count, candidates, index;
+    gdouble *weights, total;
+    GList *iterator;
+
+    count = g_list_length(bbbm->images);
+    mode = bbbm_options_get_random_mode(bbbm->options);
+    if (mode == BBBM_RANDOM_ANY) {
+        return BBBM_IMAGE(g_list_nth_data(bbbm->images, g_rand_int_range(rand, 0, count)));
+    }
+
+    /* the background should look good on the largest monitor */
+    screen = gdk_screen_get_default();
+    for (i = 0; i < gdk_screen_get_n_monitors(screen); ++i) {
+        gdk_screen_get_monitor_geometry(screen, i, &geometry);
+        if (geometry.width * geometry.height > width * height) {
+            width = geometry.width;
+            height = geometry.height;
+        }
+    }
+
+    weights = g_new(gdouble, count);
+    candidates = 0;
+    for (iterator = bbbm->images, index = 0; iterator != NULL; iterator = iterator->next, ++index) {
+        weights[index] = bbbm_get_fit_score(bbbm, bbbm_image_get_filename(BBBM_IMAGE(iterator->data)),
+                                            width, height);
+        if (weights[index] >= BBBM_FIT_THRESHOLD) {
+            ++candidates;
+        }
+    }
+    total = 0;
+    for (index = 0; index < count; ++index) {
+        if (mode == BBBM_RANDOM_FITTING && candidates > 0) {
+            /* only fitting images, all equally likely */
+            weights[index] = weights[index] >= BBBM_FIT_THRESHOLD ? 1 : 0;
+        } else {
+            /* squaring makes images that fit clearly preferred, without excluding any */
+            weights[index] = weights[index] * weights[index] + BBBM_FIT_MIN_WEIGHT;
+        }
+        total += weights[index];
+    }
+    if (mode == BBBM_RANDOM_FITTING && candidates == 0) {
+        g_info("no image fits %dx%d; preferring the best fitting images instead", width, height);
+    }
+
+    total = g_rand_double_range(rand, 0, total);
+    for (index = 0; index < count - 1 && total >= weights[index]; ++index) {
+        total -= weights[index];
+    }
+    g_free(weights);
+    return BBBM_IMAGE(g_list_nth_data(bbbm->images, index));
+}
+
+static gdouble bbbm_get_fit_score(BBBM *bbbm, const gchar *filename, gint width, gint height) {
+    gpointer value;
+    const BBBMMetadata *metadata;
+    guint score;
+
+    /* scores are stored in thousandths, plus one so a score of 0 can be told apart from a missing one */
+    value = g_hash_table_lookup(bbbm->fit_scores, filename);
+    if (value != NULL) {
+        return (GPOINTER_TO_UINT(value) - 1) / 1000.0;
+    }
+    /* the metadata has been refreshed by bbbm_menu_tools_random_background */
+    metadata = bbbm_metadata_index_peek(bbbm->metadata, filename);
+    score = metadata != NULL ? (guint) (bbbm_metadata_get_fit(metadata, width, height) * 1000 + 0.5) : 0;
+    g_hash_table_insert(bbbm->fit_scores, g_strdup(filename), GUINT_TO_POINTER(score + 1));
+    return score / 1000.0;
+}
+
+static void bbbm_find_duplicates(BBBM *bbbm, gboolean identical) {
+    const gchar **filenames;
+    GList *iterator;
+    guint count, i;
+
+    /* the images are kept alive until the search has finished, even if they are removed in the meantime */
+    count = g_list_length(bbbm->images);
+    filenames = g_new(const gchar *, count);
+    bbbm->duplicate_images = g_ptr_array_sized_new(count);
+    for (iterator = bbbm->images, i = 0; iterator != NULL; iterator = iterator->next, ++i) {
+        g_ptr_array_add(bbbm->duplicate_images, g_object_ref(iterator->data));
+        filenames[i] = bbbm_image_get_filename(BBBM_IMAGE(iterator->data));
+    }
+    if (identical) {
+        bbbm->duplicates = bbbm_duplicates_find_identical(filenames, count,
+                                                          (bbbm_duplicates_function) bbbm_duplicates_found, bbbm);
+    } else {
+        bbbm->duplicates = bbbm_duplicates_find_similar(filenames, count, BBBM_DUPLICATES_SIMILAR_THRESHOLD,
+                                                        (bbbm_duplicates_function) bbbm_duplicates_found, bbbm);
+    }
+    g_free(filenames);
+
+    gtk_statusbar_push(GTK_STATUSBAR(bbbm->file_bar),
+                       gtk_statusbar_get_context_id(GTK_STATUSBAR(bbbm->file_bar), "Duplicates"),
+                       "Looking for duplicates...");
+    bbbm_update_item_enabled_states(bbbm);
+}
+
+static void bbbm_duplicates_found(BBBM *bbbm, GList *groups) {
+    GList *image_groups = NULL, *iterator, *removed;
+
+    /* the search destroys itself after this call */
+    bbbm->duplicates = NULL;
+    gtk_statusbar_pop(GTK_STATUSBAR(bbbm->file_bar),
+                      gtk_statusbar_get_context_id(GTK_STATUSBAR(bbbm->file_bar), "Duplicates"));
+
+    for (iterator = groups; iterator != NULL; iterator = iterator->next) {
+        GList *image_group = NULL, *index;
+
+        for (index = (GList *) iterator->data; index != NULL; index = index->next) {
+            gpointer image = g_ptr_array_index(bbbm->duplicate_images, GPOINTER_TO_UINT(index->data));
+
+            /* skip images that have been removed during the search */
+            if (g_list_find(bbbm->images, image) != NULL) {
+                image_group = g_list_prepend(image_group, image);
+            }
+        }
+        if (image_group != NULL && image_group->next != NULL) {
+            image_groups = g_list_prepend(image_groups, g_list_reverse(image_group));
+        } else {
+            g_list_free(image_group);
+        }
+    }
+    image_groups = g_list_reverse(image_groups);
+
+    removed = bbbm_dialogs_duplicates(GTK_WINDOW(bbbm->window), "Duplicates", image_groups);
+    if (removed != NULL) {
+        for (iterator = removed; iterator != NULL; iterator = iterator->next) {
+            bbbm->images = g_list_remove(bbbm->images, iterator->data);
+            gtk_widget_destroy(GTK_WIDGET(iterator->data));
+            g_object_unref(iterator->data);
+        }
+        g_list_free(removed);
+        bbbm_reset_images(bbbm, 0);
+        bbbm_set_modified(bbbm, TRUE);
+    }
+    for (iterator = image_groups; iterator != NULL; iterator = iterator->next) {
+        g_list_free((GList *) iterator->data);
+    }
+    g_list_free(image_groups);
+
+    g_ptr_array_foreach(bbbm->duplicate_images, (GFunc) g_object_unref, NULL);
+    g_ptr_array_free(bbbm->duplicate_images, TRUE);
+    bbbm->duplicate_images = NULL;
+    bbbm_update_item_enabled_states(bbbm);
+}
+
+static void bbbm_cancel_duplicates(BBBM *bbbm) {
+    if (bbbm->duplicates != NULL) {
+        bbbm_duplicates_cancel(bbbm->duplicates);
+        bbbm->duplicates = NULL;
+        g_ptr_array_foreach(bbbm->duplicate_images, (GFunc) g_object_unref, NULL);
+        g_ptr_array_free(bbbm->duplicate_images, TRUE);
+        bbbm->duplicate_images = NULL;
+    }
+}
+
+static void bbbm_thumbnail_loaded(BBBM *bbbm, BBBMImage *image, GdkPixbuf *pixbuf, BBBMValidateStatus status,
+                                  const BBBMMetadata *metadata) {
+    if (status != BBBM_VALIDATE_OK) {
+        GList *iterator;
+
+        g_warning("could not load '%s': %s", bbbm_image_get_filename(image), bbbm_validate_status_to_string(status));
+        /* a thumbnail that is loaded again, for instance after a resize, is only offered once */
+        for (iterator = bbbm->loaded_broken; iterator != NULL; iterator = iterator->next) {
+            if (((BBBMBrokenEntry *) iterator->data)->image == image) {
+                break;
+            }
+        }
+        if (iterator == NULL) {
+            BBBMBrokenEntry *broken_entry = g_malloc(sizeof(BBBMBrokenEntry));
+
+            broken_entry->entry = bbbm_collection_entry_new(bbbm_image_get_filename(image),
+                                                            bbbm_image_get_description(image));
+            broken_entry->entry->status = status;
+            broken_entry->index = 0;
+            broken_entry->image = image;
+            g_object_ref(image);
+            bbbm->loaded_broken = g_list_append(bbbm->loaded_broken, broken_entry);
+        }
+    }
+    /* the dialog is not shown from within the loader's poll, which would run while the dialog is open */
+    if (bbbm->loaded_broken != NULL && bbbm->loaded_broken_id == 0
+            && bbbm_loader_get_pending_count(bbbm->loader) == 0) {
+        bbbm->loaded_broken_id = g_idle_add((GSourceFunc) bbbm_repair_loaded, bbbm);
+    }
+    bbbm_image_set_thumbnail(image, pixbuf, status);
+    if (metadata != NULL) {
+        /* read by the loader thread along with the thumbnail */
+        bbbm_metadata_index_put(bbbm->metadata, bbbm_image_get_filename(image), metadata);
+    }
+}
+
+static void bbbm_prioritize_visible(BBBM *bbbm) {
+    GtkAdjustment *adjustment;
+    GPtrArray *visible;
+    GList *iterator;
+    guint image_count, column_count, rows, first, last, i;
+    gdouble row_height;
+
+    /* the table has no parent while the window is being destroyed */
+    if (bbbm->images == NULL || !bbbm_options_get_thumb_deferred(bbbm->options)
+            || gtk_widget_get_parent(bbbm->table) == NULL) {
+        return;
+    }
+    adjustment   = gtk_viewport_get_vadjustment(GTK_VIEWPORT(gtk_widget_get_parent(bbbm->table)));
+    image_count  = g_list_length(bbbm->images);
+    column_count = bbbm_options_get_thumb_column_count(bbbm->options);
+    rows = (image_count + column_count - 1) / column_count;
+    /* all rows have the same height; before the table is allocated, estimate it */
+    if (bbbm->table->allocation.height > 1) {
+        row_height = (gdouble) bbbm->table->allocation.height / rows;
+    } else {
+        row_height = bbbm_options_get_thumb_height(bbbm->options) + 2 * PADDING;
+    }
+    /* the rows on screen, and the ones below them which are likely to be scrolled to next */
+    first = (guint) (adjustment->value / row_height) * column_count;
+    last  = MIN((guint) ((adjustment->value + 2 * adjustment->page_size) / row_height + 1) * column_count,
+                image_count);
+
+    visible = g_ptr_array_new();
+    for (iterator = g_list_nth(bbbm->images, first), i = first; iterator != NULL && i < last;
+         iterator = iterator->next, ++i) {
+        g_ptr_array_add(visible, iterator->data);
+    }
+    /* each one is moved to the front, so the first one must be moved last */
+    for (i = visible->len; i > 0; --i) {
+        bbbm_loader_prioritize(bbbm->loader, g_ptr_array_index(visible, i - 1));
+    }
+    g_ptr_array_free(visible, TRUE);
+}
+
+static void bbbm_import_files(BBBM *bbbm, GList *files, BBBMImportSource source) {
+    const gchar **filenames;
+    GList *iterator;
+    guint count, i, width = 0, height = 0;
+
+    if (files == NULL) {
+        return;
+    }
+    count = g_list_length(files);
+    filenames = g_new(const gchar *, count);
+    for (iterator = files, i = 0; iterator != NULL; iterator = iterator->next, ++i) {
+        filenames[i] = (const gchar *) iterator->data;
+    }
+    /* deferred thumbs are left to the loader, which decodes the ones in view first */
+    if (!bbbm_options_get_thumb_deferred(bbbm->options)) {
+        width  = bbbm_options_get_thumb_width(bbbm->options);
+        height = bbbm_options_get_thumb_height(bbbm->options);
+    }
+    bbbm->import = bbbm_import_new(filenames, count, source, width, height,
+                                   (bbbm_import_function) bbbm_imported, bbbm);
+    g_free(filenames);
+    g_list_foreach(files, (GFunc) g_free, NULL);
+    g_list_free(files);
+
+    bbbm->import_dialog = bbbm_dialogs_progress_new(GTK_WINDOW(bbbm->window), "Adding images", BBBM_IMPORT_STAGES);
+    g_signal_connect(G_OBJECT(bbbm->import_dialog), "response", G_CALLBACK(bbbm_import_dialog_response), bbbm);
+    /* the dialog is destroyed along with the window */
+    g_signal_connect(G_OBJECT(bbbm->import_dialog), "destroy", G_CALLBACK(gtk_widget_destroyed),
+                     &(bbbm->import_dialog));
+    bbbm_update_item_enabled_states(bbbm);
+}
+
+static void bbbm_imported(BBBM *bbbm, GList *items, gboolean finished) {
+    GList *iterator, *added = NULL, *broken, *failed;
+    guint index, column_count, count;
+
+    index = g_list_length(bbbm->images);
+    column_count = bbbm_options_get_thumb_column_count(bbbm->options);
+    /* like bbbm_add_entries, the table grows once per batch */
+    count = index + g_list_length(items);
+    if (items != NULL) {
+        gtk_table_resize(GTK_TABLE(bbbm->table), MAX((count + column_count - 1) / column_count, 1),
+                         MAX(MIN(count, column_count), 1));
+    }
+    for (iterator = items; iterator != NULL; iterator = iterator->next) {
+        BBBMImportItem *item = (BBBMImportItem *) iterator->data;
+        GtkWidget *image;
+
+        if (item->is_source) {
+            bbbm->import_failed = g_list_append(bbbm->import_failed, g_strdup(item->filename));
+            continue;
+        }
+        if (item->status != BBBM_VALIDATE_OK
+                && (item->source == BBBM_IMPORT_IMAGE || item->source == BBBM_IMPORT_DIRECTORY)) {
+            /* files that were picked or listed, but that are no images */
+            g_debug("skipping '%s': %s", item->filename, bbbm_validate_status_to_string(item->status));
+            continue;
+        }
+        if (item->status != BBBM_VALIDATE_OK && !bbbm_options_get_thumb_deferred(bbbm->options)) {
+            BBBMBrokenEntry *broken_entry = g_malloc(sizeof(BBBMBrokenEntry));
+
+            g_warning("skipping '%s': %s", item->filename, bbbm_validate_status_to_string(item->status));
+            broken_entry->entry = bbbm_collection_entry_new(item->filename, item->description);
+            broken_entry->entry->status = item->status;
+            broken_entry->index = index;
+            broken_entry->image = NULL;
+            bbbm->import_broken = g_list_append(bbbm->import_broken, broken_entry);
+            continue;
+        }
+        /* with deferred thumbs, broken entries are added anyway, and marked once the loader gets to them */
+        if (item->has_metadata) {
+            bbbm_metadata_index_put(bbbm->metadata, item->filename, &(item->metadata));
+        }
+        image = bbbm_create_image(bbbm, item->filename, item->description, item->thumbnail);
+        bbbm_attach_image(GTK_TABLE(bbbm->table), image, index % column_count, index / column_count);
+        added = g_list_prepend(added, image);
+        ++index;
+    }
+    if (index != count) {
+        /* the skipped files took up room they do not need */
+        gtk_table_resize(GTK_TABLE(bbbm->table), MAX((index + column_count - 1) / column_count, 1),
+                         MAX(MIN(index, column_count), 1));
+    }
+    if (added != NULL) {
+        bbbm->images = g_list_concat(bbbm->images, g_list_reverse(added));
+        bbbm_set_modified(bbbm, TRUE);
+    }
+
+    if (!finished) {
+        bbbm_update_import_progress(bbbm);
+        if (added != NULL) {
+            bbbm_update_item_enabled_states(bbbm);
+        }
+        return;
+    }
+    /* the import destroys itself */
+    bbbm->import = NULL;
+    if (bbbm->import_dialog != NULL) {
+        gtk_widget_destroy(bbbm->import_dialog);
+    }
+    bbbm_update_item_enabled_states(bbbm);
+
+    failed = bbbm->import_failed;
+    bbbm->import_failed = NULL;
+    for (iterator = failed; iterator != NULL; iterator = iterator->next) {
+        bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not add '%s' properly", (gchar *) iterator->data);
+        g_free(iterator->data);
+    }
+    g_list_free(failed);
+    broken = bbbm->import_broken;
+    bbbm->import_broken = NULL;
+    bbbm_repair_entries(bbbm, broken);
+}
+
+static void bbbm_update_import_progress(BBBM *bbbm) {
+    BBBMImportProgress progress;
+    gchar *lines[BBBM_IMPORT_STAGES];
+    guint stage;
+
+    if (bbbm->import_dialog == NULL) {
+        return;
+    }
+    bbbm_import_get_progress(bbbm->import, &progress);
+    for (stage = 0; stage < BBBM_IMPORT_STAGES; ++stage) {
+        guint done = progress.done[stage];
+
+        /* the rate shows which stage holds up the others, the time per file why */
+        lines[stage] = g_strdup_printf("%s: %u (%.0f per second, %.1f ms each)", bbbm_import_stage_to_string(stage),
+                                       done, progress.elapsed > 0 ? done / progress.elapsed : 0,
+                                       done > 0 ? progress.busy[stage] * 1000 / done : 0);
+    }
+    bbbm_dialogs_progress_update(bbbm->import_dialog,
+                                 progress.total > 0 ? (gdouble) progress.done[BBBM_IMPORT_INSERT] / progress.total : 0,
+                                 (const gchar **) lines);
+    for (stage = 0; stage < BBBM_IMPORT_STAGES; ++stage) {
+        g_free(lines[stage]);
+    }
+}
+
+static void bbbm_import_dialog_response(GtkDialog *dialog, gint response, BBBM *bbbm) {
+    /* the images added so far are kept */
+    bbbm_cancel_import(bbbm);
+    bbbm_update_item_enabled_states(bbbm);
+}
+
+static void bbbm_cancel_import(BBBM *bbbm) {
+    if (bbbm->import != NULL) {
+        bbbm_import_cancel(bbbm->import);
+        bbbm->import = NULL;
+    }
+    if (bbbm->import_dialog != NULL) {
+        gtk_widget_destroy(bbbm->import_dialog);
+    }
+    g_list_foreach(bbbm->import_broken, (GFunc) bbbm_free_broken_entry, NULL);
+    g_list_free(bbbm->import_broken);
+    bbbm->import_broken = NULL;
+    g_list_foreach(bbbm->import_failed, (GFunc) g_free, NULL);
+    g_list_free(bbbm->import_failed);
+    bbbm->import_failed = NULL;
+}
+
+static gboolean bbbm_repair_loaded(BBBM *bbbm) {
+    GList *broken;
+
+    bbbm->loaded_broken_id = 0;
+    if (bbbm_loader_get_pending_count(bbbm->loader) > 0) {
+        /* more thumbnails were queued in the meantime; wait for those as well */
         return FALSE;
     }
+    broken = bbbm->loaded_broken;
+    bbbm->loaded_broken = NULL;
+    bbbm_repair_entries(bbbm, broken);
+    return FALSE;
+}
+
+static void bbbm_cancel_loaded_broken(BBBM *bbbm) {
+    if (bbbm->loaded_broken_id != 0) {
+        g_source_remove(bbbm->loaded_broken_id);
+        bbbm->loaded_broken_id = 0;
+    }
+    g_list_foreach(bbbm->loaded_broken, (GFunc) bbbm_free_broken_entry, NULL);
+    g_list_free(bbbm->loaded_broken);
+    bbbm->loaded_broken = NULL;
+}
+
+static void bbbm_refresh_metadata(BBBM *bbbm, GList *images, void (* finished) (BBBM *bbbm)) {
+    BBBMRefreshRequest *request;
+    const BBBMMetadata *metadata;
+    GList *iterator;
+    guint i;
+
+    /* only the most recent request is finished */
+    if (bbbm->refreshing != NULL) {
+        bbbm_async_cancel(bbbm->refreshing);
+        bbbm->refreshing = NULL;
+    }
+    if (images == NULL) {
+        finished(bbbm);
+        return;
+    }
+    request = g_malloc(sizeof(BBBMRefreshRequest));
+    request->bbbm = bbbm;
+    request->count = g_list_length(images);
+    request->filenames = g_new(gchar *, request->count + 1);
+    request->metadata = g_new(BBBMMetadata, request->count);
+    request->indexed = g_new(gboolean, request->count);
+    request->finished = finished;
+    for (iterator = images, i = 0; iterator != NULL; iterator = iterator->next, ++i) {
+        request->filenames[i] = g_strdup(bbbm_image_get_filename(BBBM_IMAGE(iterator->data)));
+        metadata = bbbm_metadata_index_peek(bbbm->metadata, request->filenames[i]);
+        request->indexed[i] = metadata != NULL;
+        if (metadata != NULL) {
+            request->metadata[i] = *metadata;
+        }
+    }
+    request->filenames[request->count] = NULL;
+    bbbm->refreshing = bbbm_async_run(request->filenames[0], bbbm_async_get_timeout(request->count),
+                                      (bbbm_async_function) bbbm_refresh_files,
+                                      (bbbm_async_callback) bbbm_metadata_refreshed, request,
+                                      (GDestroyNotify) bbbm_free_refresh_request, g_free);
+}
+
+static gpointer bbbm_refresh_files(const gchar *filename, BBBMRefreshRequest *request) {
+    BBBMRefreshedMetadata *refreshed;
+    guint i;
+
+    refreshed = g_new(BBBMRefreshedMetadata, request->count);
+    for (i = 0; i < request->count; ++i) {
+        refreshed[i].changed = !request->indexed[i]
+                               || !bbbm_metadata_is_current(&(request->metadata[i]), request->filenames[i]);
+        refreshed[i].readable = refreshed[i].changed
+                                && bbbm_metadata_read(request->filenames[i], &(refreshed[i].metadata));
+    }
+    return refreshed;
+}
+
+static void bbbm_metadata_refreshed(BBBMRefreshRequest *request, BBBMRefreshedMetadata *refreshed,
+                                    BBBMAsyncStatus status) {
+    BBBM *bbbm;
+    guint i;
+
+    bbbm = request->bbbm;
+    bbbm->refreshing = NULL;
+    if (refreshed == NULL) {
+        g_warning("gave up refreshing the metadata of %u images; using the indexed metadata", request->count);
+    } else {
+        for (i = 0; i < request->count; ++i) {
+            if (!refreshed[i].changed) {
+                continue;
+            }
+            if (refreshed[i].readable) {
+                bbbm_metadata_index_put(bbbm->metadata, request->filenames[i], &(refreshed[i].metadata));
+            } else {
+                bbbm_metadata_index_remove(bbbm->metadata, request->filenames[i]);
+            }
+            g_hash_table_remove(bbbm->fit_scores, request->filenames[i]);
+        }
+        g_free(refreshed);
+    }
+    request->finished(bbbm);
+}
+
+static void bbbm_free_refresh_request(BBBMRefreshRequest *request) {
+    g_strfreev(request->filenames);
+    g_free(request->metadata);
+    g_free(request->indexed);
+    g_free(request);
+}
+
+static void bbbm_open_collection(BBBM *bbbm, const gchar *filename) {
+    BBBMOpenRequest *request;
+    gchar *text;
+
+    bbbm_close_collection(bbbm);
+
+    request = g_malloc(sizeof(BBBMOpenRequest));
+    request->bbbm = bbbm;
+    request->filename = g_strdup(filename);
+    /* without deferred thumbs all files are checked at once; that too should not block the main loop */
+    request->validate = !bbbm_options_get_thumb_deferred(bbbm->options);
+    request->entries = NULL;
+    bbbm->opening = bbbm_async_run(filename, BBBM_ASYNC_TIMEOUT, (bbbm_async_function) bbbm_read_collection,
+                                   (bbbm_async_callback) bbbm_collection_opened, request,
+                                   (GDestroyNotify) bbbm_free_open_request, (GDestroyNotify) bbbm_free_open_result);
+
+    text = g_strdup_printf("Opening %s...", filename);
+    gtk_statusbar_pop(GTK_STATUSBAR(bbbm->file_bar), bbbm->file_cid);
+    gtk_statusbar_push(GTK_STATUSBAR(bbbm->file_bar), bbbm->file_cid, text);
+    g_free(text);
+    bbbm_update_item_enabled_states(bbbm);
+}
+
+static gpointer bbbm_read_collection(const gchar *filename, BBBMOpenRequest *request) {
+    BBBMOpenResult *result;
+
+    result = g_malloc(sizeof(BBBMOpenResult));
+    result->entries = NULL;
+    /* the files are checked afterwards, with a timeout that depends on how many there are */
+    result->success = bbbm_collection_read_all(filename, FALSE, FALSE, &(result->entries));
+    return result;
+}
+
+static void bbbm_collection_opened(BBBMOpenRequest *request, BBBMOpenResult *result, BBBMAsyncStatus status) {
+    BBBM *bbbm;
+    BBBMOpenRequest *validation;
+
+    bbbm = request->bbbm;
+    bbbm->opening = NULL;
+    if (result == NULL || !result->success) {
+        if (result != NULL) {
+            bbbm_free_open_result(result);
+        }
+        bbbm_collection_failed(bbbm, request->filename, status);
+        return;
+    }
+    if (!request->validate) {
+        bbbm_collection_loaded(bbbm, request->filename, result->entries);
+        bbbm_free_open_result(result);
+        return;
+    }
+    validation = g_malloc(sizeof(BBBMOpenRequest));
+    validation->bbbm = bbbm;
+    validation->filename = g_strdup(request->filename);
+    validation->validate = TRUE;
+    validation->entries = result->entries;
+    result->entries = NULL;
+    bbbm_free_open_result(result);
+    bbbm->opening = bbbm_async_run(validation->filename, bbbm_async_get_timeout(g_list_length(validation->entries)),
+                                   (bbbm_async_function) bbbm_validate_collection,
+                                   (bbbm_async_callback) bbbm_collection_validated, validation,
+                                   (GDestroyNotify) bbbm_free_open_request, NULL);
+}
+
+static gpointer bbbm_validate_collection(const gchar *filename, BBBMOpenRequest *request) {
+    /* only the statuses of the entries are changed, and the main loop does not touch them until this is done */
+    bbbm_collection_validate(request->entries);
+    return request;
+}
+
+static void bbbm_collection_validated(BBBMOpenRequest *request, gpointer result, BBBMAsyncStatus status) {
+    BBBM *bbbm;
+
+    bbbm = request->bbbm;
+    bbbm->opening = NULL;
+    if (result == NULL) {
+        bbbm_collection_failed(bbbm, request->filename, status);
+        return;
+    }
+    bbbm_collection_loaded(bbbm, request->filename, request->entries);
+}
+
+static void bbbm_collection_loaded(BBBM *bbbm, const gchar *filename, GList *entries) {
+    GList *broken = NULL;
+
+    /* broken entries no longer fail the whole collection; they are reported, and can be repaired */
+    bbbm_add_entries(bbbm, entries, &broken);
+    bbbm_set_modified(bbbm, FALSE);
+    bbbm->filename = g_strdup(filename);
+    gtk_statusbar_pop(GTK_STATUSBAR(bbbm->file_bar), bbbm->file_cid);
+    gtk_statusbar_push(GTK_STATUSBAR(bbbm->file_bar), bbbm->file_cid, bbbm->filename);
+    bbbm_update_item_enabled_states(bbbm);
+    bbbm_repair_entries(bbbm, broken);
+}
+
+static void bbbm_collection_failed(BBBM *bbbm, const gchar *filename, BBBMAsyncStatus status) {
+    if (status == BBBM_ASYNC_TIMED_OUT) {
+        bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Gave up opening '%s'; it took too long", filename);
+    } else {
+        bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not open '%s'", filename);
+    }
+    bbbm_close_collection(bbbm);
+}
+
+static void bbbm_free_open_request(BBBMOpenRequest *request) {
+    bbbm_collection_free(request->entries);
+    g_free(request->filename);
+    g_free(request);
+}
+
+static void bbbm_free_open_result(BBBMOpenResult *result) {
+    bbbm_collection_free(result->entries);
+    g_free(result);
+}
+
+static gpointer bbbm_check_image(const gchar *filename, gpointer unused) {
+    return GINT_TO_POINTER(bbbm_util_is_image(filename));
+}
+
+static void bbbm_image_checked(BBBMAddRequest *request, gpointer is_image, BBBMAsyncStatus status) {
+    BBBM *bbbm;
+
+    bbbm = request->bbbm;
+    bbbm->adding = g_list_remove(bbbm->adding, request->async);
+    if (!GPOINTER_TO_INT(is_image) || !bbbm_add_image(bbbm, request->filename, NULL, -1)) {
+        bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Could not add image '%s'", request->filename);
+    }
+}
+
+static void bbbm_free_add_request(BBBMAddRequest *request) {
+    g_free(request->filename);
+    g_free(request);
+}
+
+static gpointer bbbm_read_metadata(const gchar *filename, gpointer unused) {
+    BBBMMetadata *metadata;
+
+    metadata = g_malloc(sizeof(BBBMMetadata));
+    if (!bbbm_metadata_read(filename, metadata)) {
+        g_free(metadata);
+        return NULL;
+    }
+    return metadata;
+}
+
+static void bbbm_hovered_metadata_read(BBBMImage *image, BBBMMetadata *metadata, BBBMAsyncStatus status) {
+    const BBBMMetadata *indexed;
+
+    image->bbbm->hovering = NULL;
+    /* the image may have been deleted while the pointer was on it */
+    if (metadata == NULL || bbbm_image_get_filename(image) == NULL) {
+        g_free(metadata);
+        return;
+    }
+    /* keep the colors that were taken from the thumbnail if the file has not changed */
+    indexed = bbbm_metadata_index_peek(image->bbbm->metadata, bbbm_image_get_filename(image));
+    if (indexed != NULL && indexed->has_colors && indexed->mtime == metadata->mtime
+            && indexed->size == metadata->size) {
+        metadata->has_colors = TRUE;
+        metadata->colors = indexed->colors;
+    }
+    bbbm_metadata_index_put(image->bbbm->metadata, bbbm_image_get_filename(image), metadata);
+    bbbm_show_image_info(image, metadata);
+    g_free(metadata);
+}
+
+static void bbbm_show_image_info(BBBMImage *image, const BBBMMetadata *metadata) {
+    /* pop any existing image first */
+    gtk_statusbar_pop(GTK_STATUSBAR(image->bbbm->image_bar), image->bbbm->image_cid);
+    if (bbbm_image_get_status(image) != BBBM_VALIDATE_OK) {
+        /* found out by the loader; there is no metadata to show */
+        gchar *text = g_strdup_printf("%s (%s)", bbbm_image_get_description(image),
+                                      bbbm_validate_status_to_string(bbbm_image_get_status(image)));
+        gtk_statusbar_push(GTK_STATUSBAR(image->bbbm->image_bar), image->bbbm->image_cid, text);
+        g_free(text);
+    } else if (metadata != NULL) {
+        gchar *details, *text;
+
+        details = bbbm_metadata_to_string(metadata);
+        text = g_strdup_printf("%s (%s)", bbbm_image_get_description(image), details);
+        gtk_statusbar_push(GTK_STATUSBAR(image->bbbm->image_bar), image->bbbm->image_cid, text);
+        g_free(text);
+        g_free(details);
+    } else {
+        gtk_statusbar_push(GTK_STATUSBAR(image->bbbm->image_bar), image->bbbm->image_cid,
+                           bbbm_image_get_description(image));
+    }
+}
+
+static void bbbm_cancel_file_operations(BBBM *bbbm) {
+    if (bbbm->opening != NULL) {
+        bbbm_async_cancel(bbbm->opening);
+        bbbm->opening = NULL;
+    }
+    g_list_foreach(bbbm->adding, (GFunc) bbbm_async_cancel, NULL);
+    g_list_free(bbbm->adding);
+    bbbm->adding = NULL;
+    if (bbbm->hovering != NULL) {
+        bbbm_async_cancel(bbbm->hovering);
+        bbbm->hovering = NULL;
+    }
+    if (bbbm->extracting_background != NULL) {
+        bbbm_async_cancel(bbbm->extracting_background);
+        bbbm->extracting_background = NULL;
+    }
+    g_list_foreach(bbbm->extracting, (GFunc) bbbm_async_cancel, NULL);
+    g_list_free(bbbm->extracting);
+    bbbm->extracting = NULL;
+    if (bbbm->refreshing != NULL) {
+        bbbm_async_cancel(bbbm->refreshing);
+        bbbm->refreshing = NULL;
+    }
+    bbbm_cancel_relocations(bbbm);
 }
 
 static gboolean bbbm_save_collection(BBBM *bbbm, const gchar *filename) {
@@ -661,6 +1949,20 @@ static gboolean bbbm_save_collection(BBBM *bbbm, const gchar *filename) {
 }
 
 static void bbbm_close_collection(BBBM *bbbm) {
+    /* an import would keep adding to the closed collection, and so would a collection that is still being read */
+    bbbm_cancel_import(bbbm);
+    if (bbbm->opening != NULL) {
+        bbbm_async_cancel(bbbm->opening);
+        bbbm->opening = NULL;
+    }
+    /* sorting or picking from the next collection is not what was asked for */
+    if (bbbm->refreshing != NULL) {
+        bbbm_async_cancel(bbbm->refreshing);
+        bbbm->refreshing = NULL;
+    }
+    /* relocated images would end up in the next collection */
+    bbbm_cancel_relocations(bbbm);
+    bbbm_cancel_loaded_broken(bbbm);
     /* remove all images */
     while (bbbm->images != NULL) {
         GtkWidget *image = GTK_WIDGET(bbbm->images->data);
@@ -681,25 +1983,38 @@ static void bbbm_close_collection(BBBM *bbbm) {
     bbbm_update_item_enabled_states(bbbm);
 }
 
-static gboolean bbbm_add_image(BBBM *bbbm, const gchar *filename, const gchar *description, gint index) {
+static GtkWidget *bbbm_create_image(BBBM *bbbm, const gchar *filename, const gchar *description,
+                                    GdkPixbuf *thumbnail) {
     GtkWidget *image;
-    guint thumb_width, thumb_height, thumb_column_count;
-    guint col, row;
+    guint thumb_width, thumb_height;
 
     if (bbbm_str_empty(description)) {
         description = filename;
     }
 
-    thumb_width        = bbbm_options_get_thumb_width(bbbm->options);
-    thumb_height       = bbbm_options_get_thumb_height(bbbm->options);
-    thumb_column_count = bbbm_options_get_thumb_column_count(bbbm->options);
-    image = bbbm_image_new(bbbm, filename, description, thumb_width, thumb_height);
+    thumb_width  = bbbm_options_get_thumb_width(bbbm->options);
+    thumb_height = bbbm_options_get_thumb_height(bbbm->options);
+    if (thumbnail != NULL) {
+        image = bbbm_image_new_from_thumbnail(bbbm, filename, description, thumbnail);
+    } else {
+        image = bbbm_image_new(bbbm, filename, description, thumb_width, thumb_height);
+    }
     g_signal_connect(G_OBJECT(image), "button-press-event",   G_CALLBACK(bbbm_image_mouse_press),   image);
     g_signal_connect(G_OBJECT(image), "button-release-event", G_CALLBACK(bbbm_image_mouse_release), image);
     g_signal_connect(G_OBJECT(image), "enter-notify-event",   G_CALLBACK(bbbm_image_mouse_enter),   image);
     g_signal_connect(G_OBJECT(image), "leave-notify-event",   G_CALLBACK(bbbm_image_mouse_leave),   image);
     gtk_widget_show(image);
     g_object_ref(image);
+    return image;
+}
+
+static gboolean bbbm_add_image(BBBM *bbbm, const gchar *filename, const gchar *description, gint index) {
+    GtkWidget *image;
+    guint thumb_column_count;
+    guint col, row;
+
+    thumb_column_count = bbbm_options_get_thumb_column_count(bbbm->options);
+    image = bbbm_create_image(bbbm, filename, description, NULL);
     if (index == -1) {
         guint img_num = g_list_length(bbbm->images);
         col = img_num % thumb_column_count;
@@ -717,138 +2032,262 @@ static gboolean bbbm_add_image(BBBM *bbbm, const gchar *filename, const gchar *d
     return TRUE;
 }
 
-static gboolean bbbm_add_collection(BBBM *bbbm, const gchar *filename) {
-    gboolean result;
-    gchar file_line[PATH_MAX], description_line[PATH_MAX];
-    FILE *file;
+static void bbbm_add_entries(BBBM *bbbm, GList *entries, GList **broken) {
+    GList *iterator, *added = NULL;
+    guint index, column_count, count;
 
-    file = fopen(filename, "r");
-    if (file == NULL) {
-        return FALSE;
+    index = g_list_length(bbbm->images);
+    column_count = bbbm_options_get_thumb_column_count(bbbm->options);
+    /* grow the table once, instead of once per row */
+    count = index + g_list_length(entries);
+    gtk_table_resize(GTK_TABLE(bbbm->table), MAX((count + column_count - 1) / column_count, 1),
+                     MAX(MIN(count, column_count), 1));
+    for (iterator = entries; iterator != NULL; iterator = iterator->next) {
+        BBBMCollectionEntry *entry = (BBBMCollectionEntry *) iterator->data;
+        GtkWidget *image;
+
+        if (entry->status != BBBM_VALIDATE_OK) {
+            BBBMBrokenEntry *broken_entry = g_malloc(sizeof(BBBMBrokenEntry));
+
+            g_warning("skipping '%s': %s", entry->filename, bbbm_validate_status_to_string(entry->status));
+            /* take the entry over, so it outlives the list */
+            broken_entry->entry = entry;
+            broken_entry->index = index;
+            broken_entry->image = NULL;
+            iterator->data = bbbm_collection_entry_new(entry->filename, entry->description);
+            *broken = g_list_append(*broken, broken_entry);
+            continue;
+        }
+        /* like bbbm_add_image, but without walking the list of images for every entry */
+        image = bbbm_create_image(bbbm, entry->filename, entry->description, NULL);
+        bbbm_attach_image(GTK_TABLE(bbbm->table), image, index % column_count, index / column_count);
+        added = g_list_prepend(added, image);
+        ++index;
+    }
+    if (index != count) {
+        /* the broken entries took up room they do not need */
+        gtk_table_resize(GTK_TABLE(bbbm->table), MAX((index + column_count - 1) / column_count, 1),
+                         MAX(MIN(index, column_count), 1));
+    }
+    if (added != NULL) {
+        bbbm->images = g_list_concat(bbbm->images, g_list_reverse(added));
+        bbbm_set_modified(bbbm, TRUE);
+        bbbm_update_item_enabled_states(bbbm);
     }
+}
 
-    result = TRUE;
-    while (fgets(file_line, PATH_MAX, file) != NULL) {
-        g_strstrip(file_line);
-        if (fgets(description_line, PATH_MAX, file) != NULL) {
-            g_strstrip(description_line);
-        } else {
-            strcpy(description_line, file_line);
-        }
-        if (bbbm_util_is_image(file_line)) {
-            result = result & bbbm_add_image(bbbm, file_line, description_line, -1);
-        } else {
-            result = FALSE;
-        }
+static void bbbm_repair_entries(BBBM *bbbm, GList *broken) {
+    BBBMRelocateRequest *request;
+    GList *entries = NULL, *iterator;
+    const gchar *lines[1];
+    gchar *dir, *text;
+    guint i;
+
+    if (broken == NULL) {
+        return;
     }
-    fclose(file);
-    return result;
+    for (iterator = g_list_last(broken); iterator != NULL; iterator = iterator->prev) {
+        entries = g_list_prepend(entries, ((BBBMBrokenEntry *) iterator->data)->entry);
+    }
+    if (!bbbm_dialogs_broken_entries(GTK_WINDOW(bbbm->window), entries)
+            || (dir = bbbm_dialogs_get_dir(GTK_WINDOW(bbbm->window), "Relocate images")) == NULL) {
+        g_list_free(entries);
+        g_list_foreach(broken, (GFunc) bbbm_free_broken_entry, NULL);
+        g_list_free(broken);
+        return;
+    }
+    g_list_free(entries);
+
+    /* searching a large tree can take a long time, so it is done by a worker thread; the filenames are copied
+       because a search that times out is left running */
+    request = g_malloc(sizeof(BBBMRelocateRequest));
+    request->bbbm = bbbm;
+    request->broken = broken;
+    request->directory = dir;
+    request->count = g_list_length(broken);
+    request->filenames = g_new(gchar *, request->count + 1);
+    request->sizes = g_new(gint64, request->count);
+    for (iterator = broken, i = 0; iterator != NULL; iterator = iterator->next, ++i) {
+        const BBBMMetadata *metadata;
+
+        request->filenames[i] = g_strdup(((BBBMBrokenEntry *) iterator->data)->entry->filename);
+        /* the index remembers the sizes of images that have been seen before */
+        metadata = bbbm_metadata_index_peek(bbbm->metadata, request->filenames[i]);
+        request->sizes[i] = metadata != NULL ? metadata->size : -1;
+    }
+    request->filenames[request->count] = NULL;
+
+    request->dialog = bbbm_dialogs_progress_new(GTK_WINDOW(bbbm->window), "Relocating images", 1);
+    g_signal_connect(G_OBJECT(request->dialog), "response", G_CALLBACK(bbbm_relocate_dialog_response), request);
+    g_signal_connect(G_OBJECT(request->dialog), "destroy", G_CALLBACK(gtk_widget_destroyed), &(request->dialog));
+    text = g_strdup_printf("Searching %s", dir);
+    lines[0] = text;
+    bbbm_dialogs_progress_pulse(request->dialog, lines);
+    g_free(text);
+    request->pulse_id = g_timeout_add(BBBM_RELOCATE_PULSE, (GSourceFunc) bbbm_pulse_relocation, request);
+
+    request->async = bbbm_async_run(dir, BBBM_RELOCATE_TIMEOUT, (bbbm_async_function) bbbm_relocate_files,
+                                    (bbbm_async_callback) bbbm_entries_relocated, request,
+                                    (GDestroyNotify) bbbm_free_relocate_request,
+                                    (GDestroyNotify) bbbm_free_relocate_result);
+    bbbm->relocating = g_list_append(bbbm->relocating, request);
 }
 
-static gboolean bbbm_add_image_list(BBBM *bbbm, const gchar *filename) {
-    gboolean result;
-    gchar file_line[PATH_MAX];
-    FILE *file;
+static gpointer bbbm_relocate_files(const gchar *directory, BBBMRelocateRequest *request) {
+    BBBMRelocateResult *result;
 
-    file = fopen(filename, "r");
-    if (file == NULL) {
-        return FALSE;
+    result = g_malloc(sizeof(BBBMRelocateResult));
+    result->count = request->count;
+    result->relocated = g_new(gchar *, request->count);
+    result->found = bbbm_validate_relocate(directory, (const gchar **) request->filenames, request->sizes,
+                                           request->count, result->relocated);
+    return result;
+}
+
+static void bbbm_entries_relocated(BBBMRelocateRequest *request, BBBMRelocateResult *result, BBBMAsyncStatus status) {
+    BBBM *bbbm;
+    GList *broken, *iterator;
+    guint i, inserted;
+
+    bbbm = request->bbbm;
+    bbbm_finish_relocation(request);
+    broken = request->broken;
+    request->broken = NULL;
+    if (result == NULL) {
+        bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "Gave up searching '%s'; it took too long",
+                           request->directory);
+        bbbm_repair_entries(bbbm, broken);
+        return;
     }
+    if (result->found == 0) {
+        bbbm_dialogs_error(GTK_WINDOW(bbbm->window), "None of the images were found in '%s'", request->directory);
+    }
+
+    /* the entries are in collection order; each insert moves the ones after it */
+    inserted = 0;
+    iterator = broken;
+    for (i = 0; i < result->count; ++i) {
+        BBBMBrokenEntry *broken_entry = (BBBMBrokenEntry *) iterator->data;
+        GList *next = iterator->next;
+        gint index;
 
-    result = TRUE;
-    while (fgets(file_line, PATH_MAX, file) != NULL) {
-        g_strstrip(file_line);
-        if (bbbm_util_is_image(file_line)) {
-            result = result & bbbm_add_image(bbbm, file_line, file_line, -1);
+        if (broken_entry->image != NULL) {
+            /* replace the broken image in place, unless it has been deleted in the meantime */
+            index = g_list_index(bbbm->images, broken_entry->image);
+            if (result->relocated[i] != NULL && index != -1) {
+                bbbm->images = g_list_remove(bbbm->images, broken_entry->image);
+                gtk_widget_destroy(GTK_WIDGET(broken_entry->image));
+                g_object_unref(broken_entry->image);
+                bbbm_add_image(bbbm, result->relocated[i], broken_entry->entry->description, index);
+            }
+            if (result->relocated[i] != NULL || index == -1) {
+                bbbm_free_broken_entry(broken_entry);
+                broken = g_list_delete_link(broken, iterator);
+            }
+        } else if (result->relocated[i] != NULL
+                && bbbm_add_image(bbbm, result->relocated[i], broken_entry->entry->description,
+                                  MIN(broken_entry->index + inserted, g_list_length(bbbm->images)))) {
+            ++inserted;
+            bbbm_free_broken_entry(broken_entry);
+            broken = g_list_delete_link(broken, iterator);
         } else {
-            result = FALSE;
+            broken_entry->index += inserted;
         }
+        iterator = next;
     }
-    fclose(file);
-    return result;
+    bbbm_free_relocate_result(result);
+    /* offer the images that were not found for another search */
+    bbbm_repair_entries(bbbm, broken);
 }
 
-static gboolean bbbm_create_list(BBBM *bbbm, const gchar *filename) {
-    GList *iterator;
-    FILE *file;
-
-    file = fopen(filename, "w");
-    if (file == NULL) {
-        return FALSE;
+static gboolean bbbm_pulse_relocation(BBBMRelocateRequest *request) {
+    if (request->dialog != NULL) {
+        bbbm_dialogs_progress_pulse(request->dialog, NULL);
     }
-    for (iterator = bbbm->images; iterator != NULL; iterator = iterator->next) {
-        fprintf(file, "%s\n", bbbm_image_get_filename(BBBM_IMAGE(iterator->data)));
-    }
-    fclose(file);
     return TRUE;
 }
 
-static gboolean bbbm_create_menu(BBBM *bbbm, const gchar *filename) {
-    gboolean filename_as_label, filename_as_title;
-    GList *iterator;
-    FILE *file;
+static void bbbm_relocate_dialog_response(GtkDialog *dialog, gint response, BBBMRelocateRequest *request) {
+    /* the images that have not been relocated stay broken */
+    bbbm_cancel_relocation(request);
+}
 
-    file = fopen(filename, "w");
-    if (file == NULL) {
-        return FALSE;
+static void bbbm_finish_relocation(BBBMRelocateRequest *request) {
+    request->bbbm->relocating = g_list_remove(request->bbbm->relocating, request);
+    g_source_remove(request->pulse_id);
+    if (request->dialog != NULL) {
+        gtk_widget_destroy(request->dialog);
+    }
+}
+
+static void bbbm_cancel_relocation(BBBMRelocateRequest *request) {
+    bbbm_finish_relocation(request);
+    bbbm_async_cancel(request->async);
+}
+
+static void bbbm_cancel_relocations(BBBM *bbbm) {
+    while (bbbm->relocating != NULL) {
+        bbbm_cancel_relocation((BBBMRelocateRequest *) bbbm->relocating->data);
     }
+}
 
-    filename_as_label = bbbm_options_get_filename_as_label(bbbm->options);
-    filename_as_title = bbbm_options_get_filename_as_title(bbbm->options);
+static void bbbm_free_relocate_request(BBBMRelocateRequest *request) {
+    g_list_foreach(request->broken, (GFunc) bbbm_free_broken_entry, NULL);
+    g_list_free(request->broken);
+    g_free(request->directory);
+    g_strfreev(request->filenames);
+    g_free(request->sizes);
+    g_free(request);
+}
 
-    fprintf(file, "[submenu] (");
-    if (bbbm->filename != NULL && (filename_as_label || filename_as_title)) {
-        gchar *name;
+static void bbbm_free_relocate_result(BBBMRelocateResult *result) {
+    guint i;
 
-        name = g_path_get_basename(bbbm->filename);
-        if (filename_as_label) {
-            bbbm_write_string(file, name);
-            fprintf(file, ")");
-        } else {
-            fprintf(file, "Backgrounds)");
-        }
-        if (filename_as_title) {
-            fprintf(file, " {");
-            bbbm_write_string(file, name);
-            fprintf(file, "}\n");
-        } else {
-            fprintf(file, "\n");
-        }
-        g_free(name);
-    } else {
-        fprintf(file, "Backgrounds)\n");
+    for (i = 0; i < result->count; ++i) {
+        g_free(result->relocated[i]);
     }
-    for (iterator = bbbm->images; iterator != NULL; iterator = iterator->next) {
-        gchar *cmd;
-
-        cmd = bbbm_util_get_command(bbbm_options_get_set_command(bbbm->options),
-                                    bbbm_image_get_filename(BBBM_IMAGE(iterator->data)));
-        fprintf(file, "  [exec] (");
-        bbbm_write_string(file, bbbm_image_get_description(BBBM_IMAGE(iterator->data)));
-        fprintf(file, ") {");
-        bbbm_write_string(file, cmd);
-        fprintf(file, "}\n");
-        g_free(cmd);
+    g_free(result->relocated);
+    g_free(result);
+}
+
+static void bbbm_free_broken_entry(BBBMBrokenEntry *broken_entry) {
+    bbbm_collection_entry_destroy(broken_entry->entry);
+    if (broken_entry->image != NULL) {
+        g_object_unref(broken_entry->image);
     }
-    fclose(file);
-    return TRUE;
+    g_free(broken_entry);
 }
 
-static inline void bbbm_write_string(FILE *file, const gchar *string) {
-    while (*string != '\0') {
-        switch (*string) {
-            case '\\': /* fallthrough */
-            case '(':  /* fallthrough */
-            case ')':  /* fallthrough */
-            case '{':  /* fallthrough */
-            case '}':
-                fputc('\\', file);
-                /* fallthrough */
-            default:
-                fputc(*string++, file);
-                break;
-        }
+static gboolean bbbm_create_list(BBBM *bbbm, const gchar *filename) {
+    gboolean result;
+    GList *entries;
+
+    entries = bbbm_get_entries(bbbm);
+    result = bbbm_collection_write_list(entries, filename);
+    bbbm_collection_free(entries);
+    return result;
+}
+
+static gboolean bbbm_create_menu(BBBM *bbbm, const gchar *filename) {
+    gboolean result;
+    GList *entries;
+
+    entries = bbbm_get_entries(bbbm);
+    result = bbbm_collection_write_menu(entries, bbbm->options, bbbm->filename, filename);
+    bbbm_collection_free(entries);
+    return result;
+}
+
+static GList *bbbm_get_entries(BBBM *bbbm) {
+    GList *entries = NULL;
+    GList *iterator;
+
+    for (iterator = g_list_last(bbbm->images); iterator != NULL; iterator = iterator->prev) {
+        BBBMImage *image = BBBM_IMAGE(iterator->data);
+        entries = g_list_prepend(entries, bbbm_collection_entry_new(bbbm_image_get_filename(image),
+                                                                    bbbm_image_get_description(image)));
     }
+    return entries;
 }
 
 static inline void bbbm_attach_image(GtkTable *table, GtkWidget *image, guint x, guint y) {
@@ -875,6 +2314,8 @@ static void bbbm_reset_images(BBBM *bbbm, guint index) {
         g_object_unref(iterator->data);
     }
     gtk_table_resize(GTK_TABLE(bbbm->table), MAX(rows, 1), MAX(cols, 1));
+    /* other images may have moved into view */
+    bbbm_prioritize_visible(bbbm);
 }
 
 static inline void bbbm_resize_thumbs(BBBM *bbbm) {
@@ -885,4 +2326,6 @@ static inline void bbbm_resize_thumbs(BBBM *bbbm) {
         guint thumb_height = bbbm_options_get_thumb_height(bbbm->options);
         bbbm_image_resize(BBBM_IMAGE(iterator->data), thumb_width, thumb_height);
     }
+    /* with deferred thumbs all images have been queued again */
+    bbbm_prioritize_visible(bbbm);
 }
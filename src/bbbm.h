@@ -23,6 +23,14 @@
 
 #include <gtk/gtk.h>
 #include "options.h"
+#include "supervisor.h"
+#include "background.h"
+#include "render_cache.h"
+#include "metadata.h"
+#include "duplicates.h"
+#include "loader.h"
+#include "import.h"
+#include "async.h"
 
 typedef struct {
     BBBMOptions *options;
@@ -38,6 +46,43 @@ typedef struct {
     GtkWidget *image_bar;
     guint image_cid;
     GtkItemFactory *factory;
+    BBBMSupervisor *supervisor;
+    gchar *pending_background;
+    guint pending_background_id;
+    gboolean setting_background;
+    BBBMBackground *background;
+    BBBMRenderCache *render_cache;
+    /* where archive members are extracted to before they are set */
+    gchar *archive_dir;
+    gchar *hovered_background;
+    guint hovered_background_id;
+    BBBMMetadataIndex *metadata;
+    /* filename -> how well the image fits the largest monitor, see bbbm_get_fit_score */
+    GHashTable *fit_scores;
+    /* the running search for duplicates, and the images it searches */
+    BBBMDuplicates *duplicates;
+    GPtrArray *duplicate_images;
+    /* loads the thumbnails of the images in the background, if thumbs are deferred */
+    BBBMLoader *loader;
+    /* the running import, if any, and what it has found that could not be added yet */
+    BBBMImport *import;
+    GtkWidget *import_dialog;
+    GList *import_broken;
+    GList *import_failed;
+    /* images the loader could not use, offered for relocation once it has handled all requests */
+    GList *loaded_broken;
+    guint loaded_broken_id;
+    /* file operations that must not block the main loop: reading the collection that is being opened, checking
+       images that are added on request, reading the metadata of the hovered image, extracting archive members
+       for the background that is being set and for commands, and refreshing metadata before it is used */
+    BBBMAsync *opening;
+    GList *adding;
+    BBBMAsync *hovering;
+    BBBMAsync *extracting_background;
+    GList *extracting;
+    BBBMAsync *refreshing;
+    /* searches for images that have been moved, see bbbm_repair_entries */
+    GList *relocating;
 } BBBM;
 
 /* Creates a new BBBM object with the given options, configuration file and optional initial collection file.
@@ -46,4 +91,8 @@ BBBM *bbbm_new(BBBMOptions *options, const gchar *config_file, const gchar *coll
 
 void bbbm_destroy(BBBM *bbbm);
 
+/* Handles a command from the command line or another instance; see remote.h for the supported commands.
+   Its signature matches bbbm_remote_function */
+void bbbm_handle_command(BBBM *bbbm, const gchar *command, const gchar *argument);
+
 #endif /* __BBBM_H_ */
@@ -0,0 +1,144 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <glib.h>
+#include "config.h"
+#include "blend.h"
+
+/* the vector implementations need GCC's target attribute and CPU detection, which are x86 specific */
+#if HAVE_IMMINTRIN_H == 1 && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) \
+    && (defined(__x86_64__) || defined(__i386__))
+#define BBBM_BLEND_X86  1
+#include <immintrin.h>
+#else
+#define BBBM_BLEND_X86  0
+#endif
+
+typedef void (* bbbm_blend_function) (guchar *dest, const guchar *from, const guchar *to, gsize length, guint weight);
+
+static void bbbm_blend_scalar(guchar *dest, const guchar *from, const guchar *to, gsize length, guint weight);
+#if BBBM_BLEND_X86
+static void bbbm_blend_sse2(guchar *dest, const guchar *from, const guchar *to, gsize length, guint weight);
+static void bbbm_blend_avx2(guchar *dest, const guchar *from, const guchar *to, gsize length, guint weight);
+#endif
+static bbbm_blend_function bbbm_blend_select(const gchar **name);
+
+void bbbm_blend(guchar *dest, const guchar *from, const guchar *to, gsize length, guint weight) {
+    static bbbm_blend_function function = NULL;
+
+    g_return_if_fail(weight <= BBBM_BLEND_MAX);
+
+    /* only the main thread blends, so no locking is needed */
+    if (function == NULL) {
+        function = bbbm_blend_select(NULL);
+    }
+    function(dest, from, to, length, weight);
+}
+
+const gchar *bbbm_blend_get_implementation() {
+    const gchar *name;
+
+    bbbm_blend_select(&name);
+    return name;
+}
+
+static bbbm_blend_function bbbm_blend_select(const gchar **name) {
+#if BBBM_BLEND_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        if (name != NULL) {
+            *name = "avx2";
+        }
+        return bbbm_blend_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        if (name != NULL) {
+            *name = "sse2";
+        }
+        return bbbm_blend_sse2;
+    }
+#endif
+    if (name != NULL) {
+        *name = "scalar";
+    }
+    return bbbm_blend_scalar;
+}
+
+static void bbbm_blend_scalar(guchar *dest, const guchar *from, const guchar *to, gsize length, guint weight) {
+    guint inverse = BBBM_BLEND_MAX - weight;
+    gsize i;
+
+    for (i = 0; i < length; ++i) {
+        dest[i] = (guchar) ((from[i] * inverse + to[i] * weight) >> 8);
+    }
+}
+
+#if BBBM_BLEND_X86
+
+/* both vector versions widen the bytes to 16 bits; 255 * 256 still fits */
+
+__attribute__((target("sse2")))
+static void bbbm_blend_sse2(guchar *dest, const guchar *from, const guchar *to, gsize length, guint weight) {
+    __m128i zero, w, inverse;
+    gsize i;
+
+    zero    = _mm_setzero_si128();
+    w       = _mm_set1_epi16((gshort) weight);
+    inverse = _mm_set1_epi16((gshort) (BBBM_BLEND_MAX - weight));
+    for (i = 0; i + 16 <= length; i += 16) {
+        __m128i a, b, low, high;
+
+        a = _mm_loadu_si128((const __m128i *) (from + i));
+        b = _mm_loadu_si128((const __m128i *) (to + i));
+        low  = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), inverse),
+                             _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w));
+        high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), inverse),
+                             _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w));
+        _mm_storeu_si128((__m128i *) (dest + i),
+                         _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8)));
+    }
+    bbbm_blend_scalar(dest + i, from + i, to + i, length - i, weight);
+}
+
+__attribute__((target("avx2")))
+static void bbbm_blend_avx2(guchar *dest, const guchar *from, const guchar *to, gsize length, guint weight) {
+    __m256i zero, w, inverse;
+    gsize i;
+
+    zero    = _mm256_setzero_si256();
+    w       = _mm256_set1_epi16((gshort) weight);
+    inverse = _mm256_set1_epi16((gshort) (BBBM_BLEND_MAX - weight));
+    for (i = 0; i + 32 <= length; i += 32) {
+        __m256i a, b, low, high;
+
+        /* unpacking and packing both work per 128-bit lane, so the byte order is preserved */
+        a = _mm256_loadu_si256((const __m256i *) (from + i));
+        b = _mm256_loadu_si256((const __m256i *) (to + i));
+        low  = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), inverse),
+                                _mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), w));
+        high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), inverse),
+                                _mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), w));
+        _mm256_storeu_si256((__m256i *) (dest + i),
+                            _mm256_packus_epi16(_mm256_srli_epi16(low, 8), _mm256_srli_epi16(high, 8)));
+    }
+    bbbm_blend_scalar(dest + i, from + i, to + i, length - i, weight);
+}
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_BLEND_H_
+#define __BBBM_BLEND_H_
+
+#include <glib.h>
+
+/* The weight of the second buffer is given in 1/BBBM_BLEND_MAX units */
+#define BBBM_BLEND_MAX  256
+
+/* Blends length bytes of from and to into dest: dest = (from * (BBBM_BLEND_MAX - weight) + to * weight) / BBBM_BLEND_MAX.
+   Uses AVX2 or SSE2 if the processor supports it; all implementations give the same result */
+void bbbm_blend(guchar *dest, const guchar *from, const guchar *to, gsize length, guint weight);
+
+/* Returns the name of the implementation bbbm_blend uses, for diagnostics */
+const gchar *bbbm_blend_get_implementation();
+
+#endif /* __BBBM_BLEND_H_ */
@@ -0,0 +1,394 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <glib.h>
+#include "config.h"
+#include "collection.h"
+#include "options.h"
+#include "util.h"
+#include "template.h"
+#include "validate.h"
+#include "archive.h"
+#include "compat.h"
+
+/* the initial size of the buffer menus are built in */
+#define BBBM_COLLECTION_MENU_BUFFER_SIZE  65536
+
+/* the state shared while building a menu */
+typedef struct {
+    GString *menu;
+    BBBMOptions *options;
+    BBBMTemplate *template;
+    /* reused for every expanded command */
+    GString *command;
+} BBBMCollectionMenu;
+
+static void bbbm_collection_append_groups(BBBMCollectionMenu *menu, GList *entries);
+static GList *bbbm_collection_append_entries(BBBMCollectionMenu *menu, GList *entries, guint count, guint depth);
+static gchar *bbbm_collection_get_letter(const gchar *description);
+static gboolean bbbm_collection_write_if_changed(const gchar *filename, GString *content);
+static inline void bbbm_collection_append_string(GString *menu, const gchar *string);
+static gboolean bbbm_collection_remove_broken(const gchar *filename, GList **entries);
+static GList *bbbm_collection_without_members(GList *entries);
+
+BBBMCollectionEntry *bbbm_collection_entry_new(const gchar *filename, const gchar *description) {
+    BBBMCollectionEntry *entry;
+
+    entry = g_malloc(sizeof(BBBMCollectionEntry));
+    entry->filename    = g_strdup(filename);
+    entry->description = g_strdup(bbbm_str_empty(description) ? filename : description);
+    entry->status      = BBBM_VALIDATE_OK;
+
+    return entry;
+}
+
+void bbbm_collection_entry_destroy(BBBMCollectionEntry *entry) {
+    g_return_if_fail(entry != NULL);
+    g_free(entry->filename);
+    g_free(entry->description);
+    g_free(entry);
+}
+
+void bbbm_collection_free(GList *entries) {
+    g_list_foreach(entries, (GFunc) bbbm_collection_entry_destroy, NULL);
+    g_list_free(entries);
+}
+
+gboolean bbbm_collection_read(const gchar *filename, GList **entries) {
+    GList *read = NULL;
+    gboolean result;
+
+    g_return_val_if_fail(entries != NULL, FALSE);
+
+    result = bbbm_collection_read_all(filename, FALSE, TRUE, &read);
+    result = bbbm_collection_remove_broken(filename, &read) && result;
+    *entries = g_list_concat(*entries, read);
+    return result;
+}
+
+gboolean bbbm_collection_read_image_list(const gchar *filename, GList **entries) {
+    GList *read = NULL;
+    gboolean result;
+
+    g_return_val_if_fail(entries != NULL, FALSE);
+
+    result = bbbm_collection_read_all(filename, TRUE, TRUE, &read);
+    result = bbbm_collection_remove_broken(filename, &read) && result;
+    *entries = g_list_concat(*entries, read);
+    return result;
+}
+
+gboolean bbbm_collection_read_all(const gchar *filename, gboolean image_list, gboolean validate, GList **entries) {
+    gchar file_line[PATH_MAX], description_line[PATH_MAX];
+    GList *read = NULL;
+    FILE *file;
+
+    g_return_val_if_fail(entries != NULL, FALSE);
+
+    file = fopen(filename, "r");
+    if (file == NULL) {
+        g_warning("could not read from '%s': %s", filename, g_strerror(errno));
+        return FALSE;
+    }
+    while (fgets(file_line, PATH_MAX, file) != NULL) {
+        g_strstrip(file_line);
+        if (image_list) {
+            strcpy(description_line, file_line);
+        } else if (fgets(description_line, PATH_MAX, file) != NULL) {
+            g_strstrip(description_line);
+        } else {
+            strcpy(description_line, file_line);
+        }
+        read = g_list_prepend(read, bbbm_collection_entry_new(file_line, description_line));
+    }
+    fclose(file);
+    /* prepending and reversing is a lot cheaper than appending for large collections */
+    read = g_list_reverse(read);
+    if (validate) {
+        bbbm_collection_validate(read);
+    }
+    *entries = g_list_concat(*entries, read);
+    return TRUE;
+}
+
+void bbbm_collection_validate(GList *entries) {
+    GList *iterator;
+    const gchar **filenames;
+    BBBMValidateStatus *statuses;
+    guint count, i;
+
+    /* all files are checked at once, so they can be checked in parallel */
+    count = g_list_length(entries);
+    filenames = g_new(const gchar *, count);
+    statuses = g_new(BBBMValidateStatus, count);
+    for (iterator = entries, i = 0; iterator != NULL; iterator = iterator->next, ++i) {
+        filenames[i] = ((BBBMCollectionEntry *) iterator->data)->filename;
+    }
+    bbbm_validate_files(filenames, count, statuses);
+    for (iterator = entries, i = 0; iterator != NULL; iterator = iterator->next, ++i) {
+        ((BBBMCollectionEntry *) iterator->data)->status = statuses[i];
+    }
+    g_free(filenames);
+    g_free(statuses);
+}
+
+gboolean bbbm_collection_write_list(GList *entries, const gchar *filename) {
+    GList *iterator;
+    FILE *file;
+
+    file = fopen(filename, "w");
+    if (file == NULL) {
+        return FALSE;
+    }
+    entries = bbbm_collection_without_members(entries);
+    for (iterator = entries; iterator != NULL; iterator = iterator->next) {
+        fprintf(file, "%s\n", ((BBBMCollectionEntry *) iterator->data)->filename);
+    }
+    g_list_free(entries);
+    fclose(file);
+    return TRUE;
+}
+
+gboolean bbbm_collection_write_menu(GList *entries, BBBMOptions *options, const gchar *collection_file,
+                                    const gchar *filename) {
+    gboolean filename_as_label, filename_as_title, result;
+    BBBMCollectionMenu data;
+    GString *menu;
+
+    filename_as_label = bbbm_options_get_filename_as_label(options);
+    filename_as_title = bbbm_options_get_filename_as_title(options);
+
+    /* the menu is built in memory first, so it can be compared to the current file */
+    menu = g_string_sized_new(BBBM_COLLECTION_MENU_BUFFER_SIZE);
+    g_string_append(menu, "[submenu] (");
+    if (collection_file != NULL && (filename_as_label || filename_as_title)) {
+        gchar *name;
+
+        name = g_path_get_basename(collection_file);
+        if (filename_as_label) {
+            bbbm_collection_append_string(menu, name);
+            g_string_append(menu, ")");
+        } else {
+            g_string_append(menu, "Backgrounds)");
+        }
+        if (filename_as_title) {
+            g_string_append(menu, " {");
+            bbbm_collection_append_string(menu, name);
+            g_string_append(menu, "}\n");
+        } else {
+            g_string_append(menu, "\n");
+        }
+        g_free(name);
+    } else {
+        g_string_append(menu, "Backgrounds)\n");
+    }
+
+    /* the set command is parsed only once, and expanded into the same buffer for each entry */
+    data.menu     = menu;
+    data.options  = options;
+    data.template = bbbm_template_new(bbbm_options_get_set_command(options));
+    data.command  = g_string_sized_new(PATH_MAX);
+    entries = bbbm_collection_without_members(entries);
+    if (bbbm_options_get_menu_split(options) == BBBM_MENU_SPLIT_NONE) {
+        bbbm_collection_append_entries(&data, entries, g_list_length(entries), 1);
+    } else {
+        bbbm_collection_append_groups(&data, entries);
+    }
+    g_list_free(entries);
+    bbbm_template_destroy(data.template);
+    g_string_free(data.command, TRUE);
+
+    result = bbbm_collection_write_if_changed(filename, menu);
+    g_string_free(menu, TRUE);
+    return result;
+}
+
+static void bbbm_collection_append_groups(BBBMCollectionMenu *menu, GList *entries) {
+    GHashTable *groups;
+    GList *keys = NULL, *iterator;
+    BBBMMenuSplit split;
+
+    /* key -> entries of the group, in reverse order */
+    groups = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    split = bbbm_options_get_menu_split(menu->options);
+    for (iterator = entries; iterator != NULL; iterator = iterator->next) {
+        BBBMCollectionEntry *entry = (BBBMCollectionEntry *) iterator->data;
+        GList *group;
+        gchar *key;
+
+        key = split == BBBM_MENU_SPLIT_DIRECTORY ? g_path_get_dirname(entry->filename)
+                                                 : bbbm_collection_get_letter(entry->description);
+        group = (GList *) g_hash_table_lookup(groups, key);
+        if (group == NULL) {
+            keys = g_list_prepend(keys, key);
+        }
+        /* for an existing group, g_hash_table_insert frees the new copy of the key */
+        g_hash_table_insert(groups, g_strdup(key), g_list_prepend(group, entry));
+        if (group != NULL) {
+            g_free(key);
+        }
+    }
+    /* directories keep the collection order, letters are sorted */
+    keys = split == BBBM_MENU_SPLIT_DIRECTORY ? g_list_reverse(keys)
+                                              : g_list_sort(keys, (GCompareFunc) g_utf8_collate);
+
+    if (g_list_length(keys) == 1) {
+        /* a single submenu would only add a level */
+        bbbm_collection_append_entries(menu, entries, g_list_length(entries), 1);
+    } else {
+        for (iterator = keys; iterator != NULL; iterator = iterator->next) {
+            GList *group;
+
+            group = g_list_reverse((GList *) g_hash_table_lookup(groups, iterator->data));
+            g_string_append(menu->menu, "  [submenu] (");
+            bbbm_collection_append_string(menu->menu, (const gchar *) iterator->data);
+            g_string_append(menu->menu, ")\n");
+            bbbm_collection_append_entries(menu, group, g_list_length(group), 2);
+            g_string_append(menu->menu, "  [end]\n");
+            g_list_free(group);
+        }
+    }
+    g_list_foreach(keys, (GFunc) g_free, NULL);
+    g_list_free(keys);
+    g_hash_table_destroy(groups);
+}
+
+static GList *bbbm_collection_append_entries(BBBMCollectionMenu *menu, GList *entries, guint count, guint depth) {
+    guint page_size, i;
+
+    page_size = bbbm_options_get_menu_page_size(menu->options);
+    if (page_size != 0 && count > page_size) {
+        /* split into pages of page_size entries each */
+        for (i = 0; i < count; i += page_size) {
+            guint page_count = MIN(page_size, count - i);
+
+            g_string_append_printf(menu->menu, "%*s[submenu] (%d-%d)\n", depth * 2, "", i + 1, i + page_count);
+            entries = bbbm_collection_append_entries(menu, entries, page_count, depth + 1);
+            g_string_append_printf(menu->menu, "%*s[end]\n", depth * 2, "");
+        }
+        return entries;
+    }
+    for (i = 0; i < count && entries != NULL; ++i, entries = entries->next) {
+        BBBMCollectionEntry *entry;
+
+        entry = (BBBMCollectionEntry *) entries->data;
+        bbbm_template_expand(menu->template, entry->filename, menu->command);
+        g_string_append_printf(menu->menu, "%*s[exec] (", depth * 2, "");
+        bbbm_collection_append_string(menu->menu, entry->description);
+        g_string_append(menu->menu, ") {");
+        bbbm_collection_append_string(menu->menu, menu->command->str);
+        g_string_append(menu->menu, "}\n");
+    }
+    return entries;
+}
+
+static gchar *bbbm_collection_get_letter(const gchar *description) {
+    gchar *name, *letter;
+    gunichar c;
+
+    /* descriptions default to the full path; use the name of the file then */
+    name = g_path_get_basename(description);
+    c = g_utf8_get_char_validated(name, -1);
+    g_free(name);
+    if (c == (gunichar) -1 || c == (gunichar) -2 || !g_unichar_isalpha(c)) {
+        return g_strdup("#");
+    }
+    letter = g_malloc0(7);
+    g_unichar_to_utf8(g_unichar_toupper(c), letter);
+    return letter;
+}
+
+static gboolean bbbm_collection_write_if_changed(const gchar *filename, GString *content) {
+    gchar *current;
+    gsize length;
+    FILE *file;
+    gboolean result;
+
+    /* an unchanged menu file should not make the window manager reload it */
+    if (g_file_get_contents(filename, &current, &length, NULL)) {
+        gboolean unchanged = length == content->len && memcmp(current, content->str, length) == 0;
+
+        g_free(current);
+        if (unchanged) {
+            g_debug("'%s' has not changed", filename);
+            return TRUE;
+        }
+    }
+    file = fopen(filename, "w");
+    if (file == NULL) {
+        return FALSE;
+    }
+    result = fwrite(content->str, 1, content->len, file) == content->len;
+    return fclose(file) == 0 && result;
+}
+
+static inline void bbbm_collection_append_string(GString *menu, const gchar *string) {
+    while (*string != '\0') {
+        /* copy everything up to the next character that needs escaping in one go */
+        gsize length = strcspn(string, "\\(){}");
+
+        g_string_append_len(menu, string, length);
+        string += length;
+        if (*string != '\0') {
+            g_string_append_c(menu, '\\');
+            g_string_append_c(menu, *string++);
+        }
+    }
+}
+
+static gboolean bbbm_collection_remove_broken(const gchar *filename, GList **entries) {
+    GList *iterator, *next;
+    gboolean result = TRUE;
+
+    for (iterator = *entries; iterator != NULL; iterator = next) {
+        BBBMCollectionEntry *entry = (BBBMCollectionEntry *) iterator->data;
+
+        next = iterator->next;
+        if (entry->status != BBBM_VALIDATE_OK) {
+            g_warning("skipping '%s' in '%s': %s", entry->filename, filename,
+                      bbbm_validate_status_to_string(entry->status));
+            bbbm_collection_entry_destroy(entry);
+            *entries = g_list_delete_link(*entries, iterator);
+            result = FALSE;
+        }
+    }
+    return result;
+}
+
+static GList *bbbm_collection_without_members(GList *entries) {
+    GList *iterator, *result = NULL;
+
+    /* the entries themselves are shared with the given list */
+    for (iterator = g_list_last(entries); iterator != NULL; iterator = iterator->prev) {
+        BBBMCollectionEntry *entry = (BBBMCollectionEntry *) iterator->data;
+
+        /* an extracted copy would not last; only the most recently extracted members are kept */
+        if (bbbm_archive_is_member(entry->filename)) {
+            g_warning("skipping '%s': it is a member of an archive", entry->filename);
+        } else {
+            result = g_list_prepend(result, entry);
+        }
+    }
+    return result;
+}
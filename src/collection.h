@@ -0,0 +1,77 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_COLLECTION_H_
+#define __BBBM_COLLECTION_H_
+
+#include <glib.h>
+#include "options.h"
+#include "validate.h"
+
+/* A single collection entry. Unlike BBBMImage this does not require GTK+, nor does it decode the image */
+typedef struct _BBBMCollectionEntry BBBMCollectionEntry;
+
+struct _BBBMCollectionEntry {
+    gchar *filename;
+    gchar *description;
+    /* whether the file could be used when it was read */
+    BBBMValidateStatus status;
+};
+
+/* Creates a new BBBMCollectionEntry object with the given filename and description.
+   If the description is empty the filename is used instead.
+   The returned object must be freed with bbbm_collection_entry_destroy when no longer needed */
+BBBMCollectionEntry *bbbm_collection_entry_new(const gchar *filename, const gchar *description);
+
+void bbbm_collection_entry_destroy(BBBMCollectionEntry *entry);
+
+/* Frees the given list and all of its elements (entries) */
+void bbbm_collection_free(GList *entries);
+
+/* Reads all entries from the given collection file, and appends them to the given list.
+   Entries that are not valid images are skipped.
+   Returns FALSE if the file could not be read or any entry has been skipped, or TRUE otherwise */
+gboolean bbbm_collection_read(const gchar *filename, GList **entries);
+
+/* Like bbbm_collection_read, but for image lists; each line only contains a filename */
+gboolean bbbm_collection_read_image_list(const gchar *filename, GList **entries);
+
+/* Reads all entries from the given collection file or image list, and appends them to the given list.
+   If validate is TRUE all files are checked at once, and entries that cannot be used are kept with their status
+   set; otherwise no file is touched, and all statuses are BBBM_VALIDATE_OK.
+   Returns FALSE if the file could not be read, or TRUE otherwise */
+gboolean bbbm_collection_read_all(const gchar *filename, gboolean image_list, gboolean validate, GList **entries);
+
+/* Checks the files of all given entries at once, and sets their statuses */
+void bbbm_collection_validate(GList *entries);
+
+/* Writes the filenames of the given entries to the given file.
+   Archive members are skipped with a warning, as other programs cannot read them */
+gboolean bbbm_collection_write_list(GList *entries, const gchar *filename);
+
+/* Writes a Blackbox background submenu for the given entries to the given file.
+   The collection file is optional, and is used for the label and title if the options say so.
+   The options also determine if the entries are split into nested submenus.
+   Archive members are skipped with a warning, as the set command cannot read them.
+   The file is left untouched if its content would not change */
+gboolean bbbm_collection_write_menu(GList *entries, BBBMOptions *options, const gchar *collection_file,
+                                    const gchar *filename);
+
+#endif /* __BBBM_COLLECTION_H_ */
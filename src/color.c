@@ -0,0 +1,194 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "config.h"
+#include "color.h"
+#include "compat.h"
+
+/* the number of separate histograms counted into; consecutive pixels often fall in the same cell, and counting
+   them into different copies keeps each increment from waiting for the previous one */
+#define BBBM_COLOR_LANES  4
+/* the saturation, out of 255, below which a cell counts as gray */
+#define BBBM_COLOR_GRAY   32
+
+static inline guint bbbm_color_get_cell(const guchar *pixel);
+static gint bbbm_color_get_hue(guint cell, guint *saturation);
+
+void bbbm_color_extract(const guchar *pixels, gint width, gint height, gint rowstride, gint channels,
+                        BBBMColors *colors) {
+    guint32 counts[BBBM_COLOR_LANES][BBBM_COLOR_HISTOGRAM_SIZE];
+    guint64 sums[BBBM_COLOR_LANES][3];
+    guint64 total;
+    gint x, y, lane, i;
+
+    g_return_if_fail(pixels != NULL);
+    g_return_if_fail(colors != NULL);
+    g_return_if_fail(channels >= 3);
+
+    memset(counts, 0, sizeof(counts));
+    memset(sums, 0, sizeof(sums));
+    for (y = 0; y < height; ++y) {
+        const guchar *row = pixels + y * rowstride;
+
+        /* four pixels at a time, one per lane */
+        for (x = 0; x + BBBM_COLOR_LANES <= width; x += BBBM_COLOR_LANES) {
+            for (lane = 0; lane < BBBM_COLOR_LANES; ++lane) {
+                const guchar *pixel = row + (x + lane) * channels;
+
+                counts[lane][bbbm_color_get_cell(pixel)]++;
+                sums[lane][0] += pixel[0];
+                sums[lane][1] += pixel[1];
+                sums[lane][2] += pixel[2];
+            }
+        }
+        for (; x < width; ++x) {
+            const guchar *pixel = row + x * channels;
+
+            counts[0][bbbm_color_get_cell(pixel)]++;
+            sums[0][0] += pixel[0];
+            sums[0][1] += pixel[1];
+            sums[0][2] += pixel[2];
+        }
+    }
+
+    total = (guint64) MAX(width, 0) * MAX(height, 0);
+    for (i = 0; i < 3; ++i) {
+        guint64 sum = 0;
+
+        for (lane = 0; lane < BBBM_COLOR_LANES; ++lane) {
+            sum += sums[lane][i];
+        }
+        colors->average[i] = total == 0 ? 0 : (guint8) (sum / total);
+    }
+    for (i = 0; i < BBBM_COLOR_HISTOGRAM_SIZE; ++i) {
+        guint64 count = 0;
+
+        for (lane = 0; lane < BBBM_COLOR_LANES; ++lane) {
+            count += counts[lane][i];
+        }
+        colors->histogram[i] = total == 0 ? 0 : (guint8) ((count * 255 + total / 2) / total);
+    }
+}
+
+guint bbbm_color_distance(const BBBMColors *colors1, const BBBMColors *colors2) {
+    guint distance = 0, i;
+
+    g_return_val_if_fail(colors1 != NULL && colors2 != NULL, G_MAXUINT);
+
+    /* the histograms tell how colors are spread, the averages separate images that fall in the same cells */
+    for (i = 0; i < BBBM_COLOR_HISTOGRAM_SIZE; ++i) {
+        distance += abs(colors1->histogram[i] - colors2->histogram[i]);
+    }
+    for (i = 0; i < 3; ++i) {
+        distance += abs(colors1->average[i] - colors2->average[i]);
+    }
+    return distance;
+}
+
+guint bbbm_color_nearest(const BBBMColors *target, const BBBMColors **candidates, guint count, guint k,
+                         guint *result) {
+    guint *distances;
+    guint found = 0, i, j;
+
+    g_return_val_if_fail(target != NULL, 0);
+    g_return_val_if_fail(candidates != NULL || count == 0, 0);
+
+    if (k == 0) {
+        return 0;
+    }
+    /* k is small; keeping the best k sorted by insertion beats sorting all candidates */
+    distances = g_new(guint, k);
+    for (i = 0; i < count; ++i) {
+        guint distance;
+
+        if (candidates[i] == NULL) {
+            continue;
+        }
+        distance = bbbm_color_distance(target, candidates[i]);
+        if (found == k && distance >= distances[k - 1]) {
+            continue;
+        }
+        j = found < k ? found++ : k - 1;
+        for (; j > 0 && distances[j - 1] > distance; --j) {
+            distances[j] = distances[j - 1];
+            result[j] = result[j - 1];
+        }
+        distances[j] = distance;
+        result[j] = i;
+    }
+    g_free(distances);
+    return found;
+}
+
+guint bbbm_color_get_brightness(const BBBMColors *colors) {
+    g_return_val_if_fail(colors != NULL, 0);
+    return (colors->average[0] * 299 + colors->average[1] * 587 + colors->average[2] * 114) / 1000;
+}
+
+gint bbbm_color_compare_dominant(const BBBMColors *colors1, const BBBMColors *colors2) {
+    guint dominant1 = 0, dominant2 = 0, saturation1, saturation2, i;
+    gint hue1, hue2;
+
+    g_return_val_if_fail(colors1 != NULL && colors2 != NULL, 0);
+
+    for (i = 1; i < BBBM_COLOR_HISTOGRAM_SIZE; ++i) {
+        if (colors1->histogram[i] > colors1->histogram[dominant1]) {
+            dominant1 = i;
+        }
+        if (colors2->histogram[i] > colors2->histogram[dominant2]) {
+            dominant2 = i;
+        }
+    }
+    hue1 = bbbm_color_get_hue(dominant1, &saturation1);
+    hue2 = bbbm_color_get_hue(dominant2, &saturation2);
+    if ((saturation1 < BBBM_COLOR_GRAY) != (saturation2 < BBBM_COLOR_GRAY)) {
+        return saturation1 < BBBM_COLOR_GRAY ? 1 : -1;
+    }
+    if (saturation1 >= BBBM_COLOR_GRAY && hue1 != hue2) {
+        return hue1 - hue2;
+    }
+    /* the same hue, or both gray */
+    return (gint) bbbm_color_get_brightness(colors1) - (gint) bbbm_color_get_brightness(colors2);
+}
+
+static inline guint bbbm_color_get_cell(const guchar *pixel) {
+    return ((pixel[0] >> 6) << 4) | ((pixel[1] >> 6) << 2) | (pixel[2] >> 6);
+}
+
+static gint bbbm_color_get_hue(guint cell, guint *saturation) {
+    /* the center of the cell */
+    gint r = ((cell >> 4) & 3) * 64 + 32, g = ((cell >> 2) & 3) * 64 + 32, b = (cell & 3) * 64 + 32;
+    gint max = MAX(MAX(r, g), b), min = MIN(MIN(r, g), b), delta = max - min;
+
+    *saturation = delta * 255 / max;
+    if (delta == 0) {
+        return 0;
+    }
+    if (max == r) {
+        return (60 * (g - b) / delta + 360) % 360;
+    }
+    if (max == g) {
+        return 60 * (b - r) / delta + 120;
+    }
+    return 60 * (r - g) / delta + 240;
+}
@@ -0,0 +1,56 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_COLOR_H_
+#define __BBBM_COLOR_H_
+
+#include <glib.h>
+
+/* the number of cells of the color histogram; the top two bits of each of red, green and blue */
+#define BBBM_COLOR_HISTOGRAM_SIZE  64
+
+/* A compact description of the colors of an image, small enough to keep for every image of a collection */
+typedef struct {
+    guint8 average[3];
+    /* the share of the pixels in each cell, out of 255 */
+    guint8 histogram[BBBM_COLOR_HISTOGRAM_SIZE];
+} BBBMColors;
+
+/* Computes the colors of the given RGB or RGBA pixels, such as those of a thumbnail */
+void bbbm_color_extract(const guchar *pixels, gint width, gint height, gint rowstride, gint channels,
+                        BBBMColors *colors);
+
+/* Returns how different two images are in color; 0 means they are equal */
+guint bbbm_color_distance(const BBBMColors *colors1, const BBBMColors *colors2);
+
+/* Finds the (at most) k entries of candidates that are closest in color to target; NULL entries are skipped.
+   Their indexes are stored in result, which must have room for k elements, closest first.
+   Returns the number of indexes stored */
+guint bbbm_color_nearest(const BBBMColors *target, const BBBMColors **candidates, guint count, guint k,
+                         guint *result);
+
+/* Returns the perceived brightness of the average color, from 0 to 255 */
+guint bbbm_color_get_brightness(const BBBMColors *colors);
+
+/* Orders colors by the hue of their dominant cell, from red through green and blue back to red.
+   Gray images come last, from dark to light */
+gint bbbm_color_compare_dominant(const BBBMColors *colors1, const BBBMColors *colors2);
+
+#endif /* __BBBM_COLOR_H_ */
@@ -61,6 +61,7 @@ static void bbbm_command_item_class_init(BBBMCommandItemClass *klass) {
 
 static void bbbm_command_item_init(BBBMCommandItem *item) {
     item->command = NULL;
+    item->filename = NULL;
 }
 
 static void bbbm_command_item_destroy(GtkObject *object) {
@@ -70,6 +71,8 @@ static void bbbm_command_item_destroy(GtkObject *object) {
 
     g_free(item->command);
     item->command = NULL;
+    g_free(item->filename);
+    item->filename = NULL;
 
     (* GTK_OBJECT_CLASS(bbbm_command_item_parent_class)->destroy) (object);
 }
@@ -113,7 +116,8 @@ GtkWidget *bbbm_command_item_new_for_file(const gchar *label, const gchar *comma
     g_return_val_if_fail(filename != NULL, NULL);
 
     item = bbbm_command_item_new_no_command(label);
-    item->command = bbbm_util_get_command(command, filename);
+    item->command = g_strdup(command);
+    item->filename = g_strdup(filename);
 
     return GTK_WIDGET(item);
 }
@@ -122,3 +126,8 @@ const gchar *bbbm_command_item_get_command(BBBMCommandItem *item) {
     g_return_val_if_fail(BBBM_IS_COMMAND_ITEM(item), NULL);
     return item->command;
 }
+
+const gchar *bbbm_command_item_get_filename(BBBMCommandItem *item) {
+    g_return_val_if_fail(BBBM_IS_COMMAND_ITEM(item), NULL);
+    return item->filename;
+}
@@ -37,6 +37,7 @@ typedef struct _BBBMCommandItemClass BBBMCommandItemClass;
 struct _BBBMCommandItem {
     GtkMenuItem parent;
     gchar *command;
+    gchar *filename;
 };
 
 struct _BBBMCommandItemClass {
@@ -49,10 +50,14 @@ GType bbbm_command_item_get_type();
    The returned widget must be destroyed with gtk_widget_destroy when no longer needed */
 GtkWidget *bbbm_command_item_new(const gchar *label, const gchar *command);
 
-/* Creates a new command item with the given label and command for the given filename.
+/* Creates a new command item with the given label and command for the given filename. The command is not expanded,
+   as archive members must be extracted before it can run; see bbbm_util_get_command.
    The returned widget must be destroyed with gtk_widget_destroy when no longer needed */
 GtkWidget *bbbm_command_item_new_for_file(const gchar *label, const gchar *command, const gchar *filename);
 
 const gchar *bbbm_command_item_get_command(BBBMCommandItem *item);
 
+/* Returns the filename the item was created for, or NULL if it was created without one */
+const gchar *bbbm_command_item_get_filename(BBBMCommandItem *item);
+
 #endif /* __BBBM_COMMAND_ITEM_H_ */
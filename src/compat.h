@@ -47,6 +47,20 @@
 #define HAVE_G_MARKUP_ERROR_MISSING_ATTRIBUTE          1
 #endif
 
+/* g_compute_checksum_for_string is available since glib 2.16 */
+#if GLIB_MAJOR_VERSION == 2 && GLIB_MINOR_VERSION < 16
+#define HAVE_G_COMPUTE_CHECKSUM  0
+#else
+#define HAVE_G_COMPUTE_CHECKSUM  1
+#endif
+
+/* g_thread_pool_set_sort_function is available since glib 2.10 */
+#if GLIB_MAJOR_VERSION == 2 && GLIB_MINOR_VERSION < 10
+#define HAVE_G_THREAD_POOL_SET_SORT_FUNCTION  0
+#else
+#define HAVE_G_THREAD_POOL_SET_SORT_FUNCTION  1
+#endif
+
 /* G_MARKUP_TREAT_CDATA_AS_TEXT is available since glib 2.12 */
 #if GLIB_MAJOR_VERSION == 2 && GLIB_MINOR_VERSION < 12
 #define HAVE_G_MARKUP_TREAT_CDATA_AS_TEXT  0
@@ -68,4 +82,34 @@
 #define HAVE_GTK_MENU_ITEM_LABEL  1
 #endif
 
+/* the monitors-changed signal of GdkScreen is available since gtk+ 2.14 */
+#if GTK_MAJOR_VERSION == 2 && GTK_MINOR_VERSION < 14
+#define HAVE_GDK_SCREEN_MONITORS_CHANGED  0
+#else
+#define HAVE_GDK_SCREEN_MONITORS_CHANGED  1
+#endif
+
+/* gdk_pixbuf_new_from_file_at_scale is available since gdk-pixbuf 2.6 */
+#if GDK_PIXBUF_MAJOR == 2 && GDK_PIXBUF_MINOR < 6
+#define HAVE_GDK_PIXBUF_NEW_FROM_FILE_AT_SCALE  0
+#else
+#define HAVE_GDK_PIXBUF_NEW_FROM_FILE_AT_SCALE  1
+#endif
+
+/* g_thread_new and g_thread_try_new are available since glib 2.32, which also initializes the thread system
+   automatically; older versions need g_thread_create and g_thread_init */
+#if GLIB_MAJOR_VERSION == 2 && GLIB_MINOR_VERSION < 32
+#define HAVE_G_THREAD_NEW  0
+#else
+#define HAVE_G_THREAD_NEW  1
+#endif
+
+/* since glib 2.36 the type system is initialized automatically; older versions need g_type_init, which gtk_init
+   calls, but processes without GTK+ must call themselves */
+#if GLIB_MAJOR_VERSION == 2 && GLIB_MINOR_VERSION < 36
+#define HAVE_G_TYPE_INIT_IMPLICIT  0
+#else
+#define HAVE_G_TYPE_INIT_IMPLICIT  1
+#endif
+
 #endif /* __BBBM_COMPAT_H_ */
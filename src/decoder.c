@@ -0,0 +1,593 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "config.h"
+#include "decoder.h"
+#include "archive.h"
+#include "metadata.h"
+#include "util.h"
+#include "compat.h"
+
+/* the size of the shared memory a helper puts its pixels in; enough for a 1024x1024 thumbnail with alpha.
+   Larger thumbnails are decoded in-process */
+#define BBBM_DECODER_SEGMENT  (4 * 1024 * 1024)
+/* the number of milliseconds a helper may take to start or to decode one image before it is considered hung */
+#define BBBM_DECODER_TIMEOUT  30000
+/* the number of milliseconds a helper that could not be started waits before it is tried again; this doubles with
+   each failure in a row, up to the maximum */
+#define BBBM_DECODER_RETRY      1000
+#define BBBM_DECODER_MAX_RETRY  60000
+/* the maximum length of a reply of a helper, including its newline */
+#define BBBM_DECODER_REPLY    64
+/* the memory a decode is assumed to need if its image's header cannot be read, such as for archive members;
+   that of a 12 megapixel photo */
+#define BBBM_DECODER_UNKNOWN_COST  (48 * 1024 * 1024)
+
+extern char **environ;
+
+typedef struct {
+    /* 0 if the helper is not running; it is then started when it is next used */
+    pid_t pid;
+    /* the parent's end of the socket the helper reads requests from and writes replies to */
+    gint socket;
+    /* where the helper puts the pixels of the last decoded image */
+    guchar *segment;
+    /* the number of times in a row the helper could not be started, and the time since the last one */
+    guint failures;
+    GTimer *failed;
+} BBBMDecoderHelper;
+
+/* idle helpers; a thread that takes one has it to itself until it puts it back */
+static GAsyncQueue *bbbm_decoder_idle = NULL;
+static gchar *bbbm_decoder_program = NULL;
+
+/* the memory budget, and the estimated memory of the running decodes; all protected by the mutex */
+static GMutex *bbbm_decoder_mutex = NULL;
+static GCond *bbbm_decoder_cond = NULL;
+static gsize bbbm_decoder_budget = 0;
+static gsize bbbm_decoder_used = 0;
+static guint bbbm_decoder_running = 0;
+/* the number of decodes that exceed the budget and wait to run alone; others wait for them, so they get a turn */
+static guint bbbm_decoder_oversized = 0;
+
+static GdkPixbuf *bbbm_decoder_decode_helper(const gchar *filename, guint width, guint height);
+static GdkPixbuf *bbbm_decoder_decode_here(const gchar *filename, guint width, guint height);
+static gsize bbbm_decoder_estimate(const gchar *filename, guint width, guint height);
+static void bbbm_decoder_admit(const gchar *filename, gsize cost);
+static void bbbm_decoder_release(gsize cost);
+#if HAVE_SHM_OPEN == 1
+static GdkPixbuf *bbbm_decoder_decode_remote(BBBMDecoderHelper *helper, const gchar *filename, guint width,
+                                             guint height);
+static gboolean bbbm_decoder_start(BBBMDecoderHelper *helper);
+static void bbbm_decoder_stop(BBBMDecoderHelper *helper, gboolean force);
+static gboolean bbbm_decoder_write(gint fd, const gchar *data);
+static gboolean bbbm_decoder_read_line(gint fd, gchar *buffer, gsize size);
+#endif
+
+void bbbm_decoder_init(const gchar *program) {
+#if HAVE_G_THREAD_NEW == 1
+    static GMutex mutex;
+    static GCond cond;
+#endif
+#if HAVE_SHM_OPEN == 1
+    gint i, count;
+#endif
+
+    g_return_if_fail(program != NULL);
+    g_return_if_fail(bbbm_decoder_mutex == NULL);
+
+#if HAVE_G_THREAD_NEW == 1
+    /* static ones need no initialization */
+    bbbm_decoder_mutex = &mutex;
+    bbbm_decoder_cond  = &cond;
+#else
+    bbbm_decoder_mutex = g_mutex_new();
+    bbbm_decoder_cond  = g_cond_new();
+#endif
+
+#if HAVE_SHM_OPEN == 1
+
+    /* argv[0] may be relative, or only a name that is looked up in the path */
+    bbbm_decoder_program = g_file_read_link("/proc/self/exe", NULL);
+    if (bbbm_decoder_program == NULL) {
+        bbbm_decoder_program = strchr(program, '/') != NULL ? bbbm_util_absolute_path(program)
+                                                             : g_find_program_in_path(program);
+    }
+    if (bbbm_decoder_program == NULL) {
+        g_warning("could not find '%s'; images are decoded in-process", program);
+        return;
+    }
+
+    /* like the loader; the helpers themselves are single threaded */
+    count = bbbm_util_get_cpu_threads();
+    bbbm_decoder_idle = g_async_queue_new();
+    for (i = 0; i < count; i++) {
+        BBBMDecoderHelper *helper = g_malloc(sizeof(BBBMDecoderHelper));
+
+        helper->pid     = 0;
+        helper->socket  = -1;
+        helper->segment  = NULL;
+        helper->failures = 0;
+        helper->failed   = g_timer_new();
+        g_async_queue_push(bbbm_decoder_idle, helper);
+    }
+#else
+    g_info("shared memory is not supported; images are decoded in-process");
+#endif
+}
+
+void bbbm_decoder_set_memory_budget(gsize budget) {
+    g_return_if_fail(bbbm_decoder_mutex != NULL);
+
+    g_mutex_lock(bbbm_decoder_mutex);
+    bbbm_decoder_budget = budget;
+    /* waiting decodes may fit now */
+    g_cond_broadcast(bbbm_decoder_cond);
+    g_mutex_unlock(bbbm_decoder_mutex);
+}
+
+GdkPixbuf *bbbm_decoder_decode(const gchar *filename, guint width, guint height) {
+    GdkPixbuf *pixbuf;
+    gsize cost;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+
+    if (bbbm_decoder_mutex == NULL) {
+        return bbbm_decoder_decode_here(filename, width, height);
+    }
+    cost = bbbm_decoder_estimate(filename, width, height);
+    bbbm_decoder_admit(filename, cost);
+    pixbuf = bbbm_decoder_decode_helper(filename, width, height);
+    bbbm_decoder_release(cost);
+    return pixbuf;
+}
+
+static GdkPixbuf *bbbm_decoder_decode_helper(const gchar *filename, guint width, guint height) {
+#if HAVE_SHM_OPEN == 1
+    if (bbbm_decoder_idle != NULL && (gsize) width * height * 4 <= BBBM_DECODER_SEGMENT) {
+        BBBMDecoderHelper *helper;
+        GdkPixbuf *pixbuf = NULL;
+        gboolean started = FALSE;
+
+        helper = (BBBMDecoderHelper *) g_async_queue_pop(bbbm_decoder_idle);
+        if (helper->pid != 0) {
+            started = TRUE;
+        } else if (helper->failures == 0 || g_timer_elapsed(helper->failed, NULL) * 1000
+                   >= MIN(BBBM_DECODER_RETRY << MIN(helper->failures - 1, 6), BBBM_DECODER_MAX_RETRY)) {
+            /* a failure such as running out of file descriptors need not last, so the helper is tried again */
+            started = bbbm_decoder_start(helper);
+            if (started) {
+                helper->failures = 0;
+            } else {
+                if (helper->failures++ == 0) {
+                    g_warning("could not start a decoder; its images are decoded in-process until it can be");
+                }
+                g_timer_start(helper->failed);
+            }
+        }
+        if (started) {
+            pixbuf = bbbm_decoder_decode_remote(helper, filename, width, height);
+        }
+        g_async_queue_push(bbbm_decoder_idle, helper);
+        if (started) {
+            return pixbuf;
+        }
+    }
+#endif
+    return bbbm_decoder_decode_here(filename, width, height);
+}
+
+void bbbm_decoder_shutdown(void) {
+#if HAVE_SHM_OPEN == 1
+    BBBMDecoderHelper *helper;
+
+    if (bbbm_decoder_idle == NULL) {
+        return;
+    }
+    /* the queue itself is kept, as busy helpers are still put back in it */
+    while ((helper = (BBBMDecoderHelper *) g_async_queue_try_pop(bbbm_decoder_idle)) != NULL) {
+        if (helper->pid != 0) {
+            bbbm_decoder_stop(helper, FALSE);
+        }
+        g_timer_destroy(helper->failed);
+        g_free(helper);
+    }
+#endif
+}
+
+gint bbbm_decoder_serve(gint argc, gchar *argv[]) {
+#if HAVE_SHM_OPEN == 1
+    GIOChannel *input;
+    gchar *line;
+    guchar *segment;
+    gint memory;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: "PACKAGE" "BBBM_DECODER_OPTION" <shared memory>\n");
+        return 1;
+    }
+#if HAVE_G_TYPE_INIT_IMPLICIT == 0
+    g_type_init();
+#endif
+
+    memory = shm_open(argv[2], O_RDWR, 0600);
+    if (memory == -1) {
+        g_critical("could not open shared memory '%s': %s", argv[2], g_strerror(errno));
+        return 1;
+    }
+    segment = mmap(NULL, BBBM_DECODER_SEGMENT, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+    close(memory);
+    if (segment == MAP_FAILED) {
+        g_critical("could not map shared memory '%s': %s", argv[2], g_strerror(errno));
+        return 1;
+    }
+    if (!bbbm_decoder_write(STDOUT_FILENO, "READY\n")) {
+        return 1;
+    }
+
+    input = g_io_channel_unix_new(STDIN_FILENO);
+    g_io_channel_set_encoding(input, NULL, NULL);
+    while (g_io_channel_read_line(input, &line, NULL, NULL, NULL) == G_IO_STATUS_NORMAL) {
+        GdkPixbuf *pixbuf = NULL;
+        guint width, height;
+        gint offset = 0;
+        gchar *reply;
+
+        g_strchomp(line);
+        if (sscanf(line, "%u %u %n", &width, &height, &offset) == 2 && offset != 0) {
+            gchar *filename = g_strcompress(line + offset);
+
+            pixbuf = bbbm_decoder_decode_here(filename, width, height);
+            g_free(filename);
+        }
+        if (pixbuf != NULL && gdk_pixbuf_get_bits_per_sample(pixbuf) == 8
+                && (gsize) gdk_pixbuf_get_rowstride(pixbuf) * gdk_pixbuf_get_height(pixbuf) <= BBBM_DECODER_SEGMENT) {
+            gint rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+
+            /* the last row need not be padded */
+            memcpy(segment, gdk_pixbuf_get_pixels(pixbuf), (gdk_pixbuf_get_height(pixbuf) - 1) * rowstride
+                   + gdk_pixbuf_get_width(pixbuf) * gdk_pixbuf_get_n_channels(pixbuf));
+            reply = g_strdup_printf("OK %d %d %d %d\n", gdk_pixbuf_get_width(pixbuf), gdk_pixbuf_get_height(pixbuf),
+                                    rowstride, gdk_pixbuf_get_has_alpha(pixbuf));
+        } else {
+            reply = g_strdup("FAIL\n");
+        }
+        if (pixbuf != NULL) {
+            g_object_unref(pixbuf);
+        }
+        g_free(line);
+        if (!bbbm_decoder_write(STDOUT_FILENO, reply)) {
+            g_free(reply);
+            break;
+        }
+        g_free(reply);
+    }
+    g_io_channel_unref(input);
+    munmap(segment, BBBM_DECODER_SEGMENT);
+    return 0;
+#else
+    fprintf(stderr, "Shared memory is not supported\n");
+    return 1;
+#endif
+}
+
+static GdkPixbuf *bbbm_decoder_decode_here(const gchar *filename, guint width, guint height) {
+    GdkPixbuf *pixbuf;
+    GError *error = NULL;
+
+    if (bbbm_archive_is_member(filename)) {
+        /* members are decoded while they are read, at the requested size */
+        pixbuf = bbbm_archive_load(filename, width, height, &error);
+    } else {
+#if HAVE_GDK_PIXBUF_NEW_FROM_FILE_AT_SCALE == 0
+        pixbuf = gdk_pixbuf_new_from_file(filename, &error);
+        if (pixbuf != NULL) {
+            GdkPixbuf *scaled;
+            gdouble scale;
+
+            scale = MIN((gdouble) width / gdk_pixbuf_get_width(pixbuf),
+                        (gdouble) height / gdk_pixbuf_get_height(pixbuf));
+            scaled = gdk_pixbuf_scale_simple(pixbuf, MAX(gdk_pixbuf_get_width(pixbuf) * scale, 1),
+                                             MAX(gdk_pixbuf_get_height(pixbuf) * scale, 1), GDK_INTERP_BILINEAR);
+            g_object_unref(pixbuf);
+            pixbuf = scaled;
+        }
+#else
+        /* the loader can decode large JPEG files at a fraction of their size, which is a lot cheaper than scaling */
+        pixbuf = gdk_pixbuf_new_from_file_at_scale(filename, width, height, TRUE, &error);
+#endif
+    }
+    if (error != NULL) {
+        g_warning("could not load thumbnail of '%s': %s", filename, error->message);
+        g_error_free(error);
+    }
+    return pixbuf;
+}
+
+static gsize bbbm_decoder_estimate(const gchar *filename, guint width, guint height) {
+    BBBMMetadata metadata;
+    gsize decoded;
+
+    if (bbbm_archive_is_member(filename) || !bbbm_metadata_read(filename, &metadata)) {
+        return BBBM_DECODER_UNKNOWN_COST;
+    }
+    if (strcmp(metadata.format, "jpeg") == 0) {
+        gint denominator = 1;
+
+#if HAVE_GDK_PIXBUF_NEW_FROM_FILE_AT_SCALE == 1
+        /* libjpeg scales down by 1/2, 1/4 or 1/8 while decoding, as long as the result is not smaller than asked */
+        while (denominator < 8 && metadata.width / (denominator * 2) >= (gint) width
+                && metadata.height / (denominator * 2) >= (gint) height) {
+            denominator *= 2;
+        }
+#endif
+        decoded = (gsize) ((metadata.width + denominator - 1) / denominator)
+                * ((metadata.height + denominator - 1) / denominator) * 3;
+    } else {
+        /* everything else is decoded at full size, possibly with alpha */
+        decoded = (gsize) metadata.width * metadata.height * 4;
+    }
+    /* plus the scaled copy */
+    return decoded + (gsize) width * height * 4;
+}
+
+static void bbbm_decoder_admit(const gchar *filename, gsize cost) {
+    g_mutex_lock(bbbm_decoder_mutex);
+    if (bbbm_decoder_budget != 0 && cost > bbbm_decoder_budget) {
+        g_debug("decoding '%s' alone; it needs an estimated %" G_GSIZE_FORMAT " bytes", filename, cost);
+        bbbm_decoder_oversized++;
+        while (bbbm_decoder_running > 0) {
+            g_cond_wait(bbbm_decoder_cond, bbbm_decoder_mutex);
+        }
+        bbbm_decoder_oversized--;
+    } else {
+        while (bbbm_decoder_oversized > 0
+                || (bbbm_decoder_running > 0 && bbbm_decoder_budget != 0
+                    && bbbm_decoder_used + cost > bbbm_decoder_budget)) {
+            g_cond_wait(bbbm_decoder_cond, bbbm_decoder_mutex);
+        }
+    }
+    bbbm_decoder_used += cost;
+    bbbm_decoder_running++;
+    g_mutex_unlock(bbbm_decoder_mutex);
+}
+
+static void bbbm_decoder_release(gsize cost) {
+    g_mutex_lock(bbbm_decoder_mutex);
+    bbbm_decoder_used -= cost;
+    bbbm_decoder_running--;
+    g_cond_broadcast(bbbm_decoder_cond);
+    g_mutex_unlock(bbbm_decoder_mutex);
+}
+
+#if HAVE_SHM_OPEN == 1
+static GdkPixbuf *bbbm_decoder_decode_remote(BBBMDecoderHelper *helper, const gchar *filename, guint width,
+                                             guint height) {
+    GdkPixbuf *pixbuf;
+    gchar *escaped, *request;
+    gchar reply[BBBM_DECODER_REPLY];
+    gint w, h, rowstride, has_alpha, channels, y;
+    gboolean sent;
+
+    /* escaped, so filenames with newlines cannot break the protocol */
+    escaped = g_strescape(filename, NULL);
+    request = g_strdup_printf("%u %u %s\n", width, height, escaped);
+    sent = bbbm_decoder_write(helper->socket, request);
+    g_free(request);
+    g_free(escaped);
+    if (!sent || !bbbm_decoder_read_line(helper->socket, reply, sizeof(reply))) {
+        /* only this file is given up on; the next one gets a new helper */
+        g_warning("the decoder crashed or hung on '%s'", filename);
+        bbbm_decoder_stop(helper, TRUE);
+        return NULL;
+    }
+    if (sscanf(reply, "OK %d %d %d %d", &w, &h, &rowstride, &has_alpha) != 4) {
+        /* the helper has reported why */
+        return NULL;
+    }
+    channels = has_alpha ? 4 : 3;
+    if (w <= 0 || h <= 0 || rowstride < w * channels || (gsize) rowstride * h > BBBM_DECODER_SEGMENT) {
+        g_warning("the decoder returned an invalid image for '%s'", filename);
+        return NULL;
+    }
+    pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, has_alpha, 8, w, h);
+    if (pixbuf == NULL) {
+        return NULL;
+    }
+    /* copied row by row, as the rowstrides need not match */
+    for (y = 0; y < h; y++) {
+        memcpy(gdk_pixbuf_get_pixels(pixbuf) + y * gdk_pixbuf_get_rowstride(pixbuf),
+               helper->segment + y * rowstride, w * channels);
+    }
+    return pixbuf;
+}
+
+static gboolean bbbm_decoder_start(BBBMDecoderHelper *helper) {
+    posix_spawn_file_actions_t actions;
+    gchar *name, *argv[4];
+    gchar reply[BBBM_DECODER_REPLY];
+    gint sockets[2], memory, result;
+
+    /* the helper opens the shared memory by name; it is unlinked once both have it mapped */
+    name = g_strdup_printf("/bbbm-decoder-%d-%p", (gint) getpid(), (gpointer) helper);
+    memory = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (memory == -1) {
+        g_warning("could not create shared memory '%s': %s", name, g_strerror(errno));
+        g_free(name);
+        return FALSE;
+    }
+    helper->segment = ftruncate(memory, BBBM_DECODER_SEGMENT) == 0
+                    ? mmap(NULL, BBBM_DECODER_SEGMENT, PROT_READ, MAP_SHARED, memory, 0) : MAP_FAILED;
+    close(memory);
+    if (helper->segment == MAP_FAILED) {
+        g_warning("could not map shared memory '%s': %s", name, g_strerror(errno));
+        helper->segment = NULL;
+        shm_unlink(name);
+        g_free(name);
+        return FALSE;
+    }
+
+    /* close-on-exec, so other helpers and commands do not keep them open */
+#ifdef SOCK_CLOEXEC
+    result = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets);
+#else
+    result = socketpair(AF_UNIX, SOCK_STREAM, 0, sockets);
+    if (result == 0) {
+        fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+        fcntl(sockets[1], F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    if (result == -1) {
+        g_warning("could not create a socket for a decoder: %s", g_strerror(errno));
+        bbbm_decoder_stop(helper, TRUE);
+        shm_unlink(name);
+        g_free(name);
+        return FALSE;
+    }
+    argv[0] = bbbm_decoder_program;
+    argv[1] = BBBM_DECODER_OPTION;
+    argv[2] = name;
+    argv[3] = NULL;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, sockets[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, sockets[1], STDOUT_FILENO);
+    result = posix_spawn(&helper->pid, bbbm_decoder_program, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(sockets[1]);
+    helper->socket = sockets[0];
+    if (result != 0) {
+        g_warning("could not execute '%s': %s", bbbm_decoder_program, g_strerror(result));
+        helper->pid = 0;
+        bbbm_decoder_stop(helper, TRUE);
+        shm_unlink(name);
+        g_free(name);
+        return FALSE;
+    }
+
+    result = bbbm_decoder_read_line(helper->socket, reply, sizeof(reply)) && strcmp(reply, "READY\n") == 0;
+    shm_unlink(name);
+    g_free(name);
+    if (!result) {
+        g_warning("decoder %d did not start", (gint) helper->pid);
+        bbbm_decoder_stop(helper, TRUE);
+        return FALSE;
+    }
+    g_debug("started decoder %d", (gint) helper->pid);
+    return TRUE;
+}
+
+static void bbbm_decoder_stop(BBBMDecoderHelper *helper, gboolean force) {
+    if (helper->socket != -1) {
+        /* an idle helper exits once its input is closed */
+        close(helper->socket);
+        helper->socket = -1;
+    }
+    if (helper->pid != 0) {
+        if (force) {
+            kill(helper->pid, SIGKILL);
+        }
+        waitpid(helper->pid, NULL, 0);
+        helper->pid = 0;
+    }
+    if (helper->segment != NULL) {
+        munmap(helper->segment, BBBM_DECODER_SEGMENT);
+        helper->segment = NULL;
+    }
+}
+
+static gboolean bbbm_decoder_write(gint fd, const gchar *data) {
+    gsize length;
+    gssize written;
+
+    length = strlen(data);
+    while (length > 0) {
+        /* a socket, so a helper that has died does not raise SIGPIPE in bbbm */
+        written = send(fd, data, length, MSG_NOSIGNAL);
+        if (written == -1 && errno == ENOTSOCK) {
+            /* the helper's end, which is its standard output */
+            written = write(fd, data, length);
+        }
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        data += written;
+        length -= written;
+    }
+    return TRUE;
+}
+
+static gboolean bbbm_decoder_read_line(gint fd, gchar *buffer, gsize size) {
+    struct pollfd poll_fd;
+    GTimer *timer;
+    gsize length = 0;
+    gssize count;
+    gint remaining, result;
+
+    timer = g_timer_new();
+    poll_fd.fd = fd;
+    poll_fd.events = POLLIN;
+    while (length < size - 1) {
+        remaining = BBBM_DECODER_TIMEOUT - (gint) (g_timer_elapsed(timer, NULL) * 1000);
+        if (remaining <= 0) {
+            break;
+        }
+        result = poll(&poll_fd, 1, remaining);
+        if (result == -1 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        count = read(fd, buffer + length, size - 1 - length);
+        if (count <= 0) {
+            if (count == -1 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        length += count;
+        buffer[length] = '\0';
+        if (buffer[length - 1] == '\n') {
+            g_timer_destroy(timer);
+            return TRUE;
+        }
+    }
+    g_timer_destroy(timer);
+    return FALSE;
+}
+#endif
@@ -0,0 +1,53 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_DECODER_H_
+#define __BBBM_DECODER_H_
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* the hidden command line option that turns bbbm into a decoder helper */
+#define BBBM_DECODER_OPTION  "--decoder"
+
+/* Starts using helper processes for decoding, one per processor. Images are then decoded by re-running the given
+   program with BBBM_DECODER_OPTION, so an image that crashes gdk-pixbuf only takes a helper down with it.
+   The helpers are started when they are first needed. Until this is called, images are decoded in-process, and
+   without a memory budget */
+void bbbm_decoder_init(const gchar *program);
+
+/* Limits the memory that decodes may use at once to the given number of bytes, or lifts the limit if it is 0 */
+void bbbm_decoder_set_memory_budget(gsize budget);
+
+/* Decodes the given image file or archive member at the largest size that fits the given size, keeping its aspect
+   ratio. May be called from any thread. The call waits while all helpers are busy, and while the memory the decode
+   is estimated to need, from the image's header, does not fit in the budget next to the decodes that are running.
+   An image that needs more than the whole budget is decoded alone.
+   Returns NULL if the file could not be decoded, or if the helper decoding it crashed or hung */
+GdkPixbuf *bbbm_decoder_decode(const gchar *filename, guint width, guint height);
+
+/* Stops all helpers that are not busy; busy ones stop by themselves once bbbm exits */
+void bbbm_decoder_shutdown(void);
+
+/* Runs a decoder helper, which decodes the files it is asked for until its input is closed.
+   argc and argv are those of main. Returns the exit status */
+gint bbbm_decoder_serve(gint argc, gchar *argv[]);
+
+#endif /* __BBBM_DECODER_H_ */
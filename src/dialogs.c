@@ -25,12 +25,17 @@
 #include "dialogs.h"
 #include "options.h"
 #include "bbbm.h"
+#include "image.h"
+#include "collection.h"
 #include "util.h"
+#include "archive.h"
 #include "compat.h"
 
 #define PADDING                5
 #define OPTION_LABEL_ALIGN_X   1
 #define OPTION_LABEL_ALIGN_Y   0.5
+#define DUPLICATE_THUMB_SIZE   64
+#define RESPONSE_RELOCATE      1
 
 struct BBBMCommandList {
     GtkWindow *parent_window;
@@ -134,8 +139,36 @@ GList *bbbm_dialogs_get_files(GtkWindow *parent, const gchar *title) {
     return result;
 }
 
-GList *bbbm_dialogs_get_files_dir(GtkWindow *parent, const gchar *title) {
-    GList *result = NULL;
+gchar *bbbm_dialogs_get_dir_or_archive(GtkWindow *parent, const gchar *title) {
+    gchar *result = NULL;
+    GtkWidget *file_selection;
+
+    file_selection = gtk_file_selection_new(title);
+    gtk_window_set_transient_for(GTK_WINDOW(file_selection), parent);
+    gtk_file_selection_set_select_multiple(GTK_FILE_SELECTION(file_selection), FALSE);
+    gtk_file_selection_hide_fileop_buttons(GTK_FILE_SELECTION(file_selection));
+
+    while (gtk_dialog_run(GTK_DIALOG(file_selection)) == GTK_RESPONSE_OK) {
+        gchar *dir;
+        gchar *file;
+
+        file = bbbm_util_absolute_path(gtk_file_selection_get_filename(GTK_FILE_SELECTION(file_selection)));
+        if (g_file_test(file, G_FILE_TEST_IS_DIR)
+                || (bbbm_archive_is_archive(file) && g_file_test(file, G_FILE_TEST_IS_REGULAR))) {
+            result = file;
+            break;
+        }
+        dir = bbbm_util_dirname(file);
+        gtk_file_selection_set_filename(GTK_FILE_SELECTION(file_selection), dir);
+        g_free(dir);
+        g_free(file);
+    }
+    gtk_widget_destroy(file_selection);
+    return result;
+}
+
+gchar *bbbm_dialogs_get_dir(GtkWindow *parent, const gchar *title) {
+    gchar *result = NULL;
     GtkWidget *file_selection;
 
     file_selection = gtk_file_selection_new(title);
@@ -149,8 +182,7 @@ GList *bbbm_dialogs_get_files_dir(GtkWindow *parent, const gchar *title) {
 
         file = bbbm_util_absolute_path(gtk_file_selection_get_filename(GTK_FILE_SELECTION(file_selection)));
         if (g_file_test(file, G_FILE_TEST_IS_DIR)) {
-            result = bbbm_util_listdir(file);
-            g_free(file);
+            result = file;
             break;
         }
         dir = bbbm_util_dirname(file);
@@ -226,8 +258,13 @@ guint bbbm_dialogs_options(GtkWindow *parent, BBBMOptions *options) {
     guint result = 0;
     GtkWidget *dialog, *notebook, *vbox, *hbox, *frame, *table, *label;
     GtkWidget *set_command_entry,
-              *thumb_width_entry, *thumb_height_entry, *thumb_column_count_entry,
-              *filename_as_label_check_button, *filename_as_title_check_button;
+              *thumb_width_entry, *thumb_height_entry, *thumb_column_count_entry, *thumb_deferred_check_button,
+              *decode_memory_entry,
+              *filename_as_label_check_button, *filename_as_title_check_button,
+              *menu_split_combo_box, *menu_page_size_entry,
+              *max_jobs_entry, *job_timeout_entry,
+              *builtin_setter_check_button, *background_mode_combo_box, *pixmap_cache_size_entry,
+              *render_cache_check_button, *transition_entry, *random_mode_combo_box;
     GtkSizeGroup *size_group;
     struct BBBMCommandList commands;
     const GList *iterator;
@@ -253,7 +290,7 @@ guint bbbm_dialogs_options(GtkWindow *parent, BBBMOptions *options) {
     gtk_container_set_border_width(GTK_CONTAINER(frame), PADDING);
     gtk_box_pack_start(GTK_BOX(vbox), frame, FALSE, FALSE, 0);
 
-    table = gtk_table_new(2, 1, FALSE);
+    table = gtk_table_new(2, 7, FALSE);
     gtk_container_add(GTK_CONTAINER(frame), table);
 
     /* General tab, Background frame, Set command */
@@ -266,12 +303,71 @@ guint bbbm_dialogs_options(GtkWindow *parent, BBBMOptions *options) {
     gtk_entry_set_text(GTK_ENTRY(set_command_entry), bbbm_options_get_set_command(options));
     gtk_table_attach(GTK_TABLE(table), set_command_entry, 1, 2, 0, 1, GTK_EXPAND | GTK_FILL, 0, PADDING, 0);
 
+    /* General tab, Background frame, Built-in setter */
+    builtin_setter_check_button = gtk_check_button_new_with_mnemonic("Set backgrounds _without the set command");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(builtin_setter_check_button), bbbm_options_get_builtin_setter(options));
+    gtk_table_attach(GTK_TABLE(table), builtin_setter_check_button, 0, 2, 1, 2, GTK_EXPAND | GTK_FILL, 0, PADDING, 0);
+
+    /* General tab, Background frame, Mode */
+    label = gtk_label_new("Mode:");
+    gtk_misc_set_alignment(GTK_MISC(label), OPTION_LABEL_ALIGN_X, OPTION_LABEL_ALIGN_Y);
+    gtk_size_group_add_widget(size_group, label);
+    gtk_table_attach(GTK_TABLE(table), label, 0, 1, 2, 3, 0, 0, PADDING, 0);
+
+    /* the order matches BBBMRenderMode */
+    background_mode_combo_box = gtk_combo_box_new_text();
+    gtk_combo_box_append_text(GTK_COMBO_BOX(background_mode_combo_box), "Fill");
+    gtk_combo_box_append_text(GTK_COMBO_BOX(background_mode_combo_box), "Fit");
+    gtk_combo_box_append_text(GTK_COMBO_BOX(background_mode_combo_box), "Center");
+    gtk_combo_box_append_text(GTK_COMBO_BOX(background_mode_combo_box), "Tile");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(background_mode_combo_box), bbbm_options_get_background_mode(options));
+    gtk_table_attach(GTK_TABLE(table), background_mode_combo_box, 1, 2, 2, 3, GTK_EXPAND | GTK_FILL, 0, PADDING, 0);
+
+    /* General tab, Background frame, Cached backgrounds */
+    label = gtk_label_new("Cached backgrounds:");
+    gtk_misc_set_alignment(GTK_MISC(label), OPTION_LABEL_ALIGN_X, OPTION_LABEL_ALIGN_Y);
+    gtk_size_group_add_widget(size_group, label);
+    gtk_table_attach(GTK_TABLE(table), label, 0, 1, 3, 4, 0, 0, PADDING, 0);
+
+    pixmap_cache_size_entry = gtk_spin_button_new_with_range(0, BBBM_OPTIONS_MAX_PIXMAP_CACHE_SIZE, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(pixmap_cache_size_entry), bbbm_options_get_pixmap_cache_size(options));
+    gtk_table_attach(GTK_TABLE(table), pixmap_cache_size_entry, 1, 2, 3, 4, GTK_EXPAND | GTK_FILL, 0, PADDING, 0);
+
+    /* General tab, Background frame, Crossfade */
+    label = gtk_label_new("Crossfade (milliseconds):");
+    gtk_misc_set_alignment(GTK_MISC(label), OPTION_LABEL_ALIGN_X, OPTION_LABEL_ALIGN_Y);
+    gtk_size_group_add_widget(size_group, label);
+    gtk_table_attach(GTK_TABLE(table), label, 0, 1, 4, 5, 0, 0, PADDING, 0);
+
+    transition_entry = gtk_spin_button_new_with_range(0, BBBM_OPTIONS_MAX_TRANSITION, 50);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(transition_entry), bbbm_options_get_transition(options));
+    gtk_table_attach(GTK_TABLE(table), transition_entry, 1, 2, 4, 5, GTK_EXPAND | GTK_FILL, 0, PADDING, 0);
+
+    /* General tab, Background frame, Random backgrounds */
+    label = gtk_label_new("Random backgrounds:");
+    gtk_misc_set_alignment(GTK_MISC(label), OPTION_LABEL_ALIGN_X, OPTION_LABEL_ALIGN_Y);
+    gtk_size_group_add_widget(size_group, label);
+    gtk_table_attach(GTK_TABLE(table), label, 0, 1, 5, 6, 0, 0, PADDING, 0);
+
+    /* the order matches BBBMRandomMode */
+    random_mode_combo_box = gtk_combo_box_new_text();
+    gtk_combo_box_append_text(GTK_COMBO_BOX(random_mode_combo_box), "Any image");
+    gtk_combo_box_append_text(GTK_COMBO_BOX(random_mode_combo_box), "Prefer images that fit the screen");
+    gtk_combo_box_append_text(GTK_COMBO_BOX(random_mode_combo_box), "Only images that fit the screen");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(random_mode_combo_box), bbbm_options_get_random_mode(options));
+    gtk_table_attach(GTK_TABLE(table), random_mode_combo_box, 1, 2, 5, 6, GTK_EXPAND | GTK_FILL, 0, PADDING, 0);
+
+    /* General tab, Background frame, Render cache */
+    render_cache_check_button = gtk_check_button_new_with_mnemonic("Give the set command images _fitted to the screen");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(render_cache_check_button), bbbm_options_get_render_cache(options));
+    gtk_table_attach(GTK_TABLE(table), render_cache_check_button, 0, 2, 6, 7, GTK_EXPAND | GTK_FILL, 0, PADDING, PADDING);
+
     /* General tab, Thumbnails frame */
     frame = gtk_frame_new("Thumbnails");
     gtk_container_set_border_width(GTK_CONTAINER(frame), PADDING);
     gtk_box_pack_start(GTK_BOX(vbox), frame, FALSE, FALSE, 0);
 
-    table = gtk_table_new(2, 2, FALSE);
+    table = gtk_table_new(2, 3, FALSE);
     gtk_container_add(GTK_CONTAINER(frame), table);
 
     /* General tab, Thumbnails frame, Thumbnail size (WxH) */
@@ -304,12 +400,27 @@ guint bbbm_dialogs_options(GtkWindow *parent, BBBMOptions *options) {
     gtk_spin_button_set_value(GTK_SPIN_BUTTON(thumb_column_count_entry), bbbm_options_get_thumb_column_count(options));
     gtk_table_attach(GTK_TABLE(table), thumb_column_count_entry, 1, 2, 1, 2, GTK_EXPAND | GTK_FILL, 0, PADDING, PADDING);
 
+    /* General tab, Thumbnails frame, Load thumbnails in the background */
+    thumb_deferred_check_button = gtk_check_button_new_with_mnemonic("Load thumbnails in the _background");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(thumb_deferred_check_button), bbbm_options_get_thumb_deferred(options));
+    gtk_table_attach(GTK_TABLE(table), thumb_deferred_check_button, 0, 2, 2, 3, GTK_EXPAND | GTK_FILL, 0, PADDING, PADDING);
+
+    /* General tab, Thumbnails frame, Decode memory */
+    label = gtk_label_new("Decode memory (MB):");
+    gtk_misc_set_alignment(GTK_MISC(label), OPTION_LABEL_ALIGN_X, OPTION_LABEL_ALIGN_Y);
+    gtk_size_group_add_widget(size_group, label);
+    gtk_table_attach(GTK_TABLE(table), label, 0, 1, 3, 4, 0, 0, PADDING, 0);
+
+    decode_memory_entry = gtk_spin_button_new_with_range(0, BBBM_OPTIONS_MAX_DECODE_MEMORY, 64);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(decode_memory_entry), bbbm_options_get_decode_memory(options));
+    gtk_table_attach(GTK_TABLE(table), decode_memory_entry, 1, 2, 3, 4, GTK_EXPAND | GTK_FILL, 0, PADDING, PADDING);
+
     /* General tab, Menu options frame */
     frame = gtk_frame_new("Menu options");
     gtk_container_set_border_width(GTK_CONTAINER(frame), PADDING);
     gtk_box_pack_start(GTK_BOX(vbox), frame, FALSE, FALSE, 0);
 
-    table = gtk_table_new(2, 1, FALSE);
+    table = gtk_table_new(2, 4, FALSE);
     gtk_container_add(GTK_CONTAINER(frame), table);
 
     /* General tab, Menu options frame, Use filename as label */
@@ -322,6 +433,58 @@ guint bbbm_dialogs_options(GtkWindow *parent, BBBMOptions *options) {
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(filename_as_title_check_button), bbbm_options_get_filename_as_title(options));
     gtk_table_attach(GTK_TABLE(table), filename_as_title_check_button, 0, 1, 1, 2, GTK_EXPAND | GTK_FILL, 0, PADDING, 0);
 
+    /* General tab, Menu options frame, Submenus */
+    label = gtk_label_new("Submenus:");
+    gtk_misc_set_alignment(GTK_MISC(label), OPTION_LABEL_ALIGN_X, OPTION_LABEL_ALIGN_Y);
+    gtk_size_group_add_widget(size_group, label);
+    gtk_table_attach(GTK_TABLE(table), label, 0, 1, 2, 3, 0, 0, PADDING, 0);
+
+    /* the order matches BBBMMenuSplit */
+    menu_split_combo_box = gtk_combo_box_new_text();
+    gtk_combo_box_append_text(GTK_COMBO_BOX(menu_split_combo_box), "None");
+    gtk_combo_box_append_text(GTK_COMBO_BOX(menu_split_combo_box), "Per directory");
+    gtk_combo_box_append_text(GTK_COMBO_BOX(menu_split_combo_box), "Per first letter");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(menu_split_combo_box), bbbm_options_get_menu_split(options));
+    gtk_table_attach(GTK_TABLE(table), menu_split_combo_box, 1, 2, 2, 3, GTK_EXPAND | GTK_FILL, 0, PADDING, 0);
+
+    /* General tab, Menu options frame, Entries per submenu */
+    label = gtk_label_new("Entries per submenu:");
+    gtk_misc_set_alignment(GTK_MISC(label), OPTION_LABEL_ALIGN_X, OPTION_LABEL_ALIGN_Y);
+    gtk_size_group_add_widget(size_group, label);
+    gtk_table_attach(GTK_TABLE(table), label, 0, 1, 3, 4, 0, 0, PADDING, 0);
+
+    menu_page_size_entry = gtk_spin_button_new_with_range(0, BBBM_OPTIONS_MAX_MENU_PAGE_SIZE, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(menu_page_size_entry), bbbm_options_get_menu_page_size(options));
+    gtk_table_attach(GTK_TABLE(table), menu_page_size_entry, 1, 2, 3, 4, GTK_EXPAND | GTK_FILL, 0, PADDING, PADDING);
+
+    /* General tab, Jobs frame */
+    frame = gtk_frame_new("Jobs");
+    gtk_container_set_border_width(GTK_CONTAINER(frame), PADDING);
+    gtk_box_pack_start(GTK_BOX(vbox), frame, FALSE, FALSE, 0);
+
+    table = gtk_table_new(2, 2, FALSE);
+    gtk_container_add(GTK_CONTAINER(frame), table);
+
+    /* General tab, Jobs frame, Parallel jobs */
+    label = gtk_label_new("Parallel jobs:");
+    gtk_misc_set_alignment(GTK_MISC(label), OPTION_LABEL_ALIGN_X, OPTION_LABEL_ALIGN_Y);
+    gtk_size_group_add_widget(size_group, label);
+    gtk_table_attach(GTK_TABLE(table), label, 0, 1, 0, 1, 0, 0, PADDING, 0);
+
+    max_jobs_entry = gtk_spin_button_new_with_range(1, BBBM_OPTIONS_MAX_MAX_JOBS, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(max_jobs_entry), bbbm_options_get_max_jobs(options));
+    gtk_table_attach(GTK_TABLE(table), max_jobs_entry, 1, 2, 0, 1, GTK_EXPAND | GTK_FILL, 0, PADDING, 0);
+
+    /* General tab, Jobs frame, Timeout in seconds; 0 disables the timeout */
+    label = gtk_label_new("Timeout (seconds):");
+    gtk_misc_set_alignment(GTK_MISC(label), OPTION_LABEL_ALIGN_X, OPTION_LABEL_ALIGN_Y);
+    gtk_size_group_add_widget(size_group, label);
+    gtk_table_attach(GTK_TABLE(table), label, 0, 1, 1, 2, 0, 0, PADDING, 0);
+
+    job_timeout_entry = gtk_spin_button_new_with_range(0, BBBM_OPTIONS_MAX_JOB_TIMEOUT, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(job_timeout_entry), bbbm_options_get_job_timeout(options));
+    gtk_table_attach(GTK_TABLE(table), job_timeout_entry, 1, 2, 1, 2, GTK_EXPAND | GTK_FILL, 0, PADDING, PADDING);
+
     /* Commands tab */
     label = gtk_label_new("Commands");
     commands.parent_window   = parent;
@@ -386,16 +549,40 @@ guint bbbm_dialogs_options(GtkWindow *parent, BBBMOptions *options) {
         gint thumb_width;
         gint thumb_height;
         gint thumb_column_count;
+        gboolean thumb_deferred;
+        gint decode_memory;
         gboolean filename_as_label;
         gboolean filename_as_title;
+        BBBMMenuSplit menu_split;
+        gint menu_page_size;
+        gint max_jobs;
+        gint job_timeout;
+        gboolean builtin_setter;
+        BBBMRenderMode background_mode;
+        gint pixmap_cache_size;
+        gboolean render_cache;
+        gint transition;
+        BBBMRandomMode random_mode;
         GList *label_iterator, *command_iterator;
 
         set_command        = gtk_entry_get_text(GTK_ENTRY(set_command_entry));
         thumb_width        = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(thumb_width_entry));
         thumb_height       = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(thumb_height_entry));
         thumb_column_count = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(thumb_column_count_entry));
+        thumb_deferred     = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(thumb_deferred_check_button));
+        decode_memory      = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(decode_memory_entry));
         filename_as_label  = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(filename_as_label_check_button));
         filename_as_title  = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(filename_as_title_check_button));
+        menu_split         = gtk_combo_box_get_active(GTK_COMBO_BOX(menu_split_combo_box));
+        menu_page_size     = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(menu_page_size_entry));
+        max_jobs           = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(max_jobs_entry));
+        job_timeout        = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(job_timeout_entry));
+        builtin_setter     = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(builtin_setter_check_button));
+        background_mode    = gtk_combo_box_get_active(GTK_COMBO_BOX(background_mode_combo_box));
+        pixmap_cache_size  = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(pixmap_cache_size_entry));
+        render_cache       = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(render_cache_check_button));
+        transition         = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(transition_entry));
+        random_mode        = gtk_combo_box_get_active(GTK_COMBO_BOX(random_mode_combo_box));
 
         if (bbbm_options_set_set_command(options, set_command)) {
             result |= OPTIONS_SET_COMMAND_CHANGED;
@@ -406,12 +593,48 @@ guint bbbm_dialogs_options(GtkWindow *parent, BBBMOptions *options) {
         if (bbbm_options_set_thumb_column_count(options, thumb_column_count)) {
             result |= OPTIONS_THUMB_COLUMN_COUNT_CHANGED;
         }
+        if (bbbm_options_set_thumb_deferred(options, thumb_deferred)) {
+            result |= OPTIONS_THUMB_DEFERRED_CHANGED;
+        }
+        if (bbbm_options_set_decode_memory(options, decode_memory)) {
+            result |= OPTIONS_DECODE_MEMORY_CHANGED;
+        }
         if (bbbm_options_set_filename_as_label(options, filename_as_label)) {
             result |= OPTIONS_FILENAME_AS_LABEL_CHANGED;
         }
         if (bbbm_options_set_filename_as_title(options, filename_as_title)) {
             result |= OPTIONS_FILENAME_AS_TITLE_CHANGED;
         }
+        if (bbbm_options_set_menu_split(options, menu_split)) {
+            result |= OPTIONS_MENU_SPLIT_CHANGED;
+        }
+        if (bbbm_options_set_menu_page_size(options, menu_page_size)) {
+            result |= OPTIONS_MENU_SPLIT_CHANGED;
+        }
+        if (bbbm_options_set_max_jobs(options, max_jobs)) {
+            result |= OPTIONS_JOBS_CHANGED;
+        }
+        if (bbbm_options_set_job_timeout(options, job_timeout)) {
+            result |= OPTIONS_JOBS_CHANGED;
+        }
+        if (bbbm_options_set_builtin_setter(options, builtin_setter)) {
+            result |= OPTIONS_BACKGROUND_CHANGED;
+        }
+        if (bbbm_options_set_background_mode(options, background_mode)) {
+            result |= OPTIONS_BACKGROUND_CHANGED;
+        }
+        if (bbbm_options_set_pixmap_cache_size(options, pixmap_cache_size)) {
+            result |= OPTIONS_BACKGROUND_CHANGED;
+        }
+        if (bbbm_options_set_render_cache(options, render_cache)) {
+            result |= OPTIONS_BACKGROUND_CHANGED;
+        }
+        if (bbbm_options_set_transition(options, transition)) {
+            result |= OPTIONS_BACKGROUND_CHANGED;
+        }
+        if (bbbm_options_set_random_mode(options, random_mode)) {
+            result |= OPTIONS_BACKGROUND_CHANGED;
+        }
 
         if (bbbm_options_set_command_count(options, commands.command_count)) {
             result |= OPTIONS_COMMANDS_CHANGED;
@@ -521,6 +744,195 @@ gchar *bbbm_dialogs_edit_description(GtkWindow *parent, const gchar *initial) {
     return result;
 }
 
+gboolean bbbm_dialogs_broken_entries(GtkWindow *parent, GList *entries) {
+    GtkWidget *dialog, *label, *text_view, *scrolled_window;
+    GtkTextBuffer *buffer;
+    GList *iterator;
+    gchar *message;
+    gboolean result;
+
+    dialog = gtk_dialog_new_with_buttons("Broken entries", parent,
+                                         GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_NO_SEPARATOR,
+                                         "_Relocate...", RESPONSE_RELOCATE,
+                                         GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE,
+                                         NULL);
+    gtk_window_set_default_size(GTK_WINDOW(dialog), 500, 300);
+
+    message = g_strdup_printf("%d images could not be added. Moved images can be searched for in another directory.",
+                              g_list_length(entries));
+    label = gtk_label_new(message);
+    g_free(message);
+    gtk_label_set_line_wrap(GTK_LABEL(label), TRUE);
+    gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+    gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), label, FALSE, FALSE, PADDING);
+
+    /* all entries at once, one per line */
+    text_view = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(text_view), FALSE);
+    buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(text_view));
+    for (iterator = entries; iterator != NULL; iterator = iterator->next) {
+        BBBMCollectionEntry *entry = (BBBMCollectionEntry *) iterator->data;
+        GtkTextIter end;
+        gchar *line;
+
+        line = g_strdup_printf("%s: %s\n", entry->filename, bbbm_validate_status_to_string(entry->status));
+        gtk_text_buffer_get_end_iter(buffer, &end);
+        gtk_text_buffer_insert(buffer, &end, line, -1);
+        g_free(line);
+    }
+    scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(scrolled_window), text_view);
+    gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), scrolled_window, TRUE, TRUE, 0);
+    gtk_widget_show_all(dialog);
+
+    result = gtk_dialog_run(GTK_DIALOG(dialog)) == RESPONSE_RELOCATE;
+    gtk_widget_destroy(dialog);
+    return result;
+}
+
+GList *bbbm_dialogs_duplicates(GtkWindow *parent, const gchar *title, GList *groups) {
+    GList *result = NULL, *check_buttons = NULL, *images = NULL, *group, *iterator, *image_iterator;
+    GtkWidget *dialog, *scrolled_window, *vbox;
+    guint index = 0;
+
+    if (groups == NULL) {
+        dialog = gtk_message_dialog_new(parent, GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                        GTK_MESSAGE_INFO, GTK_BUTTONS_OK, "No duplicates found");
+        gtk_window_set_title(GTK_WINDOW(dialog), title);
+        gtk_dialog_run(GTK_DIALOG(dialog));
+        gtk_widget_destroy(dialog);
+        return NULL;
+    }
+
+    dialog = gtk_dialog_new_with_buttons(title, parent,
+                                         GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_NO_SEPARATOR,
+                                         GTK_STOCK_REMOVE, GTK_RESPONSE_OK,
+                                         GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+                                         NULL);
+    gtk_window_set_default_size(GTK_WINDOW(dialog), 500, 400);
+
+    vbox = gtk_vbox_new(FALSE, 0);
+    for (group = groups; group != NULL; group = group->next) {
+        GtkWidget *frame, *group_box;
+        gchar *text;
+
+        text = g_strdup_printf("Group %d", ++index);
+        frame = gtk_frame_new(text);
+        g_free(text);
+        gtk_container_set_border_width(GTK_CONTAINER(frame), PADDING);
+
+        group_box = gtk_vbox_new(FALSE, 0);
+        for (iterator = (GList *) group->data; iterator != NULL; iterator = iterator->next) {
+            BBBMImage *image = BBBM_IMAGE(iterator->data);
+            const gchar *filename, *description;
+            GtkWidget *check_button, *hbox, *label;
+            GdkPixbuf *pixbuf;
+
+            filename = bbbm_image_get_filename(image);
+            description = bbbm_image_get_description(image);
+            hbox = gtk_hbox_new(FALSE, PADDING);
+            pixbuf = gdk_pixbuf_new_from_file_at_size(filename, DUPLICATE_THUMB_SIZE, DUPLICATE_THUMB_SIZE, NULL);
+            if (pixbuf != NULL) {
+                gtk_box_pack_start(GTK_BOX(hbox), gtk_image_new_from_pixbuf(pixbuf), FALSE, FALSE, 0);
+                g_object_unref(pixbuf);
+            }
+            text = bbbm_str_equals(filename, description) ? g_strdup(filename)
+                                                          : g_strdup_printf("%s\n%s", description, filename);
+            label = gtk_label_new(text);
+            g_free(text);
+            gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+            gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+
+            check_button = gtk_check_button_new();
+            gtk_container_add(GTK_CONTAINER(check_button), hbox);
+            /* keep the first image of each group by default */
+            gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_button), iterator != (GList *) group->data);
+            gtk_box_pack_start(GTK_BOX(group_box), check_button, FALSE, FALSE, 0);
+
+            check_buttons = g_list_prepend(check_buttons, check_button);
+            images = g_list_prepend(images, image);
+        }
+        gtk_container_add(GTK_CONTAINER(frame), group_box);
+        gtk_box_pack_start(GTK_BOX(vbox), frame, FALSE, FALSE, 0);
+    }
+
+    scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_add_with_viewport(GTK_SCROLLED_WINDOW(scrolled_window), vbox);
+    gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), scrolled_window, TRUE, TRUE, 0);
+    gtk_widget_show_all(dialog);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_OK) {
+        /* both lists are reversed, so prepending restores the original order */
+        for (iterator = check_buttons, image_iterator = images; iterator != NULL;
+                iterator = iterator->next, image_iterator = image_iterator->next) {
+            if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(iterator->data))) {
+                result = g_list_prepend(result, image_iterator->data);
+            }
+        }
+    }
+    g_list_free(check_buttons);
+    g_list_free(images);
+    gtk_widget_destroy(dialog);
+    return result;
+}
+
+GtkWidget *bbbm_dialogs_progress_new(GtkWindow *parent, const gchar *title, guint lines) {
+    GtkWidget *dialog, *progress_bar, *label;
+    GList *labels = NULL;
+    guint i;
+
+    /* not modal; the main window keeps showing what has been done so far */
+    dialog = gtk_dialog_new_with_buttons(title, parent, GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_NO_SEPARATOR,
+                                         GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+                                         NULL);
+    gtk_window_set_default_size(GTK_WINDOW(dialog), 350, -1);
+
+    progress_bar = gtk_progress_bar_new();
+    gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), progress_bar, FALSE, FALSE, PADDING);
+    g_object_set_data(G_OBJECT(dialog), "progress-bar", progress_bar);
+    for (i = 0; i < lines; ++i) {
+        label = gtk_label_new("");
+        gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+        gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), label, FALSE, FALSE, 0);
+        labels = g_list_append(labels, label);
+    }
+    g_object_set_data_full(G_OBJECT(dialog), "labels", labels, (GDestroyNotify) g_list_free);
+    gtk_widget_show_all(dialog);
+    return dialog;
+}
+
+void bbbm_dialogs_progress_update(GtkWidget *dialog, gdouble fraction, const gchar **lines) {
+    GList *iterator;
+    guint i;
+
+    g_return_if_fail(GTK_IS_DIALOG(dialog));
+
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(g_object_get_data(G_OBJECT(dialog), "progress-bar")),
+                                  CLAMP(fraction, 0, 1));
+    iterator = (GList *) g_object_get_data(G_OBJECT(dialog), "labels");
+    for (i = 0; iterator != NULL; iterator = iterator->next, ++i) {
+        gtk_label_set_text(GTK_LABEL(iterator->data), lines[i]);
+    }
+}
+
+void bbbm_dialogs_progress_pulse(GtkWidget *dialog, const gchar **lines) {
+    GList *iterator;
+    guint i;
+
+    g_return_if_fail(GTK_IS_DIALOG(dialog));
+
+    gtk_progress_bar_pulse(GTK_PROGRESS_BAR(g_object_get_data(G_OBJECT(dialog), "progress-bar")));
+    if (lines == NULL) {
+        return;
+    }
+    iterator = (GList *) g_object_get_data(G_OBJECT(dialog), "labels");
+    for (i = 0; iterator != NULL; iterator = iterator->next, ++i) {
+        gtk_label_set_text(GTK_LABEL(iterator->data), lines[i]);
+    }
+}
+
 static gboolean bbbm_dialogs_confirm_overwrite(GtkWindow *parent, const gchar *file) {
     return bbbm_dialogs_question(parent, "Overwrite?", "File '%s' exists. Overwrite?", file);
 }
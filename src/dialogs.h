@@ -32,7 +32,12 @@ enum {
     OPTIONS_THUMB_COLUMN_COUNT_CHANGED  = 1 << 2,
     OPTIONS_FILENAME_AS_LABEL_CHANGED   = 1 << 3,
     OPTIONS_FILENAME_AS_TITLE_CHANGED   = 1 << 4,
-    OPTIONS_COMMANDS_CHANGED            = 1 << 5
+    OPTIONS_COMMANDS_CHANGED            = 1 << 5,
+    OPTIONS_JOBS_CHANGED                = 1 << 6,
+    OPTIONS_BACKGROUND_CHANGED          = 1 << 7,
+    OPTIONS_MENU_SPLIT_CHANGED          = 1 << 8,
+    OPTIONS_THUMB_DEFERRED_CHANGED      = 1 << 9,
+    OPTIONS_DECODE_MEMORY_CHANGED       = 1 << 10
 };
 
 /* Shows a question dialog with Yes/No options using the format and arguments.
@@ -47,10 +52,15 @@ void bbbm_dialogs_error(GtkWindow *parent, const gchar *format, ...);
    The returned list and all elements (strings) must be freed when no longer needed */
 GList *bbbm_dialogs_get_files(GtkWindow *parent, const gchar *title);
 
-/* Shows a dialog for opening all files in a directory.
-   Returns a list of opened file names, or NULL if the user cancelled.
-   The returned list and all elements (strings) must be freed when no longer needed */
-GList *bbbm_dialogs_get_files_dir(GtkWindow *parent, const gchar *title);
+/* Shows a dialog for selecting a directory or archive, whose files can then be listed with bbbm_util_listdir.
+   Returns the selected directory or archive, or NULL if the user cancelled.
+   The returned string must be freed when no longer needed */
+gchar *bbbm_dialogs_get_dir_or_archive(GtkWindow *parent, const gchar *title);
+
+/* Shows a dialog for selecting a directory.
+   Returns the name of the selected directory, or NULL if the user cancelled.
+   The returned string must be freed when no longer needed */
+gchar *bbbm_dialogs_get_dir(GtkWindow *parent, const gchar *title);
 
 /* Shows a dialog for opening a single file.
    Returns the name of the opened file, or NULL if the user cancelled.
@@ -76,4 +86,26 @@ gint bbbm_dialogs_move(GtkWindow *parent, const gchar *title, guint limit);
    The returned string must be freed when no longer needed */
 gchar *bbbm_dialogs_edit_description(GtkWindow *parent, const gchar *initial);
 
+/* Shows the given collection entries (BBBMCollectionEntry objects) that could not be added, with their status.
+   Returns TRUE if the user chose to relocate them, or FALSE otherwise */
+gboolean bbbm_dialogs_broken_entries(GtkWindow *parent, GList *entries);
+
+/* Shows the given groups of duplicate images (lists of BBBMImage objects), to select which ones to remove.
+   All but the first image of each group are selected initially.
+   Returns the selected images, or NULL if the user cancelled. Only the returned list must be freed */
+GList *bbbm_dialogs_duplicates(GtkWindow *parent, const gchar *title, GList *groups);
+
+/* Creates and shows a dialog with a progress bar, the given number of lines of text and a cancel button. Unlike
+   the other dialogs it does not wait for the user; its "response" signal is emitted when it is cancelled.
+   The returned dialog must be destroyed with gtk_widget_destroy when no longer needed */
+GtkWidget *bbbm_dialogs_progress_new(GtkWindow *parent, const gchar *title, guint lines);
+
+/* Shows the given fraction, from 0 to 1, and the given lines of text in a dialog created with
+   bbbm_dialogs_progress_new. There must be as many lines as the dialog was created with */
+void bbbm_dialogs_progress_update(GtkWidget *dialog, gdouble fraction, const gchar **lines);
+
+/* Like bbbm_dialogs_progress_update, but for work of which the progress is not known; each call moves the progress
+   bar a bit. If lines is NULL the text is left as it is */
+void bbbm_dialogs_progress_pulse(GtkWidget *dialog, const gchar **lines);
+
 #endif /* __BBBM_DIALOGS_H_ */
@@ -0,0 +1,670 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "config.h"
+#include "duplicates.h"
+#include "archive.h"
+#include "util.h"
+#include "compat.h"
+
+/* the size images are decoded at; see bbbm_archive_load for why small sizes are cheap */
+#define BBBM_DUPLICATES_DECODE_SIZE  32
+/* dHash compares each pixel of a 9x8 grayscale image to its right neighbour, giving 64 bits */
+#define BBBM_DUPLICATES_HASH_WIDTH   9
+#define BBBM_DUPLICATES_HASH_HEIGHT  8
+/* the number of milliseconds between checks whether all files have been examined */
+#define BBBM_DUPLICATES_POLL         100
+/* reading is I/O bound, and shares on the network have a high latency; keep several requests in flight */
+#define BBBM_DUPLICATES_IO_THREADS   8
+/* the size of the blocks at the start and end of files that are compared before reading them in full */
+#define BBBM_DUPLICATES_BLOCK_SIZE   16384
+#define BBBM_DUPLICATES_BUFFER_SIZE  (256 * 1024)
+
+/* the primes of xxHash64 */
+#define BBBM_DUPLICATES_PRIME1  G_GUINT64_CONSTANT(0x9E3779B185EBCA87)
+#define BBBM_DUPLICATES_PRIME2  G_GUINT64_CONSTANT(0xC2B2AE3D27D4EB4F)
+#define BBBM_DUPLICATES_PRIME3  G_GUINT64_CONSTANT(0x165667B19E3779F9)
+#define BBBM_DUPLICATES_PRIME4  G_GUINT64_CONSTANT(0x85EBCA77C2B2AE63)
+#define BBBM_DUPLICATES_PRIME5  G_GUINT64_CONSTANT(0x27D4EB2F165667C5)
+
+typedef enum {
+    /* perceptual hashes of all files */
+    BBBM_DUPLICATES_STAGE_SIMILAR,
+    /* the sizes of all files */
+    BBBM_DUPLICATES_STAGE_SIZE,
+    /* hashes of the first and last blocks of files that have the same size as another file */
+    BBBM_DUPLICATES_STAGE_PARTIAL,
+    /* hashes of the full content of files that still have a match */
+    BBBM_DUPLICATES_STAGE_FULL
+} BBBMDuplicatesStage;
+
+/* The streaming state of xxHash64; its four independent lanes keep the multipliers of the CPU busy */
+typedef struct {
+    guint64 lanes[4];
+    guint64 length;
+    guchar buffer[32];
+    guint buffered;
+} BBBMDuplicatesHash;
+
+/* A node of a BK-tree. Its children are all at a different distance from it, which lets a search skip every
+   subtree whose distance differs more than the threshold from the distance to the node itself */
+typedef struct _BBBMDuplicatesNode BBBMDuplicatesNode;
+
+struct _BBBMDuplicatesNode {
+    guint64 hash;
+    guint index;
+    guint distance;
+    BBBMDuplicatesNode *first_child;
+    BBBMDuplicatesNode *next_sibling;
+};
+
+struct _BBBMDuplicates {
+    gchar **filenames;
+    guint count;
+    guint threshold;
+    BBBMDuplicatesStage stage;
+    /* the indexes of the files examined in the current stage */
+    guint *candidates;
+    guint candidate_count;
+    /* written by the worker threads, one element each */
+    guint64 *hashes;
+    gint64 *sizes;
+    gboolean *valid;
+    /* accessed atomically */
+    gint done;
+    gint cancelled;
+    GThreadPool *pool;
+    guint poll_id;
+    bbbm_duplicates_function function;
+    gpointer data;
+};
+
+static BBBMDuplicates *bbbm_duplicates_new(const gchar **filenames, guint count, BBBMDuplicatesStage stage,
+                                           gint threads, bbbm_duplicates_function function, gpointer data);
+static void bbbm_duplicates_start_stage(BBBMDuplicates *duplicates, BBBMDuplicatesStage stage);
+static void bbbm_duplicates_run(gpointer index, BBBMDuplicates *duplicates);
+static gboolean bbbm_duplicates_compute_dhash(const gchar *filename, guint64 *hash);
+static gboolean bbbm_duplicates_compute_size(const gchar *filename, gint64 *size);
+static gboolean bbbm_duplicates_compute_hash(const gchar *filename, gint64 size, gboolean partial, guint64 *hash);
+static gboolean bbbm_duplicates_poll(BBBMDuplicates *duplicates);
+static GList *bbbm_duplicates_group_similar(BBBMDuplicates *duplicates);
+static GList *bbbm_duplicates_group_identical(BBBMDuplicates *duplicates, gboolean use_hashes);
+static gint bbbm_duplicates_compare(const guint *index1, const guint *index2, BBBMDuplicates *duplicates);
+static void bbbm_duplicates_insert(BBBMDuplicatesNode *root, BBBMDuplicatesNode *node);
+static GList *bbbm_duplicates_get_groups(guint *parents, guint count);
+static guint bbbm_duplicates_find_root(guint *parents, guint index);
+static inline guint bbbm_duplicates_distance(guint64 hash1, guint64 hash2);
+static void bbbm_duplicates_hash_init(BBBMDuplicatesHash *hash);
+static void bbbm_duplicates_hash_update(BBBMDuplicatesHash *hash, const guchar *data, gsize length);
+static guint64 bbbm_duplicates_hash_digest(BBBMDuplicatesHash *hash);
+static inline guint64 bbbm_duplicates_hash_round(guint64 lane, guint64 input);
+static inline guint64 bbbm_duplicates_read64(const guchar *data);
+static void bbbm_duplicates_destroy(BBBMDuplicates *duplicates);
+
+BBBMDuplicates *bbbm_duplicates_find_similar(const gchar **filenames, guint count, guint threshold,
+                                             bbbm_duplicates_function function, gpointer data) {
+    BBBMDuplicates *duplicates;
+
+    g_return_val_if_fail(filenames != NULL || count == 0, NULL);
+    g_return_val_if_fail(function != NULL, NULL);
+
+    duplicates = bbbm_duplicates_new(filenames, count, BBBM_DUPLICATES_STAGE_SIMILAR, bbbm_util_get_cpu_threads(),
+                                     function, data);
+    duplicates->threshold = threshold;
+    return duplicates;
+}
+
+BBBMDuplicates *bbbm_duplicates_find_identical(const gchar **filenames, guint count,
+                                               bbbm_duplicates_function function, gpointer data) {
+    g_return_val_if_fail(filenames != NULL || count == 0, NULL);
+    g_return_val_if_fail(function != NULL, NULL);
+
+    return bbbm_duplicates_new(filenames, count, BBBM_DUPLICATES_STAGE_SIZE, BBBM_DUPLICATES_IO_THREADS,
+                               function, data);
+}
+
+void bbbm_duplicates_cancel(BBBMDuplicates *duplicates) {
+    g_return_if_fail(duplicates != NULL);
+
+    g_source_remove(duplicates->poll_id);
+    bbbm_duplicates_destroy(duplicates);
+}
+
+static BBBMDuplicates *bbbm_duplicates_new(const gchar **filenames, guint count, BBBMDuplicatesStage stage,
+                                           gint threads, bbbm_duplicates_function function, gpointer data) {
+    BBBMDuplicates *duplicates;
+    GError *error = NULL;
+    guint i;
+
+    duplicates = g_malloc(sizeof(BBBMDuplicates));
+    duplicates->filenames = g_new(gchar *, count + 1);
+    duplicates->candidates = g_new(guint, count);
+    for (i = 0; i < count; ++i) {
+        duplicates->filenames[i] = g_strdup(filenames[i]);
+        duplicates->candidates[i] = i;
+    }
+    duplicates->filenames[count] = NULL;
+    duplicates->count           = count;
+    duplicates->candidate_count = count;
+    duplicates->threshold       = 0;
+    duplicates->hashes          = g_new0(guint64, count);
+    duplicates->sizes           = g_new0(gint64, count);
+    duplicates->valid           = g_new0(gboolean, count);
+    duplicates->cancelled       = FALSE;
+    duplicates->function        = function;
+    duplicates->data            = data;
+
+    duplicates->pool = g_thread_pool_new((GFunc) bbbm_duplicates_run, duplicates, threads, FALSE, &error);
+    if (duplicates->pool == NULL) {
+        g_warning("could not create threads to examine files: %s", error->message);
+        g_error_free(error);
+    }
+    bbbm_duplicates_start_stage(duplicates, stage);
+    duplicates->poll_id = g_timeout_add(BBBM_DUPLICATES_POLL, (GSourceFunc) bbbm_duplicates_poll, duplicates);
+    return duplicates;
+}
+
+static void bbbm_duplicates_start_stage(BBBMDuplicates *duplicates, BBBMDuplicatesStage stage) {
+    guint i;
+
+    /* the workers only read the stage after it has been pushed, which synchronizes through the pool's queue */
+    duplicates->stage = stage;
+    duplicates->done  = 0;
+    if (duplicates->pool == NULL) {
+        /* files that are never examined never end up in a group */
+        for (i = 0; i < duplicates->candidate_count; ++i) {
+            duplicates->valid[duplicates->candidates[i]] = FALSE;
+        }
+        duplicates->done = duplicates->candidate_count;
+        return;
+    }
+    for (i = 0; i < duplicates->candidate_count; ++i) {
+        /* thread pools do not accept NULL data */
+        g_thread_pool_push(duplicates->pool, GUINT_TO_POINTER(duplicates->candidates[i] + 1), NULL);
+    }
+}
+
+static void bbbm_duplicates_run(gpointer index, BBBMDuplicates *duplicates) {
+    guint i = GPOINTER_TO_UINT(index) - 1;
+    const gchar *filename = duplicates->filenames[i];
+
+    if (g_atomic_int_get(&(duplicates->cancelled))) {
+        duplicates->valid[i] = FALSE;
+    } else {
+        switch (duplicates->stage) {
+            case BBBM_DUPLICATES_STAGE_SIMILAR:
+                duplicates->valid[i] = bbbm_duplicates_compute_dhash(filename, &(duplicates->hashes[i]));
+                break;
+            case BBBM_DUPLICATES_STAGE_SIZE:
+                duplicates->valid[i] = bbbm_duplicates_compute_size(filename, &(duplicates->sizes[i]));
+                break;
+            case BBBM_DUPLICATES_STAGE_PARTIAL:
+                duplicates->valid[i] = bbbm_duplicates_compute_hash(filename, duplicates->sizes[i], TRUE,
+                                                                    &(duplicates->hashes[i]));
+                break;
+            case BBBM_DUPLICATES_STAGE_FULL:
+                /* the partial hash of small files already covers all of their content */
+                if (duplicates->sizes[i] > 2 * BBBM_DUPLICATES_BLOCK_SIZE) {
+                    duplicates->valid[i] = bbbm_duplicates_compute_hash(filename, duplicates->sizes[i], FALSE,
+                                                                        &(duplicates->hashes[i]));
+                }
+                break;
+        }
+    }
+    g_atomic_int_inc(&(duplicates->done));
+}
+
+static gboolean bbbm_duplicates_compute_dhash(const gchar *filename, guint64 *hash) {
+    GdkPixbuf *decoded, *scaled;
+    GError *error = NULL;
+    guchar *pixels;
+    gint rowstride, channels, x, y;
+    guint gray[BBBM_DUPLICATES_HASH_WIDTH];
+
+    if (bbbm_archive_is_member(filename)) {
+        decoded = bbbm_archive_load(filename, BBBM_DUPLICATES_DECODE_SIZE, BBBM_DUPLICATES_DECODE_SIZE, &error);
+    } else {
+        decoded = gdk_pixbuf_new_from_file_at_size(filename, BBBM_DUPLICATES_DECODE_SIZE,
+                                                   BBBM_DUPLICATES_DECODE_SIZE, &error);
+    }
+    if (decoded == NULL) {
+        g_warning("could not read '%s': %s", filename, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    /* the aspect ratio is dropped on purpose; crops should not match, but scaled copies should */
+    scaled = gdk_pixbuf_scale_simple(decoded, BBBM_DUPLICATES_HASH_WIDTH, BBBM_DUPLICATES_HASH_HEIGHT,
+                                     GDK_INTERP_BILINEAR);
+    g_object_unref(decoded);
+    if (scaled == NULL) {
+        return FALSE;
+    }
+
+    pixels    = gdk_pixbuf_get_pixels(scaled);
+    rowstride = gdk_pixbuf_get_rowstride(scaled);
+    channels  = gdk_pixbuf_get_n_channels(scaled);
+    *hash = 0;
+    for (y = 0; y < BBBM_DUPLICATES_HASH_HEIGHT; ++y) {
+        for (x = 0; x < BBBM_DUPLICATES_HASH_WIDTH; ++x) {
+            guchar *pixel = pixels + y * rowstride + x * channels;
+
+            gray[x] = pixel[0] * 299 + pixel[1] * 587 + pixel[2] * 114;
+        }
+        for (x = 0; x < BBBM_DUPLICATES_HASH_WIDTH - 1; ++x) {
+            *hash = (*hash << 1) | (gray[x] < gray[x + 1] ? 1 : 0);
+        }
+    }
+    g_object_unref(scaled);
+    return TRUE;
+}
+
+static gboolean bbbm_duplicates_compute_size(const gchar *filename, gint64 *size) {
+    struct stat info;
+
+    if (bbbm_archive_is_member(filename)) {
+        /* members are not files of their own; they can only be compared by how they look */
+        g_debug("skipping archive member '%s'", filename);
+        return FALSE;
+    }
+    if (g_stat(filename, &info) == -1) {
+        g_warning("could not read '%s': %s", filename, g_strerror(errno));
+        return FALSE;
+    }
+    *size = info.st_size;
+    return TRUE;
+}
+
+static gboolean bbbm_duplicates_compute_hash(const gchar *filename, gint64 size, gboolean partial, guint64 *hash) {
+    BBBMDuplicatesHash state;
+    guchar *buffer;
+    gsize read;
+    FILE *file;
+    gboolean result;
+
+    file = g_fopen(filename, "rb");
+    if (file == NULL) {
+        g_warning("could not read '%s': %s", filename, g_strerror(errno));
+        return FALSE;
+    }
+    buffer = g_malloc(BBBM_DUPLICATES_BUFFER_SIZE);
+    bbbm_duplicates_hash_init(&state);
+    if (partial && size > 2 * BBBM_DUPLICATES_BLOCK_SIZE) {
+        /* only the first and last blocks; files that differ mostly already differ there */
+        read = fread(buffer, 1, BBBM_DUPLICATES_BLOCK_SIZE, file);
+        bbbm_duplicates_hash_update(&state, buffer, read);
+        if (fseeko(file, (off_t) (size - BBBM_DUPLICATES_BLOCK_SIZE), SEEK_SET) == 0) {
+            read = fread(buffer, 1, BBBM_DUPLICATES_BLOCK_SIZE, file);
+            bbbm_duplicates_hash_update(&state, buffer, read);
+        }
+    } else {
+        while ((read = fread(buffer, 1, BBBM_DUPLICATES_BUFFER_SIZE, file)) > 0) {
+            bbbm_duplicates_hash_update(&state, buffer, read);
+        }
+    }
+    result = !ferror(file);
+    if (!result) {
+        g_warning("could not read '%s': %s", filename, g_strerror(errno));
+    }
+    fclose(file);
+    g_free(buffer);
+    *hash = bbbm_duplicates_hash_digest(&state);
+    return result;
+}
+
+static gboolean bbbm_duplicates_poll(BBBMDuplicates *duplicates) {
+    GList *groups, *iterator;
+
+    if ((guint) g_atomic_int_get(&(duplicates->done)) < duplicates->candidate_count) {
+        return TRUE;
+    }
+    switch (duplicates->stage) {
+        case BBBM_DUPLICATES_STAGE_SIMILAR:
+            groups = bbbm_duplicates_group_similar(duplicates);
+            g_debug("found %d groups of similar images among %d files", g_list_length(groups), duplicates->count);
+            break;
+        case BBBM_DUPLICATES_STAGE_SIZE:
+        case BBBM_DUPLICATES_STAGE_PARTIAL:
+            /* only files that still have a match go on to the next stage */
+            groups = bbbm_duplicates_group_identical(duplicates, duplicates->stage == BBBM_DUPLICATES_STAGE_PARTIAL);
+            duplicates->candidate_count = 0;
+            for (iterator = groups; iterator != NULL; iterator = iterator->next) {
+                GList *member;
+
+                for (member = (GList *) iterator->data; member != NULL; member = member->next) {
+                    duplicates->candidates[duplicates->candidate_count++] = GPOINTER_TO_UINT(member->data);
+                }
+                g_list_free((GList *) iterator->data);
+            }
+            g_list_free(groups);
+            g_debug("%d of %d files remain after comparing %s", duplicates->candidate_count, duplicates->count,
+                    duplicates->stage == BBBM_DUPLICATES_STAGE_SIZE ? "sizes" : "partial hashes");
+            bbbm_duplicates_start_stage(duplicates, duplicates->stage + 1);
+            return TRUE;
+        default:
+            groups = bbbm_duplicates_group_identical(duplicates, TRUE);
+            g_debug("found %d groups of identical files among %d files", g_list_length(groups), duplicates->count);
+            break;
+    }
+    duplicates->function(duplicates->data, groups);
+    for (iterator = groups; iterator != NULL; iterator = iterator->next) {
+        g_list_free((GList *) iterator->data);
+    }
+    g_list_free(groups);
+    bbbm_duplicates_destroy(duplicates);
+    return FALSE;
+}
+
+static GList *bbbm_duplicates_group_similar(BBBMDuplicates *duplicates) {
+    BBBMDuplicatesNode *nodes, *root = NULL;
+    GPtrArray *stack;
+    guint *parents;
+    guint i;
+    GList *groups;
+
+    nodes   = g_new(BBBMDuplicatesNode, duplicates->count);
+    parents = g_new(guint, duplicates->count);
+    stack   = g_ptr_array_new();
+    for (i = 0; i < duplicates->count; ++i) {
+        parents[i] = i;
+        if (!duplicates->valid[i]) {
+            continue;
+        }
+        nodes[i].hash         = duplicates->hashes[i];
+        nodes[i].index        = i;
+        nodes[i].distance     = 0;
+        nodes[i].first_child  = NULL;
+        nodes[i].next_sibling = NULL;
+        if (root == NULL) {
+            root = &nodes[i];
+            continue;
+        }
+
+        /* join all earlier images within the threshold, then add this one for the images after it */
+        g_ptr_array_add(stack, root);
+        while (stack->len > 0) {
+            BBBMDuplicatesNode *node, *child;
+            guint distance;
+
+            node = (BBBMDuplicatesNode *) g_ptr_array_remove_index_fast(stack, stack->len - 1);
+            distance = bbbm_duplicates_distance(node->hash, nodes[i].hash);
+            if (distance <= duplicates->threshold) {
+                parents[bbbm_duplicates_find_root(parents, node->index)] = bbbm_duplicates_find_root(parents, i);
+            }
+            for (child = node->first_child; child != NULL; child = child->next_sibling) {
+                /* by the triangle inequality, nothing within the threshold can be found in other subtrees */
+                if (child->distance + duplicates->threshold >= distance
+                        && child->distance <= distance + duplicates->threshold) {
+                    g_ptr_array_add(stack, child);
+                }
+            }
+        }
+        bbbm_duplicates_insert(root, &nodes[i]);
+    }
+    g_ptr_array_free(stack, TRUE);
+
+    groups = bbbm_duplicates_get_groups(parents, duplicates->count);
+    g_free(parents);
+    g_free(nodes);
+    return groups;
+}
+
+static GList *bbbm_duplicates_group_identical(BBBMDuplicates *duplicates, gboolean use_hashes) {
+    guint *candidates, *parents;
+    guint count = 0, i, start;
+    GList *groups;
+
+    candidates = g_new(guint, duplicates->candidate_count);
+    for (i = 0; i < duplicates->candidate_count; ++i) {
+        if (duplicates->valid[duplicates->candidates[i]]) {
+            candidates[count++] = duplicates->candidates[i];
+        }
+    }
+    /* sizes (and hashes) could be compared with a hash table as well, but sorting needs no allocation per file */
+    if (!use_hashes) {
+        for (i = 0; i < count; ++i) {
+            duplicates->hashes[candidates[i]] = 0;
+        }
+    }
+    g_qsort_with_data(candidates, count, sizeof(guint), (GCompareDataFunc) bbbm_duplicates_compare, duplicates);
+
+    /* files that are not candidates stay on their own */
+    parents = g_new(guint, duplicates->count);
+    for (i = 0; i < duplicates->count; ++i) {
+        parents[i] = i;
+    }
+    for (start = 0, i = 1; i <= count; ++i) {
+        if (i == count || duplicates->sizes[candidates[i]] != duplicates->sizes[candidates[start]]
+                || duplicates->hashes[candidates[i]] != duplicates->hashes[candidates[start]]) {
+            start = i;
+        } else {
+            /* the run is sorted by index, so its first file is the root */
+            parents[candidates[i]] = candidates[start];
+        }
+    }
+    groups = bbbm_duplicates_get_groups(parents, duplicates->count);
+    g_free(parents);
+    g_free(candidates);
+    return groups;
+}
+
+static gint bbbm_duplicates_compare(const guint *index1, const guint *index2, BBBMDuplicates *duplicates) {
+    gint64 size1 = duplicates->sizes[*index1], size2 = duplicates->sizes[*index2];
+    guint64 hash1 = duplicates->hashes[*index1], hash2 = duplicates->hashes[*index2];
+
+    if (size1 != size2) {
+        return size1 < size2 ? -1 : 1;
+    }
+    if (hash1 != hash2) {
+        return hash1 < hash2 ? -1 : 1;
+    }
+    return *index1 < *index2 ? -1 : (*index1 > *index2 ? 1 : 0);
+}
+
+static void bbbm_duplicates_insert(BBBMDuplicatesNode *root, BBBMDuplicatesNode *node) {
+    BBBMDuplicatesNode *parent = root;
+
+    while (TRUE) {
+        BBBMDuplicatesNode *child;
+        guint distance;
+
+        distance = bbbm_duplicates_distance(parent->hash, node->hash);
+        for (child = parent->first_child; child != NULL && child->distance != distance; child = child->next_sibling);
+        if (child == NULL) {
+            node->distance       = distance;
+            node->next_sibling   = parent->first_child;
+            parent->first_child  = node;
+            return;
+        }
+        parent = child;
+    }
+}
+
+static GList *bbbm_duplicates_get_groups(guint *parents, guint count) {
+    GList **members, *groups = NULL;
+    guint i;
+
+    /* root -> members of its group, in reverse order */
+    members = g_new0(GList *, count);
+    for (i = count; i > 0; --i) {
+        guint root = bbbm_duplicates_find_root(parents, i - 1);
+
+        members[root] = g_list_prepend(members[root], GUINT_TO_POINTER(i - 1));
+    }
+    /* order the groups by their first member, like the files themselves */
+    for (i = count; i > 0; --i) {
+        guint root = bbbm_duplicates_find_root(parents, i - 1);
+
+        if (members[root] != NULL && GPOINTER_TO_UINT(members[root]->data) == i - 1) {
+            if (members[root]->next != NULL) {
+                groups = g_list_prepend(groups, members[root]);
+            } else {
+                g_list_free(members[root]);
+            }
+            members[root] = NULL;
+        }
+    }
+    g_free(members);
+    return groups;
+}
+
+static guint bbbm_duplicates_find_root(guint *parents, guint index) {
+    guint root = index;
+
+    while (parents[root] != root) {
+        root = parents[root];
+    }
+    /* shorten the path for the next search */
+    while (parents[index] != root) {
+        guint parent = parents[index];
+
+        parents[index] = root;
+        index = parent;
+    }
+    return root;
+}
+
+static inline guint bbbm_duplicates_distance(guint64 hash1, guint64 hash2) {
+    guint64 difference = hash1 ^ hash2;
+    guint distance = 0;
+
+    /* clears the lowest set bit each time */
+    for (; difference != 0; difference &= difference - 1) {
+        ++distance;
+    }
+    return distance;
+}
+
+static void bbbm_duplicates_hash_init(BBBMDuplicatesHash *hash) {
+    hash->lanes[0] = BBBM_DUPLICATES_PRIME1 + BBBM_DUPLICATES_PRIME2;
+    hash->lanes[1] = BBBM_DUPLICATES_PRIME2;
+    hash->lanes[2] = 0;
+    hash->lanes[3] = -BBBM_DUPLICATES_PRIME1;
+    hash->length   = 0;
+    hash->buffered = 0;
+}
+
+static void bbbm_duplicates_hash_update(BBBMDuplicatesHash *hash, const guchar *data, gsize length) {
+    hash->length += length;
+    if (hash->buffered + length < 32) {
+        memcpy(hash->buffer + hash->buffered, data, length);
+        hash->buffered += length;
+        return;
+    }
+    if (hash->buffered > 0) {
+        gsize needed = 32 - hash->buffered;
+
+        memcpy(hash->buffer + hash->buffered, data, needed);
+        data += needed;
+        length -= needed;
+        hash->lanes[0] = bbbm_duplicates_hash_round(hash->lanes[0], bbbm_duplicates_read64(hash->buffer));
+        hash->lanes[1] = bbbm_duplicates_hash_round(hash->lanes[1], bbbm_duplicates_read64(hash->buffer + 8));
+        hash->lanes[2] = bbbm_duplicates_hash_round(hash->lanes[2], bbbm_duplicates_read64(hash->buffer + 16));
+        hash->lanes[3] = bbbm_duplicates_hash_round(hash->lanes[3], bbbm_duplicates_read64(hash->buffer + 24));
+        hash->buffered = 0;
+    }
+    /* the lanes do not depend on each other, so the CPU can work on all four at once */
+    for (; length >= 32; data += 32, length -= 32) {
+        hash->lanes[0] = bbbm_duplicates_hash_round(hash->lanes[0], bbbm_duplicates_read64(data));
+        hash->lanes[1] = bbbm_duplicates_hash_round(hash->lanes[1], bbbm_duplicates_read64(data + 8));
+        hash->lanes[2] = bbbm_duplicates_hash_round(hash->lanes[2], bbbm_duplicates_read64(data + 16));
+        hash->lanes[3] = bbbm_duplicates_hash_round(hash->lanes[3], bbbm_duplicates_read64(data + 24));
+    }
+    memcpy(hash->buffer, data, length);
+    hash->buffered = length;
+}
+
+static guint64 bbbm_duplicates_hash_digest(BBBMDuplicatesHash *hash) {
+    guint64 result;
+    const guchar *data = hash->buffer;
+    guint remaining = hash->buffered, i;
+
+    if (hash->length >= 32) {
+        result = ((hash->lanes[0] << 1) | (hash->lanes[0] >> 63)) + ((hash->lanes[1] << 7) | (hash->lanes[1] >> 57))
+               + ((hash->lanes[2] << 12) | (hash->lanes[2] >> 52)) + ((hash->lanes[3] << 18) | (hash->lanes[3] >> 46));
+        for (i = 0; i < 4; ++i) {
+            result ^= bbbm_duplicates_hash_round(0, hash->lanes[i]);
+            result = result * BBBM_DUPLICATES_PRIME1 + BBBM_DUPLICATES_PRIME4;
+        }
+    } else {
+        result = BBBM_DUPLICATES_PRIME5;
+    }
+    result += hash->length;
+
+    for (; remaining >= 8; data += 8, remaining -= 8) {
+        result ^= bbbm_duplicates_hash_round(0, bbbm_duplicates_read64(data));
+        result = ((result << 27) | (result >> 37)) * BBBM_DUPLICATES_PRIME1 + BBBM_DUPLICATES_PRIME4;
+    }
+    if (remaining >= 4) {
+        guint32 value;
+
+        memcpy(&value, data, 4);
+        result ^= (guint64) GUINT32_FROM_LE(value) * BBBM_DUPLICATES_PRIME1;
+        result = ((result << 23) | (result >> 41)) * BBBM_DUPLICATES_PRIME2 + BBBM_DUPLICATES_PRIME3;
+        data += 4;
+        remaining -= 4;
+    }
+    for (; remaining > 0; ++data, --remaining) {
+        result ^= *data * BBBM_DUPLICATES_PRIME5;
+        result = ((result << 11) | (result >> 53)) * BBBM_DUPLICATES_PRIME1;
+    }
+
+    result ^= result >> 33;
+    result *= BBBM_DUPLICATES_PRIME2;
+    result ^= result >> 29;
+    result *= BBBM_DUPLICATES_PRIME3;
+    result ^= result >> 32;
+    return result;
+}
+
+static inline guint64 bbbm_duplicates_hash_round(guint64 lane, guint64 input) {
+    lane += input * BBBM_DUPLICATES_PRIME2;
+    lane = (lane << 31) | (lane >> 33);
+    return lane * BBBM_DUPLICATES_PRIME1;
+}
+
+static inline guint64 bbbm_duplicates_read64(const guchar *data) {
+    guint64 value;
+
+    /* memcpy avoids unaligned access, and compiles to a single load where that is allowed */
+    memcpy(&value, data, 8);
+    return GUINT64_FROM_LE(value);
+}
+
+static void bbbm_duplicates_destroy(BBBMDuplicates *duplicates) {
+    if (duplicates->pool != NULL) {
+        /* files that are still queued are skipped; wait for those being decoded */
+        g_atomic_int_set(&(duplicates->cancelled), TRUE);
+        g_thread_pool_free(duplicates->pool, TRUE, TRUE);
+    }
+    g_strfreev(duplicates->filenames);
+    g_free(duplicates->candidates);
+    g_free(duplicates->hashes);
+    g_free(duplicates->sizes);
+    g_free(duplicates->valid);
+    g_free(duplicates);
+}
@@ -0,0 +1,52 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_DUPLICATES_H_
+#define __BBBM_DUPLICATES_H_
+
+#include <glib.h>
+
+/* the default maximum number of differing bits for two images to be considered similar */
+#define BBBM_DUPLICATES_SIMILAR_THRESHOLD  6
+
+/* A search for duplicate images. Files are examined by worker threads; the result is reported from the main loop */
+typedef struct _BBBMDuplicates BBBMDuplicates;
+
+/* Called from the main loop when the search has finished. The groups list contains one list per group of
+   duplicates, and each of those contains the indexes (GUINT_TO_POINTER) of its files in the searched array, in
+   ascending order. Both are freed after the call */
+typedef void (* bbbm_duplicates_function) (gpointer data, GList *groups);
+
+/* Starts searching the given files for images that look alike, even if they differ in size or encoding.
+   Images whose perceptual hashes differ in at most threshold bits end up in the same group.
+   The returned object is destroyed once the function has been called, unless it is cancelled before that */
+BBBMDuplicates *bbbm_duplicates_find_similar(const gchar **filenames, guint count, guint threshold,
+                                             bbbm_duplicates_function function, gpointer data);
+
+/* Starts searching the given files for byte-identical copies. Files are compared by size first, then by a hash of
+   their first and last blocks, and only files that still have a match are read in full.
+   The returned object is destroyed once the function has been called, unless it is cancelled before that */
+BBBMDuplicates *bbbm_duplicates_find_identical(const gchar **filenames, guint count,
+                                               bbbm_duplicates_function function, gpointer data);
+
+/* Stops the given search and destroys it, without calling its function */
+void bbbm_duplicates_cancel(BBBMDuplicates *duplicates);
+
+#endif /* __BBBM_DUPLICATES_H_ */
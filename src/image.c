@@ -24,11 +24,27 @@
 #include "image.h"
 #include "bbbm.h"
 #include "util.h"
+#include "decoder.h"
 #include "compat.h"
 
+typedef struct {
+    BBBMImage *image;
+    guint width;
+    guint height;
+} BBBMImageDecoding;
+
+typedef struct {
+    GdkPixbuf *pixbuf;
+    gboolean has_metadata;
+    BBBMMetadata metadata;
+} BBBMImageDecoded;
+
 static void bbbm_image_class_init(BBBMImageClass *klass);
 static void bbbm_image_init(BBBMImage *image);
 static void bbbm_image_destroy(GtkObject *object);
+static gpointer bbbm_image_decode(const gchar *filename, BBBMImageDecoding *decoding);
+static void bbbm_image_decoded(BBBMImageDecoding *decoding, BBBMImageDecoded *decoded, BBBMAsyncStatus status);
+static void bbbm_image_free_decoded(BBBMImageDecoded *decoded);
 
 static GtkEventBoxClass *bbbm_image_parent_class = NULL;
 
@@ -66,6 +82,9 @@ static void bbbm_image_init(BBBMImage *image) {
     image->bbbm = NULL;
     image->filename = NULL;
     image->description = NULL;
+    image->loading = FALSE;
+    image->status = BBBM_VALIDATE_OK;
+    image->decoding = NULL;
 }
 
 static void bbbm_image_destroy(GtkObject *object) {
@@ -73,6 +92,15 @@ static void bbbm_image_destroy(GtkObject *object) {
 
     image = BBBM_IMAGE(object);
 
+    if (image->loading) {
+        bbbm_loader_remove(image->bbbm->loader, image);
+        image->loading = FALSE;
+    }
+    if (image->decoding != NULL) {
+        bbbm_async_cancel(image->decoding);
+        image->decoding = NULL;
+    }
+
     g_free(image->filename);
     image->filename = NULL;
 
@@ -93,6 +121,18 @@ GtkWidget *bbbm_image_new(BBBM *bbbm, const gchar *filename, const gchar *descri
     return GTK_WIDGET(image);
 }
 
+GtkWidget *bbbm_image_new_from_thumbnail(BBBM *bbbm, const gchar *filename, const gchar *description,
+                                         GdkPixbuf *thumbnail) {
+    BBBMImage *image;
+
+    image = BBBM_IMAGE(g_object_new(BBBM_TYPE_IMAGE, NULL));
+    image->bbbm = bbbm;
+    image->filename = g_strdup(filename);
+    image->description = g_strdup(description);
+    gtk_image_set_from_pixbuf(GTK_IMAGE(image->image), thumbnail);
+    return GTK_WIDGET(image);
+}
+
 const gchar *bbbm_image_get_filename(BBBMImage *image) {
     g_return_val_if_fail(BBBM_IS_IMAGE(image), NULL);
     return image->filename;
@@ -118,41 +158,49 @@ void bbbm_image_set_description_ref(BBBMImage *image, gchar *description) {
 }
 
 void bbbm_image_resize(BBBMImage *image, guint width, guint height) {
-    GdkPixbuf *pixbuf;
-    GError *error = NULL;
+    BBBMImageDecoding *decoding;
+    const BBBMMetadata *metadata;
 
     g_return_if_fail(BBBM_IS_IMAGE(image));
 
-    /* always get from file, because decreasing size loses information */
-    pixbuf = gdk_pixbuf_new_from_file(image->filename, &error);
-    if (error != NULL) {
-        g_critical("error resizing image '%s': %s", image->filename, error->message);
-        g_error_free(error);
+    if (image->decoding != NULL) {
+        bbbm_async_cancel(image->decoding);
+        image->decoding = NULL;
+    }
+    if (bbbm_options_get_thumb_deferred(image->bbbm->options)) {
+        /* only the index is consulted here; checking the file is left to the loader as well */
+        metadata = bbbm_metadata_index_peek(image->bbbm->metadata, image->filename);
+        gtk_widget_set_size_request(image->image, width, height);
+        bbbm_loader_add(image->bbbm->loader, image, image->filename, width, height,
+                        metadata == NULL || !metadata->has_colors);
+        image->loading = TRUE;
         return;
     }
-    if (width != gdk_pixbuf_get_width(pixbuf) || height != gdk_pixbuf_get_height(pixbuf)) {
-        GdkPixbuf *pb;
-        gint w, h;
-        gfloat wf, hf;
-
-        w = gdk_pixbuf_get_width(pixbuf);
-        h = gdk_pixbuf_get_height(pixbuf);
-        wf = (gfloat)width / w;
-        hf = (gfloat)height / h;
-        if (wf > hf) {
-            /* height = hf * h = height */
-            width = hf * w;
-        } else if (wf < hf) {
-            /* width = wf * w = width */
-            height = wf * h;
-        }
-        /* else do nothing; perfect ratio */
-        pb = gdk_pixbuf_scale_simple(pixbuf, width, height, GDK_INTERP_BILINEAR);
-        g_object_unref(pixbuf);
-        pixbuf = pb;
+
+    decoding = g_malloc(sizeof(BBBMImageDecoding));
+    decoding->image  = image;
+    decoding->width  = width;
+    decoding->height = height;
+    image->decoding = bbbm_async_run(image->filename, BBBM_ASYNC_TIMEOUT, (bbbm_async_function) bbbm_image_decode,
+                                     (bbbm_async_callback) bbbm_image_decoded, decoding, g_free,
+                                     (GDestroyNotify) bbbm_image_free_decoded);
+}
+
+void bbbm_image_set_thumbnail(BBBMImage *image, GdkPixbuf *pixbuf, BBBMValidateStatus status) {
+    g_return_if_fail(BBBM_IS_IMAGE(image));
+
+    image->loading = FALSE;
+    image->status = status;
+    if (pixbuf != NULL) {
+        gtk_image_set_from_pixbuf(GTK_IMAGE(image->image), pixbuf);
+    } else {
+        gtk_image_set_from_stock(GTK_IMAGE(image->image), GTK_STOCK_MISSING_IMAGE, GTK_ICON_SIZE_DIALOG);
     }
-    gtk_image_set_from_pixbuf(GTK_IMAGE(image->image), pixbuf);
-    g_object_unref(pixbuf);
+}
+
+BBBMValidateStatus bbbm_image_get_status(BBBMImage *image) {
+    g_return_val_if_fail(BBBM_IS_IMAGE(image), BBBM_VALIDATE_OK);
+    return image->status;
 }
 
 gint bbbm_image_compare_filename(BBBMImage *image1, BBBMImage *image2) {
@@ -164,3 +212,104 @@ gint bbbm_image_compare_description(BBBMImage *image1, BBBMImage *image2) {
     g_return_val_if_fail(BBBM_IS_IMAGE(image1) && BBBM_IS_IMAGE(image2), 0);
     return strcmp(image1->description, image2->description);
 }
+
+gint bbbm_image_compare_color(BBBMImage *image1, BBBMImage *image2) {
+    const BBBMMetadata *metadata1, *metadata2;
+    gboolean has_colors1, has_colors2;
+
+    g_return_val_if_fail(BBBM_IS_IMAGE(image1) && BBBM_IS_IMAGE(image2), 0);
+    metadata1 = bbbm_metadata_index_peek(image1->bbbm->metadata, image1->filename);
+    metadata2 = bbbm_metadata_index_peek(image2->bbbm->metadata, image2->filename);
+    has_colors1 = metadata1 != NULL && metadata1->has_colors;
+    has_colors2 = metadata2 != NULL && metadata2->has_colors;
+    /* images without colors come first, like images whose size is unknown */
+    if (!has_colors1 || !has_colors2) {
+        return has_colors1 - has_colors2;
+    }
+    return bbbm_color_compare_dominant(&(metadata1->colors), &(metadata2->colors));
+}
+
+gint bbbm_image_compare_brightness(BBBMImage *image1, BBBMImage *image2) {
+    const BBBMMetadata *metadata;
+    gint brightness1 = -1, brightness2 = -1;
+
+    g_return_val_if_fail(BBBM_IS_IMAGE(image1) && BBBM_IS_IMAGE(image2), 0);
+    metadata = bbbm_metadata_index_peek(image1->bbbm->metadata, image1->filename);
+    if (metadata != NULL && metadata->has_colors) {
+        brightness1 = bbbm_color_get_brightness(&(metadata->colors));
+    }
+    metadata = bbbm_metadata_index_peek(image2->bbbm->metadata, image2->filename);
+    if (metadata != NULL && metadata->has_colors) {
+        brightness2 = bbbm_color_get_brightness(&(metadata->colors));
+    }
+    return brightness1 - brightness2;
+}
+
+gint bbbm_image_compare_resolution(BBBMImage *image1, BBBMImage *image2) {
+    const BBBMMetadata *metadata;
+    gint64 pixels1 = -1, pixels2 = -1;
+    gint width1 = -1, width2 = -1;
+
+    g_return_val_if_fail(BBBM_IS_IMAGE(image1) && BBBM_IS_IMAGE(image2), 0);
+    metadata = bbbm_metadata_index_peek(image1->bbbm->metadata, image1->filename);
+    if (metadata != NULL) {
+        pixels1 = (gint64) metadata->width * metadata->height;
+        width1  = metadata->width;
+    }
+    metadata = bbbm_metadata_index_peek(image2->bbbm->metadata, image2->filename);
+    if (metadata != NULL) {
+        pixels2 = (gint64) metadata->width * metadata->height;
+        width2  = metadata->width;
+    }
+    if (pixels1 != pixels2) {
+        return pixels1 < pixels2 ? -1 : 1;
+    }
+    return width1 - width2;
+}
+
+static gpointer bbbm_image_decode(const gchar *filename, BBBMImageDecoding *decoding) {
+    BBBMImageDecoded *decoded;
+
+    decoded = g_malloc(sizeof(BBBMImageDecoded));
+    decoded->has_metadata = bbbm_metadata_read(filename, &(decoded->metadata));
+
+    /* always get from file, because decreasing size loses information; a helper process does it, so a file that
+       crashes the decoder only costs its own thumbnail */
+    decoded->pixbuf = bbbm_decoder_decode(filename, decoding->width, decoding->height);
+    if (decoded->pixbuf == NULL) {
+        return decoded;
+    }
+    if (decoded->has_metadata) {
+        bbbm_metadata_set_colors(&(decoded->metadata), decoded->pixbuf);
+    }
+    return decoded;
+}
+
+static void bbbm_image_decoded(BBBMImageDecoding *decoding, BBBMImageDecoded *decoded, BBBMAsyncStatus status) {
+    BBBMImage *image;
+
+    image = decoding->image;
+    image->decoding = NULL;
+    if (decoded != NULL && decoded->has_metadata) {
+        bbbm_metadata_index_put(image->bbbm->metadata, image->filename, &(decoded->metadata));
+    }
+    gtk_widget_set_size_request(image->image, -1, -1);
+    if (decoded != NULL && decoded->pixbuf != NULL) {
+        bbbm_image_set_thumbnail(image, decoded->pixbuf, BBBM_VALIDATE_OK);
+    } else {
+        if (status == BBBM_ASYNC_TIMED_OUT) {
+            g_warning("gave up decoding '%s'", image->filename);
+        }
+        bbbm_image_set_thumbnail(image, NULL, decoded != NULL ? BBBM_VALIDATE_NOT_AN_IMAGE : BBBM_VALIDATE_UNREADABLE);
+    }
+    if (decoded != NULL) {
+        bbbm_image_free_decoded(decoded);
+    }
+}
+
+static void bbbm_image_free_decoded(BBBMImageDecoded *decoded) {
+    if (decoded->pixbuf != NULL) {
+        g_object_unref(decoded->pixbuf);
+    }
+    g_free(decoded);
+}
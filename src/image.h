@@ -23,6 +23,8 @@
 
 #include <gtk/gtk.h>
 #include "bbbm.h"
+#include "validate.h"
+#include "async.h"
 
 #define BBBM_TYPE_IMAGE             (bbbm_image_get_type())
 #define BBBM_IMAGE(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), BBBM_TYPE_IMAGE, BBBMImage))
@@ -40,6 +42,11 @@ struct _BBBMImage {
     GtkWidget *image;
     gchar *filename;
     gchar *description;
+    /* whether a thumbnail has been requested from the loader, and what it found out about the file */
+    gboolean loading;
+    BBBMValidateStatus status;
+    /* the decoding of the full image when thumbnails are not deferred, or NULL */
+    BBBMAsync *decoding;
 };
 
 struct _BBBMImageClass {
@@ -52,6 +59,10 @@ GType bbbm_image_get_type();
    The returned widget must be destroyed with gtk_widget_destroy when no longer needed */
 GtkWidget *bbbm_image_new(BBBM *bbbm, const gchar *filename, const gchar *description, guint width, guint height);
 
+/* Like bbbm_image_new, but shows the given thumbnail instead of decoding or queueing the file */
+GtkWidget *bbbm_image_new_from_thumbnail(BBBM *bbbm, const gchar *filename, const gchar *description,
+                                         GdkPixbuf *thumbnail);
+
 const gchar *bbbm_image_get_filename(BBBMImage *image);
 
 const gchar *bbbm_image_get_description(BBBMImage *image);
@@ -59,10 +70,30 @@ void bbbm_image_set_description(BBBMImage *image, const gchar *description);
 /* Like bbbm_image_set_description but instead of duplicating the description, a direct reference is used */
 void bbbm_image_set_description_ref(BBBMImage *image, gchar *description);
 
+/* Shows the image at the given size. With deferred thumbs the image is only queued to be loaded in the background,
+   and the area it will take up is reserved until bbbm_image_set_thumbnail is called. Otherwise the whole file is
+   decoded by a worker thread, and a placeholder is shown if that fails or takes too long */
 void bbbm_image_resize(BBBMImage *image, guint width, guint height);
 
+/* Shows the given thumbnail as loaded by the loader, or a placeholder if it is NULL; status tells why */
+void bbbm_image_set_thumbnail(BBBMImage *image, GdkPixbuf *pixbuf, BBBMValidateStatus status);
+
+/* Returns whether the file could be used when its thumbnail was last loaded */
+BBBMValidateStatus bbbm_image_get_status(BBBMImage *image);
+
 gint bbbm_image_compare_filename(BBBMImage *image1, BBBMImage *image2);
 
 gint bbbm_image_compare_description(BBBMImage *image1, BBBMImage *image2);
 
+/* Compares the number of pixels, then the width; images whose size is unknown come first.
+   Only indexed metadata is used, so the images should be looked up in the metadata index first */
+gint bbbm_image_compare_resolution(BBBMImage *image1, BBBMImage *image2);
+
+/* Compares the hue of the dominant colors, with gray images after all others; images without colors come first.
+   Colors are taken from the thumbnails, so no image is decoded for this */
+gint bbbm_image_compare_color(BBBMImage *image1, BBBMImage *image2);
+
+/* Compares the brightness of the average colors; images without colors come first */
+gint bbbm_image_compare_brightness(BBBMImage *image1, BBBMImage *image2);
+
 #endif /* __BBBM_IMAGE_H_ */
@@ -0,0 +1,467 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <unistd.h>
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "config.h"
+#include "import.h"
+#include "collection.h"
+#include "decoder.h"
+#include "util.h"
+#include "compat.h"
+
+/* the number of milliseconds between checks for handled files */
+#define BBBM_IMPORT_POLL          50
+/* the number of files that can be between listing and inserting; this bounds all queues between the stages, and
+   the thumbnails waiting to be inserted behind a file that is held up */
+#define BBBM_IMPORT_WINDOW        256
+/* files handed to the threads of a stage per thread */
+#define BBBM_IMPORT_IN_FLIGHT     2
+/* the number of files inserted per poll, so the main loop keeps handling events */
+#define BBBM_IMPORT_INSERT_BATCH  64
+/* checking files and reading their headers mostly waits for the file system */
+#define BBBM_IMPORT_IO_THREADS    8
+
+typedef struct {
+    /* the public part; filename, source and status are set when listed */
+    BBBMImportItem item;
+    /* the position among all listed files */
+    guint sequence;
+    /* the stage that handles or has handled the task */
+    BBBMImportStage stage;
+    /* the seconds the stage took, written by the worker thread */
+    gdouble busy;
+    /* for directories, archives, collections and image lists, the entries listed by the enumerate stage */
+    GList *entries;
+} BBBMImportTask;
+
+struct _BBBMImport {
+    GThreadPool *pools[BBBM_IMPORT_INSERT];
+    guint max_running[BBBM_IMPORT_INSERT];
+    guint running[BBBM_IMPORT_INSERT];
+    /* tasks waiting for each stage, in the order they were handled by the stage before it */
+    GQueue *waiting[BBBM_IMPORT_INSERT];
+    /* enumerated sources, in order, whose entries have not all been handed to the check stage yet */
+    GQueue *listing;
+    /* sequence -> task, for tasks that are ready to be inserted but follow one that is not */
+    GHashTable *ready;
+    /* the sequence of the next task to list, and of the next task to insert */
+    guint next_sequence;
+    guint next_insert;
+    /* tasks that have been handled by any stage, pushed by the worker threads */
+    GAsyncQueue *handled;
+    guint poll_id;
+    gint cancelled;
+    /* the main loop, and each task handed to the threads; whichever is done last frees the import */
+    gint users;
+    gboolean decode;
+    guint width;
+    guint height;
+    GTimer *timer;
+    BBBMImportProgress progress;
+    bbbm_import_function function;
+    gpointer data;
+};
+
+static void bbbm_import_start(BBBMImport *import);
+static void bbbm_import_work(BBBMImportTask *task, BBBMImport *import);
+static void bbbm_import_run(BBBMImportTask *task, BBBMImport *import);
+static void bbbm_import_enumerate(BBBMImportTask *task);
+static gboolean bbbm_import_poll(BBBMImport *import);
+static void bbbm_import_handled(BBBMImport *import, BBBMImportTask *task);
+static void bbbm_import_list(BBBMImport *import, BBBMImportTask *source);
+static void bbbm_import_refill(BBBMImport *import);
+static inline gboolean bbbm_import_window_full(BBBMImport *import);
+static gboolean bbbm_import_insert(BBBMImport *import);
+static void bbbm_import_destroy(BBBMImport *import);
+static void bbbm_import_unref(BBBMImport *import);
+static void bbbm_import_free_task(BBBMImportTask *task);
+
+BBBMImport *bbbm_import_new(const gchar **filenames, guint count, BBBMImportSource source, guint width,
+                            guint height, bbbm_import_function function, gpointer data) {
+    BBBMImport *import;
+    GError *error = NULL;
+    guint threads[BBBM_IMPORT_INSERT];
+    guint i;
+
+    g_return_val_if_fail(filenames != NULL || count == 0, NULL);
+    g_return_val_if_fail(function != NULL, NULL);
+
+    /* sources are listed one at a time, so their files keep their order */
+    threads[BBBM_IMPORT_ENUMERATE] = 1;
+    threads[BBBM_IMPORT_CHECK]     = BBBM_IMPORT_IO_THREADS;
+    threads[BBBM_IMPORT_METADATA]  = BBBM_IMPORT_IO_THREADS;
+    threads[BBBM_IMPORT_DECODE]    = bbbm_util_get_cpu_threads();
+
+    import = g_malloc0(sizeof(BBBMImport));
+    import->users = 1;
+    for (i = 0; i < BBBM_IMPORT_INSERT; ++i) {
+        import->waiting[i] = g_queue_new();
+        import->max_running[i] = i == BBBM_IMPORT_ENUMERATE ? 1 : threads[i] * BBBM_IMPORT_IN_FLIGHT;
+        if (i == BBBM_IMPORT_DECODE && (width == 0 || height == 0)) {
+            /* no thumbnails are asked for */
+            continue;
+        }
+        import->pools[i] = g_thread_pool_new((GFunc) bbbm_import_work, import, threads[i], FALSE, &error);
+        if (import->pools[i] == NULL) {
+            /* tasks of the stage are then handled from the main loop, one per poll */
+            g_warning("could not create threads to import files: %s", error->message);
+            g_error_free(error);
+            error = NULL;
+            import->max_running[i] = 1;
+        }
+    }
+    import->listing  = g_queue_new();
+    import->ready    = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                             (GDestroyNotify) bbbm_import_free_task);
+    import->handled  = g_async_queue_new();
+    import->decode   = width > 0 && height > 0;
+    import->width    = width;
+    import->height   = height;
+    import->timer    = g_timer_new();
+    import->function = function;
+    import->data     = data;
+
+    for (i = 0; i < count; ++i) {
+        BBBMImportTask *task = g_malloc0(sizeof(BBBMImportTask));
+
+        task->item.filename = g_strdup(filenames[i]);
+        task->item.source   = source;
+        task->stage         = BBBM_IMPORT_ENUMERATE;
+        g_queue_push_tail(import->waiting[BBBM_IMPORT_ENUMERATE], task);
+    }
+    bbbm_import_start(import);
+    import->poll_id = g_timeout_add(BBBM_IMPORT_POLL, (GSourceFunc) bbbm_import_poll, import);
+    return import;
+}
+
+void bbbm_import_get_progress(BBBMImport *import, BBBMImportProgress *progress) {
+    g_return_if_fail(import != NULL);
+    g_return_if_fail(progress != NULL);
+
+    *progress = import->progress;
+    progress->elapsed = g_timer_elapsed(import->timer, NULL);
+}
+
+const gchar *bbbm_import_stage_to_string(BBBMImportStage stage) {
+    switch (stage) {
+        case BBBM_IMPORT_ENUMERATE:
+            return "Listed";
+        case BBBM_IMPORT_CHECK:
+            return "Checked";
+        case BBBM_IMPORT_METADATA:
+            return "Read";
+        case BBBM_IMPORT_DECODE:
+            return "Decoded";
+        case BBBM_IMPORT_INSERT:
+            return "Added";
+        default:
+            return "";
+    }
+}
+
+void bbbm_import_cancel(BBBMImport *import) {
+    g_return_if_fail(import != NULL);
+
+    /* tasks that have been handed to the threads already are skipped, and the threads that are busy are not waited
+       for; a hung file system would block the main loop otherwise */
+    g_atomic_int_set(&(import->cancelled), TRUE);
+    bbbm_import_destroy(import);
+}
+
+static void bbbm_import_start(BBBMImport *import) {
+    guint stage;
+
+    /* the later stages first, so files that are almost done are not held up by new ones */
+    for (stage = BBBM_IMPORT_INSERT; stage > 0; --stage) {
+        GQueue *waiting = import->waiting[stage - 1];
+
+        /* listing stops while the entries of the sources listed so far fill the window */
+        if (stage - 1 == BBBM_IMPORT_ENUMERATE && (bbbm_import_window_full(import)
+                                                   || !g_queue_is_empty(import->listing))) {
+            continue;
+        }
+        while (import->pools[stage - 1] != NULL && import->running[stage - 1] < import->max_running[stage - 1]
+                && !g_queue_is_empty(waiting)) {
+            ++import->running[stage - 1];
+            g_atomic_int_inc(&(import->users));
+            g_thread_pool_push(import->pools[stage - 1], g_queue_pop_head(waiting), NULL);
+        }
+    }
+}
+
+static void bbbm_import_work(BBBMImportTask *task, BBBMImport *import) {
+    bbbm_import_run(task, import);
+    bbbm_import_unref(import);
+}
+
+static void bbbm_import_run(BBBMImportTask *task, BBBMImport *import) {
+    GTimer *timer;
+
+    if (g_atomic_int_get(&(import->cancelled))) {
+        g_async_queue_push(import->handled, task);
+        return;
+    }
+    timer = g_timer_new();
+    switch (task->stage) {
+        case BBBM_IMPORT_ENUMERATE:
+            bbbm_import_enumerate(task);
+            break;
+        case BBBM_IMPORT_CHECK:
+            task->item.status = bbbm_validate_file(task->item.filename);
+            break;
+        case BBBM_IMPORT_METADATA:
+            task->item.has_metadata = bbbm_metadata_read(task->item.filename, &(task->item.metadata));
+            break;
+        case BBBM_IMPORT_DECODE:
+            task->item.thumbnail = bbbm_decoder_decode(task->item.filename, import->width, import->height);
+            if (task->item.thumbnail == NULL) {
+                task->item.status = BBBM_VALIDATE_NOT_AN_IMAGE;
+            } else if (task->item.has_metadata) {
+                bbbm_metadata_set_colors(&(task->item.metadata), task->item.thumbnail);
+            }
+            break;
+        default:
+            break;
+    }
+    task->busy = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+    g_async_queue_push(import->handled, task);
+}
+
+static void bbbm_import_enumerate(BBBMImportTask *task) {
+    GList *files, *iterator;
+
+    switch (task->item.source) {
+        case BBBM_IMPORT_IMAGE:
+            task->entries = g_list_append(NULL, bbbm_collection_entry_new(task->item.filename, NULL));
+            task->item.status = BBBM_VALIDATE_OK;
+            break;
+        case BBBM_IMPORT_DIRECTORY:
+            files = bbbm_util_listdir(task->item.filename);
+            for (iterator = files; iterator != NULL; iterator = iterator->next) {
+                /* other files are left out silently, like when adding images one by one */
+                if (bbbm_util_has_image_ext((gchar *) iterator->data)) {
+                    task->entries = g_list_prepend(task->entries,
+                                                   bbbm_collection_entry_new((gchar *) iterator->data, NULL));
+                }
+                g_free(iterator->data);
+            }
+            g_list_free(files);
+            task->entries = g_list_reverse(task->entries);
+            task->item.status = files != NULL ? BBBM_VALIDATE_OK : bbbm_validate_file(task->item.filename);
+            if (task->item.status == BBBM_VALIDATE_NOT_AN_IMAGE) {
+                /* an empty directory, or an archive without images */
+                task->item.status = BBBM_VALIDATE_OK;
+            }
+            break;
+        case BBBM_IMPORT_COLLECTION:
+        case BBBM_IMPORT_IMAGE_LIST:
+            /* the files are checked by the next stage, not all at once */
+            if (!bbbm_collection_read_all(task->item.filename, task->item.source == BBBM_IMPORT_IMAGE_LIST, FALSE,
+                                          &(task->entries))) {
+                task->item.status = BBBM_VALIDATE_UNREADABLE;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static gboolean bbbm_import_poll(BBBMImport *import) {
+    BBBMImportTask *task;
+    guint stage;
+
+    for (stage = 0; stage < BBBM_IMPORT_INSERT; ++stage) {
+        if (import->pools[stage] == NULL && !g_queue_is_empty(import->waiting[stage])
+                && (stage != BBBM_IMPORT_ENUMERATE
+                    || (!bbbm_import_window_full(import) && g_queue_is_empty(import->listing)))) {
+            task = (BBBMImportTask *) g_queue_pop_head(import->waiting[stage]);
+            ++import->running[stage];
+            bbbm_import_run(task, import);
+        }
+    }
+    while ((task = (BBBMImportTask *) g_async_queue_try_pop(import->handled)) != NULL) {
+        bbbm_import_handled(import, task);
+    }
+    if (!bbbm_import_insert(import)) {
+        import->poll_id = 0;
+        bbbm_import_destroy(import);
+        return FALSE;
+    }
+    /* inserting made room in the window */
+    bbbm_import_refill(import);
+    bbbm_import_start(import);
+    return TRUE;
+}
+
+static void bbbm_import_handled(BBBMImport *import, BBBMImportTask *task) {
+    BBBMImportStage next;
+
+    --import->running[task->stage];
+    ++import->progress.done[task->stage];
+    import->progress.busy[task->stage] += task->busy;
+
+    if (task->stage == BBBM_IMPORT_ENUMERATE) {
+        bbbm_import_list(import, task);
+        return;
+    }
+    next = task->stage + 1;
+    /* files that cannot be used need no more work, and neither do thumbnails that are not asked for */
+    if (task->item.status != BBBM_VALIDATE_OK || (next == BBBM_IMPORT_DECODE && !import->decode)) {
+        next = BBBM_IMPORT_INSERT;
+    }
+    task->stage = next;
+    if (next == BBBM_IMPORT_INSERT) {
+        g_hash_table_insert(import->ready, GUINT_TO_POINTER(task->sequence), task);
+    } else {
+        g_queue_push_tail(import->waiting[next], task);
+    }
+}
+
+static void bbbm_import_list(BBBMImport *import, BBBMImportTask *source) {
+    /* a source that could not be read is handed back as it is, so it can be reported; it keeps its place */
+    import->progress.total += source->item.status != BBBM_VALIDATE_OK ? 1 : g_list_length(source->entries);
+    g_queue_push_tail(import->listing, source);
+    bbbm_import_refill(import);
+}
+
+static void bbbm_import_refill(BBBMImport *import) {
+    BBBMImportTask *source;
+
+    /* a single directory can hold any number of files; only as many as fit in the window are handed on, so the
+       decoded thumbnails that wait behind a file that is held up are bounded as well */
+    while (!bbbm_import_window_full(import) && (source = g_queue_peek_head(import->listing)) != NULL) {
+        if (source->item.status != BBBM_VALIDATE_OK) {
+            g_queue_pop_head(import->listing);
+            source->item.is_source = TRUE;
+            source->sequence = import->next_sequence++;
+            source->stage = BBBM_IMPORT_INSERT;
+            g_hash_table_insert(import->ready, GUINT_TO_POINTER(source->sequence), source);
+        } else if (source->entries == NULL) {
+            g_queue_pop_head(import->listing);
+            bbbm_import_free_task(source);
+        } else {
+            BBBMCollectionEntry *entry = (BBBMCollectionEntry *) source->entries->data;
+            BBBMImportTask *task = g_malloc0(sizeof(BBBMImportTask));
+
+            task->item.filename    = g_strdup(entry->filename);
+            task->item.description = g_strdup(entry->description);
+            task->item.source      = source->item.source;
+            task->sequence         = import->next_sequence++;
+            task->stage            = BBBM_IMPORT_CHECK;
+            g_queue_push_tail(import->waiting[BBBM_IMPORT_CHECK], task);
+            bbbm_collection_entry_destroy(entry);
+            source->entries = g_list_delete_link(source->entries, source->entries);
+        }
+    }
+}
+
+static inline gboolean bbbm_import_window_full(BBBMImport *import) {
+    return import->next_sequence - import->next_insert >= BBBM_IMPORT_WINDOW;
+}
+
+static gboolean bbbm_import_insert(BBBMImport *import) {
+    BBBMImportTask *task;
+    GList *items = NULL, *tasks = NULL, *iterator;
+    GTimer *timer;
+    gboolean finished;
+    guint stage, count = 0;
+
+    /* only in order; a file that is still being handled holds up the ones after it */
+    while (count < BBBM_IMPORT_INSERT_BATCH
+            && (task = g_hash_table_lookup(import->ready, GUINT_TO_POINTER(import->next_insert))) != NULL) {
+        g_hash_table_steal(import->ready, GUINT_TO_POINTER(import->next_insert));
+        ++import->next_insert;
+        ++count;
+        tasks = g_list_prepend(tasks, task);
+        items = g_list_prepend(items, &(task->item));
+    }
+    items = g_list_reverse(items);
+    tasks = g_list_reverse(tasks);
+
+    finished = import->next_insert == import->next_sequence && g_queue_is_empty(import->listing);
+    for (stage = 0; stage < BBBM_IMPORT_INSERT && finished; ++stage) {
+        finished = import->running[stage] == 0 && g_queue_is_empty(import->waiting[stage]);
+    }
+
+    timer = g_timer_new();
+    import->progress.done[BBBM_IMPORT_INSERT] += count;
+    import->function(import->data, items, finished);
+    import->progress.busy[BBBM_IMPORT_INSERT] += g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+
+    for (iterator = tasks; iterator != NULL; iterator = iterator->next) {
+        bbbm_import_free_task((BBBMImportTask *) iterator->data);
+    }
+    g_list_free(tasks);
+    g_list_free(items);
+    return !finished;
+}
+
+static void bbbm_import_destroy(BBBMImport *import) {
+    BBBMImportTask *task;
+    guint stage;
+
+    if (import->poll_id != 0) {
+        g_source_remove(import->poll_id);
+    }
+    for (stage = 0; stage < BBBM_IMPORT_INSERT; ++stage) {
+        if (import->pools[stage] != NULL) {
+            /* the tasks in the pool are still run, to release their hold on the import, but skip their work */
+            g_thread_pool_free(import->pools[stage], FALSE, FALSE);
+        }
+        while ((task = (BBBMImportTask *) g_queue_pop_head(import->waiting[stage])) != NULL) {
+            bbbm_import_free_task(task);
+        }
+        g_queue_free(import->waiting[stage]);
+    }
+    while ((task = (BBBMImportTask *) g_queue_pop_head(import->listing)) != NULL) {
+        bbbm_import_free_task(task);
+    }
+    g_queue_free(import->listing);
+    g_hash_table_destroy(import->ready);
+    g_timer_destroy(import->timer);
+    bbbm_import_unref(import);
+}
+
+static void bbbm_import_unref(BBBMImport *import) {
+    BBBMImportTask *task;
+
+    if (!g_atomic_int_dec_and_test(&(import->users))) {
+        return;
+    }
+    while ((task = (BBBMImportTask *) g_async_queue_try_pop(import->handled)) != NULL) {
+        bbbm_import_free_task(task);
+    }
+    g_async_queue_unref(import->handled);
+    g_free(import);
+}
+
+static void bbbm_import_free_task(BBBMImportTask *task) {
+    if (task->item.thumbnail != NULL) {
+        g_object_unref(task->item.thumbnail);
+    }
+    g_free(task->item.filename);
+    g_free(task->item.description);
+    bbbm_collection_free(task->entries);
+    g_free(task);
+}
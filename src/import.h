@@ -0,0 +1,104 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_IMPORT_H_
+#define __BBBM_IMPORT_H_
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "metadata.h"
+#include "validate.h"
+
+/* An import of images, directories, archives, collections and image lists. Each file passes through a number of
+   stages, each with its own worker threads; a fast stage stops being fed while the queue to the next one is full,
+   so memory use does not grow with the number of files. The results are handed back from the main loop, in the
+   order the files were given or listed */
+typedef struct _BBBMImport BBBMImport;
+
+typedef enum {
+    /* a single image file */
+    BBBM_IMPORT_IMAGE,
+    /* all images in a directory or archive */
+    BBBM_IMPORT_DIRECTORY,
+    BBBM_IMPORT_COLLECTION,
+    BBBM_IMPORT_IMAGE_LIST
+} BBBMImportSource;
+
+typedef enum {
+    /* lists the files of directories, archives, collections and image lists */
+    BBBM_IMPORT_ENUMERATE,
+    /* checks whether each file exists and is an image */
+    BBBM_IMPORT_CHECK,
+    /* reads the size and format from the header of each file */
+    BBBM_IMPORT_METADATA,
+    /* decodes the thumbnails; skipped if no thumbnail size is given */
+    BBBM_IMPORT_DECODE,
+    /* hands the files back to the main loop */
+    BBBM_IMPORT_INSERT,
+    BBBM_IMPORT_STAGES
+} BBBMImportStage;
+
+/* A file that has passed through all stages */
+typedef struct {
+    /* TRUE for a directory, archive, collection or image list that could not be read, instead of a file in it */
+    gboolean is_source;
+    gchar *filename;
+    /* the description from the collection, or NULL */
+    gchar *description;
+    /* what the file was listed by */
+    BBBMImportSource source;
+    BBBMValidateStatus status;
+    gboolean has_metadata;
+    BBBMMetadata metadata;
+    /* the decoded thumbnail, or NULL if no thumbnail size was given or it could not be decoded */
+    GdkPixbuf *thumbnail;
+} BBBMImportItem;
+
+/* The number of files each stage has handled so far, and how long its threads have been busy with them */
+typedef struct {
+    guint done[BBBM_IMPORT_STAGES];
+    gdouble busy[BBBM_IMPORT_STAGES];
+    /* the number of files listed so far, and the time since the import started */
+    guint total;
+    gdouble elapsed;
+} BBBMImportProgress;
+
+/* Called from the main loop whenever the import has made progress. The items list contains the files that are
+   ready to be inserted, and may be NULL; it and its elements are freed after the call. finished is TRUE for the
+   last call, after which the import is destroyed */
+typedef void (* bbbm_import_function) (gpointer data, GList *items, gboolean finished);
+
+/* Starts importing the given files, which are all of the given source. If width and height are positive the
+   thumbnails are decoded at that size as well, keeping their aspect ratio.
+   The returned object is destroyed after the last call of the function, unless it is cancelled before that */
+BBBMImport *bbbm_import_new(const gchar **filenames, guint count, BBBMImportSource source, guint width,
+                            guint height, bbbm_import_function function, gpointer data);
+
+/* Stores the progress of the given import */
+void bbbm_import_get_progress(BBBMImport *import, BBBMImportProgress *progress);
+
+/* Returns a short name of the given stage, such as "Checked" */
+const gchar *bbbm_import_stage_to_string(BBBMImportStage stage);
+
+/* Stops the given import and destroys it, without calling its function again. Files that have been handed back
+   already are not affected */
+void bbbm_import_cancel(BBBMImport *import);
+
+#endif /* __BBBM_IMPORT_H_ */
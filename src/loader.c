@@ -0,0 +1,473 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "config.h"
+#if HAVE_LINUX_FIEMAP_H == 1
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#endif
+#include "loader.h"
+#include "archive.h"
+#include "decoder.h"
+#include "util.h"
+#include "compat.h"
+
+/* the number of milliseconds between checks for handled requests */
+#define BBBM_LOADER_POLL       50
+/* requests handed to the threads per thread; more keep them busy between polls, fewer keep the queue reorderable */
+#define BBBM_LOADER_IN_FLIGHT  2
+/* the number of located requests to choose from; more means fewer seeks, but a longer wait before decoding starts */
+#define BBBM_LOADER_SWEEP      128
+/* set in the locations of files whose physical position is not known, which are sorted by inode instead. Inode
+   numbers and byte offsets cannot be compared, so these files come after the others on the same device */
+#define BBBM_LOADER_BY_INODE   (G_GUINT64_CONSTANT(1) << 63)
+
+typedef struct {
+    gpointer key;
+    gchar *filename;
+    guint width;
+    guint height;
+    gboolean read_metadata;
+    /* the queue the request is waiting in and its link in there, or NULL once handed to the threads */
+    GQueue *queue;
+    GList *link;
+    /* set if the request was removed or replaced while it was being handled */
+    gboolean dropped;
+    /* set if the request was moved to the front; it is then decoded right away, instead of in disk order */
+    gboolean prioritized;
+    /* another file to read ahead while this one is decoded, or NULL */
+    gchar *readahead;
+    /* whether a thread has checked the file and found where it is stored, and whether it is done with it */
+    gboolean located;
+    gboolean handled;
+    guint64 device;
+    guint64 location;
+    /* the results, written by the worker thread */
+    GdkPixbuf *pixbuf;
+    BBBMValidateStatus status;
+    gboolean has_metadata;
+    BBBMMetadata metadata;
+} BBBMLoaderRequest;
+
+struct _BBBMLoader {
+    /* prioritized requests, and requests that have not been located yet, in the order they are handled */
+    GQueue *waiting;
+    /* located requests, in disk order: those at or after the current position, and those before it. Reading them
+       in one direction only, and starting over once the end is reached, keeps seeks short */
+    GQueue *ahead;
+    GQueue *behind;
+    guint64 device;
+    guint64 location;
+    /* key -> request, for requests that are waiting or being handled */
+    GHashTable *requests;
+    GThreadPool *pool;
+    guint max_running;
+    guint running;
+    /* requests that have been handled, pushed by the worker threads */
+    GAsyncQueue *handled;
+    guint poll_id;
+    bbbm_loader_function function;
+    gpointer data;
+};
+
+static void bbbm_loader_start(BBBMLoader *loader);
+static BBBMLoaderRequest *bbbm_loader_next(BBBMLoader *loader);
+static void bbbm_loader_run(BBBMLoaderRequest *request, BBBMLoader *loader);
+static void bbbm_loader_locate(BBBMLoaderRequest *request);
+static void bbbm_loader_read_ahead(const gchar *filename);
+static void bbbm_loader_insert_located(BBBMLoader *loader, BBBMLoaderRequest *request);
+static inline gint bbbm_loader_compare_location(guint64 device1, guint64 location1, guint64 device2,
+                                                guint64 location2);
+static gboolean bbbm_loader_poll(BBBMLoader *loader);
+static void bbbm_loader_free_request(BBBMLoaderRequest *request);
+
+BBBMLoader *bbbm_loader_new(bbbm_loader_function function, gpointer data) {
+    BBBMLoader *loader;
+    GError *error = NULL;
+    gint threads;
+
+    g_return_val_if_fail(function != NULL, NULL);
+
+    loader = g_malloc(sizeof(BBBMLoader));
+    loader->waiting  = g_queue_new();
+    loader->ahead    = g_queue_new();
+    loader->behind   = g_queue_new();
+    loader->device   = 0;
+    loader->location = 0;
+    loader->requests = g_hash_table_new(g_direct_hash, g_direct_equal);
+    loader->running  = 0;
+    loader->handled  = g_async_queue_new();
+    loader->poll_id  = 0;
+    loader->function = function;
+    loader->data     = data;
+
+    threads = bbbm_util_get_cpu_threads();
+    loader->max_running = threads * BBBM_LOADER_IN_FLIGHT;
+    loader->pool = g_thread_pool_new((GFunc) bbbm_loader_run, loader, threads, FALSE, &error);
+    if (loader->pool == NULL) {
+        /* requests are then handled from the main loop, one per poll */
+        g_warning("could not create threads to load thumbnails: %s", error->message);
+        g_error_free(error);
+        loader->max_running = 1;
+    }
+    return loader;
+}
+
+void bbbm_loader_add(BBBMLoader *loader, gpointer key, const gchar *filename, guint width, guint height,
+                     gboolean read_metadata) {
+    BBBMLoaderRequest *request;
+
+    g_return_if_fail(loader != NULL);
+    g_return_if_fail(filename != NULL);
+
+    request = (BBBMLoaderRequest *) g_hash_table_lookup(loader->requests, key);
+    if (request != NULL && request->link != NULL) {
+        /* still waiting; keep its place in the queue, unless it was located for another file */
+        if (request->located && strcmp(request->filename, filename) != 0) {
+            g_queue_delete_link(request->queue, request->link);
+            request->located = FALSE;
+            request->queue = loader->waiting;
+            g_queue_push_tail(loader->waiting, request);
+            request->link = g_queue_peek_tail_link(loader->waiting);
+        }
+        g_free(request->filename);
+        request->filename       = g_strdup(filename);
+        request->width          = width;
+        request->height         = height;
+        request->read_metadata  = read_metadata;
+        return;
+    }
+    if (request != NULL) {
+        /* its result is already outdated */
+        request->dropped = TRUE;
+    }
+
+    request = g_malloc(sizeof(BBBMLoaderRequest));
+    request->key            = key;
+    request->filename       = g_strdup(filename);
+    request->width          = width;
+    request->height         = height;
+    request->read_metadata  = read_metadata;
+    request->has_metadata   = FALSE;
+    request->dropped        = FALSE;
+    request->prioritized    = FALSE;
+    request->readahead      = NULL;
+    request->located        = FALSE;
+    request->handled        = FALSE;
+    request->pixbuf         = NULL;
+    request->status         = BBBM_VALIDATE_OK;
+    request->queue          = loader->waiting;
+    g_queue_push_tail(loader->waiting, request);
+    request->link = g_queue_peek_tail_link(loader->waiting);
+    g_hash_table_insert(loader->requests, key, request);
+
+    bbbm_loader_start(loader);
+}
+
+void bbbm_loader_prioritize(BBBMLoader *loader, gpointer key) {
+    BBBMLoaderRequest *request;
+
+    g_return_if_fail(loader != NULL);
+
+    request = (BBBMLoaderRequest *) g_hash_table_lookup(loader->requests, key);
+    if (request != NULL && request->link != NULL) {
+        /* visible thumbnails come first, wherever they are stored */
+        g_queue_unlink(request->queue, request->link);
+        g_queue_push_head_link(loader->waiting, request->link);
+        request->queue = loader->waiting;
+        request->prioritized = TRUE;
+    }
+}
+
+void bbbm_loader_remove(BBBMLoader *loader, gpointer key) {
+    BBBMLoaderRequest *request;
+
+    g_return_if_fail(loader != NULL);
+
+    request = (BBBMLoaderRequest *) g_hash_table_lookup(loader->requests, key);
+    if (request == NULL) {
+        return;
+    }
+    g_hash_table_remove(loader->requests, key);
+    if (request->link != NULL) {
+        g_queue_delete_link(request->queue, request->link);
+        bbbm_loader_free_request(request);
+    } else {
+        /* being handled; it is freed when it comes back */
+        request->dropped = TRUE;
+    }
+}
+
+guint bbbm_loader_get_pending_count(BBBMLoader *loader) {
+    g_return_val_if_fail(loader != NULL, 0);
+    return g_hash_table_size(loader->requests);
+}
+
+void bbbm_loader_destroy(BBBMLoader *loader) {
+    BBBMLoaderRequest *request;
+
+    g_return_if_fail(loader != NULL);
+
+    if (loader->poll_id != 0) {
+        g_source_remove(loader->poll_id);
+    }
+    while ((request = (BBBMLoaderRequest *) g_queue_pop_head(loader->waiting)) != NULL) {
+        bbbm_loader_free_request(request);
+    }
+    while ((request = (BBBMLoaderRequest *) g_queue_pop_head(loader->ahead)) != NULL) {
+        bbbm_loader_free_request(request);
+    }
+    while ((request = (BBBMLoaderRequest *) g_queue_pop_head(loader->behind)) != NULL) {
+        bbbm_loader_free_request(request);
+    }
+    if (loader->pool != NULL) {
+        /* only a few requests are handed to the threads at a time, so finishing them does not take long */
+        g_thread_pool_free(loader->pool, FALSE, TRUE);
+    }
+    while ((request = (BBBMLoaderRequest *) g_async_queue_try_pop(loader->handled)) != NULL) {
+        bbbm_loader_free_request(request);
+    }
+    g_async_queue_unref(loader->handled);
+    g_queue_free(loader->waiting);
+    g_queue_free(loader->ahead);
+    g_queue_free(loader->behind);
+    g_hash_table_destroy(loader->requests);
+    g_free(loader);
+}
+
+static void bbbm_loader_start(BBBMLoader *loader) {
+    BBBMLoaderRequest *request;
+
+    if (loader->pool != NULL) {
+        while (loader->running < loader->max_running && (request = bbbm_loader_next(loader)) != NULL) {
+            ++loader->running;
+            g_thread_pool_push(loader->pool, request, NULL);
+        }
+    }
+    if (loader->poll_id == 0 && (loader->running != 0 || !g_queue_is_empty(loader->waiting)
+                                 || !g_queue_is_empty(loader->ahead) || !g_queue_is_empty(loader->behind))) {
+        loader->poll_id = g_timeout_add(BBBM_LOADER_POLL, (GSourceFunc) bbbm_loader_poll, loader);
+    }
+}
+
+static BBBMLoaderRequest *bbbm_loader_next(BBBMLoader *loader) {
+    BBBMLoaderRequest *request, *next;
+
+    request = (BBBMLoaderRequest *) g_queue_peek_head(loader->waiting);
+    /* locate enough requests to choose from first, but never let them hold up prioritized ones */
+    if (request != NULL
+            && (request->prioritized || g_queue_get_length(loader->ahead) + g_queue_get_length(loader->behind)
+                                        < BBBM_LOADER_SWEEP)) {
+        g_queue_pop_head(loader->waiting);
+    } else {
+        if (g_queue_is_empty(loader->ahead)) {
+            /* the end has been reached; start over from the first one */
+            GQueue *queue = loader->ahead;
+
+            loader->ahead  = loader->behind;
+            loader->behind = queue;
+        }
+        next = (BBBMLoaderRequest *) g_queue_pop_head(loader->ahead);
+        if (next != NULL) {
+            request = next;
+            loader->device   = request->device;
+            loader->location = request->location;
+            /* the next one can be read from disk while this one is decoded */
+            next = (BBBMLoaderRequest *) g_queue_peek_head(loader->ahead);
+            g_free(request->readahead);
+            request->readahead = next != NULL ? g_strdup(next->filename) : NULL;
+        } else if (request != NULL) {
+            g_queue_pop_head(loader->waiting);
+        }
+    }
+    if (request != NULL) {
+        request->queue = NULL;
+        request->link  = NULL;
+    }
+    return request;
+}
+
+static void bbbm_loader_run(BBBMLoaderRequest *request, BBBMLoader *loader) {
+    if (!request->located) {
+        request->status = bbbm_validate_file(request->filename);
+        if (request->status != BBBM_VALIDATE_OK) {
+            request->handled = TRUE;
+            g_async_queue_push(loader->handled, request);
+            return;
+        }
+        if (!request->prioritized) {
+            /* it is decoded once its turn comes in disk order */
+            bbbm_loader_locate(request);
+            g_async_queue_push(loader->handled, request);
+            return;
+        }
+    }
+    if (request->readahead != NULL) {
+        bbbm_loader_read_ahead(request->readahead);
+    }
+    if (request->read_metadata) {
+        request->has_metadata = bbbm_metadata_read(request->filename, &(request->metadata));
+    }
+    request->pixbuf = bbbm_decoder_decode(request->filename, request->width, request->height);
+    if (request->pixbuf == NULL) {
+        request->status = BBBM_VALIDATE_NOT_AN_IMAGE;
+        request->has_metadata = FALSE;
+    } else if (request->has_metadata) {
+        bbbm_metadata_set_colors(&(request->metadata), request->pixbuf);
+    }
+    request->handled = TRUE;
+    g_async_queue_push(loader->handled, request);
+}
+
+static void bbbm_loader_locate(BBBMLoaderRequest *request) {
+    struct stat info;
+    int fd;
+
+    request->located  = TRUE;
+    request->device   = 0;
+    request->location = 0;
+    /* archive members cannot be opened; they all end up at the front */
+    fd = open(request->filename, O_RDONLY);
+    if (fd == -1) {
+        return;
+    }
+    if (fstat(fd, &info) == 0) {
+        /* inodes are allocated close to their data on most file systems, and it costs nothing more to find */
+        request->device   = info.st_dev;
+        request->location = (guint64) info.st_ino | BBBM_LOADER_BY_INODE;
+    }
+#if HAVE_LINUX_FIEMAP_H == 1
+    {
+        /* the physical position of the first extent, if the file system can tell; not for empty files, files that
+           are stored inline, or files whose data has not been allocated yet */
+        struct {
+            struct fiemap map;
+            struct fiemap_extent extent;
+        } extents;
+
+        memset(&extents, 0, sizeof(extents));
+        extents.map.fm_start        = 0;
+        extents.map.fm_length       = FIEMAP_MAX_OFFSET;
+        extents.map.fm_extent_count = 1;
+        if (ioctl(fd, FS_IOC_FIEMAP, &extents) == 0 && extents.map.fm_mapped_extents > 0
+                && (extents.extent.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE)) == 0) {
+            request->location = extents.extent.fe_physical;
+        }
+    }
+#endif
+    close(fd);
+}
+
+static void bbbm_loader_read_ahead(const gchar *filename) {
+#if HAVE_POSIX_FADVISE == 1
+    int fd;
+
+    /* only a hint; the kernel starts reading in the background, and the file is closed right away */
+    fd = open(filename, O_RDONLY);
+    if (fd != -1) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+#endif
+}
+
+static void bbbm_loader_insert_located(BBBMLoader *loader, BBBMLoaderRequest *request) {
+    GQueue *queue;
+    GList *sibling;
+
+    /* requests that are already behind the current position wait for the next pass */
+    if (bbbm_loader_compare_location(request->device, request->location, loader->device, loader->location) >= 0) {
+        queue = loader->ahead;
+    } else {
+        queue = loader->behind;
+    }
+    /* files are mostly located in the order they are stored, so search from the end */
+    for (sibling = g_queue_peek_tail_link(queue); sibling != NULL; sibling = sibling->prev) {
+        BBBMLoaderRequest *other = (BBBMLoaderRequest *) sibling->data;
+
+        if (bbbm_loader_compare_location(other->device, other->location, request->device, request->location) <= 0) {
+            break;
+        }
+    }
+    if (sibling == NULL) {
+        g_queue_push_head(queue, request);
+        request->link = g_queue_peek_head_link(queue);
+    } else {
+        g_queue_insert_after(queue, sibling, request);
+        request->link = sibling->next;
+    }
+    request->queue = queue;
+}
+
+static inline gint bbbm_loader_compare_location(guint64 device1, guint64 location1, guint64 device2,
+                                                guint64 location2) {
+    if (device1 != device2) {
+        return device1 < device2 ? -1 : 1;
+    }
+    return location1 < location2 ? -1 : (location1 > location2 ? 1 : 0);
+}
+
+static gboolean bbbm_loader_poll(BBBMLoader *loader) {
+    BBBMLoaderRequest *request;
+
+    if (loader->pool == NULL && (request = bbbm_loader_next(loader)) != NULL) {
+        ++loader->running;
+        bbbm_loader_run(request, loader);
+    }
+    while ((request = (BBBMLoaderRequest *) g_async_queue_try_pop(loader->handled)) != NULL) {
+        --loader->running;
+        if (!request->dropped && !request->handled) {
+            /* only located; it waits for its turn */
+            bbbm_loader_insert_located(loader, request);
+            continue;
+        }
+        if (!request->dropped) {
+            /* removed first, so the function can queue the same key again */
+            g_hash_table_remove(loader->requests, request->key);
+            loader->function(loader->data, request->key, request->pixbuf, request->status,
+                             request->has_metadata ? &(request->metadata) : NULL);
+        }
+        bbbm_loader_free_request(request);
+    }
+    if (loader->running == 0 && g_queue_is_empty(loader->waiting) && g_queue_is_empty(loader->ahead)
+            && g_queue_is_empty(loader->behind)) {
+        loader->poll_id = 0;
+        return FALSE;
+    }
+    bbbm_loader_start(loader);
+    return TRUE;
+}
+
+static void bbbm_loader_free_request(BBBMLoaderRequest *request) {
+    if (request->pixbuf != NULL) {
+        g_object_unref(request->pixbuf);
+    }
+    g_free(request->filename);
+    g_free(request->readahead);
+    g_free(request);
+}
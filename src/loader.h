@@ -0,0 +1,60 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_LOADER_H_
+#define __BBBM_LOADER_H_
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "metadata.h"
+#include "validate.h"
+
+/* A queue of thumbnails that are checked and decoded by worker threads, and handed back from the main loop.
+   Requests are identified by a key, and can be moved to the front of the queue while they are waiting */
+typedef struct _BBBMLoader BBBMLoader;
+
+/* Called from the main loop when a request has been handled. The pixbuf is NULL if the file could not be used, in
+   which case status tells why. Metadata, including the colors of the thumbnail, is only given if it was asked for
+   and could be read. Neither is valid after the call */
+typedef void (* bbbm_loader_function) (gpointer data, gpointer key, GdkPixbuf *pixbuf, BBBMValidateStatus status,
+                                       const BBBMMetadata *metadata);
+
+/* Creates a new BBBMLoader object that calls the given function for each handled request.
+   The returned object must be destroyed with bbbm_loader_destroy when no longer needed */
+BBBMLoader *bbbm_loader_new(bbbm_loader_function function, gpointer data);
+
+/* Queues the given file to be decoded at the given size, keeping its aspect ratio, after all waiting requests.
+   If read_metadata is TRUE, the metadata of the file is read by the same thread.
+   A request with the same key that has not been handled yet is replaced */
+void bbbm_loader_add(BBBMLoader *loader, gpointer key, const gchar *filename, guint width, guint height,
+                     gboolean read_metadata);
+
+/* Moves the request with the given key to the front of the queue, if it is still waiting */
+void bbbm_loader_prioritize(BBBMLoader *loader, gpointer key);
+
+/* Drops the request with the given key, if any; the function will not be called for it */
+void bbbm_loader_remove(BBBMLoader *loader, gpointer key);
+
+/* Returns the number of requests that are waiting or being handled */
+guint bbbm_loader_get_pending_count(BBBMLoader *loader);
+
+/* Drops all requests, waits for the ones that are being handled, and frees the loader */
+void bbbm_loader_destroy(BBBMLoader *loader);
+
+#endif /* __BBBM_LOADER_H_ */
@@ -23,39 +23,60 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <sys/stat.h>
-#include <sys/wait.h>
 #include <getopt.h>
 #include <gtk/gtk.h>
 #include "config.h"
 #include "bbbm.h"
+#include "batch.h"
 #include "options.h"
+#include "remote.h"
 #include "util.h"
+#include "decoder.h"
+#include "archive.h"
 #include "compat.h"
 
-static void clean_up_child_process(int signal_number) {
-    wait(NULL);
-}
-
 int main(int argc, char *argv[]) {
     static const struct option long_opts[] = {
-        {"config",  required_argument, 0, 'c'},
-        {"help",    no_argument,       0, 'h'},
-        {"version", no_argument,       0, 'v'},
-        {0,         0,                 0,  0},
+        {"config",       required_argument, 0, 'c'},
+        {"create-list",  required_argument, 0, 'l'},
+        {"create-menu",  required_argument, 0, 'm'},
+        {"random",       no_argument,       0, 'r'},
+        {"add",          no_argument,       0, 'a'},
+        {"new-instance", no_argument,       0, 'n'},
+        {"help",         no_argument,       0, 'h'},
+        {"version",      no_argument,       0, 'v'},
+        {0,              0,                 0,  0},
     };
-    static const gchar *short_opts = "c:hv";
+    static const gchar *short_opts = "c:l:m:ranhv";
     gint c;
     gchar *home_dir;
     gchar *config_file = NULL;
+    const gchar *collection_file;
+    const gchar *list_file = NULL;
+    const gchar *menu_file = NULL;
+    gboolean random_background = FALSE;
+    gboolean add_images = FALSE;
+    gboolean new_instance = FALSE;
+    gchar *socket_path;
+    GList *commands = NULL;
     BBBMOptions *options;
     BBBM *bbbm;
-    struct sigaction sigchld_action;
+    BBBMRemote *remote = NULL;
 
-    memset(&sigchld_action, 0, sizeof(sigchld_action));
-    sigchld_action.sa_handler = clean_up_child_process;
-    sigaction(SIGCHLD, &sigchld_action, NULL);
+    /* a helper that decodes images for a running instance; see decoder.h */
+    if (argc > 1 && strcmp(argv[1], BBBM_DECODER_OPTION) == 0) {
+        return bbbm_decoder_serve(argc, argv);
+    }
 
-    gtk_init(&argc, &argv);
+#if HAVE_G_THREAD_NEW == 0
+    /* backgrounds are rendered using multiple threads */
+    if (!g_thread_supported()) {
+        g_thread_init(NULL);
+    }
+#endif
+
+    /* only strip the GTK+ options here; the display is not opened until it's known that it is needed */
+    gtk_parse_args(&argc, &argv);
 
 #if HAVE_GETOPT_LONG != 1
     #error getopt_long is not defined
@@ -66,13 +87,41 @@ int main(int argc, char *argv[]) {
                 g_debug("using config file '%s'", optarg);
                 config_file = bbbm_util_absolute_path(optarg);
                 break;
+            case 'l':
+                list_file = optarg;
+                break;
+            case 'm':
+                menu_file = optarg;
+                break;
+            case 'r':
+                random_background = TRUE;
+                break;
+            case 'a':
+                add_images = TRUE;
+                break;
+            case 'n':
+                new_instance = TRUE;
+                break;
             case 'h':
                 printf("Usage: "PACKAGE" [OPTIONS] [COLLECTION]\n");
+                printf("   or: "PACKAGE" [OPTIONS] --add IMAGE...\n");
                 printf("Opens the Blackbox background manager.\n");
                 printf("\n");
-                printf("  -c, --config <file>  Use <file> as configuration file\n");
-                printf("  -h, --help           Output this help and exit\n");
-                printf("  -v, --version        Output version information and exit\n");
+                printf("  -c, --config <file>       Use <file> as configuration file\n");
+                printf("  -l, --create-list <file>  Write a background list of COLLECTION to <file> and exit\n");
+                printf("  -m, --create-menu <file>  Write a background menu of COLLECTION to <file> and exit\n");
+                printf("  -r, --random              Set a random background from COLLECTION and exit\n");
+                printf("                            Without COLLECTION the running instance sets one\n");
+                printf("  -a, --add                 Add the given IMAGEs to the collection\n");
+                printf("  -n, --new-instance        Do not pass the arguments to a running instance\n");
+                printf("  -h, --help                Output this help and exit\n");
+                printf("  -v, --version             Output version information and exit\n");
+                printf("\n");
+                printf("The --create-list, --create-menu and --random options can be combined,\n");
+                printf("and do not require a display.\n");
+                printf("\n");
+                printf("If "PACKAGE" is already running on the same display, COLLECTION or the IMAGEs\n");
+                printf("are opened in that instance instead, unless --new-instance is given.\n");
                 return 0;
             case 'v':
                 printf(PACKAGE_STRING"\n");
@@ -119,13 +168,108 @@ int main(int argc, char *argv[]) {
             return 1;
         }
     }
-    bbbm = bbbm_new(options, config_file, optind < argc ? argv[optind] : NULL);
+    collection_file = optind < argc && !add_images ? argv[optind] : NULL;
+    socket_path = bbbm_remote_get_socket_path(config_file);
+
+    if (random_background && collection_file == NULL && list_file == NULL && menu_file == NULL) {
+        gint result = 0;
+
+        commands = g_list_append(commands, g_strdup(BBBM_REMOTE_RANDOM));
+        if (!bbbm_remote_send(socket_path, commands)) {
+            fprintf(stderr, "A collection is required for --random if "PACKAGE" is not running.\n");
+            fprintf(stderr, "Try `"PACKAGE" --help` for more information.\n");
+            result = 1;
+        }
+        g_list_foreach(commands, (GFunc) g_free, NULL);
+        g_list_free(commands);
+        bbbm_options_destroy(options);
+        g_free(socket_path);
+        g_free(config_file);
+        return result;
+    }
+
+    if (list_file != NULL || menu_file != NULL || random_background) {
+        gint result;
+
+        if (collection_file == NULL) {
+            fprintf(stderr, "A collection is required for --create-list, --create-menu and --random.\n");
+            fprintf(stderr, "Try `"PACKAGE" --help` for more information.\n");
+            result = 1;
+        } else {
+            gchar *dir, *archive_dir;
+
+            dir = bbbm_util_dirname(config_file);
+            archive_dir = g_build_filename(dir, BBBM_ARCHIVE_EXTRACT_DIR, NULL);
+            result = bbbm_batch_run(options, collection_file, archive_dir, list_file, menu_file, random_background);
+            g_free(archive_dir);
+            g_free(dir);
+        }
+        bbbm_options_destroy(options);
+        g_free(socket_path);
+        g_free(config_file);
+        return result;
+    }
+
+    /* the running instance may have a different working directory, so only pass absolute paths */
+    if (add_images) {
+        gint i;
+
+        for (i = optind; i < argc; i++) {
+            gchar *absolute_file = bbbm_util_absolute_path(argv[i]);
+            commands = g_list_append(commands, g_strconcat(BBBM_REMOTE_ADD, " ", absolute_file, NULL));
+            g_free(absolute_file);
+        }
+    } else if (collection_file != NULL) {
+        gchar *absolute_file = bbbm_util_absolute_path(collection_file);
+        commands = g_list_append(commands, g_strconcat(BBBM_REMOTE_OPEN, " ", absolute_file, NULL));
+        g_free(absolute_file);
+    }
+    if (!new_instance) {
+        GList *present = g_list_append(g_list_copy(commands), BBBM_REMOTE_PRESENT);
+        gboolean sent = bbbm_remote_send(socket_path, present);
+
+        g_list_free(present);
+        if (sent) {
+            g_list_foreach(commands, (GFunc) g_free, NULL);
+            g_list_free(commands);
+            bbbm_options_destroy(options);
+            g_free(socket_path);
+            g_free(config_file);
+            return 0;
+        }
+    }
+
+    gtk_init(&argc, &argv);
+    /* only the window decodes thumbnails; batch runs do without helpers */
+    bbbm_decoder_init(argv[0]);
+    bbbm_decoder_set_memory_budget((gsize) bbbm_options_get_decode_memory(options) * 1024 * 1024);
+
+    bbbm = bbbm_new(options, config_file, collection_file);
+    if (add_images) {
+        gint i;
+
+        for (i = optind; i < argc; i++) {
+            bbbm_handle_command(bbbm, BBBM_REMOTE_ADD, argv[i]);
+        }
+    }
+    g_list_foreach(commands, (GFunc) g_free, NULL);
+    g_list_free(commands);
+
+    if (!new_instance) {
+        /* a new instance leaves the socket to the instance that owns it */
+        remote = bbbm_remote_new(socket_path, (bbbm_remote_function) bbbm_handle_command, bbbm);
+    }
 
     gtk_main();
+    if (remote != NULL) {
+        bbbm_remote_destroy(remote);
+    }
     bbbm_destroy(bbbm);
+    bbbm_decoder_shutdown();
     bbbm_options_write_to_file(options, config_file);
     /* do not exit */
     bbbm_options_destroy(options);
+    g_free(socket_path);
     g_free(config_file);
     return 0;
 }
@@ -0,0 +1,447 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "config.h"
+#include "metadata.h"
+#include "util.h"
+#include "compat.h"
+
+/* the number of bytes read for all formats but JPEG, which is read segment by segment */
+#define BBBM_METADATA_HEADER_SIZE  32
+
+struct _BBBMMetadataIndex {
+    gchar *filename;
+    /* filename -> BBBMMetadata */
+    GHashTable *entries;
+    gboolean modified;
+};
+
+static gboolean bbbm_metadata_read_header(FILE *file, BBBMMetadata *metadata);
+static gboolean bbbm_metadata_read_jpeg(FILE *file, BBBMMetadata *metadata);
+static gboolean bbbm_metadata_read_pnm(const guchar *header, gsize length, BBBMMetadata *metadata);
+static inline const gchar *bbbm_metadata_intern(const gchar *format);
+static void bbbm_metadata_index_load(BBBMMetadataIndex *index);
+static void bbbm_metadata_index_write_entry(const gchar *filename, BBBMMetadata *metadata, FILE *file);
+static gint bbbm_metadata_parse_colors(const gchar *text, BBBMMetadata *metadata);
+
+gboolean bbbm_metadata_read(const gchar *filename, BBBMMetadata *metadata) {
+    struct stat info;
+    FILE *file;
+    gboolean result;
+
+    g_return_val_if_fail(filename != NULL, FALSE);
+    g_return_val_if_fail(metadata != NULL, FALSE);
+
+    if (g_stat(filename, &info) == -1) {
+        g_debug("could not read '%s': %s", filename, g_strerror(errno));
+        return FALSE;
+    }
+    metadata->size  = info.st_size;
+    metadata->mtime = info.st_mtime;
+    metadata->has_colors = FALSE;
+
+    file = fopen(filename, "rb");
+    if (file == NULL) {
+        g_debug("could not read '%s': %s", filename, g_strerror(errno));
+        return FALSE;
+    }
+    result = bbbm_metadata_read_header(file, metadata);
+    fclose(file);
+    if (!result) {
+        GdkPixbufFormat *format;
+        gchar *name;
+
+        /* let gdk-pixbuf try; its loaders usually stop after the header too */
+        format = gdk_pixbuf_get_file_info(filename, &(metadata->width), &(metadata->height));
+        if (format == NULL) {
+            return FALSE;
+        }
+        name = gdk_pixbuf_format_get_name(format);
+        metadata->format = bbbm_metadata_intern(name);
+        g_free(name);
+    }
+    return TRUE;
+}
+
+void bbbm_metadata_set_colors(BBBMMetadata *metadata, GdkPixbuf *thumbnail) {
+    g_return_if_fail(metadata != NULL);
+    g_return_if_fail(GDK_IS_PIXBUF(thumbnail));
+
+    bbbm_color_extract(gdk_pixbuf_get_pixels(thumbnail), gdk_pixbuf_get_width(thumbnail),
+                       gdk_pixbuf_get_height(thumbnail), gdk_pixbuf_get_rowstride(thumbnail),
+                       gdk_pixbuf_get_n_channels(thumbnail), &(metadata->colors));
+    metadata->has_colors = TRUE;
+}
+
+gboolean bbbm_metadata_is_current(const BBBMMetadata *metadata, const gchar *filename) {
+    struct stat info;
+
+    g_return_val_if_fail(metadata != NULL, FALSE);
+    g_return_val_if_fail(filename != NULL, FALSE);
+
+    return g_stat(filename, &info) == 0 && metadata->mtime == info.st_mtime && metadata->size == info.st_size;
+}
+
+BBBMMetadataIndex *bbbm_metadata_index_new(const gchar *filename) {
+    BBBMMetadataIndex *index;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+
+    index = g_malloc(sizeof(BBBMMetadataIndex));
+    index->filename = g_strdup(filename);
+    index->entries  = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    index->modified = FALSE;
+    bbbm_metadata_index_load(index);
+    return index;
+}
+
+const BBBMMetadata *bbbm_metadata_index_get(BBBMMetadataIndex *index, const gchar *filename) {
+    BBBMMetadata *metadata;
+
+    g_return_val_if_fail(index != NULL, NULL);
+    g_return_val_if_fail(filename != NULL, NULL);
+
+    metadata = (BBBMMetadata *) g_hash_table_lookup(index->entries, filename);
+    if (metadata != NULL && bbbm_metadata_is_current(metadata, filename)) {
+        return metadata;
+    }
+
+    metadata = g_malloc(sizeof(BBBMMetadata));
+    if (!bbbm_metadata_read(filename, metadata)) {
+        g_free(metadata);
+        if (g_hash_table_remove(index->entries, filename)) {
+            index->modified = TRUE;
+        }
+        return NULL;
+    }
+    g_hash_table_replace(index->entries, g_strdup(filename), metadata);
+    index->modified = TRUE;
+    return metadata;
+}
+
+const BBBMMetadata *bbbm_metadata_index_peek(BBBMMetadataIndex *index, const gchar *filename) {
+    g_return_val_if_fail(index != NULL, NULL);
+    g_return_val_if_fail(filename != NULL, NULL);
+    return (const BBBMMetadata *) g_hash_table_lookup(index->entries, filename);
+}
+
+void bbbm_metadata_index_put(BBBMMetadataIndex *index, const gchar *filename, const BBBMMetadata *metadata) {
+    BBBMMetadata *copy;
+
+    g_return_if_fail(index != NULL);
+    g_return_if_fail(filename != NULL);
+    g_return_if_fail(metadata != NULL);
+
+    copy = g_memdup(metadata, sizeof(BBBMMetadata));
+    g_hash_table_replace(index->entries, g_strdup(filename), copy);
+    index->modified = TRUE;
+}
+
+void bbbm_metadata_index_remove(BBBMMetadataIndex *index, const gchar *filename) {
+    g_return_if_fail(index != NULL);
+    g_return_if_fail(filename != NULL);
+
+    if (g_hash_table_remove(index->entries, filename)) {
+        index->modified = TRUE;
+    }
+}
+
+gboolean bbbm_metadata_index_save(BBBMMetadataIndex *index) {
+    gchar *temp_file;
+    FILE *file;
+
+    g_return_val_if_fail(index != NULL, FALSE);
+
+    if (!index->modified) {
+        return TRUE;
+    }
+    /* write to a temporary file first, so a crash cannot leave a truncated index */
+    temp_file = g_strconcat(index->filename, ".tmp", NULL);
+    file = fopen(temp_file, "w");
+    if (file == NULL) {
+        g_warning("could not write to '%s': %s", temp_file, g_strerror(errno));
+        g_free(temp_file);
+        return FALSE;
+    }
+    g_hash_table_foreach(index->entries, (GHFunc) bbbm_metadata_index_write_entry, file);
+    if (fclose(file) != 0 || g_rename(temp_file, index->filename) == -1) {
+        g_warning("could not write to '%s': %s", index->filename, g_strerror(errno));
+        g_unlink(temp_file);
+        g_free(temp_file);
+        return FALSE;
+    }
+    g_free(temp_file);
+    index->modified = FALSE;
+    return TRUE;
+}
+
+void bbbm_metadata_index_destroy(BBBMMetadataIndex *index) {
+    g_return_if_fail(index != NULL);
+    g_hash_table_destroy(index->entries);
+    g_free(index->filename);
+    g_free(index);
+}
+
+gdouble bbbm_metadata_get_fit(const BBBMMetadata *metadata, gint width, gint height) {
+    gdouble scale, aspect, target_aspect;
+
+    g_return_val_if_fail(metadata != NULL, 0);
+
+    if (metadata->width <= 0 || metadata->height <= 0 || width <= 0 || height <= 0) {
+        return 0;
+    }
+    /* how much of the resolution is there without upscaling */
+    scale = MIN(MIN((gdouble) metadata->width / width, (gdouble) metadata->height / height), 1.0);
+    /* how much of the image survives filling, or how much of the area is covered by fitting */
+    aspect = (gdouble) metadata->width / metadata->height;
+    target_aspect = (gdouble) width / height;
+    return scale * MIN(aspect, target_aspect) / MAX(aspect, target_aspect);
+}
+
+gchar *bbbm_metadata_to_string(const BBBMMetadata *metadata) {
+    g_return_val_if_fail(metadata != NULL, NULL);
+
+    if (metadata->size >= 1024 * 1024) {
+        return g_strdup_printf("%dx%d %s, %.1f MB", metadata->width, metadata->height, metadata->format,
+                               metadata->size / (1024.0 * 1024.0));
+    }
+    return g_strdup_printf("%dx%d %s, %d KB", metadata->width, metadata->height, metadata->format,
+                           (gint) ((metadata->size + 1023) / 1024));
+}
+
+static gboolean bbbm_metadata_read_header(FILE *file, BBBMMetadata *metadata) {
+    guchar header[BBBM_METADATA_HEADER_SIZE];
+    gsize length;
+
+    length = fread(header, 1, sizeof(header), file);
+    if (length >= 2 && header[0] == 0xFF && header[1] == 0xD8) {
+        fseek(file, 2, SEEK_SET);
+        return bbbm_metadata_read_jpeg(file, metadata);
+    }
+    if (length >= 24 && memcmp(header, "\x89PNG\r\n\x1a\n", 8) == 0 && memcmp(header + 12, "IHDR", 4) == 0) {
+        metadata->width  = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+        metadata->height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+        metadata->format = bbbm_metadata_intern("png");
+        return TRUE;
+    }
+    if (length >= 10 && (memcmp(header, "GIF87a", 6) == 0 || memcmp(header, "GIF89a", 6) == 0)) {
+        metadata->width  = header[6] | (header[7] << 8);
+        metadata->height = header[8] | (header[9] << 8);
+        metadata->format = bbbm_metadata_intern("gif");
+        return TRUE;
+    }
+    if (length >= 26 && header[0] == 'B' && header[1] == 'M') {
+        gint32 height;
+
+        metadata->width = header[18] | (header[19] << 8) | (header[20] << 16) | (header[21] << 24);
+        /* a negative height means the rows are stored top-down */
+        height = (gint32) (header[22] | (header[23] << 8) | (header[24] << 16) | ((guint32) header[25] << 24));
+        metadata->height = ABS(height);
+        metadata->format = bbbm_metadata_intern("bmp");
+        return TRUE;
+    }
+    if (length >= 2 && header[0] == 'P' && header[1] >= '1' && header[1] <= '6') {
+        return bbbm_metadata_read_pnm(header, length, metadata);
+    }
+    return FALSE;
+}
+
+static gboolean bbbm_metadata_read_jpeg(FILE *file, BBBMMetadata *metadata) {
+    guchar segment[7];
+    gint marker;
+
+    /* walk the segments until a start of frame; only their headers are read, the rest is skipped */
+    while ((marker = fgetc(file)) != EOF) {
+        guint length;
+
+        if (marker != 0xFF) {
+            return FALSE;
+        }
+        /* any number of 0xFF bytes may precede the marker */
+        while ((marker = fgetc(file)) == 0xFF) {
+        }
+        if (marker == EOF || marker == 0xD9 || marker == 0xDA) {
+            /* end of image or start of scan without a frame header */
+            return FALSE;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            /* markers without a length */
+            continue;
+        }
+        if (fread(segment, 1, 2, file) != 2) {
+            return FALSE;
+        }
+        length = (segment[0] << 8) | segment[1];
+        if (length < 2) {
+            return FALSE;
+        }
+        /* SOF0 - SOF15, except DHT (C4), JPG (C8) and DAC (CC) */
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (fread(segment, 1, 5, file) != 5) {
+                return FALSE;
+            }
+            metadata->height = (segment[1] << 8) | segment[2];
+            metadata->width  = (segment[3] << 8) | segment[4];
+            metadata->format = bbbm_metadata_intern("jpeg");
+            return TRUE;
+        }
+        if (fseek(file, length - 2, SEEK_CUR) != 0) {
+            return FALSE;
+        }
+    }
+    return FALSE;
+}
+
+static gboolean bbbm_metadata_read_pnm(const guchar *header, gsize length, BBBMMetadata *metadata) {
+    gint values[2];
+    gsize position = 2;
+    guint count = 0;
+
+    /* P<n>, whitespace, width, whitespace, height; comments run from # to the end of the line */
+    while (count < 2 && position < length) {
+        if (header[position] == '#') {
+            while (position < length && header[position] != '\n') {
+                position++;
+            }
+        } else if (g_ascii_isspace(header[position])) {
+            position++;
+        } else if (g_ascii_isdigit(header[position])) {
+            values[count] = 0;
+            while (position < length && g_ascii_isdigit(header[position])) {
+                values[count] = values[count] * 10 + (header[position] - '0');
+                position++;
+            }
+            if (position == length) {
+                /* the number may continue beyond the header */
+                return FALSE;
+            }
+            count++;
+        } else {
+            return FALSE;
+        }
+    }
+    if (count < 2) {
+        return FALSE;
+    }
+    metadata->width  = values[0];
+    metadata->height = values[1];
+    metadata->format = bbbm_metadata_intern("pnm");
+    return TRUE;
+}
+
+static inline const gchar *bbbm_metadata_intern(const gchar *format) {
+    return g_quark_to_string(g_quark_from_string(format));
+}
+
+static void bbbm_metadata_index_load(BBBMMetadataIndex *index) {
+    gchar *contents, **lines;
+    GError *error = NULL;
+    guint i;
+
+    if (!g_file_test(index->filename, G_FILE_TEST_EXISTS)) {
+        return;
+    }
+    if (!g_file_get_contents(index->filename, &contents, NULL, &error)) {
+        g_warning("could not read '%s': %s", index->filename, error->message);
+        g_error_free(error);
+        return;
+    }
+    /* each line is: mtime size width height format colors filename; the filename is last since it may contain
+       spaces. Colors are either - or hexadecimal bytes; indexes written before colors were added lack them */
+    lines = g_strsplit(contents, "\n", -1);
+    for (i = 0; lines[i] != NULL; ++i) {
+        BBBMMetadata *metadata;
+        gchar format[32];
+        glong mtime;
+        gint64 size;
+        gint offset;
+
+        metadata = g_malloc(sizeof(BBBMMetadata));
+        if (sscanf(lines[i], "%ld %" G_GINT64_FORMAT " %d %d %31s %n", &mtime, &size,
+                   &(metadata->width), &(metadata->height), format, &offset) != 5
+            || lines[i][offset] == '\0') {
+            if (lines[i][0] != '\0') {
+                g_warning("skipping invalid line %d in '%s'", i + 1, index->filename);
+            }
+            g_free(metadata);
+            continue;
+        }
+        offset += bbbm_metadata_parse_colors(lines[i] + offset, metadata);
+        metadata->mtime  = (time_t) mtime;
+        metadata->size   = size;
+        metadata->format = bbbm_metadata_intern(format);
+        g_hash_table_replace(index->entries, g_strdup(lines[i] + offset), metadata);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+    g_debug("loaded %d entries from '%s'", g_hash_table_size(index->entries), index->filename);
+}
+
+static void bbbm_metadata_index_write_entry(const gchar *filename, BBBMMetadata *metadata, FILE *file) {
+    if (strchr(filename, '\n') != NULL) {
+        /* cannot be stored in a line-based file; it is simply read again next time */
+        return;
+    }
+    fprintf(file, "%ld %" G_GINT64_FORMAT " %d %d %s ", (glong) metadata->mtime, metadata->size,
+            metadata->width, metadata->height, metadata->format);
+    if (metadata->has_colors) {
+        const guchar *bytes = (const guchar *) &(metadata->colors);
+        guint i;
+
+        for (i = 0; i < sizeof(BBBMColors); ++i) {
+            fprintf(file, "%02x", bytes[i]);
+        }
+    } else {
+        fputc('-', file);
+    }
+    fprintf(file, " %s\n", filename);
+}
+
+static gint bbbm_metadata_parse_colors(const gchar *text, BBBMMetadata *metadata) {
+    guchar *bytes = (guchar *) &(metadata->colors);
+    guint i;
+
+    metadata->has_colors = FALSE;
+    if (text[0] == '-' && text[1] == ' ') {
+        return 2;
+    }
+    for (i = 0; i < sizeof(BBBMColors) * 2; ++i) {
+        if (!g_ascii_isxdigit(text[i])) {
+            /* an older entry without colors; this is already the filename */
+            return 0;
+        }
+    }
+    if (text[i] != ' ' || text[i + 1] == '\0') {
+        return 0;
+    }
+    for (i = 0; i < sizeof(BBBMColors); ++i) {
+        bytes[i] = (g_ascii_xdigit_value(text[i * 2]) << 4) | g_ascii_xdigit_value(text[i * 2 + 1]);
+    }
+    metadata->has_colors = TRUE;
+    return sizeof(BBBMColors) * 2 + 1;
+}
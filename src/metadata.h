@@ -0,0 +1,92 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_METADATA_H_
+#define __BBBM_METADATA_H_
+
+#include <time.h>
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "color.h"
+
+/* The properties of an image file that can be determined without decoding it */
+typedef struct {
+    gint width;
+    gint height;
+    /* an interned string such as "jpeg" or "png"; never freed */
+    const gchar *format;
+    gint64 size;
+    time_t mtime;
+    /* taken from the thumbnail when it is decoded; only valid if has_colors is TRUE */
+    gboolean has_colors;
+    BBBMColors colors;
+} BBBMMetadata;
+
+/* A persistent mapping from filenames to metadata. Entries are refreshed if the file has changed */
+typedef struct _BBBMMetadataIndex BBBMMetadataIndex;
+
+/* Reads the metadata of the given image file from its header only; JPEG, PNG, GIF, BMP and PPM/PGM/PBM are read
+   directly, other formats through gdk-pixbuf's file info.
+   Returns FALSE if the file could not be read or is not a supported image */
+gboolean bbbm_metadata_read(const gchar *filename, BBBMMetadata *metadata);
+
+/* Sets the colors of the given metadata from a thumbnail of its image. Thumbnails are decoded anyway, and their
+   colors are close enough to those of the image */
+void bbbm_metadata_set_colors(BBBMMetadata *metadata, GdkPixbuf *thumbnail);
+
+/* Returns whether the given metadata still matches the given file, checking only its size and modification time.
+   Like bbbm_metadata_read, this can be called from any thread */
+gboolean bbbm_metadata_is_current(const BBBMMetadata *metadata, const gchar *filename);
+
+/* Creates a new BBBMMetadataIndex object, and loads the given index file if it exists.
+   The returned object must be destroyed with bbbm_metadata_index_destroy when no longer needed */
+BBBMMetadataIndex *bbbm_metadata_index_new(const gchar *filename);
+
+/* Returns the metadata of the given image file, reading its header only if the file is new or has changed since
+   it was indexed. Returns NULL if the metadata could not be read.
+   The returned metadata is owned by the index, and is valid until the next call for the same file */
+const BBBMMetadata *bbbm_metadata_index_get(BBBMMetadataIndex *index, const gchar *filename);
+
+/* Like bbbm_metadata_index_get, but returns the indexed metadata without checking the file at all.
+   Returns NULL if the file is not indexed */
+const BBBMMetadata *bbbm_metadata_index_peek(BBBMMetadataIndex *index, const gchar *filename);
+
+/* Stores metadata that has been read with bbbm_metadata_read, for instance by another thread, replacing any that
+   is indexed already */
+void bbbm_metadata_index_put(BBBMMetadataIndex *index, const gchar *filename, const BBBMMetadata *metadata);
+
+/* Removes the metadata of the given file, if it is indexed */
+void bbbm_metadata_index_remove(BBBMMetadataIndex *index, const gchar *filename);
+
+/* Writes the index to its file, if anything has changed since it was loaded or last saved */
+gboolean bbbm_metadata_index_save(BBBMMetadataIndex *index);
+
+/* Frees the index without saving it */
+void bbbm_metadata_index_destroy(BBBMMetadataIndex *index);
+
+/* Returns how well an image with the given metadata fits an area of the given size, from 0 to 1.
+   Images that match the aspect ratio and need no upscaling score 1 */
+gdouble bbbm_metadata_get_fit(const BBBMMetadata *metadata, gint width, gint height);
+
+/* Returns a short description of the metadata, such as "1920x1080 jpeg, 512 KB".
+   The returned string must be freed when no longer needed */
+gchar *bbbm_metadata_to_string(const BBBMMetadata *metadata);
+
+#endif /* __BBBM_METADATA_H_ */
@@ -40,11 +40,68 @@
 #define BBBM_OPTIONS_DEFAULT_THUMB_WIDTH         128
 #define BBBM_OPTIONS_DEFAULT_THUMB_HEIGHT        96
 #define BBBM_OPTIONS_DEFAULT_THUMB_COLUMN_COUNT  4
+#define BBBM_OPTIONS_DEFAULT_THUMB_DEFERRED      TRUE
+#define BBBM_OPTIONS_DEFAULT_DECODE_MEMORY       512
 #define BBBM_OPTIONS_DEFAULT_FILENAME_AS_LABEL   FALSE
 #define BBBM_OPTIONS_DEFAULT_FILENAME_AS_TITLE   FALSE
+#define BBBM_OPTIONS_DEFAULT_MENU_SPLIT          BBBM_MENU_SPLIT_NONE
+#define BBBM_OPTIONS_DEFAULT_MENU_PAGE_SIZE      0
+#define BBBM_OPTIONS_DEFAULT_MAX_JOBS            2
+#define BBBM_OPTIONS_DEFAULT_JOB_TIMEOUT         300
+#define BBBM_OPTIONS_DEFAULT_BUILTIN_SETTER      FALSE
+#define BBBM_OPTIONS_DEFAULT_BACKGROUND_MODE     BBBM_RENDER_FILL
+#define BBBM_OPTIONS_DEFAULT_PIXMAP_CACHE_SIZE   4
+#define BBBM_OPTIONS_DEFAULT_RENDER_CACHE        FALSE
+#define BBBM_OPTIONS_DEFAULT_TRANSITION          0
+#define BBBM_OPTIONS_DEFAULT_RANDOM_MODE         BBBM_RANDOM_ANY
 
 #define BBBM_OPTIONS_READ_BUFFER_SIZE            8192
 
+/* the depth=2 elements, in the order they must appear in */
+static const gchar *bbbm_options_sections[] = { "thumbs", "menu", "commands", "jobs", "background", NULL };
+
+enum {
+    BBBM_OPTIONS_SECTION_THUMBS,
+    BBBM_OPTIONS_SECTION_MENU,
+    BBBM_OPTIONS_SECTION_COMMANDS,
+    BBBM_OPTIONS_SECTION_JOBS,
+    BBBM_OPTIONS_SECTION_BACKGROUND
+};
+
+/* the optional bbbm/menu elements after filename-as-title, in the order they must appear in */
+static const gchar *bbbm_options_menu_elements[] = { "split", "page-size", NULL };
+
+enum {
+    BBBM_OPTIONS_MENU_SPLIT,
+    BBBM_OPTIONS_MENU_PAGE_SIZE
+};
+
+/* the values of bbbm/menu/split, in the order of BBBMMenuSplit */
+static const gchar *bbbm_options_menu_split_names[] = { "none", "directory", "letter", NULL };
+
+/* the bbbm/jobs elements, in the order they must appear in */
+static const gchar *bbbm_options_jobs_elements[] = { "max-count", "timeout", NULL };
+
+enum {
+    BBBM_OPTIONS_JOBS_MAX_COUNT,
+    BBBM_OPTIONS_JOBS_TIMEOUT
+};
+
+/* the bbbm/background elements, in the order they must appear in */
+static const gchar *bbbm_options_background_elements[] = { "builtin", "mode", "cache-size", "render-cache", "transition", "random", NULL };
+
+enum {
+    BBBM_OPTIONS_BACKGROUND_BUILTIN,
+    BBBM_OPTIONS_BACKGROUND_MODE,
+    BBBM_OPTIONS_BACKGROUND_CACHE_SIZE,
+    BBBM_OPTIONS_BACKGROUND_RENDER_CACHE,
+    BBBM_OPTIONS_BACKGROUND_TRANSITION,
+    BBBM_OPTIONS_BACKGROUND_RANDOM
+};
+
+/* the values of bbbm/background/random, in the order of BBBMRandomMode */
+static const gchar *bbbm_options_random_mode_names[] = { "any", "weighted", "fitting", NULL };
+
 typedef struct {
     BBBMOptions *options;
 #if HAVE_G_MARKUP_PARSE_CONTEXT_GET_ELEMENT_STACK == 0
@@ -57,14 +114,32 @@ typedef struct {
     gchar *command;
     gchar *command_label;
     /* flags for found elements */
+    guint next_section;                /* index in bbbm_options_sections */
+    guint next_menu_element;           /* index in bbbm_options_menu_elements */
+    guint next_jobs_element;           /* index in bbbm_options_jobs_elements */
+    guint next_background_element;     /* index in bbbm_options_background_elements */
     gboolean found_thumbs;             /* bbbm/thumbs */
     gboolean found_thumb_size;         /* bbbm/thumbs/size */
     gboolean found_thumb_column_count; /* bbbm/thumbs/column-count */
+    gboolean found_thumb_deferred;     /* bbbm/thumbs/deferred */
+    gboolean found_decode_memory;      /* bbbm/thumbs/decode-memory */
     gboolean found_menu;               /* bbbm/menu */
     gboolean found_filename_as_label;  /* bbbm/menu/filename-as-label */
     gboolean found_filename_as_title;  /* bbbm/menu/filename-as-title */
+    gboolean found_menu_split;         /* bbbm/menu/split */
+    gboolean found_menu_page_size;     /* bbbm/menu/page-size */
     gboolean found_commands;           /* bbbm/commands */
     gboolean found_set_command;        /* bbbm/commands/set-command */
+    gboolean found_jobs;               /* bbbm/jobs */
+    gboolean found_max_jobs;           /* bbbm/jobs/max-count */
+    gboolean found_job_timeout;        /* bbbm/jobs/timeout */
+    gboolean found_background;         /* bbbm/background */
+    gboolean found_builtin_setter;     /* bbbm/background/builtin */
+    gboolean found_background_mode;    /* bbbm/background/mode */
+    gboolean found_pixmap_cache_size;  /* bbbm/background/cache-size */
+    gboolean found_render_cache;       /* bbbm/background/render-cache */
+    gboolean found_transition;         /* bbbm/background/transition */
+    gboolean found_random_mode;        /* bbbm/background/random */
     /* the following two flags are reset for each bbbm/commands/command element */
     gboolean found_command;            /* bbbm/commands/command/command */
     gboolean found_command_label;      /* bbbm/commands/command/label */
@@ -98,7 +173,18 @@ static gboolean bbbm_options_parse_text_to_int(const gchar *element_name, GStrin
 static gboolean bbbm_options_parse_text_to_boolean(const gchar *element_name, GString *content,
                                                    gboolean *result,
                                                    GError **error);
+static gboolean bbbm_options_parse_text_to_menu_split(const gchar *element_name, GString *content,
+                                                      BBBMMenuSplit *result,
+                                                      GError **error);
+static gboolean bbbm_options_parse_text_to_random_mode(const gchar *element_name, GString *content,
+                                                       BBBMRandomMode *result,
+                                                       GError **error);
+static gboolean bbbm_options_parse_text_to_render_mode(const gchar *element_name, GString *content,
+                                                       BBBMRenderMode *result,
+                                                       GError **error);
 
+static gint bbbm_options_parse_ordered_element(const gchar *element_name, const gchar **names, guint *next,
+                                               GError **error);
 static gboolean bbbm_options_parse_check_attributes(const gchar *element_name, const gchar **names, GError **error);
 static gboolean bbbm_options_parse_get_attribute_size(const gchar *element_name,
                                                       const gchar **names, const gchar **values,
@@ -122,9 +208,21 @@ BBBMOptions *bbbm_options_new() {
     options->thumb_width        = BBBM_OPTIONS_DEFAULT_THUMB_WIDTH;
     options->thumb_height       = BBBM_OPTIONS_DEFAULT_THUMB_HEIGHT;
     options->thumb_column_count = BBBM_OPTIONS_DEFAULT_THUMB_COLUMN_COUNT;
+    options->thumb_deferred     = BBBM_OPTIONS_DEFAULT_THUMB_DEFERRED;
+    options->decode_memory      = BBBM_OPTIONS_DEFAULT_DECODE_MEMORY;
     options->filename_as_label  = BBBM_OPTIONS_DEFAULT_FILENAME_AS_LABEL;
     options->filename_as_title  = BBBM_OPTIONS_DEFAULT_FILENAME_AS_TITLE;
+    options->menu_split         = BBBM_OPTIONS_DEFAULT_MENU_SPLIT;
+    options->menu_page_size     = BBBM_OPTIONS_DEFAULT_MENU_PAGE_SIZE;
     options->commands           = NULL;
+    options->max_jobs           = BBBM_OPTIONS_DEFAULT_MAX_JOBS;
+    options->job_timeout        = BBBM_OPTIONS_DEFAULT_JOB_TIMEOUT;
+    options->builtin_setter     = BBBM_OPTIONS_DEFAULT_BUILTIN_SETTER;
+    options->background_mode    = BBBM_OPTIONS_DEFAULT_BACKGROUND_MODE;
+    options->pixmap_cache_size  = BBBM_OPTIONS_DEFAULT_PIXMAP_CACHE_SIZE;
+    options->render_cache       = BBBM_OPTIONS_DEFAULT_RENDER_CACHE;
+    options->transition         = BBBM_OPTIONS_DEFAULT_TRANSITION;
+    options->random_mode        = BBBM_OPTIONS_DEFAULT_RANDOM_MODE;
 
     return options;
 }
@@ -178,14 +276,32 @@ BBBMOptions *bbbm_options_read_from_file(const gchar *filename) {
     parse_data.text_stack               = NULL;  /* empty stack */
     parse_data.command                  = NULL;  /* no command */;
     parse_data.command_label            = NULL;  /* no command label */
+    parse_data.next_section             = 0;     /* bbbm/thumbs */
+    parse_data.next_menu_element        = 0;     /* bbbm/menu/split */
+    parse_data.next_jobs_element        = 0;     /* bbbm/jobs/max-count */
+    parse_data.next_background_element  = 0;     /* bbbm/background/builtin */
     parse_data.found_thumbs             = FALSE; /* bbbm/thumbs */
     parse_data.found_thumb_size         = FALSE;;/* bbbm/thumbs/size */
     parse_data.found_thumb_column_count = FALSE; /* bbbm/thumbs/column-count */
+    parse_data.found_thumb_deferred     = FALSE; /* bbbm/thumbs/deferred */
+    parse_data.found_decode_memory      = FALSE; /* bbbm/thumbs/decode-memory */
     parse_data.found_menu               = FALSE; /* bbbm/menu */
     parse_data.found_filename_as_label  = FALSE; /* bbbm/menu/filename-as-label */
     parse_data.found_filename_as_title  = FALSE; /* bbbm/menu/filename-as-title */
+    parse_data.found_menu_split         = FALSE; /* bbbm/menu/split */
+    parse_data.found_menu_page_size     = FALSE; /* bbbm/menu/page-size */
     parse_data.found_commands           = FALSE; /* bbbm/commands */
     parse_data.found_set_command        = FALSE; /* bbbm/commands/set-command */
+    parse_data.found_jobs               = FALSE; /* bbbm/jobs */
+    parse_data.found_max_jobs           = FALSE; /* bbbm/jobs/max-count */
+    parse_data.found_job_timeout        = FALSE; /* bbbm/jobs/timeout */
+    parse_data.found_background         = FALSE; /* bbbm/background */
+    parse_data.found_builtin_setter     = FALSE; /* bbbm/background/builtin */
+    parse_data.found_background_mode    = FALSE; /* bbbm/background/mode */
+    parse_data.found_pixmap_cache_size  = FALSE; /* bbbm/background/cache-size */
+    parse_data.found_render_cache       = FALSE; /* bbbm/background/render-cache */
+    parse_data.found_transition         = FALSE; /* bbbm/background/transition */
+    parse_data.found_random_mode        = FALSE; /* bbbm/background/random */
     parse_data.found_command            = FALSE; /* bbbm/commands/command/command */
     parse_data.found_command_label      = FALSE; /* bbbm/commands/command/label */
 
@@ -250,6 +366,20 @@ BBBMOptions *bbbm_options_read_from_file(const gchar *filename) {
                   options->thumb_column_count, BBBM_OPTIONS_MAX_THUMB_COLUMN_COUNT, BBBM_OPTIONS_MAX_THUMB_COLUMN_COUNT);
         options->thumb_column_count = BBBM_OPTIONS_MAX_THUMB_COLUMN_COUNT;
     }
+    if (!parse_data.found_thumb_deferred) {
+        g_info("deferred thumbs missing. Using default value %s",
+               BBBM_OPTIONS_DEFAULT_THUMB_DEFERRED ? "true" : "false");
+        options->thumb_deferred = BBBM_OPTIONS_DEFAULT_THUMB_DEFERRED;
+    }
+    if (!parse_data.found_decode_memory) {
+        g_info("decode memory missing. Using default value %d",
+               BBBM_OPTIONS_DEFAULT_DECODE_MEMORY);
+        options->decode_memory = BBBM_OPTIONS_DEFAULT_DECODE_MEMORY;
+    } else if (options->decode_memory > BBBM_OPTIONS_MAX_DECODE_MEMORY) {
+        g_warning("decode memory %d > %d. Using value %d",
+                  options->decode_memory, BBBM_OPTIONS_MAX_DECODE_MEMORY, BBBM_OPTIONS_MAX_DECODE_MEMORY);
+        options->decode_memory = BBBM_OPTIONS_MAX_DECODE_MEMORY;
+    }
     if (!parse_data.found_filename_as_label) {
         g_info("filename-as-label missing. Using default value %s",
                BBBM_OPTIONS_DEFAULT_FILENAME_AS_LABEL ? "true" : "false");
@@ -260,6 +390,80 @@ BBBMOptions *bbbm_options_read_from_file(const gchar *filename) {
                BBBM_OPTIONS_DEFAULT_FILENAME_AS_TITLE ? "true" : "false");
         options->filename_as_title = BBBM_OPTIONS_DEFAULT_FILENAME_AS_TITLE;
     }
+    if (!parse_data.found_menu_split) {
+        g_info("menu split missing. Using default value %s",
+               bbbm_options_menu_split_names[BBBM_OPTIONS_DEFAULT_MENU_SPLIT]);
+        options->menu_split = BBBM_OPTIONS_DEFAULT_MENU_SPLIT;
+    }
+    if (!parse_data.found_menu_page_size) {
+        g_info("menu page size missing. Using default value %d",
+               BBBM_OPTIONS_DEFAULT_MENU_PAGE_SIZE);
+        options->menu_page_size = BBBM_OPTIONS_DEFAULT_MENU_PAGE_SIZE;
+    } else if (options->menu_page_size > BBBM_OPTIONS_MAX_MENU_PAGE_SIZE) {
+        g_warning("menu page size %d > %d. Using value %d",
+                  options->menu_page_size, BBBM_OPTIONS_MAX_MENU_PAGE_SIZE, BBBM_OPTIONS_MAX_MENU_PAGE_SIZE);
+        options->menu_page_size = BBBM_OPTIONS_MAX_MENU_PAGE_SIZE;
+    }
+    if (!parse_data.found_max_jobs) {
+        g_info("max job count missing. Using default value %d",
+               BBBM_OPTIONS_DEFAULT_MAX_JOBS);
+        options->max_jobs = BBBM_OPTIONS_DEFAULT_MAX_JOBS;
+    } else if (options->max_jobs <= 0) {
+        g_warning("max job count %d <= 0. Using value 1",
+                  options->max_jobs);
+        options->max_jobs = 1;
+    } else if (options->max_jobs > BBBM_OPTIONS_MAX_MAX_JOBS) {
+        g_warning("max job count %d > %d. Using value %d",
+                  options->max_jobs, BBBM_OPTIONS_MAX_MAX_JOBS, BBBM_OPTIONS_MAX_MAX_JOBS);
+        options->max_jobs = BBBM_OPTIONS_MAX_MAX_JOBS;
+    }
+    if (!parse_data.found_job_timeout) {
+        g_info("job timeout missing. Using default value %d",
+               BBBM_OPTIONS_DEFAULT_JOB_TIMEOUT);
+        options->job_timeout = BBBM_OPTIONS_DEFAULT_JOB_TIMEOUT;
+    } else if (options->job_timeout > BBBM_OPTIONS_MAX_JOB_TIMEOUT) {
+        g_warning("job timeout %d > %d. Using value %d",
+                  options->job_timeout, BBBM_OPTIONS_MAX_JOB_TIMEOUT, BBBM_OPTIONS_MAX_JOB_TIMEOUT);
+        options->job_timeout = BBBM_OPTIONS_MAX_JOB_TIMEOUT;
+    }
+    if (!parse_data.found_builtin_setter) {
+        g_info("builtin background setter missing. Using default value %s",
+               BBBM_OPTIONS_DEFAULT_BUILTIN_SETTER ? "true" : "false");
+        options->builtin_setter = BBBM_OPTIONS_DEFAULT_BUILTIN_SETTER;
+    }
+    if (!parse_data.found_background_mode) {
+        g_info("background mode missing. Using default value %s",
+               bbbm_render_mode_to_string(BBBM_OPTIONS_DEFAULT_BACKGROUND_MODE));
+        options->background_mode = BBBM_OPTIONS_DEFAULT_BACKGROUND_MODE;
+    }
+    if (!parse_data.found_pixmap_cache_size) {
+        g_info("pixmap cache size missing. Using default value %d",
+               BBBM_OPTIONS_DEFAULT_PIXMAP_CACHE_SIZE);
+        options->pixmap_cache_size = BBBM_OPTIONS_DEFAULT_PIXMAP_CACHE_SIZE;
+    } else if (options->pixmap_cache_size > BBBM_OPTIONS_MAX_PIXMAP_CACHE_SIZE) {
+        g_warning("pixmap cache size %d > %d. Using value %d",
+                  options->pixmap_cache_size, BBBM_OPTIONS_MAX_PIXMAP_CACHE_SIZE, BBBM_OPTIONS_MAX_PIXMAP_CACHE_SIZE);
+        options->pixmap_cache_size = BBBM_OPTIONS_MAX_PIXMAP_CACHE_SIZE;
+    }
+    if (!parse_data.found_render_cache) {
+        g_info("render cache missing. Using default value %s",
+               BBBM_OPTIONS_DEFAULT_RENDER_CACHE ? "true" : "false");
+        options->render_cache = BBBM_OPTIONS_DEFAULT_RENDER_CACHE;
+    }
+    if (!parse_data.found_transition) {
+        g_info("transition missing. Using default value %d",
+               BBBM_OPTIONS_DEFAULT_TRANSITION);
+        options->transition = BBBM_OPTIONS_DEFAULT_TRANSITION;
+    } else if (options->transition > BBBM_OPTIONS_MAX_TRANSITION) {
+        g_warning("transition %d > %d. Using value %d",
+                  options->transition, BBBM_OPTIONS_MAX_TRANSITION, BBBM_OPTIONS_MAX_TRANSITION);
+        options->transition = BBBM_OPTIONS_MAX_TRANSITION;
+    }
+    if (!parse_data.found_random_mode) {
+        g_info("random mode missing. Using default value %s",
+               bbbm_options_random_mode_names[BBBM_OPTIONS_DEFAULT_RANDOM_MODE]);
+        options->random_mode = BBBM_OPTIONS_DEFAULT_RANDOM_MODE;
+    }
 
     return options;
 }
@@ -285,10 +489,14 @@ void bbbm_options_write_to_file(BBBMOptions *options, const gchar *filename) {
     fprintf(file, "  <thumbs>\n");
     fprintf(file, "    <size width=\"%d\" height=\"%d\" />\n", options->thumb_width, options->thumb_height);
     fprintf(file, "    <column-count>%d</column-count>\n", options->thumb_column_count);
+    fprintf(file, "    <deferred>%s</deferred>\n", options->thumb_deferred ? "true" : "false");
+    fprintf(file, "    <decode-memory>%d</decode-memory>\n", options->decode_memory);
     fprintf(file, "  </thumbs>\n");
     fprintf(file, "  <menu>\n");
     fprintf(file, "    <filename-as-label>%s</filename-as-label>\n", options->filename_as_label ? "true" : "false");
     fprintf(file, "    <filename-as-title>%s</filename-as-title>\n", options->filename_as_title ? "true" : "false");
+    fprintf(file, "    <split>%s</split>\n", bbbm_options_menu_split_names[options->menu_split]);
+    fprintf(file, "    <page-size>%d</page-size>\n", options->menu_page_size);
     fprintf(file, "  </menu>\n");
 
     fprintf(file, "  <commands>\n");
@@ -314,6 +522,18 @@ void bbbm_options_write_to_file(BBBMOptions *options, const gchar *filename) {
         }
     }
     fprintf(file, "  </commands>\n");
+    fprintf(file, "  <jobs>\n");
+    fprintf(file, "    <max-count>%d</max-count>\n", options->max_jobs);
+    fprintf(file, "    <timeout>%d</timeout>\n", options->job_timeout);
+    fprintf(file, "  </jobs>\n");
+    fprintf(file, "  <background>\n");
+    fprintf(file, "    <builtin>%s</builtin>\n", options->builtin_setter ? "true" : "false");
+    fprintf(file, "    <mode>%s</mode>\n", bbbm_render_mode_to_string(options->background_mode));
+    fprintf(file, "    <cache-size>%d</cache-size>\n", options->pixmap_cache_size);
+    fprintf(file, "    <render-cache>%s</render-cache>\n", options->render_cache ? "true" : "false");
+    fprintf(file, "    <transition>%d</transition>\n", options->transition);
+    fprintf(file, "    <random>%s</random>\n", bbbm_options_random_mode_names[options->random_mode]);
+    fprintf(file, "  </background>\n");
 
     fprintf(file, "</bbbm>\n");
     bbbm_options_close_file(file, filename);
@@ -368,6 +588,34 @@ gboolean bbbm_options_set_thumb_column_count(BBBMOptions *options, const guint c
     return FALSE;
 }
 
+const gboolean bbbm_options_get_thumb_deferred(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    return options->thumb_deferred;
+}
+
+gboolean bbbm_options_set_thumb_deferred(BBBMOptions *options, const gboolean deferred) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (deferred != options->thumb_deferred) {
+        options->thumb_deferred = deferred;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const guint bbbm_options_get_decode_memory(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, 0);
+    return options->decode_memory;
+}
+
+gboolean bbbm_options_set_decode_memory(BBBMOptions *options, const guint decode_memory) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (decode_memory != options->decode_memory) {
+        options->decode_memory = decode_memory;
+        return TRUE;
+    }
+    return FALSE;
+}
+
 const gboolean bbbm_options_get_filename_as_label(BBBMOptions *options) {
     g_return_val_if_fail(options != NULL, FALSE);
     return options->filename_as_label;
@@ -396,6 +644,34 @@ gboolean bbbm_options_set_filename_as_title(BBBMOptions *options, const gboolean
     return FALSE;
 }
 
+const BBBMMenuSplit bbbm_options_get_menu_split(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, BBBM_OPTIONS_DEFAULT_MENU_SPLIT);
+    return options->menu_split;
+}
+
+gboolean bbbm_options_set_menu_split(BBBMOptions *options, const BBBMMenuSplit menu_split) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (menu_split != options->menu_split) {
+        options->menu_split = menu_split;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const guint bbbm_options_get_menu_page_size(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, 0);
+    return options->menu_page_size;
+}
+
+gboolean bbbm_options_set_menu_page_size(BBBMOptions *options, const guint menu_page_size) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (menu_page_size != options->menu_page_size) {
+        options->menu_page_size = menu_page_size;
+        return TRUE;
+    }
+    return FALSE;
+}
+
 const guint bbbm_options_get_command_count(BBBMOptions *options) {
     g_return_val_if_fail(options != NULL, 0);
     return g_list_length(options->commands);
@@ -455,6 +731,118 @@ void bbbm_options_add_command(BBBMOptions *options, const gchar *command, const
     options->commands = g_list_append(options->commands, cmd);
 }
 
+const guint bbbm_options_get_max_jobs(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, 0);
+    return options->max_jobs;
+}
+
+gboolean bbbm_options_set_max_jobs(BBBMOptions *options, const guint max_jobs) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (max_jobs != options->max_jobs) {
+        options->max_jobs = max_jobs;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const guint bbbm_options_get_job_timeout(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, 0);
+    return options->job_timeout;
+}
+
+gboolean bbbm_options_set_job_timeout(BBBMOptions *options, const guint job_timeout) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (job_timeout != options->job_timeout) {
+        options->job_timeout = job_timeout;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const gboolean bbbm_options_get_builtin_setter(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    return options->builtin_setter;
+}
+
+gboolean bbbm_options_set_builtin_setter(BBBMOptions *options, const gboolean builtin_setter) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (builtin_setter != options->builtin_setter) {
+        options->builtin_setter = builtin_setter;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const BBBMRenderMode bbbm_options_get_background_mode(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, BBBM_OPTIONS_DEFAULT_BACKGROUND_MODE);
+    return options->background_mode;
+}
+
+gboolean bbbm_options_set_background_mode(BBBMOptions *options, const BBBMRenderMode background_mode) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (background_mode != options->background_mode) {
+        options->background_mode = background_mode;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const guint bbbm_options_get_pixmap_cache_size(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, 0);
+    return options->pixmap_cache_size;
+}
+
+gboolean bbbm_options_set_pixmap_cache_size(BBBMOptions *options, const guint pixmap_cache_size) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (pixmap_cache_size != options->pixmap_cache_size) {
+        options->pixmap_cache_size = pixmap_cache_size;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const gboolean bbbm_options_get_render_cache(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    return options->render_cache;
+}
+
+gboolean bbbm_options_set_render_cache(BBBMOptions *options, const gboolean render_cache) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (render_cache != options->render_cache) {
+        options->render_cache = render_cache;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const guint bbbm_options_get_transition(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, 0);
+    return options->transition;
+}
+
+gboolean bbbm_options_set_transition(BBBMOptions *options, const guint transition) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (transition != options->transition) {
+        options->transition = transition;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const BBBMRandomMode bbbm_options_get_random_mode(BBBMOptions *options) {
+    g_return_val_if_fail(options != NULL, BBBM_OPTIONS_DEFAULT_RANDOM_MODE);
+    return options->random_mode;
+}
+
+gboolean bbbm_options_set_random_mode(BBBMOptions *options, const BBBMRandomMode random_mode) {
+    g_return_val_if_fail(options != NULL, FALSE);
+    if (random_mode != options->random_mode) {
+        options->random_mode = random_mode;
+        return TRUE;
+    }
+    return FALSE;
+}
+
 void bbbm_options_destroy(BBBMOptions *options) {
     g_return_if_fail(options != NULL);
     g_free(options->set_command);
@@ -511,49 +899,35 @@ static void bbbm_options_parse_start_element(GMarkupParseContext *context,
             bbbm_options_parse_check_attributes(element_name, attribute_names, error);
             break;
         case 2:
-            /* allowed: thumbs, menu, commands */
-            if (!parse_data->found_thumbs) {
-                /* didn't find thumbs yet, so element_name must be thumbs, menu or commands */
-                if (bbbm_str_equals("thumbs", element_name)) {
+            /* allowed: thumbs, menu, commands, jobs; in that order, and only commands is required */
+            switch (bbbm_options_parse_ordered_element(element_name, bbbm_options_sections,
+                                                       &(parse_data->next_section), error)) {
+                case BBBM_OPTIONS_SECTION_THUMBS:
                     bbbm_options_parse_check_attributes(element_name, attribute_names, error);
                     parse_data->found_thumbs = TRUE;
-                } else if (bbbm_str_equals("menu", element_name)) {
+                    break;
+                case BBBM_OPTIONS_SECTION_MENU:
                     bbbm_options_parse_check_attributes(element_name, attribute_names, error);
                     parse_data->found_menu = TRUE;
-                } else if (bbbm_str_equals("commands", element_name)) {
+                    break;
+                case BBBM_OPTIONS_SECTION_COMMANDS:
                     bbbm_options_parse_check_attributes(element_name, attribute_names, error);
                     parse_data->found_commands = TRUE;
-                } else {
-                    bbbm_options_parse_invalid_element(error, element_name, "thumbs, menu, commands");
-                }
-            } else if (!parse_data->found_menu) {
-                /* found thumbs but not menu, so element_name must be menu or commands */
-                if (bbbm_str_equals("menu", element_name)) {
-                    bbbm_options_parse_check_attributes(element_name, attribute_names, error);
-                    parse_data->found_menu = TRUE;
-                } else if (bbbm_str_equals("commands", element_name)) {
+                    break;
+                case BBBM_OPTIONS_SECTION_JOBS:
                     bbbm_options_parse_check_attributes(element_name, attribute_names, error);
-                    parse_data->found_commands = TRUE;
-                } else {
-                    bbbm_options_parse_invalid_element(error, element_name, "menu, commands");
-                }
-            } else if (!parse_data->found_commands) {
-                /* found thumbs and menu but not commands, so element_name must be commands */
-                if (bbbm_str_equals("commands", element_name)) {
+                    parse_data->found_jobs = TRUE;
+                    break;
+                case BBBM_OPTIONS_SECTION_BACKGROUND:
                     bbbm_options_parse_check_attributes(element_name, attribute_names, error);
-                    parse_data->found_commands = TRUE;
-                } else {
-                    bbbm_options_parse_invalid_element(error, element_name, "commands");
-                }
-            } else {
-                /* found thumbs, menu and commands; no other element names allowed */
-                bbbm_options_parse_invalid_element(error, element_name, NULL);
+                    parse_data->found_background = TRUE;
+                    break;
             }
             break;
         case 3:
             parent_element_name = (const gchar *) g_slist_next(element_stack)->data;
             if (bbbm_str_equals("thumbs", parent_element_name)) {
-                /* allowed: size, column-count */
+                /* allowed: size, column-count, deferred, decode-memory */
                 if (!parse_data->found_thumb_size) {
                     /* didn't find size yet, so element_name must be size or column-count */
                     if (bbbm_str_equals("size", element_name)) {
@@ -579,8 +953,30 @@ static void bbbm_options_parse_start_element(GMarkupParseContext *context,
                     } else {
                         bbbm_options_parse_invalid_element(error, element_name, "column-count");
                     }
+                } else if (!parse_data->found_thumb_deferred && !parse_data->found_decode_memory) {
+                    /* found size and column-count, so element_name must be the optional deferred or decode-memory */
+                    if (bbbm_str_equals("deferred", element_name)) {
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_thumb_deferred = TRUE;
+                        /* content is handled in text + end_element handling */
+                    } else if (bbbm_str_equals("decode-memory", element_name)) {
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_decode_memory = TRUE;
+                        /* content is handled in text + end_element handling */
+                    } else {
+                        bbbm_options_parse_invalid_element(error, element_name, "deferred, decode-memory");
+                    }
+                } else if (!parse_data->found_decode_memory) {
+                    /* found deferred, so element_name must be the optional decode-memory */
+                    if (bbbm_str_equals("decode-memory", element_name)) {
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_decode_memory = TRUE;
+                        /* content is handled in text + end_element handling */
+                    } else {
+                        bbbm_options_parse_invalid_element(error, element_name, "decode-memory");
+                    }
                 } else {
-                    /* found size and column-count; no other element names allowed */
+                    /* found decode-memory, which comes last; no other element names allowed */
                     bbbm_options_parse_invalid_element(error, element_name, NULL);
                 }
             } else if (bbbm_str_equals("menu", parent_element_name)) {
@@ -608,8 +1004,20 @@ static void bbbm_options_parse_start_element(GMarkupParseContext *context,
                         bbbm_options_parse_invalid_element(error, element_name, "filename-as-title");
                     }
                 } else {
-                    /* found filename-as-label and filename-as-title; no other element names allowed */
-                    bbbm_options_parse_invalid_element(error, element_name, NULL);
+                    /* found filename-as-label and filename-as-title; only split and page-size are allowed, both optional */
+                    switch (bbbm_options_parse_ordered_element(element_name, bbbm_options_menu_elements,
+                                                               &(parse_data->next_menu_element), error)) {
+                        case BBBM_OPTIONS_MENU_SPLIT:
+                            bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                            parse_data->found_menu_split = TRUE;
+                            /* content is handled in text + end_element handling */
+                            break;
+                        case BBBM_OPTIONS_MENU_PAGE_SIZE:
+                            bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                            parse_data->found_menu_page_size = TRUE;
+                            /* content is handled in text + end_element handling */
+                            break;
+                    }
                 }
             } else if (bbbm_str_equals("commands", parent_element_name)) {
                 /* allowed: set-command, command* */
@@ -633,6 +1041,56 @@ static void bbbm_options_parse_start_element(GMarkupParseContext *context,
                         bbbm_options_parse_invalid_element(error, element_name, "command");
                     }
                 }
+            } else if (bbbm_str_equals("jobs", parent_element_name)) {
+                /* allowed: max-count, timeout; both are optional */
+                switch (bbbm_options_parse_ordered_element(element_name, bbbm_options_jobs_elements,
+                                                           &(parse_data->next_jobs_element), error)) {
+                    case BBBM_OPTIONS_JOBS_MAX_COUNT:
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_max_jobs = TRUE;
+                        /* content is handled in text + end_element handling */
+                        break;
+                    case BBBM_OPTIONS_JOBS_TIMEOUT:
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_job_timeout = TRUE;
+                        /* content is handled in text + end_element handling */
+                        break;
+                }
+            } else if (bbbm_str_equals("background", parent_element_name)) {
+                /* allowed: builtin, mode, cache-size, render-cache, transition, random; all are optional */
+                switch (bbbm_options_parse_ordered_element(element_name, bbbm_options_background_elements,
+                                                           &(parse_data->next_background_element), error)) {
+                    case BBBM_OPTIONS_BACKGROUND_BUILTIN:
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_builtin_setter = TRUE;
+                        /* content is handled in text + end_element handling */
+                        break;
+                    case BBBM_OPTIONS_BACKGROUND_MODE:
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_background_mode = TRUE;
+                        /* content is handled in text + end_element handling */
+                        break;
+                    case BBBM_OPTIONS_BACKGROUND_CACHE_SIZE:
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_pixmap_cache_size = TRUE;
+                        /* content is handled in text + end_element handling */
+                        break;
+                    case BBBM_OPTIONS_BACKGROUND_RENDER_CACHE:
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_render_cache = TRUE;
+                        /* content is handled in text + end_element handling */
+                        break;
+                    case BBBM_OPTIONS_BACKGROUND_TRANSITION:
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_transition = TRUE;
+                        /* content is handled in text + end_element handling */
+                        break;
+                    case BBBM_OPTIONS_BACKGROUND_RANDOM:
+                        bbbm_options_parse_check_attributes(element_name, attribute_names, error);
+                        parse_data->found_random_mode = TRUE;
+                        /* content is handled in text + end_element handling */
+                        break;
+                }
             } else {
                 /* should not occur; any other depth=2 elements should have produced an error */
                 bbbm_options_parse_invalid_element(error, element_name, NULL);
@@ -722,9 +1180,10 @@ static void bbbm_options_parse_end_element(GMarkupParseContext *context,
             }
             break;
         case 2:
-            /* allowed: thumbs, menu, commands */
+            /* allowed: thumbs, menu, commands, jobs, background */
             /* for commands, set-command must have been found */
-            if (bbbm_str_equals("thumbs", element_name) || bbbm_str_equals("menu", element_name)) {
+            if (bbbm_str_equals("thumbs", element_name) || bbbm_str_equals("menu", element_name)
+                || bbbm_str_equals("jobs", element_name) || bbbm_str_equals("background", element_name)) {
                 bbbm_options_parse_check_empty_content(element_name, text, error);
             } else if (bbbm_str_equals("commands", element_name)) {
                 if (!parse_data->found_set_command) {
@@ -737,7 +1196,7 @@ static void bbbm_options_parse_end_element(GMarkupParseContext *context,
         case 3:
             parent_element_name = (const gchar *) g_slist_next(element_stack)->data;
             if (bbbm_str_equals("thumbs", parent_element_name)) {
-                /* allowed: size, column-count */
+                /* allowed: size, column-count, deferred, decode-memory */
                 if (bbbm_str_equals("size", element_name)) {
                     bbbm_options_parse_check_empty_content(element_name, text, error);
                 } else if (bbbm_str_equals("column-count", element_name)) {
@@ -746,6 +1205,18 @@ static void bbbm_options_parse_end_element(GMarkupParseContext *context,
                                                    error);
                     g_debug("found thumb column count %d",
                             parse_data->options->thumb_column_count);
+                } else if (bbbm_str_equals("deferred", element_name)) {
+                    bbbm_options_parse_text_to_boolean(element_name, text,
+                                                       &(parse_data->options->thumb_deferred),
+                                                       error);
+                    g_debug("found deferred thumbs %s",
+                            parse_data->options->thumb_deferred ? "true" : "false");
+                } else if (bbbm_str_equals("decode-memory", element_name)) {
+                    bbbm_options_parse_text_to_int(element_name, text,
+                                                   &(parse_data->options->decode_memory),
+                                                   error);
+                    g_debug("found decode memory %d",
+                            parse_data->options->decode_memory);
                 }
             } else if (bbbm_str_equals("menu", parent_element_name)) {
                 /* allowed: filename-as-label, filename-as-title */
@@ -761,6 +1232,18 @@ static void bbbm_options_parse_end_element(GMarkupParseContext *context,
                                                        error);
                     g_debug("found filename-as-title %s",
                             parse_data->options->filename_as_title ? "true" : "false");
+                } else if (bbbm_str_equals("split", element_name)) {
+                    bbbm_options_parse_text_to_menu_split(element_name, text,
+                                                          &(parse_data->options->menu_split),
+                                                          error);
+                    g_debug("found menu split %s",
+                            bbbm_options_menu_split_names[parse_data->options->menu_split]);
+                } else if (bbbm_str_equals("page-size", element_name)) {
+                    bbbm_options_parse_text_to_int(element_name, text,
+                                                   &(parse_data->options->menu_page_size),
+                                                   error);
+                    g_debug("found menu page size %d",
+                            parse_data->options->menu_page_size);
                 }
             } else if (bbbm_str_equals("commands", parent_element_name)) {
                 /* allowed: set-command, command* */
@@ -779,6 +1262,60 @@ static void bbbm_options_parse_end_element(GMarkupParseContext *context,
                     parse_data->command = NULL;
                     parse_data->command_label = NULL;
                 }
+            } else if (bbbm_str_equals("jobs", parent_element_name)) {
+                /* allowed: max-count, timeout */
+                if (bbbm_str_equals("max-count", element_name)) {
+                    bbbm_options_parse_text_to_int(element_name, text,
+                                                   &(parse_data->options->max_jobs),
+                                                   error);
+                    g_debug("found max job count %d",
+                            parse_data->options->max_jobs);
+                } else if (bbbm_str_equals("timeout", element_name)) {
+                    bbbm_options_parse_text_to_int(element_name, text,
+                                                   &(parse_data->options->job_timeout),
+                                                   error);
+                    g_debug("found job timeout %d",
+                            parse_data->options->job_timeout);
+                }
+            } else if (bbbm_str_equals("background", parent_element_name)) {
+                /* allowed: builtin, mode, cache-size, render-cache, transition, random */
+                if (bbbm_str_equals("builtin", element_name)) {
+                    bbbm_options_parse_text_to_boolean(element_name, text,
+                                                       &(parse_data->options->builtin_setter),
+                                                       error);
+                    g_debug("found builtin background setter %s",
+                            parse_data->options->builtin_setter ? "true" : "false");
+                } else if (bbbm_str_equals("mode", element_name)) {
+                    bbbm_options_parse_text_to_render_mode(element_name, text,
+                                                           &(parse_data->options->background_mode),
+                                                           error);
+                    g_debug("found background mode %s",
+                            bbbm_render_mode_to_string(parse_data->options->background_mode));
+                } else if (bbbm_str_equals("cache-size", element_name)) {
+                    bbbm_options_parse_text_to_int(element_name, text,
+                                                   &(parse_data->options->pixmap_cache_size),
+                                                   error);
+                    g_debug("found pixmap cache size %d",
+                            parse_data->options->pixmap_cache_size);
+                } else if (bbbm_str_equals("render-cache", element_name)) {
+                    bbbm_options_parse_text_to_boolean(element_name, text,
+                                                       &(parse_data->options->render_cache),
+                                                       error);
+                    g_debug("found render cache %s",
+                            parse_data->options->render_cache ? "true" : "false");
+                } else if (bbbm_str_equals("transition", element_name)) {
+                    bbbm_options_parse_text_to_int(element_name, text,
+                                                   &(parse_data->options->transition),
+                                                   error);
+                    g_debug("found transition %d",
+                            parse_data->options->transition);
+                } else if (bbbm_str_equals("random", element_name)) {
+                    bbbm_options_parse_text_to_random_mode(element_name, text,
+                                                           &(parse_data->options->random_mode),
+                                                           error);
+                    g_debug("found random mode %s",
+                            bbbm_options_random_mode_names[parse_data->options->random_mode]);
+                }
             }
             break;
         case 4:
@@ -874,6 +1411,72 @@ static gboolean bbbm_options_parse_text_to_boolean(const gchar *element_name, GS
     return FALSE;
 }
 
+static gboolean bbbm_options_parse_text_to_menu_split(const gchar *element_name, GString *content,
+                                                      BBBMMenuSplit *result,
+                                                      GError **error) {
+    guint i;
+
+    for (i = 0; content != NULL && bbbm_options_menu_split_names[i] != NULL; ++i) {
+        if (bbbm_str_equals(content->str, bbbm_options_menu_split_names[i])) {
+            *result = (BBBMMenuSplit) i;
+            return TRUE;
+        }
+    }
+    g_set_error(error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                "The value '%s' of element '%s' is not a valid value for 'split'; one of none, directory, letter is expected",
+                content ? content->str : "", element_name);
+    return FALSE;
+}
+
+static gboolean bbbm_options_parse_text_to_random_mode(const gchar *element_name, GString *content,
+                                                       BBBMRandomMode *result,
+                                                       GError **error) {
+    guint i;
+
+    for (i = 0; content != NULL && bbbm_options_random_mode_names[i] != NULL; ++i) {
+        if (bbbm_str_equals(content->str, bbbm_options_random_mode_names[i])) {
+            *result = (BBBMRandomMode) i;
+            return TRUE;
+        }
+    }
+    g_set_error(error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                "The value '%s' of element '%s' is not a valid value for 'random'; one of any, weighted, fitting is expected",
+                content ? content->str : "", element_name);
+    return FALSE;
+}
+
+static gboolean bbbm_options_parse_text_to_render_mode(const gchar *element_name, GString *content,
+                                                       BBBMRenderMode *result,
+                                                       GError **error) {
+    if (content != NULL && bbbm_render_mode_from_string(content->str, result)) {
+        return TRUE;
+    }
+    g_set_error(error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                "The value '%s' of element '%s' is not a valid value for 'mode'; one of fill, fit, center, tile is expected",
+                content ? content->str : "", element_name);
+    return FALSE;
+}
+
+static gint bbbm_options_parse_ordered_element(const gchar *element_name, const gchar **names, guint *next,
+                                               GError **error) {
+    guint i;
+
+    for (i = *next; names[i] != NULL; i++) {
+        if (bbbm_str_equals(names[i], element_name)) {
+            *next = i + 1;
+            return i;
+        }
+    }
+    if (names[*next] != NULL) {
+        gchar *expected = g_strjoinv(", ", (gchar **) names + *next);
+        bbbm_options_parse_invalid_element(error, element_name, expected);
+        g_free(expected);
+    } else {
+        bbbm_options_parse_invalid_element(error, element_name, NULL);
+    }
+    return -1;
+}
+
 static gboolean bbbm_options_parse_check_attributes(const gchar *element_name, const gchar **names, GError **error) {
     if (names[0] != NULL) {
         bbbm_options_parse_invalid_attribute(error, element_name, names[0]);
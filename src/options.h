@@ -23,10 +23,32 @@
 
 #include <glib.h>
 #include "command.h"
+#include "render.h"
 
-#define BBBM_OPTIONS_MAX_THUMB_WIDTH         (gdk_screen_width())
-#define BBBM_OPTIONS_MAX_THUMB_HEIGHT        (gdk_screen_height())
+/* without a display (batch mode) there is no screen to limit the thumb size */
+#define BBBM_OPTIONS_MAX_THUMB_WIDTH         (gdk_display_get_default() != NULL ? gdk_screen_width() : G_MAXINT)
+#define BBBM_OPTIONS_MAX_THUMB_HEIGHT        (gdk_display_get_default() != NULL ? gdk_screen_height() : G_MAXINT)
 #define BBBM_OPTIONS_MAX_THUMB_COLUMN_COUNT  100
+#define BBBM_OPTIONS_MAX_MENU_PAGE_SIZE      10000
+#define BBBM_OPTIONS_MAX_MAX_JOBS            64
+#define BBBM_OPTIONS_MAX_JOB_TIMEOUT         86400
+#define BBBM_OPTIONS_MAX_PIXMAP_CACHE_SIZE   32
+#define BBBM_OPTIONS_MAX_TRANSITION          5000
+#define BBBM_OPTIONS_MAX_DECODE_MEMORY       65536
+
+/* How generated menus are split into submenus */
+typedef enum {
+    BBBM_MENU_SPLIT_NONE,
+    BBBM_MENU_SPLIT_DIRECTORY,
+    BBBM_MENU_SPLIT_LETTER
+} BBBMMenuSplit;
+
+/* How random backgrounds are picked, based on how well images fit the screen */
+typedef enum {
+    BBBM_RANDOM_ANY,
+    BBBM_RANDOM_WEIGHTED,
+    BBBM_RANDOM_FITTING
+} BBBMRandomMode;
 
 typedef struct _BBBMOptions BBBMOptions;
 
@@ -35,9 +57,21 @@ struct _BBBMOptions {
     guint thumb_width;
     guint thumb_height;
     guint thumb_column_count;
+    gboolean thumb_deferred;
+    guint decode_memory;
     gboolean filename_as_label;
     gboolean filename_as_title;
+    BBBMMenuSplit menu_split;
+    guint menu_page_size;
     GList *commands;
+    guint max_jobs;
+    guint job_timeout;
+    gboolean builtin_setter;
+    BBBMRenderMode background_mode;
+    guint pixmap_cache_size;
+    gboolean render_cache;
+    guint transition;
+    BBBMRandomMode random_mode;
 };
 
 /* Creates a new BBBMOptions object with default settings.
@@ -62,12 +96,28 @@ gboolean bbbm_options_set_thumb_size(BBBMOptions *options, const guint width, co
 const guint bbbm_options_get_thumb_column_count(BBBMOptions *options);
 gboolean bbbm_options_set_thumb_column_count(BBBMOptions *options, const guint column_count);
 
+/* Whether thumbs are shown before their images are checked and decoded, which happens in the background */
+const gboolean bbbm_options_get_thumb_deferred(BBBMOptions *options);
+gboolean bbbm_options_set_thumb_deferred(BBBMOptions *options, const gboolean deferred);
+
+/* the number of megabytes thumbnail decodes may use at once, as estimated from the image headers; 0 for no limit */
+const guint bbbm_options_get_decode_memory(BBBMOptions *options);
+gboolean bbbm_options_set_decode_memory(BBBMOptions *options, const guint decode_memory);
+
 const gboolean bbbm_options_get_filename_as_label(BBBMOptions *options);
 gboolean bbbm_options_set_filename_as_label(BBBMOptions *options, const gboolean filename_as_label);
 
 const gboolean bbbm_options_get_filename_as_title(BBBMOptions *options);
 gboolean bbbm_options_set_filename_as_title(BBBMOptions *options, const gboolean filename_as_title);
 
+/* how generated menus are split into submenus */
+const BBBMMenuSplit bbbm_options_get_menu_split(BBBMOptions *options);
+gboolean bbbm_options_set_menu_split(BBBMOptions *options, const BBBMMenuSplit menu_split);
+
+/* the maximum number of entries per generated (sub)menu before it is split into pages; 0 for no limit */
+const guint bbbm_options_get_menu_page_size(BBBMOptions *options);
+gboolean bbbm_options_set_menu_page_size(BBBMOptions *options, const guint menu_page_size);
+
 const guint bbbm_options_get_command_count(BBBMOptions *options);
 gboolean bbbm_options_set_command_count(BBBMOptions *options, const guint command_count);
 
@@ -76,6 +126,38 @@ const BBBMCommand *bbbm_options_get_command(BBBMOptions *options, const guint in
 gboolean bbbm_options_set_command(BBBMOptions *options, const guint index, const gchar *command, const gchar *label);
 void bbbm_options_add_command(BBBMOptions *options, const gchar *command, const gchar *label);
 
+/* the maximum number of commands that run in parallel when applied to several images */
+const guint bbbm_options_get_max_jobs(BBBMOptions *options);
+gboolean bbbm_options_set_max_jobs(BBBMOptions *options, const guint max_jobs);
+
+/* the number of seconds after which a command is killed, or 0 to let commands run forever */
+const guint bbbm_options_get_job_timeout(BBBMOptions *options);
+gboolean bbbm_options_set_job_timeout(BBBMOptions *options, const guint job_timeout);
+
+/* whether backgrounds are set by bbbm itself instead of the set command */
+const gboolean bbbm_options_get_builtin_setter(BBBMOptions *options);
+gboolean bbbm_options_set_builtin_setter(BBBMOptions *options, const gboolean builtin_setter);
+
+/* how the built-in setter fits images to the screen */
+const BBBMRenderMode bbbm_options_get_background_mode(BBBMOptions *options);
+gboolean bbbm_options_set_background_mode(BBBMOptions *options, const BBBMRenderMode background_mode);
+
+/* the number of screen-sized pixmaps the built-in setter keeps */
+const guint bbbm_options_get_pixmap_cache_size(BBBMOptions *options);
+gboolean bbbm_options_set_pixmap_cache_size(BBBMOptions *options, const guint pixmap_cache_size);
+
+/* whether the set command gets a copy of the image that is already fitted to the screen */
+const gboolean bbbm_options_get_render_cache(BBBMOptions *options);
+gboolean bbbm_options_set_render_cache(BBBMOptions *options, const gboolean render_cache);
+
+/* the number of milliseconds the built-in setter crossfades from one background to the next; 0 for none */
+const guint bbbm_options_get_transition(BBBMOptions *options);
+gboolean bbbm_options_set_transition(BBBMOptions *options, const guint transition);
+
+/* whether random backgrounds favour, or are limited to, images that fit the screen */
+const BBBMRandomMode bbbm_options_get_random_mode(BBBMOptions *options);
+gboolean bbbm_options_set_random_mode(BBBMOptions *options, const BBBMRandomMode random_mode);
+
 void bbbm_options_destroy(BBBMOptions *options);
 
 #endif /* __BBBM_OPTIONS_H_ */
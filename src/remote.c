@@ -0,0 +1,234 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <glib.h>
+#include "config.h"
+#include "remote.h"
+#include "util.h"
+#include "compat.h"
+
+struct _BBBMRemote {
+    gchar *socket_path;
+    GIOChannel *channel;
+    guint watch_id;
+    bbbm_remote_function function;
+    gpointer data;
+};
+
+static gboolean bbbm_remote_create_address(const gchar *socket_path, struct sockaddr_un *address);
+static gboolean bbbm_remote_accept(GIOChannel *source, GIOCondition condition, BBBMRemote *remote);
+static gboolean bbbm_remote_read(GIOChannel *source, GIOCondition condition, BBBMRemote *remote);
+static void bbbm_remote_handle_line(BBBMRemote *remote, gchar *line);
+
+gchar *bbbm_remote_get_socket_path(const gchar *config_file) {
+    gchar *dir, *name, *path;
+    const gchar *display;
+
+    display = g_getenv("DISPLAY");
+    dir = g_path_get_dirname(config_file);
+    name = g_strdup_printf("bbbm-%s%s.socket", g_get_host_name(), bbbm_str_empty(display) ? "" : display);
+    /* a display like "localhost:10.0" would otherwise add an additional '/' when forwarded */
+    g_strdelimit(name, "/", '_');
+    path = g_build_filename(dir, name, NULL);
+    g_free(name);
+    g_free(dir);
+    return path;
+}
+
+gboolean bbbm_remote_send(const gchar *socket_path, GList *commands) {
+    struct sockaddr_un address;
+    GList *iterator;
+    gint fd;
+
+    g_return_val_if_fail(socket_path != NULL, FALSE);
+
+    if (!bbbm_remote_create_address(socket_path, &address)) {
+        return FALSE;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        g_warning("could not create socket: %s", g_strerror(errno));
+        return FALSE;
+    }
+    if (connect(fd, (struct sockaddr *) &address, sizeof(address)) == -1) {
+        /* no instance listening; this is not an error */
+        g_debug("could not connect to '%s': %s", socket_path, g_strerror(errno));
+        close(fd);
+        return FALSE;
+    }
+    for (iterator = commands; iterator != NULL; iterator = iterator->next) {
+        gchar *line;
+        gsize len, written;
+
+        line = g_strconcat((const gchar *) iterator->data, "\n", NULL);
+        len = strlen(line);
+        for (written = 0; written < len; ) {
+            /* an instance that goes away mid-send must not raise SIGPIPE in this one */
+            gssize count = send(fd, line + written, len - written, MSG_NOSIGNAL);
+            if (count == -1 && errno != EINTR) {
+                g_warning("could not send '%s' to '%s': %s", (const gchar *) iterator->data, socket_path, g_strerror(errno));
+                g_free(line);
+                close(fd);
+                return FALSE;
+            }
+            written += MAX(count, 0);
+        }
+        g_debug("sent '%s' to '%s'", (const gchar *) iterator->data, socket_path);
+        g_free(line);
+    }
+    close(fd);
+    return TRUE;
+}
+
+BBBMRemote *bbbm_remote_new(const gchar *socket_path, bbbm_remote_function function, gpointer data) {
+    struct sockaddr_un address;
+    BBBMRemote *remote;
+    mode_t mask;
+    gint fd;
+
+    g_return_val_if_fail(socket_path != NULL, NULL);
+    g_return_val_if_fail(function != NULL, NULL);
+
+    if (!bbbm_remote_create_address(socket_path, &address)) {
+        return NULL;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        g_warning("could not create socket: %s", g_strerror(errno));
+        return NULL;
+    }
+    /* spawned commands must not keep the socket open */
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    /* a socket left behind by a crashed instance would make bind fail; bbbm_remote_send already found nobody listens */
+    if (g_file_test(socket_path, G_FILE_TEST_EXISTS) && unlink(socket_path) == -1) {
+        g_warning("could not remove stale socket '%s': %s", socket_path, g_strerror(errno));
+    }
+    /* only the current user may control this instance */
+    mask = umask(0077);
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address)) == -1 || listen(fd, 5) == -1) {
+        g_warning("could not listen on '%s': %s", socket_path, g_strerror(errno));
+        umask(mask);
+        close(fd);
+        return NULL;
+    }
+    umask(mask);
+
+    remote = g_malloc(sizeof(BBBMRemote));
+    remote->socket_path = g_strdup(socket_path);
+    remote->function    = function;
+    remote->data        = data;
+    remote->channel     = g_io_channel_unix_new(fd);
+    g_io_channel_set_close_on_unref(remote->channel, TRUE);
+    remote->watch_id    = g_io_add_watch(remote->channel, G_IO_IN, (GIOFunc) bbbm_remote_accept, remote);
+
+    g_debug("listening on '%s'", socket_path);
+    return remote;
+}
+
+void bbbm_remote_destroy(BBBMRemote *remote) {
+    g_return_if_fail(remote != NULL);
+    g_source_remove(remote->watch_id);
+    g_io_channel_unref(remote->channel);
+    if (unlink(remote->socket_path) == -1) {
+        g_warning("could not remove socket '%s': %s", remote->socket_path, g_strerror(errno));
+    }
+    g_free(remote->socket_path);
+    g_free(remote);
+}
+
+static gboolean bbbm_remote_create_address(const gchar *socket_path, struct sockaddr_un *address) {
+    if (strlen(socket_path) >= sizeof(address->sun_path)) {
+        g_warning("socket path '%s' is too long", socket_path);
+        return FALSE;
+    }
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, socket_path);
+    return TRUE;
+}
+
+static gboolean bbbm_remote_accept(GIOChannel *source, GIOCondition condition, BBBMRemote *remote) {
+    GIOChannel *channel;
+    gint fd;
+
+    fd = accept(g_io_channel_unix_get_fd(source), NULL, NULL);
+    if (fd == -1) {
+        g_warning("could not accept connection on '%s': %s", remote->socket_path, g_strerror(errno));
+        /* keep listening */
+        return TRUE;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    channel = g_io_channel_unix_new(fd);
+    g_io_channel_set_close_on_unref(channel, TRUE);
+    /* file names need not be UTF-8 */
+    g_io_channel_set_encoding(channel, NULL, NULL);
+    g_io_channel_set_flags(channel, G_IO_FLAG_NONBLOCK, NULL);
+    /* the watch holds the only reference from here on */
+    g_io_add_watch(channel, G_IO_IN | G_IO_HUP | G_IO_ERR, (GIOFunc) bbbm_remote_read, remote);
+    g_io_channel_unref(channel);
+    return TRUE;
+}
+
+static gboolean bbbm_remote_read(GIOChannel *source, GIOCondition condition, BBBMRemote *remote) {
+    GIOStatus status;
+    gchar *line;
+    gsize terminator;
+    GError *error = NULL;
+
+    while ((status = g_io_channel_read_line(source, &line, NULL, &terminator, &error)) == G_IO_STATUS_NORMAL) {
+        /* only the newline is removed; file names may start or end with spaces */
+        line[terminator] = '\0';
+        bbbm_remote_handle_line(remote, line);
+        g_free(line);
+    }
+    if (status == G_IO_STATUS_ERROR) {
+        g_warning("could not read from '%s': %s", remote->socket_path, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    if (status == G_IO_STATUS_EOF) {
+        return FALSE;
+    }
+    /* G_IO_STATUS_AGAIN: wait for more data */
+    return (condition & (G_IO_HUP | G_IO_ERR)) == 0;
+}
+
+static void bbbm_remote_handle_line(BBBMRemote *remote, gchar *line) {
+    gchar *argument;
+
+    if (*line == '\0') {
+        return;
+    }
+    argument = strchr(line, ' ');
+    if (argument != NULL) {
+        *argument++ = '\0';
+    }
+    g_debug("received command '%s' with argument '%s'", line, argument ? argument : "");
+    remote->function(remote->data, line, argument);
+}
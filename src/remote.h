@@ -0,0 +1,55 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_REMOTE_H_
+#define __BBBM_REMOTE_H_
+
+#include <glib.h>
+
+/* the commands that can be sent to a running instance */
+#define BBBM_REMOTE_OPEN     "open"    /* argument: collection file */
+#define BBBM_REMOTE_ADD      "add"     /* argument: image file */
+#define BBBM_REMOTE_RANDOM   "random"  /* no argument */
+#define BBBM_REMOTE_PRESENT  "present" /* no argument */
+
+typedef struct _BBBMRemote BBBMRemote;
+
+/* Called for each command received by a BBBMRemote; the argument is NULL for commands without one */
+typedef void (* bbbm_remote_function) (gpointer data, const gchar *command, const gchar *argument);
+
+/* Returns the path of the control socket that belongs to the given configuration file.
+   The socket is specific for the host and display, so instances on other displays are never reused.
+   The returned string must be freed when no longer needed */
+gchar *bbbm_remote_get_socket_path(const gchar *config_file);
+
+/* Sends the given commands to the instance listening on the given socket.
+   Each element of the list is a string of the form "command" or "command argument".
+   Returns TRUE if an instance accepted the commands, or FALSE if there is no running instance */
+gboolean bbbm_remote_send(const gchar *socket_path, GList *commands);
+
+/* Starts listening on the given socket. The given function is called from the main loop for each received command.
+   Returns NULL if the socket could not be created, for instance because another instance is already listening.
+   The returned object must be destroyed with bbbm_remote_destroy when no longer needed */
+BBBMRemote *bbbm_remote_new(const gchar *socket_path, bbbm_remote_function function, gpointer data);
+
+/* Stops listening, and removes the socket */
+void bbbm_remote_destroy(BBBMRemote *remote);
+
+#endif /* __BBBM_REMOTE_H_ */
@@ -0,0 +1,218 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gdk/gdk.h>
+#include "config.h"
+#include "render.h"
+#include "util.h"
+#include "compat.h"
+
+static const gchar *bbbm_render_mode_names[] = { "fill", "fit", "center", "tile", NULL };
+
+static GdkPixbuf *bbbm_render_load(const gchar *filename, const GdkRectangle *areas, guint area_count,
+                                   BBBMRenderMode mode, GError **error);
+static GdkPixbuf *bbbm_render_fit(GdkPixbuf *source, gint width, gint height, BBBMRenderMode mode);
+static gdouble bbbm_render_get_scale(gint source_width, gint source_height, gint width, gint height,
+                                     BBBMRenderMode mode);
+static GdkPixbuf *bbbm_render_new_canvas(gint width, gint height);
+static void bbbm_render_place(GdkPixbuf *source, GdkPixbuf *dest, gint x, gint y);
+
+const gchar *bbbm_render_mode_to_string(BBBMRenderMode mode) {
+    g_return_val_if_fail(mode >= BBBM_RENDER_FILL && mode <= BBBM_RENDER_TILE, NULL);
+    return bbbm_render_mode_names[mode];
+}
+
+gboolean bbbm_render_mode_from_string(const gchar *string, BBBMRenderMode *mode) {
+    guint i;
+
+    for (i = 0; bbbm_render_mode_names[i] != NULL; ++i) {
+        if (bbbm_str_equals(string, bbbm_render_mode_names[i])) {
+            *mode = (BBBMRenderMode) i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+GdkPixbuf *bbbm_render_file(const gchar *filename, gint width, gint height, BBBMRenderMode mode, GError **error) {
+    GdkRectangle area = { 0, 0, width, height };
+    GdkPixbuf *source, *result;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+    g_return_val_if_fail(width > 0 && height > 0, NULL);
+
+    source = bbbm_render_load(filename, &area, 1, mode, error);
+    if (source == NULL) {
+        return NULL;
+    }
+    result = bbbm_render_fit(source, width, height, mode);
+    g_object_unref(source);
+    return result;
+}
+
+GdkPixbuf *bbbm_render_file_for_monitors(const gchar *filename, gint width, gint height,
+                                         const GdkRectangle *monitors, guint monitor_count,
+                                         BBBMRenderMode mode, GError **error) {
+    GdkPixbuf *source, *result;
+    guint i, j;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+    g_return_val_if_fail(width > 0 && height > 0, NULL);
+
+    if (monitor_count <= 1) {
+        /* a single monitor covers the entire screen */
+        return bbbm_render_file(filename, width, height, mode, error);
+    }
+
+    /* decoding is the expensive part, so it is done once, for the monitor that needs the most detail; the other
+       monitors get a scaled down copy */
+    source = bbbm_render_load(filename, monitors, monitor_count, mode, error);
+    if (source == NULL) {
+        return NULL;
+    }
+    result = bbbm_render_new_canvas(width, height);
+    for (i = 0; i < monitor_count; ++i) {
+        GdkPixbuf *fitted;
+
+        /* cloned outputs show the same part of the screen; render those only once */
+        for (j = 0; j < i; ++j) {
+            if (monitors[i].x == monitors[j].x && monitors[i].y == monitors[j].y
+                && monitors[i].width == monitors[j].width && monitors[i].height == monitors[j].height) {
+                break;
+            }
+        }
+        if (j < i) {
+            continue;
+        }
+        fitted = bbbm_render_fit(source, monitors[i].width, monitors[i].height, mode);
+        bbbm_render_place(fitted, result, monitors[i].x, monitors[i].y);
+        g_object_unref(fitted);
+    }
+    g_object_unref(source);
+    return result;
+}
+
+static GdkPixbuf *bbbm_render_load(const gchar *filename, const GdkRectangle *areas, guint area_count,
+                                   BBBMRenderMode mode, GError **error) {
+    GdkPixbuf *source;
+    gint source_width, source_height;
+    gdouble scale = 0;
+    guint i;
+
+    if (mode != BBBM_RENDER_FILL && mode != BBBM_RENDER_FIT) {
+        return gdk_pixbuf_new_from_file(filename, error);
+    }
+    if (gdk_pixbuf_get_file_info(filename, &source_width, &source_height) == NULL) {
+        g_set_error(error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_UNKNOWN_TYPE,
+                    "Could not recognize the image file format of '%s'", filename);
+        return NULL;
+    }
+    for (i = 0; i < area_count; ++i) {
+        scale = MAX(scale, bbbm_render_get_scale(source_width, source_height, areas[i].width, areas[i].height, mode));
+    }
+    source_width  = MAX((gint) (source_width * scale + 0.5), 1);
+    source_height = MAX((gint) (source_height * scale + 0.5), 1);
+#if HAVE_GDK_PIXBUF_NEW_FROM_FILE_AT_SCALE == 0
+    g_debug("gdk_pixbuf_new_from_file_at_scale is not available, scaling after loading instead");
+    source = gdk_pixbuf_new_from_file(filename, error);
+    if (source != NULL) {
+        GdkPixbuf *scaled = gdk_pixbuf_scale_simple(source, source_width, source_height, GDK_INTERP_BILINEAR);
+        g_object_unref(source);
+        source = scaled;
+    }
+#else
+    /* the loader can decode large JPEG files at a fraction of their size, which is a lot cheaper than scaling */
+    source = gdk_pixbuf_new_from_file_at_scale(filename, source_width, source_height, FALSE, error);
+#endif
+    return source;
+}
+
+static GdkPixbuf *bbbm_render_fit(GdkPixbuf *source, gint width, gint height, BBBMRenderMode mode) {
+    GdkPixbuf *scaled, *result;
+    gint source_width, source_height;
+    gint x, y;
+
+    source_width  = gdk_pixbuf_get_width(source);
+    source_height = gdk_pixbuf_get_height(source);
+    if (mode == BBBM_RENDER_FILL || mode == BBBM_RENDER_FIT) {
+        gdouble scale = bbbm_render_get_scale(source_width, source_height, width, height, mode);
+
+        source_width  = MAX((gint) (source_width * scale + 0.5), 1);
+        source_height = MAX((gint) (source_height * scale + 0.5), 1);
+    }
+    if (source_width != gdk_pixbuf_get_width(source) || source_height != gdk_pixbuf_get_height(source)) {
+        scaled = gdk_pixbuf_scale_simple(source, source_width, source_height, GDK_INTERP_BILINEAR);
+    } else {
+        scaled = g_object_ref(source);
+    }
+
+    if (source_width == width && source_height == height && !gdk_pixbuf_get_has_alpha(scaled)) {
+        /* nothing to crop, pad or tile */
+        return scaled;
+    }
+
+    result = bbbm_render_new_canvas(width, height);
+    if (mode == BBBM_RENDER_TILE) {
+        for (y = 0; y < height; y += source_height) {
+            for (x = 0; x < width; x += source_width) {
+                bbbm_render_place(scaled, result, x, y);
+            }
+        }
+    } else {
+        /* fill crops, fit and center pad; either way the image is centered */
+        bbbm_render_place(scaled, result, (width - source_width) / 2, (height - source_height) / 2);
+    }
+    g_object_unref(scaled);
+    return result;
+}
+
+static gdouble bbbm_render_get_scale(gint source_width, gint source_height, gint width, gint height,
+                                     BBBMRenderMode mode) {
+    gdouble scale_x, scale_y;
+
+    scale_x = (gdouble) width / source_width;
+    scale_y = (gdouble) height / source_height;
+    return mode == BBBM_RENDER_FILL ? MAX(scale_x, scale_y) : MIN(scale_x, scale_y);
+}
+
+static GdkPixbuf *bbbm_render_new_canvas(gint width, gint height) {
+    GdkPixbuf *canvas;
+
+    canvas = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+    gdk_pixbuf_fill(canvas, 0x000000ff);
+    return canvas;
+}
+
+static void bbbm_render_place(GdkPixbuf *source, GdkPixbuf *dest, gint x, gint y) {
+    gint left, top, right, bottom;
+
+    left   = MAX(x, 0);
+    top    = MAX(y, 0);
+    right  = MIN(x + gdk_pixbuf_get_width(source), gdk_pixbuf_get_width(dest));
+    bottom = MIN(y + gdk_pixbuf_get_height(source), gdk_pixbuf_get_height(dest));
+    if (right > left && bottom > top) {
+        /* compositing also handles images with an alpha channel, by blending them onto the black canvas */
+        gdk_pixbuf_composite(source, dest, left, top, right - left, bottom - top,
+                             x, y, 1.0, 1.0, GDK_INTERP_NEAREST, 255);
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_RENDER_H_
+#define __BBBM_RENDER_H_
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gdk/gdk.h>
+
+/* The ways an image can be fitted to a screen */
+typedef enum {
+    BBBM_RENDER_FILL,   /* scaled to cover the screen, cropping what does not fit */
+    BBBM_RENDER_FIT,    /* scaled to fit on the screen, with black borders */
+    BBBM_RENDER_CENTER, /* not scaled, centered */
+    BBBM_RENDER_TILE    /* not scaled, repeated from the top left */
+} BBBMRenderMode;
+
+/* Returns the name of the given mode, as used in the configuration file */
+const gchar *bbbm_render_mode_to_string(BBBMRenderMode mode);
+
+/* Stores the mode with the given name in mode. Returns FALSE if there is no such mode */
+gboolean bbbm_render_mode_from_string(const gchar *string, BBBMRenderMode *mode);
+
+/* Loads the given image file, fitted to the given size according to the given mode.
+   For the scaling modes, the image is decoded at the target size instead of being scaled down afterwards.
+   Returns NULL if the file could not be loaded.
+   The returned pixbuf must be unreferenced when no longer needed */
+GdkPixbuf *bbbm_render_file(const gchar *filename, gint width, gint height, BBBMRenderMode mode, GError **error);
+
+/* Like bbbm_render_file, but the image is fitted to each of the given monitors separately, at the monitor's own
+   resolution, and placed at the monitor's position. The image is decoded only once.
+   Parts of the returned width x height pixbuf that are not covered by any monitor are black */
+GdkPixbuf *bbbm_render_file_for_monitors(const gchar *filename, gint width, gint height,
+                                         const GdkRectangle *monitors, guint monitor_count,
+                                         BBBMRenderMode mode, GError **error);
+
+#endif /* __BBBM_RENDER_H_ */
@@ -0,0 +1,452 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include "config.h"
+#include "render_cache.h"
+#include "render.h"
+#include "archive.h"
+#include "util.h"
+#include "compat.h"
+
+/* the number of images rendered at the same time; rendering competes with the thumbnail loader for processors */
+#define BBBM_RENDER_CACHE_THREADS   1
+/* the number of milliseconds between checks for finished renders */
+#define BBBM_RENDER_CACHE_POLL      50
+#define BBBM_RENDER_CACHE_QUALITY   "95"
+
+typedef struct {
+    gchar *filename;
+    /* determined by the worker thread, since it needs to check the image file */
+    gchar *rendered_file;
+    BBBMRenderMode mode;
+    gint width;
+    gint height;
+    GdkRectangle *monitors;
+    guint monitor_count;
+    /* speculative tasks are skipped if the generation of the cache has changed; accessed atomically */
+    gint speculative;
+    gint generation;
+    guint sequence;
+    gboolean success;
+    bbbm_render_cache_function function;
+    gpointer data;
+} BBBMRenderCacheTask;
+
+struct _BBBMRenderCache {
+    gchar *directory;
+    GThreadPool *pool;
+    /* finished tasks, pushed by the worker threads and popped by the main loop */
+    GAsyncQueue *finished;
+    guint pending;
+    guint poll_id;
+    /* incremented to cancel speculative tasks; accessed atomically */
+    gint generation;
+    guint sequence;
+    /* the most recent speculative task, until it is finished */
+    BBBMRenderCacheTask *speculative;
+    /* set while destroying; queued tasks are then skipped. Accessed atomically */
+    gint destroyed;
+};
+
+typedef struct {
+    gchar *file;
+    time_t mtime;
+    gint64 size;
+} BBBMRenderCacheFile;
+
+static void bbbm_render_cache_push(BBBMRenderCache *cache, const gchar *filename, BBBMRenderMode mode,
+                                   gboolean speculative, bbbm_render_cache_function function, gpointer data);
+#if HAVE_G_THREAD_POOL_SET_SORT_FUNCTION
+static gint bbbm_render_cache_compare(BBBMRenderCacheTask *task1, BBBMRenderCacheTask *task2, gpointer data);
+#endif
+static gboolean bbbm_render_cache_within_budget(BBBMRenderCacheTask *task);
+static gchar *bbbm_render_cache_get_file(BBBMRenderCache *cache, BBBMRenderCacheTask *task);
+static void bbbm_render_cache_run(BBBMRenderCacheTask *task, BBBMRenderCache *cache);
+static void bbbm_render_cache_evict(BBBMRenderCache *cache, const gchar *keep);
+static gint bbbm_render_cache_compare_files(const BBBMRenderCacheFile *file1, const BBBMRenderCacheFile *file2);
+static gboolean bbbm_render_cache_poll(BBBMRenderCache *cache);
+static void bbbm_render_cache_task_destroy(BBBMRenderCacheTask *task);
+
+BBBMRenderCache *bbbm_render_cache_new(const gchar *directory) {
+    BBBMRenderCache *cache;
+    GError *error = NULL;
+
+    g_return_val_if_fail(directory != NULL, NULL);
+
+    if (!g_file_test(directory, G_FILE_TEST_IS_DIR) && mkdir(directory, 0700) == -1) {
+        g_warning("could not create directory '%s': %s", directory, g_strerror(errno));
+    }
+    cache = g_malloc(sizeof(BBBMRenderCache));
+    cache->directory = g_strdup(directory);
+    cache->finished  = g_async_queue_new();
+    cache->pending   = 0;
+    cache->poll_id   = 0;
+    cache->generation  = 0;
+    cache->sequence    = 0;
+    cache->speculative = NULL;
+    cache->destroyed   = FALSE;
+    cache->pool      = g_thread_pool_new((GFunc) bbbm_render_cache_run, cache, BBBM_RENDER_CACHE_THREADS, FALSE, &error);
+    if (cache->pool == NULL) {
+        g_warning("could not create render threads: %s", error->message);
+        g_error_free(error);
+    } else {
+#if HAVE_G_THREAD_POOL_SET_SORT_FUNCTION
+        g_thread_pool_set_sort_function(cache->pool, (GCompareDataFunc) bbbm_render_cache_compare, NULL);
+#else
+        g_debug("g_thread_pool_set_sort_function is not available, speculative requests are not deferred");
+#endif
+    }
+    return cache;
+}
+
+void bbbm_render_cache_render(BBBMRenderCache *cache, const gchar *filename, BBBMRenderMode mode,
+                              bbbm_render_cache_function function, gpointer data) {
+    g_return_if_fail(cache != NULL);
+    g_return_if_fail(filename != NULL);
+
+    if (cache->speculative != NULL && cache->speculative->function == NULL
+            && cache->speculative->mode == mode && bbbm_str_equals(cache->speculative->filename, filename)) {
+        /* the image is already being rendered speculatively; take over that task instead of rendering it twice.
+           If the worker thread has just skipped it, the function is called with a NULL rendered file */
+        g_atomic_int_set(&(cache->speculative->speculative), FALSE);
+        cache->speculative->function = function;
+        cache->speculative->data     = data;
+        return;
+    }
+    bbbm_render_cache_push(cache, filename, mode, FALSE, function, data);
+}
+
+void bbbm_render_cache_prerender(BBBMRenderCache *cache, const gchar *filename, BBBMRenderMode mode) {
+    g_return_if_fail(cache != NULL);
+    g_return_if_fail(filename != NULL);
+
+    if (cache->speculative != NULL && cache->speculative->mode == mode
+            && bbbm_str_equals(cache->speculative->filename, filename)) {
+        return;
+    }
+    bbbm_render_cache_cancel(cache);
+    bbbm_render_cache_push(cache, filename, mode, TRUE, NULL, NULL);
+}
+
+void bbbm_render_cache_cancel(BBBMRenderCache *cache) {
+    g_return_if_fail(cache != NULL);
+
+    g_atomic_int_inc(&(cache->generation));
+}
+
+static void bbbm_render_cache_push(BBBMRenderCache *cache, const gchar *filename, BBBMRenderMode mode,
+                                   gboolean speculative, bbbm_render_cache_function function, gpointer data) {
+    BBBMRenderCacheTask *task;
+    GdkScreen *screen;
+    GError *error = NULL;
+    guint i;
+
+    screen = gdk_screen_get_default();
+    task = g_malloc(sizeof(BBBMRenderCacheTask));
+    task->filename      = g_strdup(filename);
+    task->rendered_file = NULL;
+    task->mode          = mode;
+    /* the screen layout is determined here, since GDK may only be used from the main thread */
+    task->width         = gdk_screen_get_width(screen);
+    task->height        = gdk_screen_get_height(screen);
+    task->monitor_count = gdk_screen_get_n_monitors(screen);
+    task->monitors      = g_new(GdkRectangle, task->monitor_count);
+    for (i = 0; i < task->monitor_count; ++i) {
+        gdk_screen_get_monitor_geometry(screen, i, &(task->monitors[i]));
+    }
+    task->speculative   = speculative;
+    task->generation    = g_atomic_int_get(&(cache->generation));
+    task->sequence      = cache->sequence++;
+    task->success       = FALSE;
+    task->function      = function;
+    task->data          = data;
+    if (speculative) {
+        cache->speculative = task;
+    }
+
+    cache->pending++;
+    if (cache->poll_id == 0) {
+        cache->poll_id = g_timeout_add(BBBM_RENDER_CACHE_POLL, (GSourceFunc) bbbm_render_cache_poll, cache);
+    }
+    if (cache->pool == NULL) {
+        /* report the failure from the main loop, like any other result */
+        g_async_queue_push(cache->finished, task);
+    } else if (!g_thread_pool_push(cache->pool, task, &error)) {
+        g_warning("could not render '%s': %s", filename, error->message);
+        g_error_free(error);
+        g_async_queue_push(cache->finished, task);
+    }
+}
+
+void bbbm_render_cache_clear(BBBMRenderCache *cache) {
+    GList *files;
+
+    g_return_if_fail(cache != NULL);
+
+    g_debug("clearing render cache '%s'", cache->directory);
+    /* files that are still being rendered will simply not be found anymore */
+    files = bbbm_util_listdir(cache->directory);
+    while (files != NULL) {
+        gchar *file = (gchar *) files->data;
+
+        if (g_unlink(file) == -1) {
+            g_warning("could not remove '%s': %s", file, g_strerror(errno));
+        }
+        files = g_list_remove(files, file);
+        g_free(file);
+    }
+}
+
+void bbbm_render_cache_destroy(BBBMRenderCache *cache) {
+    BBBMRenderCacheTask *task;
+
+    g_return_if_fail(cache != NULL);
+
+    if (cache->pool != NULL) {
+        /* the pool cannot hand back requests that have not started, so they are run, but skip straight to the
+           finished queue; this also waits for the one that has started */
+        g_atomic_int_set(&(cache->destroyed), TRUE);
+        g_thread_pool_free(cache->pool, FALSE, TRUE);
+    }
+    while ((task = (BBBMRenderCacheTask *) g_async_queue_try_pop(cache->finished)) != NULL) {
+        bbbm_render_cache_task_destroy(task);
+    }
+    g_async_queue_unref(cache->finished);
+    if (cache->poll_id != 0) {
+        g_source_remove(cache->poll_id);
+    }
+    g_free(cache->directory);
+    g_free(cache);
+}
+
+#if HAVE_G_THREAD_POOL_SET_SORT_FUNCTION
+static gint bbbm_render_cache_compare(BBBMRenderCacheTask *task1, BBBMRenderCacheTask *task2, gpointer data) {
+    /* requested renders first, then first come first served */
+    gint speculative1 = g_atomic_int_get(&(task1->speculative));
+    gint speculative2 = g_atomic_int_get(&(task2->speculative));
+
+    if (speculative1 != speculative2) {
+        return speculative1 ? 1 : -1;
+    }
+    return task1->sequence < task2->sequence ? -1 : (task1->sequence > task2->sequence ? 1 : 0);
+}
+#endif
+
+static gboolean bbbm_render_cache_within_budget(BBBMRenderCacheTask *task) {
+    gint source_width, source_height;
+    gsize needed;
+
+    /* the canvas, plus the decoded source; fill and fit decode at the target size, center and tile do not */
+    needed = (gsize) task->width * task->height * 4;
+    if (task->mode == BBBM_RENDER_CENTER || task->mode == BBBM_RENDER_TILE) {
+        if (gdk_pixbuf_get_file_info(task->filename, &source_width, &source_height) == NULL) {
+            return FALSE;
+        }
+        needed += (gsize) source_width * source_height * 4;
+    } else {
+        needed *= 2;
+    }
+    return needed <= BBBM_RENDER_CACHE_SPECULATIVE_BUDGET;
+}
+
+static gchar *bbbm_render_cache_get_file(BBBMRenderCache *cache, BBBMRenderCacheTask *task) {
+    GString *key;
+    gchar *name, *rendered_file;
+    struct stat info;
+    guint i;
+
+    if (g_stat(task->filename, &info) == -1) {
+        g_warning("could not read '%s': %s", task->filename, g_strerror(errno));
+        return NULL;
+    }
+
+    /* any change to the image, the mode or the screen layout results in a different file */
+    key = g_string_sized_new(256);
+    g_string_append_printf(key, "%s\n%ld\n%ld\n%s\n%dx%d", task->filename, (glong) info.st_mtime,
+                           (glong) info.st_size, bbbm_render_mode_to_string(task->mode), task->width, task->height);
+    for (i = 0; i < task->monitor_count; ++i) {
+        g_string_append_printf(key, ";%dx%d+%d+%d", task->monitors[i].width, task->monitors[i].height,
+                               task->monitors[i].x, task->monitors[i].y);
+    }
+#if HAVE_G_COMPUTE_CHECKSUM == 0
+    g_debug("g_compute_checksum_for_string is not available, using g_str_hash instead");
+    name = g_strdup_printf("%08x-%s.jpg", g_str_hash(key->str), bbbm_render_mode_to_string(task->mode));
+#else
+    {
+        gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_MD5, key->str, key->len);
+        name = g_strdup_printf("%s.jpg", checksum);
+        g_free(checksum);
+    }
+#endif
+    g_string_free(key, TRUE);
+    rendered_file = g_build_filename(cache->directory, name, NULL);
+    g_free(name);
+    return rendered_file;
+}
+
+static void bbbm_render_cache_run(BBBMRenderCacheTask *task, BBBMRenderCache *cache) {
+    GdkPixbuf *pixbuf;
+    GError *error = NULL;
+    GTimer *timer;
+
+    if (g_atomic_int_get(&(cache->destroyed))) {
+        g_async_queue_push(cache->finished, task);
+        return;
+    }
+    if (g_atomic_int_get(&(task->speculative))
+            && task->generation != g_atomic_int_get(&(cache->generation))) {
+        g_debug("skipping cancelled render of '%s'", task->filename);
+        g_async_queue_push(cache->finished, task);
+        return;
+    }
+    /* archive members are only extracted when they are actually set */
+    if (g_atomic_int_get(&(task->speculative)) && bbbm_archive_is_member(task->filename)) {
+        g_async_queue_push(cache->finished, task);
+        return;
+    }
+    task->rendered_file = bbbm_render_cache_get_file(cache, task);
+    if (task->rendered_file == NULL) {
+        g_async_queue_push(cache->finished, task);
+        return;
+    }
+    if (g_file_test(task->rendered_file, G_FILE_TEST_IS_REGULAR)) {
+        /* already rendered; the modification time is what eviction goes by */
+        if (utime(task->rendered_file, NULL) == -1) {
+            g_debug("could not touch '%s': %s", task->rendered_file, g_strerror(errno));
+        }
+        task->success = TRUE;
+        g_async_queue_push(cache->finished, task);
+        return;
+    }
+    if (g_atomic_int_get(&(task->speculative)) && !bbbm_render_cache_within_budget(task)) {
+        g_debug("skipping render of '%s': exceeds the memory budget", task->filename);
+        g_async_queue_push(cache->finished, task);
+        return;
+    }
+    timer = g_timer_new();
+    pixbuf = bbbm_render_file_for_monitors(task->filename, task->width, task->height,
+                                           task->monitors, task->monitor_count, task->mode, &error);
+    if (pixbuf == NULL) {
+        g_warning("could not render '%s': %s", task->filename, error->message);
+        g_error_free(error);
+    } else {
+        gchar *temp_file;
+
+        /* write to a temporary file first, so a set command never sees a partial file */
+        temp_file = g_strconcat(task->rendered_file, ".tmp", NULL);
+        if (!gdk_pixbuf_save(pixbuf, temp_file, "jpeg", &error, "quality", BBBM_RENDER_CACHE_QUALITY, NULL)) {
+            g_warning("could not write '%s': %s", temp_file, error->message);
+            g_error_free(error);
+            g_unlink(temp_file);
+        } else if (g_rename(temp_file, task->rendered_file) == -1) {
+            g_warning("could not rename '%s': %s", temp_file, g_strerror(errno));
+            g_unlink(temp_file);
+        } else {
+            task->success = TRUE;
+            bbbm_render_cache_evict(cache, task->rendered_file);
+        }
+        g_free(temp_file);
+        g_object_unref(pixbuf);
+    }
+    g_debug("rendered '%s' in %.3f seconds", task->filename, g_timer_elapsed(timer, NULL));
+    g_timer_destroy(timer);
+    g_async_queue_push(cache->finished, task);
+}
+
+static void bbbm_render_cache_evict(BBBMRenderCache *cache, const gchar *keep) {
+    GList *files, *listed;
+    gint64 total = 0;
+
+    files = NULL;
+    for (listed = bbbm_util_listdir(cache->directory); listed != NULL; listed = g_list_delete_link(listed, listed)) {
+        gchar *file = (gchar *) listed->data;
+        struct stat info;
+
+        /* temporary files belong to renders in progress */
+        if (g_str_has_suffix(file, ".tmp") || g_stat(file, &info) == -1) {
+            g_free(file);
+        } else {
+            BBBMRenderCacheFile *entry = g_malloc(sizeof(BBBMRenderCacheFile));
+
+            entry->file  = file;
+            entry->mtime = info.st_mtime;
+            entry->size  = info.st_size;
+            total += entry->size;
+            files = g_list_prepend(files, entry);
+        }
+    }
+    /* least recently used first */
+    files = g_list_sort(files, (GCompareFunc) bbbm_render_cache_compare_files);
+    while (files != NULL) {
+        BBBMRenderCacheFile *entry = (BBBMRenderCacheFile *) files->data;
+
+        if (total > BBBM_RENDER_CACHE_MAX_SIZE && !bbbm_str_equals(entry->file, keep)) {
+            g_debug("evicting '%s' from the render cache", entry->file);
+            if (g_unlink(entry->file) == -1) {
+                g_warning("could not remove '%s': %s", entry->file, g_strerror(errno));
+            } else {
+                total -= entry->size;
+            }
+        }
+        g_free(entry->file);
+        g_free(entry);
+        files = g_list_delete_link(files, files);
+    }
+}
+
+static gint bbbm_render_cache_compare_files(const BBBMRenderCacheFile *file1, const BBBMRenderCacheFile *file2) {
+    return file1->mtime < file2->mtime ? -1 : (file1->mtime > file2->mtime ? 1 : 0);
+}
+
+static gboolean bbbm_render_cache_poll(BBBMRenderCache *cache) {
+    BBBMRenderCacheTask *task;
+
+    while ((task = (BBBMRenderCacheTask *) g_async_queue_try_pop(cache->finished)) != NULL) {
+        cache->pending--;
+        if (task == cache->speculative) {
+            cache->speculative = NULL;
+        }
+        if (task->function != NULL) {
+            task->function(task->data, task->filename, task->success ? task->rendered_file : NULL);
+        }
+        bbbm_render_cache_task_destroy(task);
+    }
+    if (cache->pending == 0) {
+        cache->poll_id = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void bbbm_render_cache_task_destroy(BBBMRenderCacheTask *task) {
+    g_free(task->filename);
+    g_free(task->rendered_file);
+    g_free(task->monitors);
+    g_free(task);
+}
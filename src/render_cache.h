@@ -0,0 +1,64 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_RENDER_CACHE_H_
+#define __BBBM_RENDER_CACHE_H_
+
+#include <glib.h>
+#include "render.h"
+
+#define BBBM_RENDER_CACHE_SPECULATIVE_BUDGET  (64 * 1024 * 1024)
+/* the total size of the rendered files; the least recently used ones are removed beyond it */
+#define BBBM_RENDER_CACHE_MAX_SIZE            (128 * 1024 * 1024)
+
+/* A directory of images that are already fitted to the monitors of the default screen.
+   Passing these to an external set command saves it from decoding and scaling the original image.
+   Rendering is done by worker threads; the results are reported from the main loop */
+typedef struct _BBBMRenderCache BBBMRenderCache;
+
+/* Called from the main loop when rendering has finished. The rendered file is NULL if rendering failed */
+typedef void (* bbbm_render_cache_function) (gpointer data, const gchar *filename, const gchar *rendered_file);
+
+/* Creates a new BBBMRenderCache object that stores its files in the given directory, which is created if needed.
+   The returned object must be destroyed with bbbm_render_cache_destroy when no longer needed */
+BBBMRenderCache *bbbm_render_cache_new(const gchar *directory);
+
+/* Renders the given image file for the current screen layout in the background, unless it has been rendered
+   already, in which case the rendered file is only marked as recently used. Both are done by a worker thread.
+   The function is optional; if given it is called when rendering has finished */
+void bbbm_render_cache_render(BBBMRenderCache *cache, const gchar *filename, BBBMRenderMode mode,
+                              bbbm_render_cache_function function, gpointer data);
+
+/* Renders the given image file for the current screen layout in anticipation of it being set.
+   Speculative requests run after all others, and each one cancels the previous one. Archive members, and images
+   that would need more than BBBM_RENDER_CACHE_SPECULATIVE_BUDGET bytes to render, are skipped */
+void bbbm_render_cache_prerender(BBBMRenderCache *cache, const gchar *filename, BBBMRenderMode mode);
+
+/* Cancels the current speculative request, unless it is already being rendered */
+void bbbm_render_cache_cancel(BBBMRenderCache *cache);
+
+/* Removes all rendered files, for instance because the screen layout has changed */
+void bbbm_render_cache_clear(BBBMRenderCache *cache);
+
+/* Waits for the file currently being rendered, and discards any other pending requests without calling their
+   functions */
+void bbbm_render_cache_destroy(BBBMRenderCache *cache);
+
+#endif /* __BBBM_RENDER_CACHE_H_ */
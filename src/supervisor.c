@@ -0,0 +1,252 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include "config.h"
+#include "supervisor.h"
+#include "util.h"
+#include "compat.h"
+
+/* the number of seconds between asking a timed out command to stop and killing it */
+#define BBBM_SUPERVISOR_KILL_DELAY  5
+
+typedef struct {
+    BBBMSupervisor *supervisor;
+    gchar *command;
+    bbbm_supervisor_function function;
+    gpointer data;
+    gboolean queued;
+    pid_t pid;
+    GTimer *timer;
+    guint watch_id;
+    guint timeout_id;
+    gboolean terminated;
+} BBBMSupervisorJob;
+
+struct _BBBMSupervisor {
+    guint max_jobs;
+    guint timeout;
+    GQueue *pending;
+    GList *running;
+    guint running_queued;
+};
+
+static BBBMSupervisorJob *bbbm_supervisor_job_new(BBBMSupervisor *supervisor, const gchar *command,
+                                                  bbbm_supervisor_function function, gpointer data, gboolean queued);
+static void bbbm_supervisor_job_destroy(BBBMSupervisorJob *job);
+static gboolean bbbm_supervisor_start(BBBMSupervisor *supervisor, BBBMSupervisorJob *job);
+static void bbbm_supervisor_start_pending(BBBMSupervisor *supervisor);
+static void bbbm_supervisor_finish(BBBMSupervisorJob *job, gint status);
+static void bbbm_supervisor_child_exited(GPid pid, gint status, BBBMSupervisorJob *job);
+static gboolean bbbm_supervisor_child_timed_out(BBBMSupervisorJob *job);
+
+BBBMSupervisor *bbbm_supervisor_new(guint max_jobs, guint timeout) {
+    BBBMSupervisor *supervisor;
+
+    supervisor = g_malloc(sizeof(BBBMSupervisor));
+    supervisor->max_jobs       = MAX(max_jobs, 1);
+    supervisor->timeout        = timeout;
+    supervisor->pending        = g_queue_new();
+    supervisor->running        = NULL;
+    supervisor->running_queued = 0;
+    return supervisor;
+}
+
+void bbbm_supervisor_set_max_jobs(BBBMSupervisor *supervisor, guint max_jobs) {
+    g_return_if_fail(supervisor != NULL);
+    supervisor->max_jobs = MAX(max_jobs, 1);
+    /* more slots may have become available */
+    bbbm_supervisor_start_pending(supervisor);
+}
+
+void bbbm_supervisor_set_timeout(BBBMSupervisor *supervisor, guint timeout) {
+    g_return_if_fail(supervisor != NULL);
+    /* running commands keep the timeout they were started with */
+    supervisor->timeout = timeout;
+}
+
+void bbbm_supervisor_execute(BBBMSupervisor *supervisor, const gchar *command,
+                             bbbm_supervisor_function function, gpointer data) {
+    BBBMSupervisorJob *job;
+
+    g_return_if_fail(supervisor != NULL);
+    g_return_if_fail(command != NULL);
+    job = bbbm_supervisor_job_new(supervisor, command, function, data, FALSE);
+    if (!bbbm_supervisor_start(supervisor, job)) {
+        bbbm_supervisor_finish(job, -1);
+    }
+}
+
+void bbbm_supervisor_queue(BBBMSupervisor *supervisor, const gchar *command,
+                           bbbm_supervisor_function function, gpointer data) {
+    g_return_if_fail(supervisor != NULL);
+    g_return_if_fail(command != NULL);
+    g_queue_push_tail(supervisor->pending, bbbm_supervisor_job_new(supervisor, command, function, data, TRUE));
+    bbbm_supervisor_start_pending(supervisor);
+}
+
+guint bbbm_supervisor_get_pending_count(BBBMSupervisor *supervisor) {
+    g_return_val_if_fail(supervisor != NULL, 0);
+    return g_queue_get_length(supervisor->pending);
+}
+
+guint bbbm_supervisor_get_running_count(BBBMSupervisor *supervisor) {
+    g_return_val_if_fail(supervisor != NULL, 0);
+    return g_list_length(supervisor->running);
+}
+
+void bbbm_supervisor_destroy(BBBMSupervisor *supervisor) {
+    GList *iterator;
+
+    g_return_if_fail(supervisor != NULL);
+    while (!g_queue_is_empty(supervisor->pending)) {
+        bbbm_supervisor_job_destroy((BBBMSupervisorJob *) g_queue_pop_head(supervisor->pending));
+    }
+    g_queue_free(supervisor->pending);
+    for (iterator = supervisor->running; iterator != NULL; iterator = iterator->next) {
+        BBBMSupervisorJob *job = (BBBMSupervisorJob *) iterator->data;
+
+        g_debug("leaving command '%s' (pid %d) running", job->command, (gint) job->pid);
+        g_source_remove(job->watch_id);
+        if (job->timeout_id != 0) {
+            g_source_remove(job->timeout_id);
+        }
+        bbbm_supervisor_job_destroy(job);
+    }
+    g_list_free(supervisor->running);
+    g_free(supervisor);
+}
+
+static BBBMSupervisorJob *bbbm_supervisor_job_new(BBBMSupervisor *supervisor, const gchar *command,
+                                                  bbbm_supervisor_function function, gpointer data, gboolean queued) {
+    BBBMSupervisorJob *job;
+
+    job = g_malloc(sizeof(BBBMSupervisorJob));
+    job->supervisor = supervisor;
+    job->command    = g_strdup(command);
+    job->function   = function;
+    job->data       = data;
+    job->queued     = queued;
+    job->pid        = 0;
+    job->timer      = NULL;
+    job->watch_id   = 0;
+    job->timeout_id = 0;
+    job->terminated = FALSE;
+    return job;
+}
+
+static void bbbm_supervisor_job_destroy(BBBMSupervisorJob *job) {
+    g_free(job->command);
+    if (job->timer != NULL) {
+        g_timer_destroy(job->timer);
+    }
+    g_free(job);
+}
+
+/* Returns FALSE if the command could not be started; the caller must then finish the job */
+static gboolean bbbm_supervisor_start(BBBMSupervisor *supervisor, BBBMSupervisorJob *job) {
+    if (job->queued) {
+        supervisor->running_queued++;
+    }
+    job->timer = g_timer_new();
+    if (!bbbm_util_spawn_cmd(job->command, &job->pid)) {
+        /* bbbm_util_spawn_cmd printed the error */
+        return FALSE;
+    }
+    supervisor->running = g_list_prepend(supervisor->running, job);
+    job->watch_id = g_child_watch_add((GPid) job->pid, (GChildWatchFunc) bbbm_supervisor_child_exited, job);
+    if (supervisor->timeout > 0) {
+        job->timeout_id = g_timeout_add(supervisor->timeout * 1000, (GSourceFunc) bbbm_supervisor_child_timed_out, job);
+    }
+    g_debug("started command '%s' (pid %d); %d running, %d pending", job->command, (gint) job->pid,
+            g_list_length(supervisor->running), g_queue_get_length(supervisor->pending));
+    return TRUE;
+}
+
+static void bbbm_supervisor_start_pending(BBBMSupervisor *supervisor) {
+    while (supervisor->running_queued < supervisor->max_jobs && !g_queue_is_empty(supervisor->pending)) {
+        BBBMSupervisorJob *job = (BBBMSupervisorJob *) g_queue_pop_head(supervisor->pending);
+
+        if (!bbbm_supervisor_start(supervisor, job)) {
+            /* this frees its slot again, so the loop simply moves on to the next job */
+            bbbm_supervisor_finish(job, -1);
+        }
+    }
+}
+
+static void bbbm_supervisor_finish(BBBMSupervisorJob *job, gint status) {
+    BBBMSupervisor *supervisor;
+    gdouble duration;
+
+    supervisor = job->supervisor;
+    duration = g_timer_elapsed(job->timer, NULL);
+    if (status == -1) {
+        g_debug("command '%s' could not be started", job->command);
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        g_debug("command '%s' finished after %.2f seconds", job->command, duration);
+    } else if (WIFEXITED(status)) {
+        g_warning("command '%s' exited with status %d after %.2f seconds", job->command, WEXITSTATUS(status), duration);
+    } else if (WIFSIGNALED(status)) {
+        g_warning("command '%s' was killed by signal %d after %.2f seconds", job->command, WTERMSIG(status), duration);
+    }
+    if (job->function != NULL) {
+        job->function(job->data, job->command, status, duration);
+    }
+    if (job->queued) {
+        supervisor->running_queued--;
+    }
+    bbbm_supervisor_job_destroy(job);
+}
+
+static void bbbm_supervisor_child_exited(GPid pid, gint status, BBBMSupervisorJob *job) {
+    BBBMSupervisor *supervisor;
+
+    job->supervisor->running = g_list_remove(job->supervisor->running, job);
+    if (job->timeout_id != 0) {
+        g_source_remove(job->timeout_id);
+    }
+    g_spawn_close_pid(pid);
+    supervisor = job->supervisor;
+    bbbm_supervisor_finish(job, status);
+    bbbm_supervisor_start_pending(supervisor);
+}
+
+static gboolean bbbm_supervisor_child_timed_out(BBBMSupervisorJob *job) {
+    /* commands run in their own process group, so this also stops any children of a shell */
+    if (!job->terminated) {
+        g_warning("command '%s' (pid %d) did not finish within %d seconds; terminating it",
+                  job->command, (gint) job->pid, job->supervisor->timeout);
+        kill(-job->pid, SIGTERM);
+        job->terminated = TRUE;
+        job->timeout_id = g_timeout_add(BBBM_SUPERVISOR_KILL_DELAY * 1000, (GSourceFunc) bbbm_supervisor_child_timed_out, job);
+    } else {
+        g_warning("command '%s' (pid %d) did not terminate; killing it", job->command, (gint) job->pid);
+        kill(-job->pid, SIGKILL);
+        job->timeout_id = 0;
+    }
+    return FALSE;
+}
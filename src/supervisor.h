@@ -0,0 +1,61 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_SUPERVISOR_H_
+#define __BBBM_SUPERVISOR_H_
+
+#include <glib.h>
+
+/* A supervisor for spawned commands. Every command it starts is reaped from the main loop, its exit status and
+   duration are logged, and it is killed if it runs longer than the timeout.
+   Queued commands run at most max_jobs at a time; commands that are executed directly do not wait for a slot */
+typedef struct _BBBMSupervisor BBBMSupervisor;
+
+/* Called from the main loop when a command has finished.
+   The status is the wait status as returned by waitpid, or -1 if the command could not be started */
+typedef void (* bbbm_supervisor_function) (gpointer data, const gchar *command, gint status, gdouble duration);
+
+/* Creates a new BBBMSupervisor object that runs at most max_jobs queued commands in parallel,
+   and kills commands after timeout seconds. A timeout of 0 disables killing.
+   The returned object must be destroyed with bbbm_supervisor_destroy when no longer needed */
+BBBMSupervisor *bbbm_supervisor_new(guint max_jobs, guint timeout);
+
+void bbbm_supervisor_set_max_jobs(BBBMSupervisor *supervisor, guint max_jobs);
+
+void bbbm_supervisor_set_timeout(BBBMSupervisor *supervisor, guint timeout);
+
+/* Executes the given command now. The function is optional; if given it is called when the command has finished */
+void bbbm_supervisor_execute(BBBMSupervisor *supervisor, const gchar *command,
+                             bbbm_supervisor_function function, gpointer data);
+
+/* Like bbbm_supervisor_execute, but the command waits until fewer than max_jobs queued commands are running */
+void bbbm_supervisor_queue(BBBMSupervisor *supervisor, const gchar *command,
+                           bbbm_supervisor_function function, gpointer data);
+
+/* Returns the number of queued commands that have not started yet */
+guint bbbm_supervisor_get_pending_count(BBBMSupervisor *supervisor);
+
+/* Returns the number of commands that are currently running, including the ones not started through the queue */
+guint bbbm_supervisor_get_running_count(BBBMSupervisor *supervisor);
+
+/* Discards all pending commands. Running commands are left alone, but are no longer reaped */
+void bbbm_supervisor_destroy(BBBMSupervisor *supervisor);
+
+#endif /* __BBBM_SUPERVISOR_H_ */
@@ -0,0 +1,189 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "config.h"
+#include "template.h"
+#include "compat.h"
+
+typedef enum {
+    BBBM_TEMPLATE_LITERAL,
+    BBBM_TEMPLATE_FILENAME,
+    BBBM_TEMPLATE_QUOTED,
+    BBBM_TEMPLATE_DIR,
+    BBBM_TEMPLATE_NAME,
+    BBBM_TEMPLATE_WIDTH,
+    BBBM_TEMPLATE_HEIGHT
+} BBBMTemplateTokenType;
+
+typedef struct {
+    BBBMTemplateTokenType type;
+    /* for literals only; points into the command of the template */
+    const gchar *text;
+    gsize length;
+} BBBMTemplateToken;
+
+struct _BBBMTemplate {
+    gchar *command;
+    GArray *tokens;
+    /* only read the image header if the size is actually used */
+    gboolean needs_size;
+};
+
+/* the %{...} placeholders, indexed by token type */
+static const gchar *bbbm_template_names[] = { NULL, NULL, "quoted", "dir", "name", "width", "height", NULL };
+
+static void bbbm_template_add_token(BBBMTemplate *template, BBBMTemplateTokenType type,
+                                    const gchar *text, gsize length);
+static BBBMTemplateTokenType bbbm_template_parse_placeholder(const gchar *start, gsize *length);
+
+BBBMTemplate *bbbm_template_new(const gchar *command) {
+    BBBMTemplate *template;
+    const gchar *start, *current;
+    gboolean has_placeholder = FALSE;
+
+    g_return_val_if_fail(command != NULL, NULL);
+
+    template = g_malloc(sizeof(BBBMTemplate));
+    template->command    = g_strdup(command);
+    template->tokens     = g_array_new(FALSE, FALSE, sizeof(BBBMTemplateToken));
+    template->needs_size = FALSE;
+
+    start = current = template->command;
+    while ((current = strchr(current, '%')) != NULL) {
+        BBBMTemplateTokenType type;
+        gsize length;
+
+        type = bbbm_template_parse_placeholder(current, &length);
+        if (type == BBBM_TEMPLATE_LITERAL) {
+            current++;
+            continue;
+        }
+        bbbm_template_add_token(template, BBBM_TEMPLATE_LITERAL, start, current - start);
+        bbbm_template_add_token(template, type, NULL, 0);
+        has_placeholder = TRUE;
+        current += length;
+        start = current;
+    }
+    bbbm_template_add_token(template, BBBM_TEMPLATE_LITERAL, start, strlen(start));
+    if (!has_placeholder) {
+        /* no placeholders in the command, so add the filename to the end */
+        bbbm_template_add_token(template, BBBM_TEMPLATE_LITERAL, " \"", 2);
+        bbbm_template_add_token(template, BBBM_TEMPLATE_FILENAME, NULL, 0);
+        bbbm_template_add_token(template, BBBM_TEMPLATE_LITERAL, "\"", 1);
+    }
+    return template;
+}
+
+void bbbm_template_expand(BBBMTemplate *template, const gchar *filename, GString *buffer) {
+    gint width = 0, height = 0;
+    guint i;
+
+    g_return_if_fail(template != NULL);
+    g_return_if_fail(filename != NULL);
+    g_return_if_fail(buffer != NULL);
+
+    if (template->needs_size && gdk_pixbuf_get_file_info(filename, &width, &height) == NULL) {
+        g_warning("could not read the size of '%s'", filename);
+    }
+    g_string_truncate(buffer, 0);
+    for (i = 0; i < template->tokens->len; ++i) {
+        BBBMTemplateToken *token = &g_array_index(template->tokens, BBBMTemplateToken, i);
+        const gchar *name;
+        gchar *value;
+
+        switch (token->type) {
+            case BBBM_TEMPLATE_LITERAL:
+                g_string_append_len(buffer, token->text, token->length);
+                break;
+            case BBBM_TEMPLATE_FILENAME:
+                g_string_append(buffer, filename);
+                break;
+            case BBBM_TEMPLATE_QUOTED:
+                value = g_shell_quote(filename);
+                g_string_append(buffer, value);
+                g_free(value);
+                break;
+            case BBBM_TEMPLATE_DIR:
+                value = g_path_get_dirname(filename);
+                g_string_append(buffer, value);
+                g_free(value);
+                break;
+            case BBBM_TEMPLATE_NAME:
+                /* unlike g_path_get_basename, this needs no copy */
+                name = strrchr(filename, G_DIR_SEPARATOR);
+                g_string_append(buffer, name != NULL ? name + 1 : filename);
+                break;
+            case BBBM_TEMPLATE_WIDTH:
+                g_string_append_printf(buffer, "%d", width);
+                break;
+            case BBBM_TEMPLATE_HEIGHT:
+                g_string_append_printf(buffer, "%d", height);
+                break;
+        }
+    }
+}
+
+void bbbm_template_destroy(BBBMTemplate *template) {
+    g_return_if_fail(template != NULL);
+    g_array_free(template->tokens, TRUE);
+    g_free(template->command);
+    g_free(template);
+}
+
+static void bbbm_template_add_token(BBBMTemplate *template, BBBMTemplateTokenType type,
+                                    const gchar *text, gsize length) {
+    BBBMTemplateToken token;
+
+    if (type == BBBM_TEMPLATE_LITERAL && length == 0) {
+        return;
+    }
+    if (type == BBBM_TEMPLATE_WIDTH || type == BBBM_TEMPLATE_HEIGHT) {
+        template->needs_size = TRUE;
+    }
+    token.type   = type;
+    token.text   = text;
+    token.length = length;
+    g_array_append_val(template->tokens, token);
+}
+
+static BBBMTemplateTokenType bbbm_template_parse_placeholder(const gchar *start, gsize *length) {
+    const gchar *end;
+    guint i;
+
+    /* start points to a % */
+    if (start[1] == '1') {
+        *length = 2;
+        return BBBM_TEMPLATE_FILENAME;
+    }
+    if (start[1] != '{' || (end = strchr(start + 2, '}')) == NULL) {
+        return BBBM_TEMPLATE_LITERAL;
+    }
+    for (i = BBBM_TEMPLATE_QUOTED; bbbm_template_names[i] != NULL; ++i) {
+        if (strlen(bbbm_template_names[i]) == (gsize) (end - start - 2)
+            && strncmp(bbbm_template_names[i], start + 2, end - start - 2) == 0) {
+            *length = end - start + 1;
+            return (BBBMTemplateTokenType) i;
+        }
+    }
+    return BBBM_TEMPLATE_LITERAL;
+}
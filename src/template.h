@@ -0,0 +1,48 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_TEMPLATE_H_
+#define __BBBM_TEMPLATE_H_
+
+#include <glib.h>
+
+/* A command parsed once into literal text and placeholders, so it can be expanded for many files cheaply.
+   The placeholders are:
+   %1         the filename
+   %{quoted}  the filename, quoted for the shell
+   %{dir}     the directory of the file
+   %{name}    the name of the file, without its directory
+   %{width}   the width of the image
+   %{height}  the height of the image
+   Anything else, including unknown placeholders, is copied as-is.
+   If the command has no placeholders at all, the quoted filename is added to the end */
+typedef struct _BBBMTemplate BBBMTemplate;
+
+/* Creates a new BBBMTemplate object for the given command.
+   The returned object must be destroyed with bbbm_template_destroy when no longer needed */
+BBBMTemplate *bbbm_template_new(const gchar *command);
+
+/* Replaces the contents of the given buffer with the command expanded for the given filename.
+   Reusing the buffer for many files avoids allocating a string for each of them */
+void bbbm_template_expand(BBBMTemplate *template, const gchar *filename, GString *buffer);
+
+void bbbm_template_destroy(BBBMTemplate *template);
+
+#endif /* __BBBM_TEMPLATE_H_ */
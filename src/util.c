@@ -22,15 +22,23 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
-#include <sys/wait.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <spawn.h>
 #include <glib.h>
 #include "config.h"
 #include "util.h"
+#include "template.h"
+#include "archive.h"
 #include "compat.h"
 
+/* characters that require a shell to interpret a command; quotes and backslashes are handled by g_shell_parse_argv */
+#define BBBM_SHELL_CHARS  "|&;<>()$`*?[]~{}#=\n"
+
+extern char **environ;
+
 static gboolean bbbm_util_has_ext(const gchar *file, const gchar *ext);
+static gchar **bbbm_util_get_argv(const gchar *command);
 
 gboolean bbbm_str_empty(const gchar *str) {
     return str == NULL || *str == '\0';
@@ -47,12 +55,14 @@ gboolean bbbm_str_equals(const gchar *str1, const gchar *str2) {
 }
 
 gboolean bbbm_util_is_image(const gchar *filename) {
+    return bbbm_util_has_image_ext(filename)
+        && (g_file_test(filename, G_FILE_TEST_IS_REGULAR) || bbbm_archive_is_member(filename));
+}
+
+gboolean bbbm_util_has_image_ext(const gchar *filename) {
     static const gchar *extensions[] = { ".jpg", ".jpeg", ".gif", ".ppm", ".pgm", NULL };
     guint i;
 
-    if (!g_file_test(filename, G_FILE_TEST_IS_REGULAR)) {
-        return FALSE;
-    }
     for (i = 0; extensions[i] != NULL; ++i) {
         if (bbbm_util_has_ext(filename, extensions[i])) {
             return TRUE;
@@ -61,31 +71,19 @@ gboolean bbbm_util_is_image(const gchar *filename) {
     return FALSE;
 }
 
+guint bbbm_util_get_cpu_threads(void) {
+    return MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+}
+
 gchar *bbbm_util_get_command(const gchar *command, const gchar *filename) {
-    gchar *start, *end;
-
-    start = (gchar *) command;
-    end = strstr(start, "%1");
-
-    if (end != NULL) {
-        GString *result = g_string_sized_new(1024);
-        while (end != NULL) {
-            while (start != end) {
-                result = g_string_append_c(result, *start++);
-            }
-            result = g_string_append(result, filename);
-            start += 2;
-            end = strstr(start, "%1");
-        }
-        /* copy the rest */
-        while (*start != '\0') {
-            result = g_string_append_c(result, *start++);
-        }
-        return g_string_free(result, FALSE);
-    } else {
-        /* no %1 in the command, so add the filename to the end */
-        return g_strdup_printf("%s \"%s\"", command, filename);
-    }
+    BBBMTemplate *template;
+    GString *result;
+
+    template = bbbm_template_new(command);
+    result = g_string_sized_new(strlen(command) + strlen(filename) + 16);
+    bbbm_template_expand(template, filename, result);
+    bbbm_template_destroy(template);
+    return g_string_free(result, FALSE);
 }
 
 void bbbm_util_execute(const gchar *command, const gchar *filename) {
@@ -99,29 +97,49 @@ void bbbm_util_execute(const gchar *command, const gchar *filename) {
 void bbbm_util_execute_cmd(const gchar *command) {
     pid_t pid;
 
+    bbbm_util_spawn_cmd(command, &pid);
+}
+
+gboolean bbbm_util_spawn_cmd(const gchar *command, pid_t *pid) {
+    gchar **argv;
+    GTimer *timer;
+    posix_spawnattr_t attributes;
+    gint result;
+
+    g_return_val_if_fail(pid != NULL, FALSE);
+
     g_debug("executing command '%s'", command);
     if (bbbm_str_empty(command)) {
-        return;
+        return FALSE;
     }
-#if HAVE_FORK != 1
-    #error fork is not defined
-#endif
-#if HAVE_WORKING_FORK != 1
-    #error fork does not work
+    argv = bbbm_util_get_argv(command);
+    if (argv == NULL) {
+        return FALSE;
+    }
+#if HAVE_POSIX_SPAWNP != 1
+    #error posix_spawnp is not defined
 #endif
-    pid = fork();
-    if (pid == 0) {
-        /* use system instead of exec* for less strict commands */
-        gint result;
-
-        result = system(command);
-        if (result == -1) {
-            g_critical("could not execute '%s': %s", command, g_strerror(errno));
-        }
-        exit(WEXITSTATUS(result));
-    } else if (pid == -1) {
-        g_critical("could not execute '%s': %s", command, g_strerror(errno));
+    /* unlike fork, posix_spawn does not copy the address space, which can hold a lot of thumbnails;
+       its duration is therefore independent of the size of the collection */
+    /* a process group of its own allows a command to be stopped along with any processes it started */
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    timer = g_timer_new();
+    result = posix_spawnp(pid, argv[0], NULL, &attributes, argv, environ);
+    g_timer_stop(timer);
+    g_debug("spawned '%s' in %.3f ms", argv[0], g_timer_elapsed(timer, NULL) * 1000);
+    g_timer_destroy(timer);
+    posix_spawnattr_destroy(&attributes);
+    g_strfreev(argv);
+
+    if (result != 0) {
+        /* not fatal; callers such as the supervisor go on with their other commands */
+        g_warning("could not execute '%s': %s", command, g_strerror(result));
+        return FALSE;
     }
+    return TRUE;
 }
 
 gchar *bbbm_util_dirname(const gchar *filename) {
@@ -180,6 +198,13 @@ GList *bbbm_util_listdir(const gchar *dir) {
     const gchar *entry;
     GDir *d;
 
+    if (bbbm_archive_is_archive(dir) && g_file_test(dir, G_FILE_TEST_IS_REGULAR)) {
+        gchar *archive = bbbm_util_absolute_path(dir);
+
+        files = bbbm_archive_list(archive);
+        g_free(archive);
+        return files;
+    }
     d = g_dir_open(dir, 0, &error);
     if (d == NULL) {
         g_critical("could not open dir '%s' for reading: %s", dir, error->message);
@@ -216,3 +241,25 @@ static gboolean bbbm_util_has_ext(const gchar *file, const gchar *ext) {
     }
     return strcmp(file + file_len - ext_len, ext) == 0;
 }
+
+static gchar **bbbm_util_get_argv(const gchar *command) {
+    gchar **argv;
+    GError *error = NULL;
+
+    if (strpbrk(command, BBBM_SHELL_CHARS) == NULL) {
+        /* a simple command; no need to start a shell */
+        if (g_shell_parse_argv(command, NULL, &argv, &error)) {
+            return argv;
+        }
+        g_critical("could not parse '%s': %s", command, error->message);
+        g_error_free(error);
+        return NULL;
+    }
+    /* use a shell for less strict commands, like system did */
+    argv = g_new(gchar *, 4);
+    argv[0] = g_strdup("/bin/sh");
+    argv[1] = g_strdup("-c");
+    argv[2] = g_strdup(command);
+    argv[3] = NULL;
+    return argv;
+}
@@ -22,6 +22,7 @@
 #define __BBBM_UTIL_H_
 
 #include <stdarg.h>
+#include <sys/types.h>
 #include <glib.h>
 
 /* Returns whether or not the given string is NULL or empty */
@@ -30,10 +31,18 @@ gboolean bbbm_str_empty(const gchar *str);
 /* Returns whether or not the given strings are equal (NULL safe) */
 gboolean bbbm_str_equals(const gchar *str1, const gchar *str2);
 
-/* Returns whether or not the given string is a valid image filename */
+/* Returns whether or not the given string is a valid image filename; archive members are valid as well */
 gboolean bbbm_util_is_image(const gchar *filename);
 
-/* Returns a fully expanded command based on the given command and filename
+/* Returns whether or not the given string has the extension of an image; unlike bbbm_util_is_image,
+   the file itself is not checked */
+gboolean bbbm_util_has_image_ext(const gchar *filename);
+
+/* Returns the number of threads for CPU bound work such as decoding images: one per processor */
+guint bbbm_util_get_cpu_threads(void);
+
+/* Returns a fully expanded command based on the given command and filename; see template.h for the placeholders.
+   To expand the same command for many files, use BBBMTemplate directly instead.
    The returned string must be freed when no longer needed */
 gchar *bbbm_util_get_command(const gchar *command, const gchar *filename);
 
@@ -43,6 +52,12 @@ void bbbm_util_execute(const gchar *command, const gchar *filename);
 /* Executes the given command */
 void bbbm_util_execute_cmd(const gchar *command);
 
+/* Executes the given command without waiting for it, and stores its process id in pid.
+   The command is run directly if possible, and through /bin/sh only if it contains shell syntax.
+   It runs in a process group of its own, with the same id as the process.
+   Returns whether or not the command could be started */
+gboolean bbbm_util_spawn_cmd(const gchar *command, pid_t *pid);
+
 /* Returns the dirname for the given filename.
    The returned string must be freed when no longer needed */
 gchar *bbbm_util_dirname(const gchar *filename);
@@ -51,7 +66,7 @@ gchar *bbbm_util_dirname(const gchar *filename);
    The returned string must be freed when no longer needed */
 gchar *bbbm_util_absolute_path(const gchar *path);
 
-/* Lists all regular files in the given directory.
+/* Lists all regular files in the given directory, or all members of the given archive.
    The returned list and all of its elements (strings) must be freed when no longer needed */
 GList *bbbm_util_listdir(const gchar *dir);
 
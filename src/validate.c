@@ -0,0 +1,200 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "config.h"
+#include "validate.h"
+#include "util.h"
+#include "archive.h"
+#include "compat.h"
+
+/* checking files waits for the file system, not the CPU; keep several checks in flight */
+#define BBBM_VALIDATE_THREADS       8
+/* below this number of files starting threads costs more than it saves */
+#define BBBM_VALIDATE_SERIAL_LIMIT  32
+
+typedef struct {
+    const gchar **filenames;
+    BBBMValidateStatus *statuses;
+} BBBMValidateBatch;
+
+static void bbbm_validate_run(gpointer index, BBBMValidateBatch *batch);
+
+void bbbm_validate_files(const gchar **filenames, guint count, BBBMValidateStatus *statuses) {
+    BBBMValidateBatch batch;
+    GThreadPool *pool = NULL;
+    GError *error = NULL;
+    guint i;
+
+    g_return_if_fail(filenames != NULL || count == 0);
+    g_return_if_fail(statuses != NULL || count == 0);
+
+    if (count >= BBBM_VALIDATE_SERIAL_LIMIT) {
+        batch.filenames = filenames;
+        batch.statuses  = statuses;
+        pool = g_thread_pool_new((GFunc) bbbm_validate_run, &batch, BBBM_VALIDATE_THREADS, FALSE, &error);
+        if (pool == NULL) {
+            g_warning("could not create threads to check files: %s", error->message);
+            g_error_free(error);
+        }
+    }
+    if (pool == NULL) {
+        for (i = 0; i < count; ++i) {
+            statuses[i] = bbbm_validate_file(filenames[i]);
+        }
+        return;
+    }
+    for (i = 0; i < count; ++i) {
+        /* thread pools do not accept NULL data */
+        g_thread_pool_push(pool, GUINT_TO_POINTER(i + 1), NULL);
+    }
+    /* wait until all files have been checked */
+    g_thread_pool_free(pool, FALSE, TRUE);
+}
+
+BBBMValidateStatus bbbm_validate_file(const gchar *filename) {
+    struct stat info;
+
+    if (g_stat(filename, &info) == -1) {
+        int error = errno;
+
+        /* archive members cannot be looked up directly, since the archive is not a directory */
+        if (error == ENOTDIR && bbbm_archive_is_member(filename)) {
+            return bbbm_util_has_image_ext(filename) ? BBBM_VALIDATE_OK : BBBM_VALIDATE_NOT_AN_IMAGE;
+        }
+        return error == ENOENT || error == ENOTDIR ? BBBM_VALIDATE_MISSING : BBBM_VALIDATE_UNREADABLE;
+    }
+    if (!S_ISREG(info.st_mode) || !bbbm_util_has_image_ext(filename)) {
+        return BBBM_VALIDATE_NOT_AN_IMAGE;
+    }
+    if (g_access(filename, R_OK) == -1) {
+        return BBBM_VALIDATE_UNREADABLE;
+    }
+    return BBBM_VALIDATE_OK;
+}
+
+const gchar *bbbm_validate_status_to_string(BBBMValidateStatus status) {
+    switch (status) {
+        case BBBM_VALIDATE_OK:
+            return "ok";
+        case BBBM_VALIDATE_MISSING:
+            return "file not found";
+        case BBBM_VALIDATE_UNREADABLE:
+            return "file cannot be read";
+        case BBBM_VALIDATE_NOT_AN_IMAGE:
+            return "not an image";
+        default:
+            return "unknown";
+    }
+}
+
+guint bbbm_validate_relocate(const gchar *directory, const gchar **filenames, const gint64 *sizes, guint count,
+                             gchar **relocated) {
+    GHashTable *wanted;
+    gboolean *ambiguous;
+    GList *directories;
+    guint found = 0, i;
+
+    g_return_val_if_fail(directory != NULL, 0);
+    g_return_val_if_fail(relocated != NULL || count == 0, 0);
+
+    /* name -> indexes of the files with that name, plus one */
+    wanted = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_slist_free);
+    for (i = 0; i < count; ++i) {
+        gchar *name = g_path_get_basename(filenames[i]);
+        GSList *indexes = (GSList *) g_hash_table_lookup(wanted, name);
+
+        if (indexes != NULL) {
+            /* add after the head, so the list in the table stays valid */
+            indexes->next = g_slist_prepend(indexes->next, GUINT_TO_POINTER(i + 1));
+            g_free(name);
+        } else {
+            g_hash_table_insert(wanted, name, g_slist_prepend(NULL, GUINT_TO_POINTER(i + 1)));
+        }
+        relocated[i] = NULL;
+    }
+    ambiguous = g_new0(gboolean, count);
+
+    /* depth first, without following links to directories; those could lead back up the tree */
+    directories = g_list_prepend(NULL, g_strdup(directory));
+    while (directories != NULL) {
+        gchar *current = (gchar *) directories->data;
+        const gchar *entry;
+        GDir *dir;
+
+        directories = g_list_delete_link(directories, directories);
+        dir = g_dir_open(current, 0, NULL);
+        while (dir != NULL && (entry = g_dir_read_name(dir)) != NULL) {
+            gchar *path = g_build_filename(current, entry, NULL);
+            GSList *indexes;
+            struct stat info;
+
+            if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+                if (!g_file_test(path, G_FILE_TEST_IS_SYMLINK)) {
+                    directories = g_list_prepend(directories, path);
+                    continue;
+                }
+            } else if ((indexes = (GSList *) g_hash_table_lookup(wanted, entry)) != NULL
+                       && g_stat(path, &info) == 0) {
+                for (; indexes != NULL; indexes = indexes->next) {
+                    guint index = GPOINTER_TO_UINT(indexes->data) - 1;
+
+                    if (sizes != NULL && sizes[index] >= 0 && sizes[index] != info.st_size) {
+                        continue;
+                    }
+                    if (relocated[index] != NULL) {
+                        ambiguous[index] = TRUE;
+                    } else {
+                        relocated[index] = g_strdup(path);
+                    }
+                }
+            }
+            g_free(path);
+        }
+        if (dir != NULL) {
+            g_dir_close(dir);
+        }
+        g_free(current);
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (ambiguous[i]) {
+            g_debug("not relocating '%s': it matches more than one file", filenames[i]);
+            g_free(relocated[i]);
+            relocated[i] = NULL;
+        } else if (relocated[i] != NULL) {
+            g_debug("relocated '%s' to '%s'", filenames[i], relocated[i]);
+            ++found;
+        }
+    }
+    g_free(ambiguous);
+    g_hash_table_destroy(wanted);
+    return found;
+}
+
+static void bbbm_validate_run(gpointer index, BBBMValidateBatch *batch) {
+    guint i = GPOINTER_TO_UINT(index) - 1;
+
+    batch->statuses[i] = bbbm_validate_file(batch->filenames[i]);
+}
@@ -0,0 +1,52 @@
+/*
+ * bbbm - A background manager for Blackbox
+ * Copyright (C) 2004-2015 Rob Spoor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BBBM_VALIDATE_H_
+#define __BBBM_VALIDATE_H_
+
+#include <glib.h>
+
+typedef enum {
+    BBBM_VALIDATE_OK,
+    BBBM_VALIDATE_MISSING,
+    BBBM_VALIDATE_UNREADABLE,
+    BBBM_VALIDATE_NOT_AN_IMAGE
+} BBBMValidateStatus;
+
+/* Checks whether the given files exist, can be read and have the extension of an image, and stores the result for
+   each of them in statuses. Large numbers of files are checked by a pool of threads, since every check waits for
+   the file system; the call returns when all files have been checked */
+void bbbm_validate_files(const gchar **filenames, guint count, BBBMValidateStatus *statuses);
+
+/* Checks a single file like bbbm_validate_files, in the calling thread */
+BBBMValidateStatus bbbm_validate_file(const gchar *filename);
+
+/* Returns a description of the given status, such as "file not found" */
+const gchar *bbbm_validate_status_to_string(BBBMValidateStatus status);
+
+/* Searches the given directory and its subdirectories for files that have been moved there. A file matches if it
+   has the same name, and the same size if that is known; sizes of -1 are unknown. Files that match more than one
+   file are not relocated. The new locations are stored in relocated, which must have room for count elements;
+   its elements are NULL for files that were not found, and must be freed otherwise.
+   Returns the number of relocated files */
+guint bbbm_validate_relocate(const gchar *directory, const gchar **filenames, const gint64 *sizes, guint count,
+                             gchar **relocated);
+
+#endif /* __BBBM_VALIDATE_H_ */